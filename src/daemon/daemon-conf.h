@@ -68,6 +68,7 @@ typedef struct pa_daemon_conf {
         system_instance,
         no_cpu_limit,
         disable_shm,
+        disable_memfd,
         disable_remixing,
         disable_lfe_remixing,
         load_default_script_file,
@@ -76,7 +77,8 @@ typedef struct pa_daemon_conf {
         log_time,
         flat_volumes,
         lock_memory,
-        deferred_volume;
+        deferred_volume,
+        rewind_free_sinks;
     pa_server_type_t local_server_type;
     int exit_idle_time,
         scache_idle_time,
@@ -129,11 +131,14 @@ typedef struct pa_daemon_conf {
 
     unsigned default_n_fragments, default_fragment_size_msec;
     unsigned deferred_volume_safety_margin_usec;
+    unsigned rewind_free_max_latency_msec;
+    unsigned render_threads;
     int deferred_volume_extra_delay_usec;
     pa_sample_spec default_sample_spec;
     uint32_t alternate_sample_rate;
     pa_channel_map default_channel_map;
     size_t shm_size;
+    size_t shm_max_size;
 } pa_daemon_conf;
 
 /* Allocate a new structure and fill it with sane defaults */
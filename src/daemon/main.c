@@ -102,6 +102,10 @@
 #include "ltdl-bind-now.h"
 #include "server-lookup.h"
 
+/* How late time events in the main loop may be dispatched, so that
+ * timers due close to each other share a wakeup */
+#define MAINLOOP_TIMER_SLACK_USEC (5*PA_USEC_PER_MSEC)
+
 #ifdef HAVE_LIBWRAP
 /* Only one instance of these variables */
 int allow_severity = LOG_INFO;
@@ -1019,11 +1023,17 @@ int main(int argc, char *argv[]) {
 
     pa_assert_se(mainloop = pa_mainloop_new());
 
-    if (!(c = pa_core_new(pa_mainloop_get_api(mainloop), !conf->disable_shm, conf->shm_size))) {
+    /* Nothing in the main thread is timing critical, the realtime
+     * work happens in the IO threads */
+    pa_mainloop_set_timer_slack(mainloop, MAINLOOP_TIMER_SLACK_USEC);
+
+    if (!(c = pa_core_new(pa_mainloop_get_api(mainloop), !conf->disable_shm, !conf->disable_memfd, conf->shm_size))) {
         pa_log(_("pa_core_new() failed."));
         goto finish;
     }
 
+    pa_mempool_set_max_size(c->mempool, conf->shm_max_size);
+
     if (valid_pid_file)
         pid_monitor = pa_inotify_start(pa_pid_file_name(), c, pid_file_deleted, c);
 
@@ -1034,6 +1044,8 @@ int main(int argc, char *argv[]) {
     c->default_fragment_size_msec = conf->default_fragment_size_msec;
     c->deferred_volume_safety_margin_usec = conf->deferred_volume_safety_margin_usec;
     c->deferred_volume_extra_delay_usec = conf->deferred_volume_extra_delay_usec;
+    c->rewind_free_sinks = !!conf->rewind_free_sinks;
+    c->rewind_free_max_latency_msec = conf->rewind_free_max_latency_msec;
     c->exit_idle_time = conf->exit_idle_time;
     c->scache_idle_time = conf->scache_idle_time;
     c->resample_method = conf->resample_method;
@@ -1049,6 +1061,9 @@ int main(int argc, char *argv[]) {
     c->server_type = conf->local_server_type;
 #endif
 
+    if (conf->render_threads > 0)
+        c->render_pool = pa_render_pool_new(conf->render_threads, c->realtime_scheduling, c->realtime_priority);
+
     c->cpu_info.cpu_type = PA_CPU_UNDEFINED;
     if (!getenv("PULSE_NO_SIMD")) {
         if (pa_cpu_init_x86(&(c->cpu_info.flags.x86)))
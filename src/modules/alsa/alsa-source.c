@@ -1924,6 +1924,12 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
 
     if (u->use_tsched) {
         pa_log_info("Successfully enabled timer-based scheduling mode.");
+
+        /* Wake up at the exact deadline rather than after a rounded
+         * relative timeout */
+        if (pa_rtpoll_enable_timerfd(u->rtpoll) >= 0)
+            pa_log_debug("Using a timerfd for the wakeups.");
+
         if (u->fixed_latency_range)
             pa_log_info("Disabling latency range changes on overrun");
     }
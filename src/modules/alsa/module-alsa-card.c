@@ -68,6 +68,7 @@ PA_MODULE_USAGE(
         "fixed_latency_range=<disable latency range changes on underrun?> "
         "ignore_dB=<ignore dB information from the device?> "
         "deferred_volume=<Synchronize software and hardware volume changes to avoid momentary jumps?> "
+        "rewind_free=<keep the latency low instead of rewinding the device?> "
         "profile_set=<profile set configuration file> "
         "paths_dir=<directory containing the path configuration files> "
         "use_ucm=<load use case manager> "
@@ -95,6 +96,7 @@ static const char* const valid_modargs[] = {
     "profile",
     "ignore_dB",
     "deferred_volume",
+    "rewind_free",
     "profile_set",
     "paths_dir",
     "use_ucm",
@@ -62,6 +62,8 @@ static void handle_get_ports(DBusConnection *conn, DBusMessage *msg, void *userd
 static void handle_get_active_port(DBusConnection *conn, DBusMessage *msg, void *userdata);
 static void handle_set_active_port(DBusConnection *conn, DBusMessage *msg, DBusMessageIter *iter, void *userdata);
 static void handle_get_property_list(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_get_wakeup_lateness(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_get_processing_time(DBusConnection *conn, DBusMessage *msg, void *userdata);
 
 static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdata);
 
@@ -126,6 +128,8 @@ enum property_handler_index {
     PROPERTY_HANDLER_PORTS,
     PROPERTY_HANDLER_ACTIVE_PORT,
     PROPERTY_HANDLER_PROPERTY_LIST,
+    PROPERTY_HANDLER_WAKEUP_LATENESS,
+    PROPERTY_HANDLER_PROCESSING_TIME,
     PROPERTY_HANDLER_MAX
 };
 
@@ -164,7 +168,9 @@ static pa_dbus_property_handler property_handlers[PROPERTY_HANDLER_MAX] = {
     [PROPERTY_HANDLER_STATE]                             = { .property_name = "State",                         .type = "u",      .get_cb = handle_get_state,                             .set_cb = NULL },
     [PROPERTY_HANDLER_PORTS]                             = { .property_name = "Ports",                         .type = "ao",     .get_cb = handle_get_ports,                             .set_cb = NULL },
     [PROPERTY_HANDLER_ACTIVE_PORT]                       = { .property_name = "ActivePort",                    .type = "o",      .get_cb = handle_get_active_port,                       .set_cb = handle_set_active_port },
-    [PROPERTY_HANDLER_PROPERTY_LIST]                     = { .property_name = "PropertyList",                  .type = "a{say}", .get_cb = handle_get_property_list,                     .set_cb = NULL }
+    [PROPERTY_HANDLER_PROPERTY_LIST]                     = { .property_name = "PropertyList",                  .type = "a{say}", .get_cb = handle_get_property_list,                     .set_cb = NULL },
+    [PROPERTY_HANDLER_WAKEUP_LATENESS]                   = { .property_name = "WakeupLateness",                .type = "au",     .get_cb = handle_get_wakeup_lateness,                   .set_cb = NULL },
+    [PROPERTY_HANDLER_PROCESSING_TIME]                   = { .property_name = "ProcessingTime",                .type = "au",     .get_cb = handle_get_processing_time,                   .set_cb = NULL }
 };
 
 static pa_dbus_property_handler sink_property_handlers[SINK_PROPERTY_HANDLER_MAX] = {
@@ -779,6 +785,44 @@ static void handle_get_property_list(DBusConnection *conn, DBusMessage *msg, voi
     pa_dbus_send_proplist_variant_reply(conn, msg, d->proplist);
 }
 
+/* The histograms are sent as arrays of bucket counts, see
+ * pulsecore/histogram.h for the bucket boundaries */
+static const pa_histogram *get_wakeup_lateness(pa_dbusiface_device *d) {
+    return (d->type == PA_DEVICE_TYPE_SINK) ? &d->sink->io_stats.wakeup_lateness : &d->source->io_stats.wakeup_lateness;
+}
+
+/* For sinks the time spent rendering, for sources the time spent
+ * posting the captured data to the outputs */
+static const pa_histogram *get_processing_time(pa_dbusiface_device *d) {
+    return (d->type == PA_DEVICE_TYPE_SINK) ? &d->sink->io_stats.render_time : &d->source->io_stats.post_time;
+}
+
+static void handle_get_wakeup_lateness(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_device *d = userdata;
+    dbus_uint32_t counts[PA_HISTOGRAM_BUCKETS];
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(d);
+
+    pa_histogram_get(get_wakeup_lateness(d), counts, NULL);
+
+    pa_dbus_send_basic_array_variant_reply(conn, msg, DBUS_TYPE_UINT32, counts, PA_HISTOGRAM_BUCKETS);
+}
+
+static void handle_get_processing_time(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_device *d = userdata;
+    dbus_uint32_t counts[PA_HISTOGRAM_BUCKETS];
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(d);
+
+    pa_histogram_get(get_processing_time(d), counts, NULL);
+
+    pa_dbus_send_basic_array_variant_reply(conn, msg, DBUS_TYPE_UINT32, counts, PA_HISTOGRAM_BUCKETS);
+}
+
 static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdata) {
     pa_dbusiface_device *d = userdata;
     DBusMessage *reply = NULL;
@@ -811,6 +855,8 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
     const char **ports = NULL;
     unsigned n_ports = 0;
     const char *active_port = NULL;
+    dbus_uint32_t wakeup_lateness[PA_HISTOGRAM_BUCKETS];
+    dbus_uint32_t processing_time[PA_HISTOGRAM_BUCKETS];
     unsigned i = 0;
 
     pa_assert(conn);
@@ -871,6 +917,8 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
     ports = get_ports(d, &n_ports);
     if (d->active_port)
         active_port = pa_dbusiface_device_port_get_path(pa_hashmap_get(d->ports, d->active_port->name));
+    pa_histogram_get(get_wakeup_lateness(d), wakeup_lateness, NULL);
+    pa_histogram_get(get_processing_time(d), processing_time, NULL);
 
     pa_assert_se((reply = dbus_message_new_method_return(msg)));
 
@@ -910,6 +958,8 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
         pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_ACTIVE_PORT].property_name, DBUS_TYPE_OBJECT_PATH, &active_port);
 
     pa_dbus_append_proplist_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_PROPERTY_LIST].property_name, d->proplist);
+    pa_dbus_append_basic_array_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_WAKEUP_LATENESS].property_name, DBUS_TYPE_UINT32, wakeup_lateness, PA_HISTOGRAM_BUCKETS);
+    pa_dbus_append_basic_array_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_PROCESSING_TIME].property_name, DBUS_TYPE_UINT32, processing_time, PA_HISTOGRAM_BUCKETS);
 
     pa_assert_se(dbus_message_iter_close_container(&msg_iter, &dict_iter));
 
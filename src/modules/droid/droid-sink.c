@@ -247,6 +247,9 @@ static int thread_write(struct userdata *u) {
     const void *p;
     ssize_t wrote;
 
+    /* The HAL gets exactly one buffer per write, that's what our timing
+     * is based on. This is a reference to a rendered block as long as the
+     * buffer doesn't span two of them, only then the data is copied. */
     pa_memblockq_peek_fixed_size(u->memblockq, u->buffer_size, &c);
 
     /* We should be able to write everything in one go as long as memblock size
@@ -284,9 +287,17 @@ static void thread_render(struct userdata *u) {
     length = pa_memblockq_get_length(u->memblockq);
     missing = u->buffer_size * u->buffer_count - length;
 
-    if (missing > 0) {
+    /* Queue the blocks as pa_sink_render() hands them out. With a single
+     * input at unity volume they are the input's own blocks, which
+     * pa_sink_render_full() would copy into one block of its own as soon
+     * as the input has less than missing bytes in one piece. */
+    while (missing > 0) {
         pa_memchunk c;
-        pa_sink_render_full(u->sink, missing, &c);
+
+        pa_sink_render(u->sink, missing, &c);
+        pa_assert(c.length > 0 && c.length <= missing);
+        missing -= c.length;
+
         pa_memblockq_push_align(u->memblockq, &c);
         pa_memblock_unref(c.memblock);
     }
@@ -23,6 +23,7 @@
 #include <config.h>
 #endif
 
+#include <pulse/timeval.h>
 #include <pulse/volume.h>
 #include <pulse/xmalloc.h>
 
@@ -44,7 +45,8 @@ PA_MODULE_USAGE(
         "trigger_roles=<Comma separated list of roles which will trigger a ducking> "
         "ducking_roles=<Comma separated list of roles which will be ducked> "
         "global=<Should we operate globally or only inside the same device?>"
-        "volume=<Volume for the attenuated streams. Default: -20dB"
+        "volume=<Volume for the attenuated streams. Default: -20dB> "
+        "ramp_msec=<How long fading the attenuated streams in and out takes. Default: 100>"
 );
 
 static const char* const valid_modargs[] = {
@@ -52,17 +54,18 @@ static const char* const valid_modargs[] = {
     "ducking_roles",
     "global",
     "volume",
+    "ramp_msec",
     NULL
 };
 
 struct userdata {
     pa_core *core;
-    const char *name;
     pa_idxset *trigger_roles;
     pa_idxset *ducking_roles;
     pa_idxset *ducked_inputs;
     bool global;
     pa_volume_t volume;
+    pa_usec_t ramp;
     pa_hook_slot
         *sink_input_put_slot,
         *sink_input_unlink_slot,
@@ -126,17 +129,13 @@ static void apply_ducking_to_sink(struct userdata *u, pa_sink *s, pa_sink_input
 
         i = pa_idxset_get_by_data(u->ducked_inputs, j, NULL);
         if (duck && !i) {
-            pa_cvolume vol;
-            vol.channels = 1;
-            vol.values[0] = u->volume;
-
             pa_log_debug("Found a '%s' stream that should be ducked.", ducking_role);
-            pa_sink_input_add_volume_factor(j, u->name, &vol);
+            pa_sink_input_set_volume_ramp(j, u->volume, u->ramp, PA_VOLUME_RAMP_LOGARITHMIC);
             pa_idxset_put(u->ducked_inputs, j, NULL);
         } else if (!duck && i) { /* This stream should not longer be ducked */
             pa_log_debug("Found a '%s' stream that should be unducked", ducking_role);
             pa_idxset_remove_by_data(u->ducked_inputs, j, NULL);
-            pa_sink_input_remove_volume_factor(j, u->name);
+            pa_sink_input_set_volume_ramp(j, PA_VOLUME_NORM, u->ramp, PA_VOLUME_RAMP_LOGARITHMIC);
         }
     }
 }
@@ -203,6 +202,7 @@ int pa__init(pa_module *m) {
     pa_modargs *ma = NULL;
     struct userdata *u;
     const char *roles;
+    uint32_t ramp_msec;
 
     pa_assert(m);
 
@@ -214,7 +214,6 @@ int pa__init(pa_module *m) {
     m->userdata = u = pa_xnew0(struct userdata, 1);
 
     u->core = m->core;
-    u->name = m->name;
 
     u->ducked_inputs = pa_idxset_new(NULL, NULL);
 
@@ -265,6 +264,13 @@ int pa__init(pa_module *m) {
         goto fail;
     }
 
+    ramp_msec = 100;
+    if (pa_modargs_get_value_u32(ma, "ramp_msec", &ramp_msec) < 0) {
+        pa_log("Failed to parse a numeric parameter: ramp_msec");
+        goto fail;
+    }
+    u->ramp = (pa_usec_t) ramp_msec * PA_USEC_PER_MSEC;
+
     u->sink_input_put_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_INPUT_PUT], PA_HOOK_LATE, (pa_hook_cb_t) sink_input_put_cb, u);
     u->sink_input_unlink_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_INPUT_UNLINK], PA_HOOK_LATE, (pa_hook_cb_t) sink_input_unlink_cb, u);
     u->sink_input_move_start_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_INPUT_MOVE_START], PA_HOOK_LATE, (pa_hook_cb_t) sink_input_move_start_cb, u);
@@ -300,7 +306,7 @@ void pa__done(pa_module *m) {
 
     if (u->ducked_inputs) {
         while ((i = pa_idxset_steal_first(u->ducked_inputs, NULL)))
-            pa_sink_input_remove_volume_factor(i, u->name);
+            pa_sink_input_set_volume_ramp(i, PA_VOLUME_NORM, 0, PA_VOLUME_RAMP_LOGARITHMIC);
 
         pa_idxset_free(u->ducked_inputs, NULL);
     }
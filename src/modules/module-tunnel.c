@@ -1434,6 +1434,9 @@ static void start_subscribe(struct userdata *u) {
 #endif
                         );
 
+    if (u->version >= 31)
+        pa_tagstruct_put_boolean(t, FALSE);
+
     pa_pstream_send_tagstruct(u->pstream, t);
 }
 
@@ -1586,7 +1589,7 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
     support SHM here at all, so we just ignore this. */
 
     if (u->version >= 13)
-        u->version &= 0x7FFFFFFFU;
+        u->version &= 0x3FFFFFFFU;
 
     pa_log_debug("Protocol version: remote %u, local %u", u->version, PA_PROTOCOL_VERSION);
 
@@ -230,6 +230,16 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
 
     pa_assert(n > 0);
 
+    /* IF SILENCE STAYS SILENCE IN YOUR FILTER, PASS IT ON AS IT IS, SO
+     * THAT THE MASTER SINK DOESN'T HAVE TO MIX IT */
+    if (pa_memblock_is_silence(tchunk.memblock)) {
+        *chunk = tchunk;
+        chunk->length = n*fs;
+
+        pa_memblockq_drop(u->memblockq, chunk->length);
+        return 0;
+    }
+
     chunk->index = 0;
     chunk->length = n*fs;
     chunk->memblock = pa_memblock_new(i->sink->core->mempool, chunk->length);
@@ -59,6 +59,8 @@ static const pa_client_conf default_conf = {
     .default_dbus_server = NULL,
     .autospawn = TRUE,
     .disable_shm = FALSE,
+    .disable_memfd = FALSE,
+    .disable_shm_ring = FALSE,
     .cookie_file = NULL,
     .cookie_valid = FALSE,
     .shm_size = 0,
@@ -105,6 +107,10 @@ int pa_client_conf_load(pa_client_conf *c, const char *filename) {
         { "cookie-file",            pa_config_parse_string,   &c->cookie_file, NULL },
         { "disable-shm",            pa_config_parse_bool,     &c->disable_shm, NULL },
         { "enable-shm",             pa_config_parse_not_bool, &c->disable_shm, NULL },
+        { "disable-memfd",          pa_config_parse_bool,     &c->disable_memfd, NULL },
+        { "enable-memfd",           pa_config_parse_not_bool, &c->disable_memfd, NULL },
+        { "disable-shm-ring",       pa_config_parse_bool,     &c->disable_shm_ring, NULL },
+        { "enable-shm-ring",        pa_config_parse_not_bool, &c->disable_shm_ring, NULL },
         { "shm-size-bytes",         pa_config_parse_size,     &c->shm_size, NULL },
         { "auto-connect-localhost", pa_config_parse_bool,     &c->auto_connect_localhost, NULL },
         { "auto-connect-display",   pa_config_parse_bool,     &c->auto_connect_display, NULL },
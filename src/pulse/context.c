@@ -110,6 +110,8 @@ static void reset_callbacks(pa_context *c) {
 
     c->subscribe_callback = NULL;
     c->subscribe_userdata = NULL;
+    c->subscribe_payload_callback = NULL;
+    c->subscribe_payload_userdata = NULL;
 
     c->event_callback = NULL;
     c->event_userdata = NULL;
@@ -172,7 +174,12 @@ pa_context *pa_context_new_with_proplist(pa_mainloop_api *mainloop, const char *
 #endif
     pa_client_conf_env(c->conf);
 
-    if (!(c->mempool = pa_mempool_new(!c->conf->disable_shm, c->conf->shm_size))) {
+    c->mempool = NULL;
+
+    if (!c->conf->disable_shm && !c->conf->disable_memfd)
+        c->mempool = pa_mempool_new_memfd(c->conf->shm_size);
+
+    if (!c->mempool && !(c->mempool = pa_mempool_new(!c->conf->disable_shm, c->conf->shm_size))) {
 
         if (!c->conf->disable_shm)
             c->mempool = pa_mempool_new(FALSE, c->conf->shm_size);
@@ -425,7 +432,7 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
     switch(c->state) {
         case PA_CONTEXT_AUTHORIZING: {
             pa_tagstruct *reply;
-            pa_bool_t shm_on_remote = FALSE;
+            pa_bool_t shm_on_remote = FALSE, memfd_on_remote = FALSE;
 
             if (pa_tagstruct_getu32(t, &c->version) < 0 ||
                 !pa_tagstruct_eof(t)) {
@@ -444,7 +451,12 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
                not. */
             if (c->version >= 13) {
                 shm_on_remote = !!(c->version & 0x80000000U);
-                c->version &= 0x7FFFFFFFU;
+
+                /* Starting with protocol version 29 the second MSB
+                 * tells whether the other side does memfd */
+                memfd_on_remote = !!(c->version & 0x40000000U);
+
+                c->version &= 0x3FFFFFFFU;
             }
 
             pa_log_debug("Protocol version: remote %u, local %u", c->version, PA_PROTOCOL_VERSION);
@@ -470,6 +482,12 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
             pa_log_debug("Negotiated SHM: %s", pa_yes_no(c->do_shm));
             pa_pstream_enable_shm(c->pstream, c->do_shm);
 
+            if (!c->do_shm || c->version < 29 || !memfd_on_remote)
+                c->do_memfd = FALSE;
+
+            pa_log_debug("Negotiated memfd: %s", pa_yes_no(c->do_memfd));
+            pa_pstream_enable_memfd(c->pstream, c->do_memfd);
+
             reply = pa_tagstruct_command(c, PA_COMMAND_SET_CLIENT_NAME, &tag);
 
             if (c->version >= 13) {
@@ -535,9 +553,17 @@ static void setup_context(pa_context *c, pa_iochannel *io) {
 
     pa_log_debug("SHM possible: %s", pa_yes_no(c->do_shm));
 
+    /* Segment fds can only be passed over unix sockets */
+#ifdef HAVE_CREDS
+    c->do_memfd = c->do_shm && pa_iochannel_creds_supported(io);
+#else
+    c->do_memfd = FALSE;
+#endif
+
     /* Starting with protocol version 13 we use the MSB of the version
-     * tag for informing the other side if we could do SHM or not */
-    pa_tagstruct_putu32(t, PA_PROTOCOL_VERSION | (c->do_shm ? 0x80000000U : 0));
+     * tag for informing the other side if we could do SHM or not,
+     * since version 29 the second MSB for memfd */
+    pa_tagstruct_putu32(t, PA_PROTOCOL_VERSION | (c->do_shm ? 0x80000000U : 0) | (c->do_memfd ? 0x40000000U : 0));
     pa_tagstruct_put_arbitrary(t, c->conf->cookie, sizeof(c->conf->cookie));
 
 #ifdef HAVE_CREDS
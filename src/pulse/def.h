@@ -609,6 +609,56 @@ typedef enum pa_subscription_event_type {
 #define PA_SUBSCRIPTION_EVENT_TYPE_MASK PA_SUBSCRIPTION_EVENT_TYPE_MASK
 /** \endcond */
 
+/** Which properties of an object a change event is about. Sent along
+ * with change events of sinks, sources, sink inputs and source outputs
+ * to clients that subscribed with pa_context_subscribe_with_payload().
+ * \since 5.0 */
+typedef enum pa_subscription_field {
+    PA_SUBSCRIPTION_FIELD_NONE = 0x0000U,
+    /**< No field */
+
+    PA_SUBSCRIPTION_FIELD_VOLUME = 0x0001U,
+    /**< The volume changed */
+
+    PA_SUBSCRIPTION_FIELD_MUTE = 0x0002U,
+    /**< The mute switch changed */
+
+    PA_SUBSCRIPTION_FIELD_STATE = 0x0004U,
+    /**< The state of a sink or source changed, or a stream was
+     * corked or uncorked */
+
+    PA_SUBSCRIPTION_FIELD_OTHER = 0x8000U,
+    /**< Something else changed, the object needs to be queried to
+     * find out what */
+
+    PA_SUBSCRIPTION_FIELD_ALL = 0x8007U
+    /**< All fields */
+} pa_subscription_field_t;
+
+/** \cond fulldocs */
+#define PA_SUBSCRIPTION_FIELD_NONE PA_SUBSCRIPTION_FIELD_NONE
+#define PA_SUBSCRIPTION_FIELD_VOLUME PA_SUBSCRIPTION_FIELD_VOLUME
+#define PA_SUBSCRIPTION_FIELD_MUTE PA_SUBSCRIPTION_FIELD_MUTE
+#define PA_SUBSCRIPTION_FIELD_STATE PA_SUBSCRIPTION_FIELD_STATE
+#define PA_SUBSCRIPTION_FIELD_OTHER PA_SUBSCRIPTION_FIELD_OTHER
+#define PA_SUBSCRIPTION_FIELD_ALL PA_SUBSCRIPTION_FIELD_ALL
+/** \endcond */
+
+/** Flags for pa_context_get_info_batch(). \since 5.0 */
+typedef enum pa_info_batch_flags {
+    PA_INFO_BATCH_NOFLAGS = 0x0000U,
+    /**< Flag to pass when no specific options are needed */
+
+    PA_INFO_BATCH_NO_PROPLISTS = 0x0001U
+    /**< Leave the property lists of all objects empty. Saves a lot
+     * of bandwidth for clients that don't look at them. */
+} pa_info_batch_flags_t;
+
+/** \cond fulldocs */
+#define PA_INFO_BATCH_NOFLAGS PA_INFO_BATCH_NOFLAGS
+#define PA_INFO_BATCH_NO_PROPLISTS PA_INFO_BATCH_NO_PROPLISTS
+/** \endcond */
+
 /** A structure for all kinds of timing information of a stream. See
  * pa_stream_update_timing_info() and pa_stream_get_timing_info(). The
  * total output latency a sample that is written with
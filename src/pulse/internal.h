@@ -43,6 +43,7 @@
 #include <pulsecore/hashmap.h>
 #include <pulsecore/refcnt.h>
 #include <pulsecore/time-smoother.h>
+#include <pulsecore/shmring.h>
 #ifdef HAVE_DBUS
 #include <pulsecore/dbus-util.h>
 #endif
@@ -80,6 +81,8 @@ struct pa_context {
     void *state_userdata;
     pa_context_subscribe_cb_t subscribe_callback;
     void *subscribe_userdata;
+    pa_context_subscribe_payload_cb_t subscribe_payload_callback;
+    void *subscribe_payload_userdata;
     pa_context_event_cb_t event_callback;
     void *event_userdata;
 
@@ -87,6 +90,7 @@ struct pa_context {
 
     pa_bool_t is_local:1;
     pa_bool_t do_shm:1;
+    pa_bool_t do_memfd:1;
     pa_bool_t server_specified:1;
     pa_bool_t no_fail:1;
     pa_bool_t do_autospawn:1;
@@ -171,6 +175,11 @@ struct pa_stream {
     void *write_data;
     int64_t latest_underrun_at_index;
 
+    /* Ring buffer the server reads our data from, see write_ring() */
+    pa_shmring *ring;
+    uint32_t ring_barrier;
+    pa_bool_t ring_ready:1;
+
     /* recording */
     pa_memchunk peek_memchunk;
     void *peek_data;
@@ -2156,3 +2156,299 @@ pa_operation* pa_context_suspend_source_by_index(pa_context *c, uint32_t idx, in
 
     return o;
 }
+
+/*** Batch queries ***/
+
+struct info_batch {
+    pa_operation *operation;
+    pa_info_batch_callbacks callbacks;
+    pa_subscription_mask_t mask;
+};
+
+static void info_batch_free(struct info_batch *b) {
+    pa_assert(b);
+
+    pa_operation_unref(b->operation);
+    pa_xfree(b);
+}
+
+/* Returns the parser and the callback for a facility of a batch */
+static pa_pdispatch_cb_t info_batch_facility(const pa_info_batch_callbacks *cbs, uint32_t facility, pa_operation_cb_t *cb) {
+
+    switch (facility) {
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            *cb = (pa_operation_cb_t) cbs->sink;
+            return context_get_sink_info_callback;
+        case PA_SUBSCRIPTION_EVENT_SOURCE:
+            *cb = (pa_operation_cb_t) cbs->source;
+            return context_get_source_info_callback;
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            *cb = (pa_operation_cb_t) cbs->sink_input;
+            return context_get_sink_input_info_callback;
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            *cb = (pa_operation_cb_t) cbs->source_output;
+            return context_get_source_output_info_callback;
+        case PA_SUBSCRIPTION_EVENT_MODULE:
+            *cb = (pa_operation_cb_t) cbs->module;
+            return context_get_module_info_callback;
+        case PA_SUBSCRIPTION_EVENT_CLIENT:
+            *cb = (pa_operation_cb_t) cbs->client;
+            return context_get_client_info_callback;
+        case PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE:
+            *cb = (pa_operation_cb_t) cbs->sample;
+            return context_get_sample_info_callback;
+        case PA_SUBSCRIPTION_EVENT_CARD:
+            *cb = (pa_operation_cb_t) cbs->card;
+            return context_get_card_info_callback;
+    }
+
+    *cb = NULL;
+    return NULL;
+}
+
+static void context_get_info_batch_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    struct info_batch *b = userdata;
+    pa_info_batch_callbacks *cbs;
+    pa_operation *o;
+    pa_subscription_mask_t seen = 0;
+    uint32_t facility;
+
+    pa_assert(pd);
+    pa_assert(b);
+
+    o = b->operation;
+    cbs = &b->callbacks;
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, FALSE) < 0)
+            goto finish;
+
+        /* Let every requested list know that it failed */
+        if (cbs->sink)
+            cbs->sink(o->context, NULL, -1, o->userdata);
+        if (cbs->source)
+            cbs->source(o->context, NULL, -1, o->userdata);
+        if (cbs->sink_input)
+            cbs->sink_input(o->context, NULL, -1, o->userdata);
+        if (cbs->source_output)
+            cbs->source_output(o->context, NULL, -1, o->userdata);
+        if (cbs->module)
+            cbs->module(o->context, NULL, -1, o->userdata);
+        if (cbs->client)
+            cbs->client(o->context, NULL, -1, o->userdata);
+        if (cbs->card)
+            cbs->card(o->context, NULL, -1, o->userdata);
+        if (cbs->sample)
+            cbs->sample(o->context, NULL, -1, o->userdata);
+
+    } else {
+
+        /* Each list comes in a blob laid out like the reply to the
+         * matching list command, so we hand it to the same parser */
+        while (!pa_tagstruct_eof(t)) {
+            pa_pdispatch_cb_t parse;
+            pa_operation_cb_t cb;
+            pa_tagstruct *list;
+            const void *data;
+            uint32_t length;
+
+            if (pa_tagstruct_getu32(t, &facility) < 0 ||
+                pa_tagstruct_getu32(t, &length) < 0 ||
+                pa_tagstruct_get_arbitrary(t, &data, length) < 0 ||
+                !(parse = info_batch_facility(cbs, facility, &cb)) ||
+                !cb ||
+                (seen & (1U << facility))) {
+                pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                goto finish;
+            }
+
+            seen |= 1U << facility;
+
+            list = pa_tagstruct_new(length > 0 ? data : NULL, length);
+            parse(pd, PA_COMMAND_REPLY, tag, list, pa_operation_new(o->context, NULL, cb, o->userdata));
+            pa_tagstruct_free(list);
+
+            /* The parser fails the context on malformed lists */
+            if (!o->context)
+                goto finish;
+        }
+
+        if (seen != b->mask) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+    }
+
+    pa_operation_done(o);
+
+finish:
+    info_batch_free(b);
+}
+
+pa_operation* pa_context_get_info_batch(pa_context *c, const pa_info_batch_callbacks *cbs, pa_info_batch_flags_t flags, void *userdata) {
+    struct info_batch *b;
+    pa_tagstruct *t;
+    pa_operation *o;
+    uint32_t tag, facility;
+    pa_subscription_mask_t m = 0;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+    pa_assert(cbs);
+
+    for (facility = 0; facility <= PA_SUBSCRIPTION_EVENT_CARD; facility++) {
+        pa_operation_cb_t cb;
+
+        if (info_batch_facility(cbs, facility, &cb) && cb)
+            m |= 1U << facility;
+    }
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 32, PA_ERR_NOTSUPPORTED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, m != 0, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, (flags & ~PA_INFO_BATCH_NO_PROPLISTS) == 0, PA_ERR_INVALID);
+
+    o = pa_operation_new(c, NULL, NULL, userdata);
+
+    b = pa_xnew(struct info_batch, 1);
+    b->operation = pa_operation_ref(o);
+    b->callbacks = *cbs;
+    b->mask = m;
+
+    t = pa_tagstruct_command(c, PA_COMMAND_GET_INFO_BATCH, &tag);
+    pa_tagstruct_putu32(t, m);
+    pa_tagstruct_putu32(t, flags);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_info_batch_callback, b, (pa_free_cb_t) info_batch_free);
+
+    return o;
+}
+
+/*** IO thread statistics ***/
+
+/* Sanity limits for what the server sends */
+#define IO_STATS_HISTOGRAMS_MAX 32
+#define IO_STATS_BUCKETS_MAX 64
+
+static void context_get_io_stats_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    pa_io_stats_info i, *p = &i;
+    pa_io_stats_histogram *histograms = NULL;
+    uint32_t *buckets = NULL;
+    uint32_t j, k;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    pa_zero(i);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, FALSE) < 0)
+            goto finish;
+
+        p = NULL;
+    } else {
+        if (pa_tagstruct_getu32(t, &i.index) < 0 ||
+            pa_tagstruct_getu32(t, &i.n_histograms) < 0 ||
+            i.n_histograms > IO_STATS_HISTOGRAMS_MAX) {
+
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
+        histograms = pa_xnew0(pa_io_stats_histogram, PA_MAX(i.n_histograms, 1U));
+        buckets = pa_xnew(uint32_t, PA_MAX(i.n_histograms, 1U) * IO_STATS_BUCKETS_MAX);
+
+        for (j = 0; j < i.n_histograms; j++) {
+            pa_io_stats_histogram *h = &histograms[j];
+            uint32_t *b = buckets + j * IO_STATS_BUCKETS_MAX;
+
+            if (pa_tagstruct_gets(t, &h->name) < 0 ||
+                pa_tagstruct_get_usec(t, &h->max) < 0 ||
+                pa_tagstruct_getu32(t, &h->n_buckets) < 0 ||
+                !h->name ||
+                h->n_buckets > IO_STATS_BUCKETS_MAX) {
+
+                pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                goto finish;
+            }
+
+            for (k = 0; k < h->n_buckets; k++)
+                if (pa_tagstruct_getu32(t, &b[k]) < 0) {
+                    pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                    goto finish;
+                }
+
+            h->buckets = b;
+        }
+
+        if (!pa_tagstruct_eof(t)) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
+        i.histograms = histograms;
+    }
+
+    if (o->callback) {
+        pa_io_stats_info_cb_t cb = (pa_io_stats_info_cb_t) o->callback;
+        cb(o->context, p, o->userdata);
+    }
+
+finish:
+    pa_xfree(histograms);
+    pa_xfree(buckets);
+
+    pa_operation_done(o);
+    pa_operation_unref(o);
+}
+
+static pa_operation* get_io_stats(pa_context *c, uint32_t command, uint32_t idx, const char *name, pa_io_stats_info_cb_t cb, void *userdata) {
+    pa_tagstruct *t;
+    pa_operation *o;
+    uint32_t tag;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+    pa_assert(cb);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 33, PA_ERR_NOTSUPPORTED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !name || *name, PA_ERR_INVALID);
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+
+    t = pa_tagstruct_command(c, command, &tag);
+    pa_tagstruct_putu32(t, idx);
+    pa_tagstruct_puts(t, name);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_io_stats_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
+pa_operation* pa_context_get_sink_io_stats_by_name(pa_context *c, const char *name, pa_io_stats_info_cb_t cb, void *userdata) {
+    return get_io_stats(c, PA_COMMAND_GET_SINK_IO_STATS, PA_INVALID_INDEX, name, cb, userdata);
+}
+
+pa_operation* pa_context_get_sink_io_stats_by_index(pa_context *c, uint32_t idx, pa_io_stats_info_cb_t cb, void *userdata) {
+    return get_io_stats(c, PA_COMMAND_GET_SINK_IO_STATS, idx, NULL, cb, userdata);
+}
+
+pa_operation* pa_context_get_source_io_stats_by_name(pa_context *c, const char *name, pa_io_stats_info_cb_t cb, void *userdata) {
+    return get_io_stats(c, PA_COMMAND_GET_SOURCE_IO_STATS, PA_INVALID_INDEX, name, cb, userdata);
+}
+
+pa_operation* pa_context_get_source_io_stats_by_index(pa_context *c, uint32_t idx, pa_io_stats_info_cb_t cb, void *userdata) {
+    return get_io_stats(c, PA_COMMAND_GET_SOURCE_IO_STATS, idx, NULL, cb, userdata);
+}
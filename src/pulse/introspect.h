@@ -665,6 +665,70 @@ pa_operation* pa_context_get_sample_info_list(pa_context *c, pa_sample_info_cb_t
 
 /** @} */
 
+/** @{ \name Batch Queries */
+
+/** The callbacks for pa_context_get_info_batch(). Only the lists whose
+ * callback is not NULL are requested. \since 5.0 */
+typedef struct pa_info_batch_callbacks {
+    pa_sink_info_cb_t sink;                   /**< Called for every sink */
+    pa_source_info_cb_t source;               /**< Called for every source */
+    pa_sink_input_info_cb_t sink_input;       /**< Called for every sink input */
+    pa_source_output_info_cb_t source_output; /**< Called for every source output */
+    pa_module_info_cb_t module;               /**< Called for every module */
+    pa_client_info_cb_t client;               /**< Called for every client */
+    pa_card_info_cb_t card;                   /**< Called for every card */
+    pa_sample_info_cb_t sample;               /**< Called for every sample cache entry */
+} pa_info_batch_callbacks;
+
+/** Get several object lists from the daemon in a single round trip.
+ * The lists are a consistent snapshot of the server state. Each
+ * callback is called just like it would be for the matching
+ * pa_context_get_*_info_list() call, including the final call with
+ * eol set. The callbacks are copied, the structure does not need to
+ * stay around. The operation is done once all lists have been
+ * delivered. \since 5.0 */
+pa_operation* pa_context_get_info_batch(pa_context *c, const pa_info_batch_callbacks *cbs, pa_info_batch_flags_t flags, void *userdata);
+
+/** @} */
+
+/** @{ \name IO Thread Statistics */
+
+/** A histogram of durations measured in the IO thread of a sink or
+ * source. Bucket 0 counts durations below 1 usec, bucket n those from
+ * 2^(n-1) to below 2^n usec, and the last bucket everything longer.
+ * \since 5.0 */
+typedef struct pa_io_stats_histogram {
+    const char *name;                     /**< What was measured, for example "wakeup-lateness" or "render-time" */
+    pa_usec_t max;                        /**< The longest duration seen */
+    uint32_t n_buckets;                   /**< Number of entries in buckets */
+    const uint32_t *buckets;              /**< How many durations fell into each bucket */
+} pa_io_stats_histogram;
+
+/** Timing statistics of the IO thread of a sink or source. The
+ * counters run from the creation of the device. \since 5.0 */
+typedef struct pa_io_stats_info {
+    uint32_t index;                       /**< Index of the sink or source */
+    uint32_t n_histograms;                /**< Number of entries in histograms */
+    const pa_io_stats_histogram *histograms; /**< The histograms, which ones there are depends on the server version */
+} pa_io_stats_info;
+
+/** Callback prototype for pa_context_get_sink_io_stats_by_name() and friends. i is NULL on failure. \since 5.0 */
+typedef void (*pa_io_stats_info_cb_t)(pa_context *c, const pa_io_stats_info *i, void *userdata);
+
+/** Get the IO thread statistics of a sink by its name \since 5.0 */
+pa_operation* pa_context_get_sink_io_stats_by_name(pa_context *c, const char *name, pa_io_stats_info_cb_t cb, void *userdata);
+
+/** Get the IO thread statistics of a sink by its index \since 5.0 */
+pa_operation* pa_context_get_sink_io_stats_by_index(pa_context *c, uint32_t idx, pa_io_stats_info_cb_t cb, void *userdata);
+
+/** Get the IO thread statistics of a source by its name \since 5.0 */
+pa_operation* pa_context_get_source_io_stats_by_name(pa_context *c, const char *name, pa_io_stats_info_cb_t cb, void *userdata);
+
+/** Get the IO thread statistics of a source by its index \since 5.0 */
+pa_operation* pa_context_get_source_io_stats_by_index(pa_context *c, uint32_t idx, pa_io_stats_info_cb_t cb, void *userdata);
+
+/** @} */
+
 /** \cond fulldocs */
 
 /** @{ \name Autoload Entries */
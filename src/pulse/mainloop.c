@@ -34,6 +34,11 @@
 #include <pulsecore/pipe.h>
 #endif
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#define HAVE_EPOLL 1
+#endif
+
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
 #include <pulse/xmalloc.h>
@@ -72,8 +77,13 @@ struct pa_time_event {
 
     pa_bool_t enabled:1;
     pa_bool_t use_rtclock:1;
+    pa_bool_t dispatch_pending:1;
     pa_usec_t time;
 
+    /* Position in the heap of enabled time events */
+    unsigned heap_index;
+    pa_time_event *next_expired;
+
     pa_time_event_cb_t callback;
     void *userdata;
     pa_time_event_destroy_cb_t destroy_callback;
@@ -107,7 +117,11 @@ struct pa_mainloop {
     unsigned max_pollfds, n_pollfds;
 
     pa_usec_t prepared_timeout;
-    pa_time_event *cached_next_time_event;
+
+    /* The enabled time events, as a binary min-heap on their time */
+    pa_time_event **time_heap;
+    unsigned n_time_heap, max_time_heap;
+    pa_usec_t timer_slack;
 
     pa_mainloop_api api;
 
@@ -129,6 +143,15 @@ struct pa_mainloop {
     pa_poll_func poll_func;
     void *poll_func_userdata;
     int poll_func_ret;
+
+#ifdef HAVE_EPOLL
+    /* With epoll the io events stay registered with the kernel, and
+     * only the ready ones are looked at. -1 if we use poll(). */
+    int epoll_fd;
+    struct epoll_event *epoll_events;
+    unsigned max_epoll_events;
+    pa_bool_t polled_epoll:1;
+#endif
 };
 
 static short map_flags_to_libc(pa_io_event_flags_t flags) {
@@ -147,6 +170,126 @@ static pa_io_event_flags_t map_flags_from_libc(short flags) {
         (flags & POLLHUP ? PA_IO_EVENT_HANGUP : 0);
 }
 
+#ifdef HAVE_EPOLL
+static uint32_t map_flags_to_epoll(pa_io_event_flags_t flags) {
+    return
+        (flags & PA_IO_EVENT_INPUT ? EPOLLIN : 0) |
+        (flags & PA_IO_EVENT_OUTPUT ? EPOLLOUT : 0) |
+        (flags & PA_IO_EVENT_ERROR ? EPOLLERR : 0) |
+        (flags & PA_IO_EVENT_HANGUP ? EPOLLHUP : 0);
+}
+
+static pa_io_event_flags_t map_flags_from_epoll(uint32_t flags) {
+    return
+        (flags & EPOLLIN ? PA_IO_EVENT_INPUT : 0) |
+        (flags & EPOLLOUT ? PA_IO_EVENT_OUTPUT : 0) |
+        (flags & EPOLLERR ? PA_IO_EVENT_ERROR : 0) |
+        (flags & EPOLLHUP ? PA_IO_EVENT_HANGUP : 0);
+}
+
+static int epoll_init(pa_mainloop *m) {
+    struct epoll_event ev;
+
+    pa_assert(m);
+    pa_assert(m->epoll_fd < 0);
+
+    if ((m->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        pa_log_debug("epoll_create1() failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    pa_zero(ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+
+    if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, m->wakeup_pipe[0], &ev) < 0) {
+        pa_log_debug("Failed to add wakeup pipe to epoll set: %s", pa_cstrerror(errno));
+        pa_close(m->epoll_fd);
+        m->epoll_fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Called whenever the set of io events changed. Returns -1 if the
+ * kernel refused the fd, in which case the caller should go back to
+ * poll(). Some fds can't be used with epoll, regular files for
+ * example, and two io events can't share an fd. */
+static int epoll_update(pa_mainloop *m, pa_io_event *e, int op) {
+    struct epoll_event ev;
+
+    pa_assert(m);
+    pa_assert(e);
+    pa_assert(m->epoll_fd >= 0);
+
+    pa_zero(ev);
+    ev.events = map_flags_to_epoll(e->events);
+    ev.data.ptr = e;
+
+    if (epoll_ctl(m->epoll_fd, op, e->fd, &ev) < 0) {
+        pa_log_debug("epoll_ctl() failed for fd %i: %s", e->fd, pa_cstrerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+static void epoll_fallback(pa_mainloop *m) {
+    pa_assert(m);
+
+    /* The array from the last epoll_wait() might still be dispatched
+     * from, so only the fd goes away now */
+    pa_close(m->epoll_fd);
+    m->epoll_fd = -1;
+
+    m->rebuild_pollfds = TRUE;
+}
+
+/* The kernel registers the file behind an fd, not the fd itself. If
+ * the owner of an io event closed its fd before freeing the event,
+ * the registration can't be removed anymore while a dup of the fd is
+ * still open, and it would keep pointing to the freed event. The
+ * same fd number might even belong to another io event by now. Hence
+ * start over with a new epoll set then. */
+static void epoll_reset(pa_mainloop *m) {
+    pa_io_event *e;
+
+    pa_assert(m);
+
+    pa_close(m->epoll_fd);
+    m->epoll_fd = -1;
+
+    if (epoll_init(m) < 0) {
+        m->rebuild_pollfds = TRUE;
+        return;
+    }
+
+    PA_LLIST_FOREACH(e, m->io_events)
+        if (!e->dead && epoll_update(m, e, EPOLL_CTL_ADD) < 0) {
+            epoll_fallback(m);
+            return;
+        }
+}
+
+static void epoll_remove(pa_mainloop *m, pa_io_event *e) {
+    pa_io_event *i;
+
+    pa_assert(m);
+    pa_assert(e);
+    pa_assert(e->dead);
+
+    PA_LLIST_FOREACH(i, m->io_events)
+        if (!i->dead && i->fd == e->fd) {
+            epoll_reset(m);
+            return;
+        }
+
+    if (epoll_update(m, e, EPOLL_CTL_DEL) < 0)
+        epoll_reset(m);
+}
+#endif
+
 /* IO events */
 static pa_io_event* mainloop_io_new(
         pa_mainloop_api *a,
@@ -179,6 +322,11 @@ static pa_io_event* mainloop_io_new(
     m->rebuild_pollfds = TRUE;
     m->n_io_events ++;
 
+#ifdef HAVE_EPOLL
+    if (m->epoll_fd >= 0 && epoll_update(m, e, EPOLL_CTL_ADD) < 0)
+        epoll_fallback(m);
+#endif
+
     pa_mainloop_wakeup(m);
 
     return e;
@@ -193,6 +341,12 @@ static void mainloop_io_enable(pa_io_event *e, pa_io_event_flags_t events) {
 
     e->events = events;
 
+#ifdef HAVE_EPOLL
+    if (e->mainloop->epoll_fd >= 0) {
+        if (epoll_update(e->mainloop, e, EPOLL_CTL_MOD) < 0)
+            epoll_reset(e->mainloop);
+    } else
+#endif
     if (e->pollfd)
         e->pollfd->events = map_flags_to_libc(events);
     else
@@ -211,6 +365,11 @@ static void mainloop_io_free(pa_io_event *e) {
     e->mainloop->n_io_events --;
     e->mainloop->rebuild_pollfds = TRUE;
 
+#ifdef HAVE_EPOLL
+    if (e->mainloop->epoll_fd >= 0)
+        epoll_remove(e->mainloop, e);
+#endif
+
     pa_mainloop_wakeup(e->mainloop);
 }
 
@@ -289,6 +448,85 @@ static void mainloop_defer_set_destroy(pa_defer_event *e, pa_defer_event_destroy
 }
 
 /* Time events */
+static void time_heap_set(pa_mainloop *m, unsigned i, pa_time_event *e) {
+    m->time_heap[i] = e;
+    e->heap_index = i;
+}
+
+static void time_heap_up(pa_mainloop *m, unsigned i) {
+    pa_time_event *e = m->time_heap[i];
+
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+
+        if (m->time_heap[parent]->time <= e->time)
+            break;
+
+        time_heap_set(m, i, m->time_heap[parent]);
+        i = parent;
+    }
+
+    time_heap_set(m, i, e);
+}
+
+static void time_heap_down(pa_mainloop *m, unsigned i) {
+    pa_time_event *e = m->time_heap[i];
+
+    for (;;) {
+        unsigned child = 2 * i + 1;
+
+        if (child >= m->n_time_heap)
+            break;
+
+        if (child + 1 < m->n_time_heap && m->time_heap[child + 1]->time < m->time_heap[child]->time)
+            child++;
+
+        if (e->time <= m->time_heap[child]->time)
+            break;
+
+        time_heap_set(m, i, m->time_heap[child]);
+        i = child;
+    }
+
+    time_heap_set(m, i, e);
+}
+
+static void time_heap_insert(pa_mainloop *m, pa_time_event *e) {
+    pa_assert(e->heap_index == PA_INVALID_INDEX);
+
+    if (m->n_time_heap >= m->max_time_heap) {
+        m->max_time_heap = PA_MAX(2 * m->max_time_heap, 16U);
+        m->time_heap = pa_xrealloc(m->time_heap, sizeof(pa_time_event*) * m->max_time_heap);
+    }
+
+    time_heap_set(m, m->n_time_heap++, e);
+    time_heap_up(m, e->heap_index);
+}
+
+static void time_heap_remove(pa_mainloop *m, pa_time_event *e) {
+    unsigned i = e->heap_index;
+    pa_time_event *last;
+
+    pa_assert(i < m->n_time_heap);
+    pa_assert(m->time_heap[i] == e);
+
+    e->heap_index = PA_INVALID_INDEX;
+    last = m->time_heap[--m->n_time_heap];
+
+    if (last == e)
+        return;
+
+    time_heap_set(m, i, last);
+    time_heap_up(m, i);
+    time_heap_down(m, last->heap_index);
+}
+
+/* Moves e after its time changed */
+static void time_heap_update(pa_mainloop *m, pa_time_event *e) {
+    time_heap_up(m, e->heap_index);
+    time_heap_down(m, e->heap_index);
+}
+
 static pa_usec_t make_rt(const struct timeval *tv, pa_bool_t *use_rtclock) {
     struct timeval ttv;
 
@@ -330,19 +568,14 @@ static pa_time_event* mainloop_time_new(
 
     e = pa_xnew0(pa_time_event, 1);
     e->mainloop = m;
+    e->heap_index = PA_INVALID_INDEX;
 
     if ((e->enabled = (t != PA_USEC_INVALID))) {
         e->time = t;
         e->use_rtclock = use_rtclock;
 
         m->n_enabled_time_events++;
-
-        if (m->cached_next_time_event) {
-            pa_assert(m->cached_next_time_event->enabled);
-
-            if (t < m->cached_next_time_event->time)
-                m->cached_next_time_event = e;
-        }
+        time_heap_insert(m, e);
     }
 
     e->callback = callback;
@@ -366,26 +599,30 @@ static void mainloop_time_restart(pa_time_event *e, const struct timeval *tv) {
 
     t = make_rt(tv, &use_rtclock);
 
+    /* If it expired but wasn't dispatched yet, the new time wins */
+    e->dispatch_pending = FALSE;
+
     valid = (t != PA_USEC_INVALID);
     if (e->enabled && !valid) {
         pa_assert(e->mainloop->n_enabled_time_events > 0);
         e->mainloop->n_enabled_time_events--;
+        time_heap_remove(e->mainloop, e);
     } else if (!e->enabled && valid)
         e->mainloop->n_enabled_time_events++;
 
-    if ((e->enabled = valid)) {
+    if (valid) {
         e->time = t;
         e->use_rtclock = use_rtclock;
+
+        if (e->enabled)
+            time_heap_update(e->mainloop, e);
+        else
+            time_heap_insert(e->mainloop, e);
+
         pa_mainloop_wakeup(e->mainloop);
     }
 
-    if (e->mainloop->cached_next_time_event && e->enabled) {
-        pa_assert(e->mainloop->cached_next_time_event->enabled);
-
-        if (t < e->mainloop->cached_next_time_event->time)
-            e->mainloop->cached_next_time_event = e;
-    } else if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
+    e->enabled = valid;
 }
 
 static void mainloop_time_free(pa_time_event *e) {
@@ -393,17 +630,16 @@ static void mainloop_time_free(pa_time_event *e) {
     pa_assert(!e->dead);
 
     e->dead = TRUE;
+    e->dispatch_pending = FALSE;
     e->mainloop->time_events_please_scan ++;
 
     if (e->enabled) {
         pa_assert(e->mainloop->n_enabled_time_events > 0);
         e->mainloop->n_enabled_time_events--;
         e->enabled = FALSE;
+        time_heap_remove(e->mainloop, e);
     }
 
-    if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
-
     /* no wakeup needed here. Think about it! */
 }
 
@@ -473,6 +709,13 @@ pa_mainloop *pa_mainloop_new(void) {
 
     m->poll_func_ret = -1;
 
+#ifdef HAVE_EPOLL
+    m->epoll_fd = -1;
+
+    if (getenv("PULSE_MAINLOOP_EPOLL"))
+        epoll_init(m);
+#endif
+
     return m;
 }
 
@@ -524,6 +767,7 @@ static void cleanup_time_events(pa_mainloop *m, pa_bool_t force) {
                 pa_assert(m->n_enabled_time_events > 0);
                 m->n_enabled_time_events--;
                 e->enabled = FALSE;
+                time_heap_remove(m, e);
             }
 
             if (e->destroy_callback)
@@ -577,6 +821,14 @@ void pa_mainloop_free(pa_mainloop *m) {
     cleanup_time_events(m, TRUE);
 
     pa_xfree(m->pollfds);
+    pa_xfree(m->time_heap);
+
+#ifdef HAVE_EPOLL
+    if (m->epoll_fd >= 0)
+        pa_close(m->epoll_fd);
+
+    pa_xfree(m->epoll_events);
+#endif
 
     pa_close_pipe(m->wakeup_pipe);
 
@@ -663,6 +915,45 @@ static unsigned dispatch_pollfds(pa_mainloop *m) {
     return r;
 }
 
+#ifdef HAVE_EPOLL
+static void prepare_epoll(pa_mainloop *m) {
+    unsigned l;
+
+    /* Room for every fd, so that each wakeup reports all ready ones */
+    l = m->n_io_events + 1;
+    if (m->max_epoll_events < l) {
+        l *= 2;
+        m->epoll_events = pa_xrealloc(m->epoll_events, sizeof(struct epoll_event)*l);
+        m->max_epoll_events = l;
+    }
+}
+
+static unsigned dispatch_epoll(pa_mainloop *m) {
+    unsigned r = 0, i;
+
+    pa_assert(m->poll_func_ret > 0);
+
+    for (i = 0; i < (unsigned) m->poll_func_ret; i++) {
+        pa_io_event *e;
+
+        if (m->quit)
+            break;
+
+        /* The wakeup pipe has no io event. Io events freed since the
+         * wait are kept around until the next scan_dead(). */
+        if (!(e = m->epoll_events[i].data.ptr) || e->dead)
+            continue;
+
+        pa_assert(e->callback);
+
+        e->callback(&m->api, e, e->fd, map_flags_from_epoll(m->epoll_events[i].events), e->userdata);
+        r++;
+    }
+
+    return r;
+}
+#endif
+
 static unsigned dispatch_defer(pa_mainloop *m) {
     pa_defer_event *e;
     unsigned r = 0;
@@ -687,33 +978,27 @@ static unsigned dispatch_defer(pa_mainloop *m) {
 }
 
 static pa_time_event* find_next_time_event(pa_mainloop *m) {
-    pa_time_event *t, *n = NULL;
     pa_assert(m);
+    pa_assert(m->n_time_heap == m->n_enabled_time_events);
 
-    if (m->cached_next_time_event)
-        return m->cached_next_time_event;
-
-    PA_LLIST_FOREACH(t, m->time_events) {
-
-        if (t->dead || !t->enabled)
-            continue;
+    return m->n_time_heap > 0 ? m->time_heap[0] : NULL;
+}
 
-        if (!n || t->time < n->time) {
-            n = t;
+/* The latest time of the events in the subheap at i that are due no
+ * later than limit. Subheaps whose root is due later are skipped. */
+static pa_usec_t latest_time_until(pa_mainloop *m, unsigned i, pa_usec_t limit, pa_usec_t latest) {
 
-            /* Shortcut for time == 0 */
-            if (n->time == 0)
-                break;
-        }
-    }
+    if (i >= m->n_time_heap || m->time_heap[i]->time > limit)
+        return latest;
 
-    m->cached_next_time_event = n;
-    return n;
+    latest = PA_MAX(latest, m->time_heap[i]->time);
+    latest = latest_time_until(m, 2 * i + 1, limit, latest);
+    return latest_time_until(m, 2 * i + 2, limit, latest);
 }
 
 static pa_usec_t calc_next_timeout(pa_mainloop *m) {
     pa_time_event *t;
-    pa_usec_t clock_now;
+    pa_usec_t clock_now, wakeup;
 
     if (m->n_enabled_time_events <= 0)
         return PA_USEC_INVALID;
@@ -728,11 +1013,18 @@ static pa_usec_t calc_next_timeout(pa_mainloop *m) {
     if (t->time <= clock_now)
         return 0;
 
-    return t->time - clock_now;
+    /* Wake up for the last of the events due within the slack after
+     * the first one, so that they are all dispatched together */
+    wakeup = t->time;
+
+    if (m->timer_slack > 0)
+        wakeup = latest_time_until(m, 0, t->time + m->timer_slack, wakeup);
+
+    return wakeup - clock_now;
 }
 
 static unsigned dispatch_timeout(pa_mainloop *m) {
-    pa_time_event *e;
+    pa_time_event *e, *expired = NULL, **tail = &expired;
     pa_usec_t now;
     unsigned r = 0;
     pa_assert(m);
@@ -742,25 +1034,41 @@ static unsigned dispatch_timeout(pa_mainloop *m) {
 
     now = pa_rtclock_now();
 
-    PA_LLIST_FOREACH(e, m->time_events) {
+    /* Take all expired events off the heap first, so that callbacks
+     * restarting their event for a time already passed don't get
+     * called again in this iteration */
+    while ((e = find_next_time_event(m)) && e->time <= now) {
+        time_heap_remove(m, e);
+        e->enabled = FALSE;
+        m->n_enabled_time_events--;
 
-        if (m->quit)
-            break;
+        e->dispatch_pending = TRUE;
+        e->next_expired = NULL;
+        *tail = e;
+        tail = &e->next_expired;
+    }
 
-        if (e->dead || !e->enabled)
+    /* Freed events stay allocated until the next scan_dead() */
+    for (e = expired; e; e = e->next_expired) {
+        struct timeval tv;
+
+        if (!e->dispatch_pending)
             continue;
 
-        if (e->time <= now) {
-            struct timeval tv;
-            pa_assert(e->callback);
+        e->dispatch_pending = FALSE;
 
-            /* Disable time event */
-            mainloop_time_restart(e, NULL);
+        if (m->quit) {
+            /* Keep it for whoever iterates the loop next */
+            e->enabled = TRUE;
+            m->n_enabled_time_events++;
+            time_heap_insert(m, e);
+            continue;
+        }
 
-            e->callback(&m->api, e, pa_timeval_rtstore(&tv, e->time, e->use_rtclock), e->userdata);
+        pa_assert(e->callback);
+        e->callback(&m->api, e, pa_timeval_rtstore(&tv, e->time, e->use_rtclock), e->userdata);
 
-            r++;
-        }
+        r++;
     }
 
     return r;
@@ -770,11 +1078,15 @@ void pa_mainloop_wakeup(pa_mainloop *m) {
     char c = 'W';
     pa_assert(m);
 
+    /* Until clear_wakeup() ran there's a byte in the pipe already, no
+     * need to write another one. Restarting many time events would
+     * otherwise cost a syscall each. */
+    if (!pa_atomic_cmpxchg(&m->wakeup_requested, FALSE, TRUE))
+        return;
+
     if (pa_write(m->wakeup_pipe[1], &c, sizeof(c), &m->wakeup_pipe_type) < 0)
         /* Not much options for recovering from the error. Let's at least log something. */
         pa_log("pa_write() failed while trying to wake up the mainloop: %s", pa_cstrerror(errno));
-
-    pa_atomic_store(&m->wakeup_requested, TRUE);
 }
 
 static void clear_wakeup(pa_mainloop *m) {
@@ -782,10 +1094,18 @@ static void clear_wakeup(pa_mainloop *m) {
 
     pa_assert(m);
 
-    if (pa_atomic_cmpxchg(&m->wakeup_requested, TRUE, FALSE)) {
-        while (pa_read(m->wakeup_pipe[0], &c, sizeof(c), &m->wakeup_pipe_type) == sizeof(c))
-            ;
-    }
+    if (!pa_atomic_load(&m->wakeup_requested))
+        return;
+
+    /* Drain before clearing the flag. Otherwise a wakeup in between
+     * would have its byte drained right away, while the flag still
+     * keeps all later wakeups from writing a new one. A wakeup before
+     * the flag is cleared doesn't need a byte, its changes are seen
+     * when we prepare the next poll. */
+    while (pa_read(m->wakeup_pipe[0], &c, sizeof(c), &m->wakeup_pipe_type) == sizeof(c))
+        ;
+
+    pa_atomic_store(&m->wakeup_requested, FALSE);
 }
 
 int pa_mainloop_prepare(pa_mainloop *m, int timeout) {
@@ -800,6 +1120,11 @@ int pa_mainloop_prepare(pa_mainloop *m, int timeout) {
 
     if (m->n_enabled_defer_events <= 0) {
 
+#ifdef HAVE_EPOLL
+        if (m->epoll_fd >= 0)
+            prepare_epoll(m);
+        else
+#endif
         if (m->rebuild_pollfds)
             rebuild_pollfds(m);
 
@@ -841,8 +1166,27 @@ int pa_mainloop_poll(pa_mainloop *m) {
 
     m->state = STATE_POLLING;
 
+#ifdef HAVE_EPOLL
+    m->polled_epoll = FALSE;
+#endif
+
     if (m->n_enabled_defer_events )
         m->poll_func_ret = 0;
+#ifdef HAVE_EPOLL
+    else if (m->epoll_fd >= 0) {
+        m->polled_epoll = TRUE;
+        m->poll_func_ret = epoll_wait(
+                m->epoll_fd, m->epoll_events, (int) m->max_epoll_events,
+                usec_to_timeout(m->prepared_timeout));
+
+        if (m->poll_func_ret < 0) {
+            if (errno == EINTR)
+                m->poll_func_ret = 0;
+            else
+                pa_log("epoll_wait(): %s", pa_cstrerror(errno));
+        }
+    }
+#endif
     else {
         pa_assert(!m->rebuild_pollfds);
 
@@ -900,8 +1244,14 @@ int pa_mainloop_dispatch(pa_mainloop *m) {
         if (m->quit)
             goto quit;
 
-        if (m->poll_func_ret > 0)
+        if (m->poll_func_ret > 0) {
+#ifdef HAVE_EPOLL
+            if (m->polled_epoll)
+                dispatched += dispatch_epoll(m);
+            else
+#endif
             dispatched += dispatch_pollfds(m);
+        }
     }
 
     if (m->quit)
@@ -972,11 +1322,24 @@ pa_mainloop_api* pa_mainloop_get_api(pa_mainloop *m) {
     return &m->api;
 }
 
+void pa_mainloop_set_timer_slack(pa_mainloop *m, pa_usec_t slack) {
+    pa_assert(m);
+    pa_assert(slack != PA_USEC_INVALID);
+
+    m->timer_slack = slack;
+}
+
 void pa_mainloop_set_poll_func(pa_mainloop *m, pa_poll_func poll_func, void *userdata) {
     pa_assert(m);
 
     m->poll_func = poll_func;
     m->poll_func_userdata = userdata;
+
+#ifdef HAVE_EPOLL
+    /* A custom poll function wants to see the pollfd array */
+    if (poll_func && m->epoll_fd >= 0)
+        epoll_fallback(m);
+#endif
 }
 
 pa_bool_t pa_mainloop_is_our_api(pa_mainloop_api *m) {
@@ -24,6 +24,7 @@
 ***/
 
 #include <pulse/mainloop-api.h>
+#include <pulse/sample.h>
 #include <pulse/cdecl.h>
 
 PA_C_DECL_BEGIN
@@ -128,6 +129,12 @@ typedef int (*pa_poll_func)(struct pollfd *ufds, unsigned long nfds, int timeout
 /** Change the poll() implementation */
 void pa_mainloop_set_poll_func(pa_mainloop *m, pa_poll_func poll_func, void *userdata);
 
+/** Allow time events to be dispatched up to the specified number of
+ * microseconds late, so that events due close to each other are
+ * dispatched in one go and the main loop wakes up less often. Time
+ * events are never dispatched early. Defaults to 0. \since 5.0 */
+void pa_mainloop_set_timer_slack(pa_mainloop *m, pa_usec_t slack);
+
 PA_C_DECL_END
 
 #endif
@@ -53,6 +53,9 @@
 #define SMOOTHER_HISTORY_TIME (5000*PA_USEC_PER_MSEC)
 #define SMOOTHER_MIN_HISTORY (4)
 
+/* Room in the ring buffer that data frames leave free for barriers */
+#define RING_BARRIER_RESERVE (64*16)
+
 pa_stream *pa_stream_new(pa_context *c, const char *name, const pa_sample_spec *ss, const pa_channel_map *map) {
     return pa_stream_new_with_proplist(c, name, ss, map, NULL);
 }
@@ -174,6 +177,10 @@ static pa_stream *pa_stream_new_with_proplist_internal(
     s->write_memblock = NULL;
     s->write_data = NULL;
 
+    s->ring = NULL;
+    s->ring_barrier = 0;
+    s->ring_ready = FALSE;
+
     pa_memchunk_reset(&s->peek_memchunk);
     s->peek_data = NULL;
     s->record_memblockq = NULL;
@@ -259,6 +266,12 @@ static void stream_unlink(pa_stream *s) {
     if (s->context->pdispatch)
         pa_pdispatch_unregister_reply(s->context->pdispatch, s);
 
+    if (s->ring) {
+        pa_shmring_free(s->ring);
+        s->ring = NULL;
+        s->ring_ready = FALSE;
+    }
+
     if (s->channel_valid) {
         pa_hashmap_remove((s->direction == PA_STREAM_RECORD) ? s->context->record_streams : s->context->playback_streams, PA_UINT32_TO_PTR(s->channel));
         s->channel = 0;
@@ -961,11 +974,175 @@ static void auto_timing_update_callback(pa_mainloop_api *m, pa_time_event *e, co
     pa_stream_unref(s);
 }
 
+/* The server never attached to the ring, hence everything we wrote
+ * into it is still there and can be sent through the socket
+ * instead. That only keeps the order intact if nothing went past the
+ * ring yet and no command was issued in between. */
+static int reclaim_ring(pa_stream *s) {
+    pa_shmring_frame f;
+    const void *data;
+    int r;
+
+    pa_assert(s);
+    pa_assert(s->ring);
+
+    if (!s->ring_ready || s->ring_barrier > 0)
+        return -1;
+
+    while ((r = pa_shmring_peek(s->ring, &f, &data)) > 0) {
+        pa_memchunk chunk;
+        void *d;
+
+        pa_assert(f.type <= PA_SEEK_RELATIVE_END);
+
+        if (f.length > 0) {
+            chunk.index = 0;
+            chunk.length = f.length;
+            chunk.memblock = pa_memblock_new(s->context->mempool, chunk.length);
+
+            d = pa_memblock_acquire(chunk.memblock);
+            memcpy(d, data, chunk.length);
+            pa_memblock_release(chunk.memblock);
+
+            pa_pstream_send_memblock(s->context->pstream, s->channel, f.offset, (pa_seek_mode_t) f.type, &chunk);
+            pa_memblock_unref(chunk.memblock);
+        }
+
+        pa_shmring_drop(s->ring);
+    }
+
+    pa_assert(r == 0);
+
+    pa_shmring_free(s->ring);
+    s->ring = NULL;
+    s->ring_ready = FALSE;
+
+    return 0;
+}
+
+static void stream_enable_ring_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_stream *s = userdata;
+
+    pa_assert(pd);
+    pa_assert(s);
+    pa_assert(PA_REFCNT_VALUE(s) >= 1);
+
+    pa_stream_ref(s);
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(s->context, command, t, FALSE) < 0)
+            goto finish;
+
+        /* On a timeout we cannot tell whether the server reads the
+         * ring or not */
+        if (command == PA_COMMAND_TIMEOUT || reclaim_ring(s) < 0) {
+            pa_stream_set_state(s, PA_STREAM_FAILED);
+            goto finish;
+        }
+
+        pa_log_debug("Server refused the shared memory ring, using the socket instead.");
+
+    } else if (!pa_tagstruct_eof(t)) {
+        pa_context_fail(s->context, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+finish:
+    pa_stream_unref(s);
+}
+
+/* We start writing into the ring right away, the server reads the
+ * frames that came before once it attached */
+static void enable_ring(pa_stream *s) {
+    pa_tagstruct *t;
+    uint32_t tag;
+    int fds[2];
+
+    pa_assert(s);
+    pa_assert(!s->ring);
+
+    if (s->direction != PA_STREAM_PLAYBACK ||
+        s->context->version < 30 ||
+        !s->context->do_memfd ||
+        s->context->conf->disable_shm_ring)
+        return;
+
+    if (!(s->ring = pa_shmring_new(PA_MIN(s->buffer_attr.maxlength, 2 * s->buffer_attr.tlength) + RING_BARRIER_RESERVE)))
+        return;
+
+    fds[0] = pa_shmring_get_memfd(s->ring);
+    fds[1] = pa_shmring_get_eventfd(s->ring);
+
+    t = pa_tagstruct_command(s->context, PA_COMMAND_ENABLE_PLAYBACK_RING, &tag);
+    pa_tagstruct_putu32(t, s->channel);
+    pa_tagstruct_putu32(t, (uint32_t) pa_shmring_get_size(s->ring));
+
+    if (pa_pstream_send_tagstruct_with_fds(s->context->pstream, t, fds, 2) < 0) {
+        pa_shmring_free(s->ring);
+        s->ring = NULL;
+        return;
+    }
+
+    pa_pdispatch_register_reply(s->context->pdispatch, tag, DEFAULT_TIMEOUT, stream_enable_ring_callback, s, NULL);
+
+    s->ring_barrier = 0;
+    s->ring_ready = TRUE;
+}
+
+/* Returns how much of the data went into the ring, the rest has to go
+ * through the socket. Once something did, the ring isn't used anymore
+ * because the server might otherwise see later data first. */
+static size_t write_ring(pa_stream *s, const void *data, size_t length, int64_t offset, pa_seek_mode_t seek) {
+    size_t done = 0, block_size_max;
+
+    pa_assert(s);
+
+    if (!s->ring || !s->ring_ready || length <= 0)
+        return 0;
+
+    block_size_max = pa_mempool_block_size_max(s->context->mempool);
+
+    while (done < length) {
+        size_t n = PA_MIN(length - done, block_size_max);
+
+        if (pa_shmring_push_max(s->ring) < n + RING_BARRIER_RESERVE ||
+            pa_shmring_push(s->ring, (uint32_t) seek, offset, (const uint8_t*) data + done, n) < 0) {
+            pa_log_debug("Shared memory ring full, using the socket from now on.");
+            s->ring_ready = FALSE;
+            break;
+        }
+
+        done += n;
+        offset = 0;
+        seek = PA_SEEK_RELATIVE;
+    }
+
+    return done;
+}
+
+/* Called before each command that has to be ordered with the data in
+ * the ring */
+static void write_ring_barrier(pa_stream *s) {
+    pa_assert(s);
+
+    if (!s->ring)
+        return;
+
+    s->ring_barrier++;
+
+    /* The server can't tell where the command belongs if the barrier
+     * is missing, so keep the data that follows out of the ring */
+    if (pa_shmring_push(s->ring, PA_PLAYBACK_RING_BARRIER, (int64_t) s->ring_barrier, NULL, 0) < 0)
+        s->ring_ready = FALSE;
+}
+
 static void create_stream_complete(pa_stream *s) {
     pa_assert(s);
     pa_assert(PA_REFCNT_VALUE(s) >= 1);
     pa_assert(s->state == PA_STREAM_CREATING);
 
+    enable_ring(s);
+
     pa_stream_set_state(s, PA_STREAM_READY);
 
     if (s->requested_bytes > 0 && s->write_callback)
@@ -1475,6 +1652,8 @@ int pa_stream_write(
         int64_t offset,
         pa_seek_mode_t seek) {
 
+    size_t ringed;
+
     pa_assert(s);
     pa_assert(PA_REFCNT_VALUE(s) >= 1);
     pa_assert(data);
@@ -1491,6 +1670,8 @@ int pa_stream_write(
                       PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, !free_cb || !s->write_memblock, PA_ERR_INVALID);
 
+    ringed = write_ring(s, data, length, offset, seek);
+
     if (s->write_memblock) {
         pa_memchunk chunk;
 
@@ -1499,20 +1680,21 @@ int pa_stream_write(
         pa_memblock_release(s->write_memblock);
 
         chunk.memblock = s->write_memblock;
-        chunk.index = (const char *) data - (const char *) s->write_data;
-        chunk.length = length;
+        chunk.index = (const char *) data - (const char *) s->write_data + ringed;
+        chunk.length = length - ringed;
 
         s->write_memblock = NULL;
         s->write_data = NULL;
 
-        pa_pstream_send_memblock(s->context->pstream, s->channel, offset, seek, &chunk);
+        if (chunk.length > 0)
+            pa_pstream_send_memblock(s->context->pstream, s->channel, ringed > 0 ? 0 : offset, ringed > 0 ? PA_SEEK_RELATIVE : seek, &chunk);
         pa_memblock_unref(chunk.memblock);
 
     } else {
-        pa_seek_mode_t t_seek = seek;
-        int64_t t_offset = offset;
-        size_t t_length = length;
-        const void *t_data = data;
+        pa_seek_mode_t t_seek = ringed > 0 ? PA_SEEK_RELATIVE : seek;
+        int64_t t_offset = ringed > 0 ? 0 : offset;
+        size_t t_length = length - ringed;
+        const void *t_data = (const uint8_t*) data + ringed;
 
         /* pa_stream_write_begin() was not called before */
 
@@ -1521,7 +1703,7 @@ int pa_stream_write(
 
             chunk.index = 0;
 
-            if (free_cb && !pa_pstream_get_shm(s->context->pstream)) {
+            if (free_cb && ringed <= 0 && !pa_pstream_get_shm(s->context->pstream)) {
                 chunk.memblock = pa_memblock_new_user(s->context->mempool, (void*) t_data, t_length, free_cb, 1);
                 chunk.length = t_length;
             } else {
@@ -1546,7 +1728,7 @@ int pa_stream_write(
             pa_memblock_unref(chunk.memblock);
         }
 
-        if (free_cb && pa_pstream_get_shm(s->context->pstream))
+        if (free_cb && (ringed > 0 || pa_pstream_get_shm(s->context->pstream)))
             free_cb((void*) data);
     }
 
@@ -1699,6 +1881,8 @@ pa_operation * pa_stream_drain(pa_stream *s, pa_stream_success_cb_t cb, void *us
 
     o = pa_operation_new(s->context, s, (pa_operation_cb_t) cb, userdata);
 
+    write_ring_barrier(s);
+
     t = pa_tagstruct_command(s->context, PA_COMMAND_DRAIN_PLAYBACK_STREAM, &tag);
     pa_tagstruct_putu32(t, s->channel);
     pa_pstream_send_tagstruct(s->context->pstream, t);
@@ -2296,6 +2480,11 @@ static pa_operation* stream_send_simple_command(pa_stream *s, uint32_t command,
 
     o = pa_operation_new(s->context, s, (pa_operation_cb_t) cb, userdata);
 
+    if (command == PA_COMMAND_FLUSH_PLAYBACK_STREAM ||
+        command == PA_COMMAND_PREBUF_PLAYBACK_STREAM ||
+        command == PA_COMMAND_TRIGGER_PLAYBACK_STREAM)
+        write_ring_barrier(s);
+
     t = pa_tagstruct_command(s->context, command, &tag);
     pa_tagstruct_putu32(t, s->channel);
     pa_pstream_send_tagstruct(s->context->pstream, t);
@@ -35,6 +35,7 @@ void pa_command_subscribe_event(pa_pdispatch *pd, uint32_t command, uint32_t tag
     pa_context *c = userdata;
     pa_subscription_event_type_t e;
     uint32_t idx;
+    pa_subscription_payload payload, *p = NULL;
 
     pa_assert(pd);
     pa_assert(command == PA_COMMAND_SUBSCRIBE_EVENT);
@@ -45,20 +46,44 @@ void pa_command_subscribe_event(pa_pdispatch *pd, uint32_t command, uint32_t tag
     pa_context_ref(c);
 
     if (pa_tagstruct_getu32(t, &e) < 0 ||
-        pa_tagstruct_getu32(t, &idx) < 0 ||
-        !pa_tagstruct_eof(t)) {
+        pa_tagstruct_getu32(t, &idx) < 0) {
         pa_context_fail(c, PA_ERR_PROTOCOL);
         goto finish;
     }
 
-    if (c->subscribe_callback)
+    if (c->version >= 31 && !pa_tagstruct_eof(t)) {
+        pa_bool_t mute = FALSE;
+
+        pa_zero(payload);
+
+        if (pa_tagstruct_getu32(t, &payload.fields) < 0 ||
+            (payload.fields & ~PA_SUBSCRIPTION_FIELD_ALL) != 0 ||
+            ((payload.fields & PA_SUBSCRIPTION_FIELD_VOLUME) && pa_tagstruct_get_cvolume(t, &payload.volume) < 0) ||
+            ((payload.fields & PA_SUBSCRIPTION_FIELD_MUTE) && pa_tagstruct_get_boolean(t, &mute) < 0) ||
+            ((payload.fields & PA_SUBSCRIPTION_FIELD_STATE) && pa_tagstruct_getu32(t, &payload.state) < 0)) {
+            pa_context_fail(c, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
+        payload.mute = mute;
+        p = &payload;
+    }
+
+    if (!pa_tagstruct_eof(t)) {
+        pa_context_fail(c, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+    if (c->subscribe_payload_callback)
+        c->subscribe_payload_callback(c, e, idx, p, c->subscribe_payload_userdata);
+    else if (c->subscribe_callback)
         c->subscribe_callback(c, e, idx, c->subscribe_userdata);
 
 finish:
     pa_context_unref(c);
 }
 
-pa_operation* pa_context_subscribe(pa_context *c, pa_subscription_mask_t m, pa_context_success_cb_t cb, void *userdata) {
+static pa_operation* subscribe(pa_context *c, pa_subscription_mask_t m, pa_bool_t payload, pa_context_success_cb_t cb, void *userdata) {
     pa_operation *o;
     pa_tagstruct *t;
     uint32_t tag;
@@ -72,12 +97,22 @@ pa_operation* pa_context_subscribe(pa_context *c, pa_subscription_mask_t m, pa_c
 
     t = pa_tagstruct_command(c, PA_COMMAND_SUBSCRIBE, &tag);
     pa_tagstruct_putu32(t, m);
+    if (c->version >= 31)
+        pa_tagstruct_put_boolean(t, payload);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, pa_context_simple_ack_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
     return o;
 }
 
+pa_operation* pa_context_subscribe(pa_context *c, pa_subscription_mask_t m, pa_context_success_cb_t cb, void *userdata) {
+    return subscribe(c, m, FALSE, cb, userdata);
+}
+
+pa_operation* pa_context_subscribe_with_payload(pa_context *c, pa_subscription_mask_t m, pa_context_success_cb_t cb, void *userdata) {
+    return subscribe(c, m, TRUE, cb, userdata);
+}
+
 void pa_context_set_subscribe_callback(pa_context *c, pa_context_subscribe_cb_t cb, void *userdata) {
     pa_assert(c);
     pa_assert(PA_REFCNT_VALUE(c) >= 1);
@@ -88,3 +123,14 @@ void pa_context_set_subscribe_callback(pa_context *c, pa_context_subscribe_cb_t
     c->subscribe_callback = cb;
     c->subscribe_userdata = userdata;
 }
+
+void pa_context_set_subscribe_payload_callback(pa_context *c, pa_context_subscribe_payload_cb_t cb, void *userdata) {
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    if (c->state == PA_CONTEXT_TERMINATED || c->state == PA_CONTEXT_FAILED)
+        return;
+
+    c->subscribe_payload_callback = cb;
+    c->subscribe_payload_userdata = userdata;
+}
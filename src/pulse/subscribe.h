@@ -27,6 +27,7 @@
 
 #include <pulse/def.h>
 #include <pulse/context.h>
+#include <pulse/volume.h>
 #include <pulse/cdecl.h>
 #include <pulse/version.h>
 
@@ -43,6 +44,14 @@
  * and the function that will be called whenever a notification occurs using
  * pa_context_set_subscribe_callback().
  *
+ * Applications that follow volume, mute or state changes of sinks,
+ * sources and streams can subscribe with
+ * pa_context_subscribe_with_payload() instead. The server then sends
+ * the new values of the fields that changed along with the change
+ * events, which are passed to the callback set with
+ * pa_context_set_subscribe_payload_callback(). The object only needs to
+ * be queried when the payload contains \ref PA_SUBSCRIPTION_FIELD_OTHER.
+ *
  * The callback will be called with a \ref pa_subscription_event_type_t
  * representing the event that caused the callback. Clients can examine what
  * object changed using \ref PA_SUBSCRIPTION_EVENT_FACILITY_MASK. The actual
@@ -81,6 +90,29 @@ pa_operation* pa_context_subscribe(pa_context *c, pa_subscription_mask_t m, pa_c
 /** Set the context specific call back function that is called whenever the state of the daemon changes */
 void pa_context_set_subscribe_callback(pa_context *c, pa_context_subscribe_cb_t cb, void *userdata);
 
+/** The fields of an object sent along with a change event. \since 5.0 */
+typedef struct pa_subscription_payload {
+    pa_subscription_field_t fields; /**< Which properties changed. Only those of volume, mute and state that are set here are valid. */
+    pa_cvolume volume;              /**< The new volume */
+    int mute;                       /**< The new mute switch */
+    uint32_t state;                 /**< For sinks and sources the new \ref pa_sink_state_t or \ref pa_source_state_t, for sink inputs and source outputs non-zero if corked */
+} pa_subscription_payload;
+
+/** Subscription event callback prototype with payload. payload is NULL
+ * for events that come without one. \since 5.0 */
+typedef void (*pa_context_subscribe_payload_cb_t)(pa_context *c, pa_subscription_event_type_t t, uint32_t idx, const pa_subscription_payload *payload, void *userdata);
+
+/** Enable event notification, and ask for the changed fields to be
+ * sent along with change events of sinks, sources, sink inputs and
+ * source outputs. Servers older than 5.0 send no payloads, the
+ * callback is called with a NULL payload then. \since 5.0 */
+pa_operation* pa_context_subscribe_with_payload(pa_context *c, pa_subscription_mask_t m, pa_context_success_cb_t cb, void *userdata);
+
+/** Set the call back function for events with payload. If set, it is
+ * called for all events instead of the one set with
+ * pa_context_set_subscribe_callback(). \since 5.0 */
+void pa_context_set_subscribe_payload_callback(pa_context *c, pa_context_subscribe_payload_cb_t cb, void *userdata);
+
 PA_C_DECL_END
 
 #endif
@@ -45,6 +45,7 @@
 #include <pulsecore/client.h>
 #include <pulsecore/sink-input.h>
 #include <pulsecore/source-output.h>
+#include <pulsecore/resampler.h>
 #include <pulsecore/tokenizer.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/namereg.h>
@@ -58,6 +59,7 @@
 #include <pulsecore/core-error.h>
 #include <pulsecore/modinfo.h>
 #include <pulsecore/dynarray.h>
+#include <pulsecore/pstream.h>
 
 #include "cli-command.h"
 
@@ -345,6 +347,8 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
     char cm[PA_CHANNEL_MAP_SNPRINT_MAX];
     char bytes[PA_BYTES_SNPRINT_MAX];
     const pa_mempool_stat *mstat;
+    const pa_resampler_cache_stat *rstat;
+    const pa_pstream_stat *pstat;
     unsigned k;
     pa_sink *def_sink;
     pa_source *def_source;
@@ -381,9 +385,35 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
                      (unsigned) pa_atomic_load(&mstat->n_exported),
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&mstat->exported_size)));
 
+    pa_strbuf_printf(buf, "Memory pool segments: %u.\n",
+                     (unsigned) pa_atomic_load(&mstat->n_segments));
+
+    pa_strbuf_printf(buf, "Memory pool slot caches: %u, %u hits/%u refills/%u drains.\n",
+                     (unsigned) pa_atomic_load(&mstat->n_slot_caches),
+                     (unsigned) pa_atomic_load(&mstat->n_slot_cache_hits),
+                     (unsigned) pa_atomic_load(&mstat->n_slot_cache_refills),
+                     (unsigned) pa_atomic_load(&mstat->n_slot_cache_drains));
+
+    pstat = pa_pstream_get_stat();
+    pa_strbuf_printf(buf, "Protocol streams: %u frames in %u reads, %u frames in %u writes.\n",
+                     (unsigned) pa_atomic_load(&pstat->n_frames_read),
+                     (unsigned) pa_atomic_load(&pstat->n_read_calls),
+                     (unsigned) pa_atomic_load(&pstat->n_frames_written),
+                     (unsigned) pa_atomic_load(&pstat->n_write_calls));
+
+    pa_strbuf_printf(buf, "Subscription events merged: %u.\n", c->subscription_events_merged);
+
     pa_strbuf_printf(buf, "Total sample cache size: %s.\n",
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_scache_total_size(c)));
 
+    rstat = pa_resampler_get_cache_stat();
+
+    pa_strbuf_printf(buf, "Resampler filter tables cached: %u, size: %s, %u hits/%u misses.\n",
+                     (unsigned) pa_atomic_load(&rstat->n_tables),
+                     pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&rstat->tables_size)),
+                     (unsigned) pa_atomic_load(&rstat->n_hits),
+                     (unsigned) pa_atomic_load(&rstat->n_misses));
+
     pa_strbuf_printf(buf, "Default sample spec: %s\n",
                      pa_sample_spec_snprint(ss, sizeof(ss), &c->default_sample_spec));
 
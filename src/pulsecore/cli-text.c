@@ -26,6 +26,7 @@
 #include <pulse/volume.h>
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
+#include <pulse/rtclock.h>
 
 #include <pulsecore/module.h>
 #include <pulsecore/client.h>
@@ -95,6 +96,12 @@ char *pa_client_list_to_string(pa_core *c) {
         if (client->module)
             pa_strbuf_printf(s, "\towner module: %u\n", client->module->index);
 
+        if (client->n_subscription_events > 0)
+            pa_strbuf_printf(s, "\tsubscription events: %u, backlog: %u (max %u)\n",
+                             client->n_subscription_events,
+                             client->subscription_backlog,
+                             client->subscription_backlog_max);
+
         t = pa_proplist_to_string_sep(client->proplist, "\n\t\t");
         pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
         pa_xfree(t);
@@ -116,6 +123,34 @@ static const char *available_to_string(pa_available_t a) {
     }
 }
 
+static void append_histogram(pa_strbuf *s, const char *name, const pa_histogram *h) {
+    char *t;
+
+    t = pa_histogram_to_string(h);
+    pa_strbuf_printf(s, "\t%s: %s\n", name, t);
+    pa_xfree(t);
+}
+
+static void append_rewind_stats(pa_strbuf *s, pa_sink *sink) {
+    pa_sink_rewind_stats stats;
+    char requested[PA_BYTES_SNPRINT_MAX], rewound[PA_BYTES_SNPRINT_MAX];
+    double secs;
+
+    pa_sink_get_rewind_stats(sink, &stats);
+    secs = (double) (pa_rtclock_now() - stats.since) / PA_USEC_PER_SEC;
+
+    pa_strbuf_printf(
+            s,
+            "\trewind free: %s\n"
+            "\trewinds: %llu requested (%s), %llu done (%s); %0.1f bytes/s rewound\n",
+            pa_yes_no(sink->rewind_free),
+            (unsigned long long) stats.requests,
+            pa_bytes_snprint(requested, sizeof(requested), (unsigned) PA_MIN(stats.requested_bytes, (uint64_t) UINT_MAX)),
+            (unsigned long long) stats.rewinds,
+            pa_bytes_snprint(rewound, sizeof(rewound), (unsigned) PA_MIN(stats.rewound_bytes, (uint64_t) UINT_MAX)),
+            secs > 0 ? (double) stats.rewound_bytes / secs : 0.0);
+}
+
 static void append_port_list(pa_strbuf *s, pa_hashmap *ports)
 {
     pa_device_port *p;
@@ -338,6 +373,26 @@ char *pa_sink_list_to_string(pa_core *c) {
         if (sink->module)
             pa_strbuf_printf(s, "\tmodule: %u\n", sink->module->index);
 
+        append_histogram(s, "wakeup lateness", &sink->io_stats.wakeup_lateness);
+        append_histogram(s, "render time", &sink->io_stats.render_time);
+        append_histogram(s, "peek time", &sink->io_stats.peek_time);
+        append_histogram(s, "convert time", &sink->io_stats.convert_time);
+        append_histogram(s, "mix time", &sink->io_stats.mix_time);
+        append_histogram(s, "join wait", &sink->io_stats.join_time);
+        pa_strbuf_printf(
+                s,
+                "\tsilence: %u silent renders; skipped %u mixes, %u volume adjustments, %u resampler runs\n",
+                (unsigned) pa_atomic_load(&sink->io_stats.silent_renders),
+                (unsigned) pa_atomic_load(&sink->io_stats.silent_mix_skips),
+                (unsigned) pa_atomic_load(&sink->io_stats.silent_volume_skips),
+                (unsigned) pa_atomic_load(&sink->io_stats.silent_resample_skips));
+        pa_strbuf_printf(
+                s,
+                "\tpassthrough: %u of %u single input renders\n",
+                (unsigned) pa_atomic_load(&sink->io_stats.passthrough_renders),
+                (unsigned) pa_atomic_load(&sink->io_stats.single_input_renders));
+        append_rewind_stats(s, sink);
+
         t = pa_proplist_to_string_sep(sink->proplist, "\n\t\t");
         pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
         pa_xfree(t);
@@ -455,6 +510,9 @@ char *pa_source_list_to_string(pa_core *c) {
         if (source->module)
             pa_strbuf_printf(s, "\tmodule: %u\n", source->module->index);
 
+        append_histogram(s, "wakeup lateness", &source->io_stats.wakeup_lateness);
+        append_histogram(s, "post time", &source->io_stats.post_time);
+
         t = pa_proplist_to_string_sep(source->proplist, "\n\t\t");
         pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
         pa_xfree(t);
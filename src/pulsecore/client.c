@@ -72,6 +72,8 @@ pa_client *pa_client_new(pa_core *core, pa_client_new_data *data) {
     c->source_outputs = pa_idxset_new(NULL, NULL);
 
     c->userdata = NULL;
+    c->n_subscription_events = 0;
+    c->subscription_backlog = c->subscription_backlog_max = 0;
     c->kill = NULL;
     c->send_event = NULL;
 
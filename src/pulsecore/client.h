@@ -47,6 +47,13 @@ struct pa_client {
 
     void *userdata;
 
+    /* Maintained by the protocol, to spot clients that don't read
+     * their subscription events fast enough: the number of events sent
+     * and how many packets were still waiting to be written to the
+     * client when the last one was queued, and at most. */
+    uint32_t n_subscription_events;
+    unsigned subscription_backlog, subscription_backlog_max;
+
     void (*kill)(pa_client *c);
 
     void (*send_event)(pa_client *c, const char *name, pa_proplist *data);
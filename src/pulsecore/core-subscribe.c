@@ -29,6 +29,7 @@
 
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/hashmap.h>
 
 #include "core-subscribe.h"
 
@@ -37,13 +38,18 @@
  * register a callback function that is called whenever an event
  * matching a subscription mask happens. The execution of the callback
  * function is postponed to the next main loop iteration, i.e. is not
- * called from within the stack frame the entity was created in. */
+ * called from within the stack frame the entity was created in.
+ *
+ * Until then there is at most one queued event per object, which is
+ * looked up in a hashmap keyed by facility and index. Further change
+ * events are merged into it, a remove event replaces it. */
 
 struct pa_subscription {
     pa_core *core;
     pa_bool_t dead;
 
     pa_subscription_cb_t callback;
+    pa_subscription_fields_cb_t fields_callback;
     void *userdata;
     pa_subscription_mask_t mask;
 
@@ -55,24 +61,25 @@ struct pa_subscription_event {
 
     pa_subscription_event_type_t type;
     uint32_t index;
+    pa_subscription_field_t fields;
 
     PA_LLIST_FIELDS(pa_subscription_event);
 };
 
 static void sched_event(pa_core *c);
 
-/* Allocate a new subscription object for the given subscription mask. Use the specified callback function and user data */
-pa_subscription* pa_subscription_new(pa_core *c, pa_subscription_mask_t m, pa_subscription_cb_t callback, void *userdata) {
+static pa_subscription* subscription_new(pa_core *c, pa_subscription_mask_t m, pa_subscription_cb_t callback, pa_subscription_fields_cb_t fields_callback, void *userdata) {
     pa_subscription *s;
 
     pa_assert(c);
     pa_assert(m);
-    pa_assert(callback);
+    pa_assert(callback || fields_callback);
 
     s = pa_xnew(pa_subscription, 1);
     s->core = c;
     s->dead = FALSE;
     s->callback = callback;
+    s->fields_callback = fields_callback;
     s->userdata = userdata;
     s->mask = m;
 
@@ -80,6 +87,19 @@ pa_subscription* pa_subscription_new(pa_core *c, pa_subscription_mask_t m, pa_su
     return s;
 }
 
+/* Allocate a new subscription object for the given subscription mask. Use the specified callback function and user data */
+pa_subscription* pa_subscription_new(pa_core *c, pa_subscription_mask_t m, pa_subscription_cb_t callback, void *userdata) {
+    pa_assert(callback);
+
+    return subscription_new(c, m, callback, NULL, userdata);
+}
+
+pa_subscription* pa_subscription_new_with_fields(pa_core *c, pa_subscription_mask_t m, pa_subscription_fields_cb_t callback, void *userdata) {
+    pa_assert(callback);
+
+    return subscription_new(c, m, NULL, callback, userdata);
+}
+
 /* Free a subscription object, effectively marking it for deletion */
 void pa_subscription_free(pa_subscription*s) {
     pa_assert(s);
@@ -97,7 +117,23 @@ static void free_subscription(pa_subscription *s) {
     pa_xfree(s);
 }
 
-static void free_event(pa_subscription_event *s) {
+static unsigned event_hash_func(const void *p) {
+    const pa_subscription_event *e = p;
+
+    return e->index * 31U + (unsigned) (e->type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK);
+}
+
+static int event_compare_func(const void *a, const void *b) {
+    const pa_subscription_event *x = a, *y = b;
+
+    if ((x->type ^ y->type) & PA_SUBSCRIPTION_EVENT_FACILITY_MASK)
+        return 1;
+
+    return x->index != y->index;
+}
+
+/* Takes the event out of the queue, without freeing it */
+static void unlink_event(pa_subscription_event *s) {
     pa_assert(s);
     pa_assert(s->core);
 
@@ -105,6 +141,14 @@ static void free_event(pa_subscription_event *s) {
         s->core->subscription_event_last = s->prev;
 
     PA_LLIST_REMOVE(pa_subscription_event, s->core->subscription_event_queue, s);
+
+    /* A new event for a reused index might have taken over the entry */
+    if (pa_hashmap_get(s->core->subscription_event_map, s) == s)
+        pa_hashmap_remove(s->core->subscription_event_map, s);
+}
+
+static void free_event(pa_subscription_event *s) {
+    unlink_event(s);
     pa_xfree(s);
 }
 
@@ -118,6 +162,11 @@ void pa_subscription_free_all(pa_core *c) {
     while (c->subscription_event_queue)
         free_event(c->subscription_event_queue);
 
+    if (c->subscription_event_map) {
+        pa_hashmap_free(c->subscription_event_map, NULL);
+        c->subscription_event_map = NULL;
+    }
+
     if (c->subscription_defer_event) {
         c->mainloop->defer_free(c->subscription_defer_event);
         c->subscription_defer_event = NULL;
@@ -168,16 +217,24 @@ static void defer_cb(pa_mainloop_api *m, pa_defer_event *de, void *userdata) {
     while (c->subscription_event_queue) {
         pa_subscription_event *e = c->subscription_event_queue;
 
+        /* Events the callbacks post must not be merged into this one */
+        unlink_event(e);
+
         for (s = c->subscriptions; s; s = s->next) {
 
-            if (!s->dead && pa_subscription_match_flags(s->mask, e->type))
+            if (s->dead || !pa_subscription_match_flags(s->mask, e->type))
+                continue;
+
+            if (s->fields_callback)
+                s->fields_callback(c, e->type, e->index, e->fields, s->userdata);
+            else
                 s->callback(c, e->type, e->index, s->userdata);
         }
 
 #ifdef DEBUG
         dump_event("Dispatched", e);
 #endif
-        free_event(e);
+        pa_xfree(e);
     }
 
     /* Remove dead subscriptions */
@@ -205,45 +262,52 @@ static void sched_event(pa_core *c) {
 
 /* Append a new subscription event to the subscription event queue and schedule a main loop event */
 void pa_subscription_post(pa_core *c, pa_subscription_event_type_t t, uint32_t idx) {
-    pa_subscription_event *e;
+    pa_subscription_post_fields(c, t, idx, PA_SUBSCRIPTION_FIELD_OTHER);
+}
+
+void pa_subscription_post_fields(pa_core *c, pa_subscription_event_type_t t, uint32_t idx, pa_subscription_field_t fields) {
+    pa_subscription_event *e, key;
     pa_assert(c);
+    pa_assert(fields != PA_SUBSCRIPTION_FIELD_NONE);
+    pa_assert((fields & ~PA_SUBSCRIPTION_FIELD_ALL) == 0);
 
     /* No need for queuing subscriptions of no one is listening */
     if (!c->subscriptions)
         return;
 
-    if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_NEW) {
-        pa_subscription_event *i, *n;
+    if (!c->subscription_event_map)
+        c->subscription_event_map = pa_hashmap_new(event_hash_func, event_compare_func);
 
-        /* Check for duplicates */
-        for (i = c->subscription_event_last; i; i = n) {
-            n = i->prev;
+    key.type = t;
+    key.index = idx;
 
-            /* not the same object type */
-            if (((t ^ i->type) & PA_SUBSCRIPTION_EVENT_FACILITY_MASK))
-                continue;
+    if ((e = pa_hashmap_get(c->subscription_event_map, &key))) {
 
-            /* not the same object */
-            if (i->index != idx)
-                continue;
+        switch (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) {
 
-            if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
+            case PA_SUBSCRIPTION_EVENT_REMOVE:
                 /* This object is being removed, hence there is no
-                 * point in keeping the old events regarding this
+                 * point in keeping the old event regarding this
                  * entry in the queue. */
 
-                free_event(i);
-                pa_log_debug("Dropped redundant event due to remove event.");
-                continue;
-            }
+                free_event(e);
+                c->subscription_events_merged++;
+                break;
 
-            if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE) {
+            case PA_SUBSCRIPTION_EVENT_CHANGE:
                 /* This object has changed. If a "new" or "change" event for
-                 * this object is still in the queue we can exit. */
+                 * this object is still in the queue we can exit, after
+                 * noting what else the queued event is about now. */
 
-                pa_log_debug("Dropped redundant event due to change event.");
+                e->fields |= fields;
+                c->subscription_events_merged++;
                 return;
-            }
+
+            default:
+                /* The index has been reused after a remove event, which
+                 * has to stay queued */
+                pa_hashmap_remove(c->subscription_event_map, e);
+                break;
         }
     }
 
@@ -251,9 +315,11 @@ void pa_subscription_post(pa_core *c, pa_subscription_event_type_t t, uint32_t i
     e->core = c;
     e->type = t;
     e->index = idx;
+    e->fields = (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE ? fields : PA_SUBSCRIPTION_FIELD_ALL;
 
     PA_LLIST_INSERT_AFTER(pa_subscription_event, c->subscription_event_queue, c->subscription_event_last, e);
     c->subscription_event_last = e;
+    pa_assert_se(pa_hashmap_put(c->subscription_event_map, e, e) >= 0);
 
 #ifdef DEBUG
     dump_event("Queued", e);
@@ -29,11 +29,19 @@ typedef struct pa_subscription_event pa_subscription_event;
 #include <pulsecore/native-common.h>
 
 typedef void (*pa_subscription_cb_t)(pa_core *c, pa_subscription_event_type_t t, uint32_t idx, void *userdata);
+typedef void (*pa_subscription_fields_cb_t)(pa_core *c, pa_subscription_event_type_t t, uint32_t idx, pa_subscription_field_t fields, void *userdata);
 
 pa_subscription* pa_subscription_new(pa_core *c, pa_subscription_mask_t m,  pa_subscription_cb_t cb, void *userdata);
+
+/* Like pa_subscription_new(), but the callback also learns which
+ * fields the events are about. Change events posted in the same main
+ * loop iteration are merged and carry all their fields. */
+pa_subscription* pa_subscription_new_with_fields(pa_core *c, pa_subscription_mask_t m, pa_subscription_fields_cb_t cb, void *userdata);
 void pa_subscription_free(pa_subscription*s);
 void pa_subscription_free_all(pa_core *c);
 
+/* Posts an event about unspecified fields, i.e. PA_SUBSCRIPTION_FIELD_OTHER */
 void pa_subscription_post(pa_core *c, pa_subscription_event_type_t t, uint32_t idx);
+void pa_subscription_post_fields(pa_core *c, pa_subscription_event_type_t t, uint32_t idx, pa_subscription_field_t fields);
 
 #endif
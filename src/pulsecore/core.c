@@ -63,14 +63,19 @@ static int core_process_msg(pa_msgobject *o, int code, void *userdata, int64_t o
 
 static void core_free(pa_object *o);
 
-pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
+pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, pa_bool_t enable_memfd, size_t shm_size) {
     pa_core* c;
-    pa_mempool *pool;
+    pa_mempool *pool = NULL;
     int j;
 
     pa_assert(m);
 
-    if (shared) {
+    if (shared && enable_memfd) {
+        if (!(pool = pa_mempool_new_memfd(shm_size)))
+            pa_log_info("memfd shared memory not available, falling back to POSIX shared memory.");
+    }
+
+    if (shared && !pool) {
         if (!(pool = pa_mempool_new(shared, shm_size))) {
             pa_log_warn("failed to allocate shared memory pool. Falling back to a normal memory pool.");
             shared = FALSE;
@@ -114,6 +119,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
     c->default_fragment_size_msec = 25;
 
     c->deferred_volume_safety_margin_usec = 8000;
+    c->rewind_free_max_latency_msec = 20;
     c->deferred_volume_extra_delay_usec = 0;
 
     c->module_defer_unload_event = NULL;
@@ -123,9 +129,12 @@ pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
     PA_LLIST_HEAD_INIT(pa_subscription, c->subscriptions);
     PA_LLIST_HEAD_INIT(pa_subscription_event, c->subscription_event_queue);
     c->subscription_event_last = NULL;
+    c->subscription_event_map = NULL;
+    c->subscription_events_merged = 0;
 
     c->mempool = pool;
     pa_silence_cache_init(&c->silence_cache);
+    c->render_pool = NULL;
 
     c->exit_event = NULL;
 
@@ -141,6 +150,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
     c->disable_remixing = FALSE;
     c->disable_lfe_remixing = FALSE;
     c->deferred_volume = TRUE;
+    c->rewind_free_sinks = FALSE;
     c->resample_method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
 
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
@@ -207,6 +217,9 @@ static void core_free(pa_object *o) {
     pa_assert(!c->default_source);
     pa_assert(!c->default_sink);
 
+    if (c->render_pool)
+        pa_render_pool_free(c->render_pool);
+
     pa_silence_cache_done(&c->silence_cache);
     pa_mempool_free(c->mempool);
 
@@ -51,6 +51,7 @@ typedef enum pa_suspend_cause {
 #include <pulsecore/source.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/msgobject.h>
+#include <pulsecore/render-pool.h>
 
 typedef enum pa_server_type {
     PA_SERVER_TYPE_UNSET,
@@ -153,6 +154,7 @@ struct pa_core {
     uint32_t alternate_sample_rate;
     unsigned default_n_fragments, default_fragment_size_msec;
     unsigned deferred_volume_safety_margin_usec;
+    unsigned rewind_free_max_latency_msec;
     int deferred_volume_extra_delay_usec;
 
     pa_defer_event *module_defer_unload_event;
@@ -161,10 +163,16 @@ struct pa_core {
     PA_LLIST_HEAD(pa_subscription, subscriptions);
     PA_LLIST_HEAD(pa_subscription_event, subscription_event_queue);
     pa_subscription_event *subscription_event_last;
+    pa_hashmap *subscription_event_map;
+    unsigned subscription_events_merged;
 
     pa_mempool *mempool;
     pa_silence_cache silence_cache;
 
+    /* Shared by the sinks to render their inputs in parallel, NULL if
+     * that is disabled */
+    pa_render_pool *render_pool;
+
     pa_time_event *exit_event;
     pa_time_event *scache_auto_unload_event;
 
@@ -178,6 +186,7 @@ struct pa_core {
     pa_bool_t disable_remixing:1;
     pa_bool_t disable_lfe_remixing:1;
     pa_bool_t deferred_volume:1;
+    pa_bool_t rewind_free_sinks:1;
 
     pa_resample_method_t resample_method;
     int realtime_priority;
@@ -197,7 +206,7 @@ enum {
     PA_CORE_MESSAGE_MAX
 };
 
-pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size);
+pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, pa_bool_t enable_memfd, size_t shm_size);
 
 /* Check whether no one is connected to this core */
 void pa_core_check_idle(pa_core *c);
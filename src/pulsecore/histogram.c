@@ -0,0 +1,102 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <limits.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/strbuf.h>
+#include <pulsecore/macro.h>
+
+#include "histogram.h"
+
+void pa_histogram_reset(pa_histogram *h) {
+    unsigned i;
+
+    pa_assert(h);
+
+    for (i = 0; i < PA_HISTOGRAM_BUCKETS; i++)
+        pa_atomic_store(&h->buckets[i], 0);
+
+    pa_atomic_store(&h->max, 0);
+}
+
+void pa_histogram_add(pa_histogram *h, pa_usec_t usec) {
+    unsigned b;
+    int v, m;
+
+    pa_assert(h);
+
+    v = (int) PA_MIN(usec, (pa_usec_t) INT_MAX);
+    b = v > 0 ? PA_MIN(pa_ulog2((unsigned) v) + 1, PA_HISTOGRAM_BUCKETS - 1U) : 0;
+
+    pa_atomic_inc(&h->buckets[b]);
+
+    /* Only the IO thread writes, hence no need for a cmpxchg loop */
+    m = pa_atomic_load(&h->max);
+    if (v > m)
+        pa_atomic_store(&h->max, v);
+}
+
+unsigned pa_histogram_get(const pa_histogram *h, uint32_t counts[PA_HISTOGRAM_BUCKETS], pa_usec_t *max) {
+    unsigned i, n = 0;
+
+    pa_assert(h);
+    pa_assert(counts);
+
+    for (i = 0; i < PA_HISTOGRAM_BUCKETS; i++) {
+        counts[i] = (uint32_t) pa_atomic_load(&h->buckets[i]);
+        n += counts[i];
+    }
+
+    if (max)
+        *max = (pa_usec_t) pa_atomic_load(&h->max);
+
+    return n;
+}
+
+char *pa_histogram_to_string(const pa_histogram *h) {
+    uint32_t counts[PA_HISTOGRAM_BUCKETS];
+    pa_usec_t max;
+    pa_strbuf *buf;
+    unsigned i, n;
+
+    pa_assert(h);
+
+    n = pa_histogram_get(h, counts, &max);
+
+    buf = pa_strbuf_new();
+    pa_strbuf_printf(buf, "n=%u max=%llu usec", n, (unsigned long long) max);
+
+    for (i = 0; i < PA_HISTOGRAM_BUCKETS; i++) {
+
+        if (counts[i] == 0)
+            continue;
+
+        if (i == PA_HISTOGRAM_BUCKETS - 1)
+            pa_strbuf_printf(buf, " >=%uus:%u", 1U << (i - 1), counts[i]);
+        else
+            pa_strbuf_printf(buf, " <%uus:%u", 1U << i, counts[i]);
+    }
+
+    return pa_strbuf_tostring_free(buf);
+}
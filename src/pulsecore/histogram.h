@@ -0,0 +1,50 @@
+#ifndef foopulsecorehistogramhfoo
+#define foopulsecorehistogramhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+#include <pulsecore/atomic.h>
+
+/* A histogram of durations that an IO thread fills in and any other
+ * thread may read at the same time, without locking. Bucket 0 counts
+ * durations below 1 usec, bucket n counts those from 2^(n-1) to below
+ * 2^n usec, and the last bucket everything longer. */
+
+#define PA_HISTOGRAM_BUCKETS 24
+
+typedef struct pa_histogram {
+    pa_atomic_t buckets[PA_HISTOGRAM_BUCKETS];
+    pa_atomic_t max; /* in usec */
+} pa_histogram;
+
+void pa_histogram_reset(pa_histogram *h);
+
+void pa_histogram_add(pa_histogram *h, pa_usec_t usec);
+
+/* Copies the bucket counts and returns their sum */
+unsigned pa_histogram_get(const pa_histogram *h, uint32_t counts[PA_HISTOGRAM_BUCKETS], pa_usec_t *max);
+
+/* A single line with the non-empty buckets, for the CLI */
+char *pa_histogram_to_string(const pa_histogram *h);
+
+#endif
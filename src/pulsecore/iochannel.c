@@ -57,10 +57,23 @@ struct pa_iochannel {
     pa_bool_t no_close:1;
 
     pa_io_event* input_event, *output_event;
+
+    /* fds passed by the other side that nobody took yet */
+    int received_fds[PA_IOCHANNEL_FDS_MAX];
+    unsigned n_received_fds;
 };
 
 static void callback(pa_mainloop_api* m, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata);
 
+static void close_received_fds(pa_iochannel *io) {
+    unsigned i;
+
+    for (i = 0; i < io->n_received_fds; i++)
+        pa_close(io->received_fds[i]);
+
+    io->n_received_fds = 0;
+}
+
 static void delete_events(pa_iochannel *io) {
     pa_assert(io);
 
@@ -187,6 +200,8 @@ void pa_iochannel_free(pa_iochannel*io) {
 
     delete_events(io);
 
+    close_received_fds(io);
+
     if (!io->no_close) {
         if (io->ifd >= 0)
             pa_close(io->ifd);
@@ -231,6 +246,47 @@ ssize_t pa_iochannel_write(pa_iochannel*io, const void*data, size_t l) {
     return r;
 }
 
+#ifdef HAVE_SYS_UIO_H
+ssize_t pa_iochannel_writev(pa_iochannel*io, const struct iovec *iov, unsigned n) {
+    ssize_t r;
+
+    pa_assert(io);
+    pa_assert(iov);
+    pa_assert(n > 0);
+    pa_assert(io->ofd >= 0);
+
+    for (;;) {
+
+        /* Like pa_write() we use sendmsg() on sockets to avoid SIGPIPE */
+        if (io->ofd_type == 0) {
+            struct msghdr mh;
+
+            pa_zero(mh);
+            mh.msg_iov = (struct iovec*) iov;
+            mh.msg_iovlen = n;
+
+            if ((r = sendmsg(io->ofd, &mh, MSG_NOSIGNAL)) < 0 && errno == ENOTSOCK) {
+                io->ofd_type = 1;
+                continue;
+            }
+        } else
+            r = writev(io->ofd, iov, (int) n);
+
+        if (r < 0 && errno == EINTR)
+            continue;
+
+        break;
+    }
+
+    if (r >= 0) {
+        io->writable = io->hungup = FALSE;
+        enable_events(io);
+    }
+
+    return r;
+}
+#endif
+
 ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l) {
     ssize_t r;
 
@@ -337,13 +393,47 @@ ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l
     return r;
 }
 
+/* Room for the ancillary data of one read. If the other side sends
+ * more fds than PA_IOCHANNEL_FDS_MAX they still fit in there, in place
+ * of the credentials. */
+#define READ_CMSG_SPACE (CMSG_SPACE(sizeof(struct ucred)) + CMSG_SPACE(sizeof(int) * PA_IOCHANNEL_FDS_MAX))
+
+/* Every fd that came with the message is either kept for
+ * pa_iochannel_steal_received_fds() or closed right away, however many
+ * the other side sent */
+static void store_received_fds(pa_iochannel *io, struct cmsghdr *cmh) {
+    int fds[READ_CMSG_SPACE / sizeof(int)];
+    unsigned n, j;
+
+    n = (unsigned) ((cmh->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+    pa_assert(n <= PA_ELEMENTSOF(fds));
+    memcpy(fds, CMSG_DATA(cmh), sizeof(int) * n);
+
+    if (io->n_received_fds > 0) {
+        pa_log_warn("Dropping file descriptors that were never taken.");
+        close_received_fds(io);
+    }
+
+    if (n > PA_IOCHANNEL_FDS_MAX) {
+        pa_log_warn("Received too many file descriptors.");
+
+        for (j = PA_IOCHANNEL_FDS_MAX; j < n; j++)
+            pa_close(fds[j]);
+
+        n = PA_IOCHANNEL_FDS_MAX;
+    }
+
+    memcpy(io->received_fds, fds, sizeof(int) * n);
+    io->n_received_fds = n;
+}
+
 ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_creds *creds, pa_bool_t *creds_valid) {
     ssize_t r;
     struct msghdr mh;
     struct iovec iov;
     union {
         struct cmsghdr hdr;
-        uint8_t data[CMSG_SPACE(sizeof(struct ucred))];
+        uint8_t data[READ_CMSG_SPACE];
     } cmsg;
 
     pa_assert(io);
@@ -364,7 +454,7 @@ ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_cr
     mh.msg_control = &cmsg;
     mh.msg_controllen = sizeof(cmsg);
 
-    if ((r = recvmsg(io->ifd, &mh, 0)) >= 0) {
+    if ((r = recvmsg(io->ifd, &mh, MSG_CMSG_CLOEXEC)) >= 0) {
         struct cmsghdr *cmh;
 
         *creds_valid = FALSE;
@@ -379,10 +469,14 @@ ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_cr
                 creds->gid = u.gid;
                 creds->uid = u.uid;
                 *creds_valid = TRUE;
-                break;
-            }
+
+            } else if (cmh->cmsg_level == SOL_SOCKET && cmh->cmsg_type == SCM_RIGHTS)
+                store_received_fds(io, cmh);
         }
 
+        if (mh.msg_flags & MSG_CTRUNC)
+            pa_log_warn("Ancillary data got truncated.");
+
         io->readable = io->hungup = FALSE;
         enable_events(io);
     }
@@ -390,6 +484,64 @@ ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_cr
     return r;
 }
 
+ssize_t pa_iochannel_write_with_fds(pa_iochannel*io, const void*data, size_t l, const int *fds, unsigned n_fds) {
+    ssize_t r;
+    struct msghdr mh;
+    struct iovec iov;
+    union {
+        struct cmsghdr hdr;
+        uint8_t data[CMSG_SPACE(sizeof(int) * PA_IOCHANNEL_FDS_MAX)];
+    } cmsg;
+
+    pa_assert(io);
+    pa_assert(data);
+    pa_assert(l);
+    pa_assert(io->ofd >= 0);
+    pa_assert(fds);
+    pa_assert(n_fds > 0 && n_fds <= PA_IOCHANNEL_FDS_MAX);
+
+    pa_zero(iov);
+    iov.iov_base = (void*) data;
+    iov.iov_len = l;
+
+    pa_zero(cmsg);
+    cmsg.hdr.cmsg_len = CMSG_LEN(sizeof(int) * n_fds);
+    cmsg.hdr.cmsg_level = SOL_SOCKET;
+    cmsg.hdr.cmsg_type = SCM_RIGHTS;
+    memcpy(CMSG_DATA(&cmsg.hdr), fds, sizeof(int) * n_fds);
+
+    pa_zero(mh);
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = &cmsg;
+    mh.msg_controllen = CMSG_SPACE(sizeof(int) * n_fds);
+
+    if ((r = sendmsg(io->ofd, &mh, MSG_NOSIGNAL)) >= 0) {
+        io->writable = io->hungup = FALSE;
+        enable_events(io);
+    }
+
+    return r;
+}
+
+unsigned pa_iochannel_steal_received_fds(pa_iochannel *io, int *fds, unsigned n_max) {
+    unsigned n, i;
+
+    pa_assert(io);
+    pa_assert(fds || n_max == 0);
+
+    n = PA_MIN(io->n_received_fds, n_max);
+    memcpy(fds, io->received_fds, sizeof(int) * n);
+
+    /* Whatever the caller didn't ask for gets closed */
+    for (i = n; i < io->n_received_fds; i++)
+        pa_close(io->received_fds[i]);
+
+    io->n_received_fds = 0;
+
+    return n;
+}
+
 #endif /* HAVE_CREDS */
 
 void pa_iochannel_set_callback(pa_iochannel*io, pa_iochannel_cb_t _callback, void *userdata) {
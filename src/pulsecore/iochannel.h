@@ -29,6 +29,10 @@
 
 #include <sys/types.h>
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
 #include <pulse/mainloop-api.h>
 #include <pulsecore/creds.h>
 #include <pulsecore/macro.h>
@@ -49,14 +53,28 @@ pa_iochannel* pa_iochannel_new(pa_mainloop_api*m, int ifd, int ofd);
 void pa_iochannel_free(pa_iochannel*io);
 
 ssize_t pa_iochannel_write(pa_iochannel*io, const void*data, size_t l);
+#ifdef HAVE_SYS_UIO_H
+/* Writes the buffers with a single call, possibly only partially */
+ssize_t pa_iochannel_writev(pa_iochannel*io, const struct iovec *iov, unsigned n);
+#endif
 ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l);
 
+/* Maximum number of fds that can be passed along with one write */
+#define PA_IOCHANNEL_FDS_MAX 2
+
 #ifdef HAVE_CREDS
 pa_bool_t pa_iochannel_creds_supported(pa_iochannel *io);
 int pa_iochannel_creds_enable(pa_iochannel *io);
 
 ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l, const pa_creds *ucred);
 ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_creds *ucred, pa_bool_t *creds_valid);
+
+/* Passes n_fds fds along with the data. On the receiving side
+ * pa_iochannel_read_with_creds() keeps the fds until they are taken
+ * with pa_iochannel_steal_received_fds(), which returns how many fds
+ * were stored in fds. */
+ssize_t pa_iochannel_write_with_fds(pa_iochannel*io, const void*data, size_t l, const int *fds, unsigned n_fds);
+unsigned pa_iochannel_steal_received_fds(pa_iochannel *io, int *fds, unsigned n_max);
 #endif
 
 pa_bool_t pa_iochannel_is_readable(pa_iochannel*io);
@@ -49,16 +49,58 @@
 #include <pulsecore/flist.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/memtrap.h>
+#include <pulsecore/thread.h>
 
 #include "memblock.h"
 
-/* We can allocate 64*1024*1024 bytes at maximum. That's 64MB. Please
- * note that the footprint is usually much smaller, since the data is
- * stored in SHM and our OS does not commit the memory before we use
- * it for the first time. */
+/* We can allocate 64*1024*1024 bytes at maximum in slots of the
+ * default size. That's 64MB. Please note that the footprint is usually
+ * much smaller, since the data is stored in SHM and our OS does not
+ * commit the memory before we use it for the first time. */
 #define PA_MEMPOOL_SLOTS_MAX 1024
 #define PA_MEMPOOL_SLOT_SIZE (64*1024)
 
+/* Next to the default slots the pool has slots of smaller and larger
+ * size classes in the same segment, so that small blocks don't waste a
+ * whole default slot and large blocks can still be shared. The number
+ * of slots of each class is given for a pool with PA_MEMPOOL_SLOTS_MAX
+ * default slots and scaled along with the pool size. */
+#define PA_MEMPOOL_CLASSES_MAX 6
+
+/* When a pool is full, another segment of the same layout is added to
+ * it, up to a configurable ceiling. Clients attach the new segments
+ * when they first see blocks from them, which must stay well below
+ * PA_MEMIMPORT_SEGMENTS_MAX. */
+#define PA_MEMPOOL_SEGMENTS_MAX 8
+#define PA_MEMPOOL_SEGMENTS_DEFAULT 4
+
+static const struct {
+    size_t block_size;
+    unsigned n_blocks;
+} mempool_class_table[PA_MEMPOOL_CLASSES_MAX] = {
+    { 1024, 1024 },
+    { 4*1024, 512 },
+    { 16*1024, 256 },
+    { PA_MEMPOOL_SLOT_SIZE, PA_MEMPOOL_SLOTS_MAX },
+    { 256*1024, 32 },
+    { 1024*1024, 16 },
+};
+
+/* Every thread keeps a small cache of free slots, so that the shared
+ * free list is touched only once for every PA_MEMPOOL_SLOT_CACHE_SIZE/2
+ * slots a thread allocates or frees. Small pools don't use these
+ * caches, since the slots sitting in them are not available to other
+ * threads. */
+#define PA_MEMPOOL_SLOT_CACHE_SIZE 16
+#define PA_MEMPOOL_SLOT_CACHE_MIN_SLOTS (PA_MEMPOOL_SLOT_CACHE_SIZE*8)
+
+/* Protects the lists of caches of all pools */
+static pa_static_mutex slot_cache_mutex = PA_STATIC_MUTEX_INIT;
+
+/* Caches are matched with pools by serial, since a new pool may get
+ * the address of one freed before */
+static pa_atomic_t next_pool_serial = PA_ATOMIC_INIT(0);
+
 #define PA_MEMEXPORT_SLOTS_MAX 128
 
 #define PA_MEMIMPORT_SLOTS_MAX 160
@@ -92,6 +134,9 @@ struct pa_memblock {
     } per_type;
 };
 
+/* Segments received as memfd can't be attached again by their ID, so
+ * they stay around until the import is freed, instead of being
+ * detached when their last block is gone. */
 struct pa_memimport_segment {
     pa_memimport *import;
     pa_shm memory;
@@ -139,21 +184,77 @@ struct pa_memexport {
     PA_LLIST_FIELDS(pa_memexport);
 };
 
-struct pa_mempool {
-    pa_semaphore *semaphore;
-    pa_mutex *mutex;
+/* Only ever accessed by the thread owning it, except when it is
+ * created and destroyed. Registering and unregistering caches with
+ * their pools happens under slot_cache_mutex. */
+struct mempool_slot_cache {
+    /* NULL once the pool was freed, the owning thread then frees the
+     * cache the next time it creates one, or when it exits */
+    pa_mempool *pool;
+    unsigned pool_serial;
 
-    pa_shm memory;
+    struct mempool_slot *slots[PA_MEMPOOL_CLASSES_MAX][PA_MEMPOOL_SLOT_CACHE_SIZE];
+    unsigned n_slots[PA_MEMPOOL_CLASSES_MAX];
+
+    /* Hits not yet accounted in the pool statistics */
+    unsigned n_hits;
+    int generation;
+
+    /* The other caches of the pool */
+    PA_LLIST_FIELDS(struct mempool_slot_cache);
+
+    /* The caches of the other pools the owning thread used */
+    struct mempool_slot_cache *thread_next;
+};
+
+/* The slots of one size, stored contiguously in every pool segment */
+struct mempool_class {
     size_t block_size;
     unsigned n_blocks;
+    size_t offset;
 
-    pa_atomic_t n_init;
+    /* Whether the slots are kept in the per-thread caches */
+    pa_bool_t cached;
+};
+
+struct mempool_segment {
+    pa_shm memory;
+
+    /* Per class: the number of slots handed out at least once, and a
+     * list of free slots that may be reused */
+    pa_atomic_t n_init[PA_MEMPOOL_CLASSES_MAX];
+    pa_flist *free_slots[PA_MEMPOOL_CLASSES_MAX];
+};
+
+struct pa_mempool {
+    pa_semaphore *semaphore;
+    pa_mutex *mutex;
+
+    /* Segments are only added, under the mutex. n_segments is
+     * increased after the new segment is set up, so that it can be
+     * read without locking. */
+    struct mempool_segment segments[PA_MEMPOOL_SEGMENTS_MAX];
+    pa_atomic_t n_segments;
+    unsigned max_segments;
+    size_t segment_size;
+    pa_bool_t shared;
+    pa_bool_t memfd;
+
+    /* Ordered by block size, default_class holds the slots of
+     * PA_MEMPOOL_SLOT_SIZE */
+    struct mempool_class classes[PA_MEMPOOL_CLASSES_MAX];
+    unsigned n_classes;
+    unsigned default_class;
 
     PA_LLIST_HEAD(pa_memimport, imports);
     PA_LLIST_HEAD(pa_memexport, exports);
 
-    /* A list of free slots that may be reused */
-    pa_flist *free_slots;
+    /* Whether threads keep caches of free slots. Bumping the
+     * generation asks all threads to return their cached slots. */
+    pa_bool_t slot_caches;
+    unsigned serial;
+    PA_LLIST_HEAD(struct mempool_slot_cache, caches);
+    pa_atomic_t slot_cache_generation;
 
     pa_mempool_stat stat;
 };
@@ -246,34 +347,366 @@ static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length) {
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_allocate_slot(pa_mempool *p) {
-    struct mempool_slot *slot;
+static struct mempool_segment* mempool_segment_by_ptr(pa_mempool *p, void *ptr) {
+    unsigned i, n;
+
     pa_assert(p);
 
-    if (!(slot = pa_flist_pop(p->free_slots))) {
+    n = (unsigned) pa_atomic_load(&p->n_segments);
+
+    for (i = 0; i < n; i++) {
+        struct mempool_segment *seg = &p->segments[i];
+
+        if ((uint8_t*) ptr >= (uint8_t*) seg->memory.ptr &&
+            (uint8_t*) ptr < (uint8_t*) seg->memory.ptr + seg->memory.size)
+            return seg;
+    }
+
+    return NULL;
+}
+
+/* No lock necessary */
+static struct mempool_slot* mempool_take_slot(pa_mempool *p, unsigned k) {
+    struct mempool_class *class;
+    unsigned i, n;
+
+    pa_assert(p);
+    pa_assert(k < p->n_classes);
+
+    class = &p->classes[k];
+    n = (unsigned) pa_atomic_load(&p->n_segments);
+
+    /* Prefer the first segments, so that the later ones stay unused
+     * once the load is gone */
+    for (i = 0; i < n; i++) {
+        struct mempool_segment *seg = &p->segments[i];
+        struct mempool_slot *slot;
         int idx;
 
+        if ((slot = pa_flist_pop(seg->free_slots[k])))
+            return slot;
+
         /* The free list was empty, we have to allocate a new entry */
 
-        if ((unsigned) (idx = pa_atomic_inc(&p->n_init)) >= p->n_blocks)
-            pa_atomic_dec(&p->n_init);
-        else
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) idx));
+        if ((unsigned) (idx = pa_atomic_inc(&seg->n_init[k])) >= class->n_blocks) {
+            pa_atomic_dec(&seg->n_init[k]);
+            continue;
+        }
+
+        return (struct mempool_slot*) ((uint8_t*) seg->memory.ptr + class->offset + (class->block_size * (size_t) idx));
+    }
+
+    return NULL;
+}
+
+/* No lock necessary */
+static void mempool_put_slot(pa_mempool *p, unsigned k, struct mempool_slot *slot) {
+    struct mempool_segment *seg;
+
+    pa_assert(p);
+    pa_assert(k < p->n_classes);
+    pa_assert(slot);
+
+    pa_assert_se(seg = mempool_segment_by_ptr(p, slot));
+
+    /* The free list dimensions should easily allow all slots
+     * to fit in, hence try harder if pushing this slot into
+     * the free list fails */
+    while (pa_flist_push(seg->free_slots[k], slot) < 0)
+        ;
+}
+
+/* No lock necessary */
+static void slot_cache_flush_stat(struct mempool_slot_cache *c) {
+    pa_assert(c);
+
+    if (c->n_hits > 0) {
+        pa_atomic_add(&c->pool->stat.n_slot_cache_hits, (int) c->n_hits);
+        c->n_hits = 0;
+    }
+}
+
+/* No lock necessary */
+static void slot_cache_refill(struct mempool_slot_cache *c, unsigned k) {
+    struct mempool_slot *slot;
+
+    pa_assert(c);
+
+    while (c->n_slots[k] < PA_MEMPOOL_SLOT_CACHE_SIZE/2 && (slot = mempool_take_slot(c->pool, k)))
+        c->slots[k][c->n_slots[k]++] = slot;
+
+    pa_atomic_inc(&c->pool->stat.n_slot_cache_refills);
+    slot_cache_flush_stat(c);
+}
+
+/* No lock necessary */
+static void slot_cache_drain(struct mempool_slot_cache *c, unsigned k, unsigned n) {
+    pa_assert(c);
+    pa_assert(n <= c->n_slots[k]);
 
-        if (!slot) {
-            if (pa_log_ratelimit(PA_LOG_DEBUG))
-                pa_log_debug("Pool full");
-            pa_atomic_inc(&p->stat.n_pool_full);
-            return NULL;
+    while (n-- > 0)
+        mempool_put_slot(c->pool, k, c->slots[k][--c->n_slots[k]]);
+
+    pa_atomic_inc(&c->pool->stat.n_slot_cache_drains);
+    slot_cache_flush_stat(c);
+}
+
+/* No lock necessary */
+static void slot_cache_drain_all(struct mempool_slot_cache *c) {
+    unsigned k;
+
+    pa_assert(c);
+
+    for (k = 0; k < c->pool->n_classes; k++)
+        if (c->n_slots[k] > 0)
+            slot_cache_drain(c, k, c->n_slots[k]);
+}
+
+/* Call with slot_cache_mutex held. Returns the slots and detaches the
+ * cache from its pool, the cache itself stays with its thread. */
+static void slot_cache_unregister(struct mempool_slot_cache *c) {
+    pa_mempool *p;
+
+    pa_assert(c);
+    pa_assert_se(p = c->pool);
+
+    slot_cache_drain_all(c);
+
+    PA_LLIST_REMOVE(struct mempool_slot_cache, p->caches, c);
+    pa_atomic_dec(&p->stat.n_slot_caches);
+    c->pool = NULL;
+}
+
+/* Called on exit of every thread that used a pool */
+static void slot_caches_free_cb(void *userdata) {
+    struct mempool_slot_cache *c, *n;
+    pa_mutex *m;
+
+    m = pa_static_mutex_get(&slot_cache_mutex, FALSE, FALSE);
+    pa_mutex_lock(m);
+
+    for (c = userdata; c; c = n) {
+        n = c->thread_next;
+
+        if (c->pool)
+            slot_cache_unregister(c);
+
+        pa_xfree(c);
+    }
+
+    pa_mutex_unlock(m);
+}
+
+/* All threads share one TLS key, holding the list of their caches */
+PA_STATIC_TLS_DECLARE(slot_caches, slot_caches_free_cb);
+
+/* No lock necessary */
+static struct mempool_slot_cache *slot_cache_find(pa_mempool *p) {
+    struct mempool_slot_cache *c;
+
+    /* Other caches may lose their pool under our feet, but the serial
+     * doesn't change */
+    for (c = PA_STATIC_TLS_GET(slot_caches); c; c = c->thread_next)
+        if (c->pool_serial == p->serial)
+            return c;
+
+    return NULL;
+}
+
+/* Returns the slot cache of the calling thread, creating it on first
+ * use. Locks only in that case. */
+static struct mempool_slot_cache *slot_cache_get(pa_mempool *p) {
+    struct mempool_slot_cache *c, *first, **i;
+    pa_mutex *m;
+
+    pa_assert(p);
+
+    if (!p->slot_caches)
+        return NULL;
+
+    if ((c = slot_cache_find(p))) {
+
+        /* Somebody found the pool full, return what we have */
+        if (PA_UNLIKELY(c->generation != pa_atomic_load(&p->slot_cache_generation))) {
+            c->generation = pa_atomic_load(&p->slot_cache_generation);
+            slot_cache_drain_all(c);
         }
+
+        return c;
+    }
+
+    c = pa_xnew0(struct mempool_slot_cache, 1);
+    c->pool = p;
+    c->pool_serial = p->serial;
+    c->generation = pa_atomic_load(&p->slot_cache_generation);
+
+    m = pa_static_mutex_get(&slot_cache_mutex, FALSE, FALSE);
+    pa_mutex_lock(m);
+
+    /* Let's get rid of the caches of pools that are gone while we are
+     * at it */
+    first = PA_STATIC_TLS_GET(slot_caches);
+    for (i = &first; *i; ) {
+        if (!(*i)->pool) {
+            struct mempool_slot_cache *dead = *i;
+
+            *i = dead->thread_next;
+            pa_xfree(dead);
+        } else
+            i = &(*i)->thread_next;
+    }
+
+    PA_LLIST_PREPEND(struct mempool_slot_cache, p->caches, c);
+    pa_atomic_inc(&p->stat.n_slot_caches);
+
+    pa_mutex_unlock(m);
+
+    c->thread_next = first;
+    PA_STATIC_TLS_SET(slot_caches, c);
+
+    return c;
+}
+
+/* No lock necessary */
+static struct mempool_slot* mempool_allocate_slot_from_class(pa_mempool *p, unsigned k) {
+    struct mempool_slot_cache *c;
+    struct mempool_slot *slot = NULL;
+
+    pa_assert(p);
+
+    if (p->classes[k].cached && (c = slot_cache_get(p))) {
+
+        if (c->n_slots[k] > 0)
+            c->n_hits++;
+        else
+            slot_cache_refill(c, k);
+
+        if (c->n_slots[k] > 0)
+            slot = c->slots[k][--c->n_slots[k]];
+
+    } else
+        slot = mempool_take_slot(p, k);
+
+    return slot;
+}
+
+/* Returns the index of the smallest size class that can hold length
+ * bytes, or n_classes if there is none. */
+static unsigned mempool_class_for_length(pa_mempool *p, size_t length) {
+    unsigned k;
+
+    pa_assert(p);
+
+    for (k = 0; k < p->n_classes; k++)
+        if (p->classes[k].block_size >= length)
+            break;
+
+    return k;
+}
+
+static int mempool_segment_init(pa_mempool *p, struct mempool_segment *seg) {
+    unsigned k;
+
+    pa_assert(p);
+    pa_assert(seg);
+
+    if (p->memfd) {
+        if (pa_shm_create_memfd(&seg->memory, p->segment_size) < 0)
+            return -1;
+    } else if (pa_shm_create_rw(&seg->memory, p->segment_size, p->shared, 0700) < 0)
+        return -1;
+
+    for (k = 0; k < p->n_classes; k++) {
+        pa_atomic_store(&seg->n_init[k], 0);
+        seg->free_slots[k] = pa_flist_new(p->classes[k].n_blocks);
+    }
+
+    return 0;
+}
+
+static void mempool_segment_done(pa_mempool *p, struct mempool_segment *seg) {
+    unsigned k;
+
+    pa_assert(p);
+    pa_assert(seg);
+
+    for (k = 0; k < p->n_classes; k++)
+        pa_flist_free(seg->free_slots[k], NULL);
+
+    pa_shm_free(&seg->memory);
+}
+
+/* Self-locked. Adds a segment to the pool unless the ceiling is
+ * reached. Returns FALSE if the pool could not grow beyond n_segments
+ * segments. */
+static pa_bool_t mempool_grow(pa_mempool *p, unsigned n_segments) {
+    char t[PA_BYTES_SNPRINT_MAX];
+    pa_bool_t grown = TRUE;
+    unsigned n;
+
+    pa_assert(p);
+
+    pa_mutex_lock(p->mutex);
+
+    /* Somebody else might have been faster */
+    if ((n = (unsigned) pa_atomic_load(&p->n_segments)) != n_segments)
+        goto finish;
+
+    if (n >= p->max_segments || mempool_segment_init(p, &p->segments[n]) < 0) {
+        grown = FALSE;
+        goto finish;
+    }
+
+    pa_atomic_inc(&p->n_segments);
+    pa_atomic_inc(&p->stat.n_segments);
+
+    pa_log_info("Memory pool grown to %u segments, %s in total.", n + 1,
+                pa_bytes_snprint(t, sizeof(t), (unsigned) ((n + 1) * p->segment_size)));
+
+finish:
+    pa_mutex_unlock(p->mutex);
+
+    return grown;
+}
+
+/* No lock necessary, locks when growing. Takes a slot of the smallest
+ * class that fits, falling back to larger classes when that one is
+ * exhausted, and to a new segment when all of them are. */
+static struct mempool_slot* mempool_allocate_slot(pa_mempool *p, size_t length, unsigned *class) {
+    struct mempool_slot *slot = NULL;
+    unsigned k, n;
+
+    pa_assert(p);
+    pa_assert(class);
+
+    do {
+        n = (unsigned) pa_atomic_load(&p->n_segments);
+
+        for (k = mempool_class_for_length(p, length); k < p->n_classes; k++)
+            if ((slot = mempool_allocate_slot_from_class(p, k)))
+                break;
+
+    } while (!slot && mempool_grow(p, n));
+
+    if (!slot) {
+        if (pa_log_ratelimit(PA_LOG_DEBUG))
+            pa_log_debug("Pool full");
+        pa_atomic_inc(&p->stat.n_pool_full);
+
+        /* Free slots might be sitting in the caches of other threads */
+        if (p->slot_caches)
+            pa_atomic_inc(&p->slot_cache_generation);
+
+        return NULL;
     }
 
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
 /*     if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*         VALGRIND_MALLOCLIKE_BLOCK(slot, p->block_size, 0, 0); */
+/*         VALGRIND_MALLOCLIKE_BLOCK(slot, p->classes[k].block_size, 0, 0); */
 /*     } */
 /* #endif */
 
+    *class = k;
     return slot;
 }
 
@@ -283,23 +716,28 @@ static inline void* mempool_slot_data(struct mempool_slot *slot) {
 }
 
 /* No lock necessary */
-static unsigned mempool_slot_idx(pa_mempool *p, void *ptr) {
+static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr, unsigned *class) {
+    struct mempool_segment *seg;
+    size_t offset;
+    unsigned k;
+
     pa_assert(p);
+    pa_assert(class);
 
-    pa_assert((uint8_t*) ptr >= (uint8_t*) p->memory.ptr);
-    pa_assert((uint8_t*) ptr < (uint8_t*) p->memory.ptr + p->memory.size);
+    pa_assert_se(seg = mempool_segment_by_ptr(p, ptr));
 
-    return (unsigned) ((size_t) ((uint8_t*) ptr - (uint8_t*) p->memory.ptr) / p->block_size);
-}
+    offset = (size_t) ((uint8_t*) ptr - (uint8_t*) seg->memory.ptr);
 
-/* No lock necessary */
-static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr) {
-    unsigned idx;
+    for (k = 0; k < p->n_classes; k++) {
+        struct mempool_class *c = &p->classes[k];
 
-    if ((idx = mempool_slot_idx(p, ptr)) == (unsigned) -1)
-        return NULL;
+        if (offset >= c->offset && offset < c->offset + c->n_blocks * c->block_size) {
+            *class = k;
+            return (struct mempool_slot*) ((uint8_t*) seg->memory.ptr + c->offset + (offset - c->offset) / c->block_size * c->block_size);
+        }
+    }
 
-    return (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (idx * p->block_size));
+    return NULL;
 }
 
 /* No lock necessary */
@@ -307,6 +745,7 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     pa_memblock *b = NULL;
     struct mempool_slot *slot;
     static int mempool_disable = 0;
+    unsigned k;
 
     pa_assert(p);
     pa_assert(length);
@@ -318,35 +757,34 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
         return NULL;
 
     /* If -1 is passed as length we choose the size for the caller: we
-     * take the largest size that fits in one of our slots. */
+     * take the largest size that fits in one of our default slots. */
 
     if (length == (size_t) -1)
         length = pa_mempool_block_size_max(p);
 
-    if (p->block_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
+    if (mempool_class_for_length(p, length) >= p->n_classes) {
+        pa_log_debug("Memory block too large for pool: %lu > %lu", (unsigned long) length,
+                     (unsigned long) p->classes[p->n_classes-1].block_size);
+        pa_atomic_inc(&p->stat.n_too_large_for_pool);
+        return NULL;
+    }
+
+    if (!(slot = mempool_allocate_slot(p, length, &k)))
+        return NULL;
 
-        if (!(slot = mempool_allocate_slot(p)))
-            return NULL;
+    if (p->classes[k].block_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
 
         b = mempool_slot_data(slot);
         b->type = PA_MEMBLOCK_POOL;
         pa_atomic_ptr_store(&b->data, (uint8_t*) b + PA_ALIGN(sizeof(pa_memblock)));
 
-    } else if (p->block_size >= length) {
-
-        if (!(slot = mempool_allocate_slot(p)))
-            return NULL;
+    } else {
 
         if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(unused_memblocks))))
             b = pa_xnew(pa_memblock, 1);
 
         b->type = PA_MEMBLOCK_POOL_EXTERNAL;
         pa_atomic_ptr_store(&b->data, mempool_slot_data(slot));
-
-    } else {
-        pa_log_debug("Memory block too large for pool: %lu > %lu", (unsigned long) length, (unsigned long) p->block_size);
-        pa_atomic_inc(&p->stat.n_too_large_for_pool);
-        return NULL;
     }
 
     PA_REFCNT_INIT(b);
@@ -544,7 +982,7 @@ static void memblock_free(pa_memblock *b) {
             pa_assert_se(pa_hashmap_remove(import->blocks, PA_UINT32_TO_PTR(b->per_type.imported.id)));
 
             pa_assert(segment->n_blocks >= 1);
-            if (-- segment->n_blocks <= 0)
+            if (-- segment->n_blocks <= 0 && !segment->memory.memfd)
                 segment_detach(segment);
 
             pa_mutex_unlock(import->mutex);
@@ -559,24 +997,28 @@ static void memblock_free(pa_memblock *b) {
 
         case PA_MEMBLOCK_POOL_EXTERNAL:
         case PA_MEMBLOCK_POOL: {
+            struct mempool_slot_cache *c;
             struct mempool_slot *slot;
             pa_bool_t call_free;
+            unsigned k;
 
-            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data)));
+            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data), &k));
 
             call_free = b->type == PA_MEMBLOCK_POOL_EXTERNAL;
 
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
 /*             if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*                 VALGRIND_FREELIKE_BLOCK(slot, b->pool->block_size); */
+/*                 VALGRIND_FREELIKE_BLOCK(slot, b->pool->classes[k].block_size); */
 /*             } */
 /* #endif */
 
-            /* The free list dimensions should easily allow all slots
-             * to fit in, hence try harder if pushing this slot into
-             * the free list fails */
-            while (pa_flist_push(b->pool->free_slots, slot) < 0)
-                ;
+            if (b->pool->classes[k].cached && (c = slot_cache_get(b->pool))) {
+                if (c->n_slots[k] >= PA_MEMPOOL_SLOT_CACHE_SIZE)
+                    slot_cache_drain(c, k, PA_MEMPOOL_SLOT_CACHE_SIZE/2);
+
+                c->slots[k][c->n_slots[k]++] = slot;
+            } else
+                mempool_put_slot(b->pool, k, slot);
 
             if (call_free)
                 if (pa_flist_push(PA_STATIC_FLIST_GET(unused_memblocks), b) < 0)
@@ -626,10 +1068,11 @@ static void memblock_make_local(pa_memblock *b) {
 
     pa_atomic_dec(&b->pool->stat.n_allocated_by_type[b->type]);
 
-    if (b->length <= b->pool->block_size) {
+    if (mempool_class_for_length(b->pool, b->length) < b->pool->n_classes) {
         struct mempool_slot *slot;
+        unsigned k;
 
-        if ((slot = mempool_allocate_slot(b->pool))) {
+        if ((slot = mempool_allocate_slot(b->pool, b->length, &k))) {
             void *new_data;
             /* We can move it into a local pool, perfect! */
 
@@ -706,45 +1149,93 @@ static void memblock_replace_import(pa_memblock *b) {
     memblock_make_local(b);
 
     pa_assert(segment->n_blocks >= 1);
-    if (-- segment->n_blocks <= 0)
+    if (-- segment->n_blocks <= 0 && !segment->memory.memfd)
         segment_detach(segment);
 
     pa_mutex_unlock(import->mutex);
 }
 
-pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size) {
+static pa_mempool* mempool_new(pa_bool_t shared, pa_bool_t memfd, size_t size) {
     pa_mempool *p;
     char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX];
+    size_t default_block_size, offset = 0;
+    unsigned n_default, i, k;
 
     p = pa_xnew(pa_mempool, 1);
 
-    p->block_size = PA_PAGE_ALIGN(PA_MEMPOOL_SLOT_SIZE);
-    if (p->block_size < PA_PAGE_SIZE)
-        p->block_size = PA_PAGE_SIZE;
+    default_block_size = PA_PAGE_ALIGN(PA_MEMPOOL_SLOT_SIZE);
+    if (default_block_size < PA_PAGE_SIZE)
+        default_block_size = PA_PAGE_SIZE;
 
     if (size <= 0)
-        p->n_blocks = PA_MEMPOOL_SLOTS_MAX;
+        n_default = PA_MEMPOOL_SLOTS_MAX;
     else {
-        p->n_blocks = (unsigned) (size / p->block_size);
+        n_default = (unsigned) (size / default_block_size);
+
+        if (n_default < 2)
+            n_default = 2;
+    }
+
+    p->n_classes = 0;
+    p->slot_caches = FALSE;
+
+    for (i = 0; i < PA_MEMPOOL_CLASSES_MAX; i++) {
+        struct mempool_class *class = &p->classes[p->n_classes];
+
+        if (mempool_class_table[i].block_size == PA_MEMPOOL_SLOT_SIZE) {
+            p->default_class = p->n_classes;
+            class->block_size = default_block_size;
+            class->n_blocks = n_default;
+        } else {
+            class->block_size = mempool_class_table[i].block_size;
+            class->n_blocks = mempool_class_table[i].n_blocks * n_default / PA_MEMPOOL_SLOTS_MAX;
+        }
 
-        if (p->n_blocks < 2)
-            p->n_blocks = 2;
+        /* Skip classes that are empty in small pools, or that got
+         * swallowed by the default class on systems with large pages */
+        if (class->n_blocks <= 0 ||
+            (p->n_classes > 0 && class->block_size <= p->classes[p->n_classes-1].block_size))
+            continue;
+
+        class->offset = offset;
+        offset += PA_PAGE_ALIGN(class->n_blocks * class->block_size);
+
+        class->cached = class->n_blocks >= PA_MEMPOOL_SLOT_CACHE_MIN_SLOTS;
+
+        p->n_classes++;
     }
 
-    if (pa_shm_create_rw(&p->memory, p->n_blocks * p->block_size, shared, 0700) < 0) {
+    pa_assert(p->n_classes > 0);
+    pa_assert(p->classes[p->default_class].block_size == default_block_size);
+
+    p->segment_size = offset;
+    p->shared = shared;
+    p->memfd = memfd;
+    p->max_segments = PA_MEMPOOL_SEGMENTS_DEFAULT;
+
+    if (mempool_segment_init(p, &p->segments[0]) < 0) {
         pa_xfree(p);
         return NULL;
     }
 
+    p->shared = !!p->segments[0].memory.shared;
+    pa_atomic_store(&p->n_segments, 1);
+
     pa_log_debug("Using %s memory pool with %u slots of size %s each, total size is %s, maximum usable slot size is %lu",
-                 p->memory.shared ? "shared" : "private",
-                 p->n_blocks,
-                 pa_bytes_snprint(t1, sizeof(t1), (unsigned) p->block_size),
-                 pa_bytes_snprint(t2, sizeof(t2), (unsigned) (p->n_blocks * p->block_size)),
+                 p->memfd ? "memfd shared" : (p->shared ? "shared" : "private"),
+                 n_default,
+                 pa_bytes_snprint(t1, sizeof(t1), (unsigned) default_block_size),
+                 pa_bytes_snprint(t2, sizeof(t2), (unsigned) p->segment_size),
                  (unsigned long) pa_mempool_block_size_max(p));
 
+    for (k = 0; k < p->n_classes; k++)
+        if (k != p->default_class)
+            pa_log_debug("Additional %u slots of size %s",
+                         p->classes[k].n_blocks,
+                         pa_bytes_snprint(t1, sizeof(t1), (unsigned) p->classes[k].block_size));
+
     memset(&p->stat, 0, sizeof(p->stat));
-    pa_atomic_store(&p->n_init, 0);
+    pa_atomic_store(&p->stat.n_segments, 1);
 
     PA_LLIST_HEAD_INIT(pa_memimport, p->imports);
     PA_LLIST_HEAD_INIT(pa_memexport, p->exports);
@@ -752,12 +1243,29 @@ pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size) {
     p->mutex = pa_mutex_new(TRUE, TRUE);
     p->semaphore = pa_semaphore_new(0);
 
-    p->free_slots = pa_flist_new(p->n_blocks);
+    PA_LLIST_HEAD_INIT(struct mempool_slot_cache, p->caches);
+    pa_atomic_store(&p->slot_cache_generation, 0);
+
+    p->serial = (unsigned) pa_atomic_inc(&next_pool_serial);
+
+    for (k = 0; k < p->n_classes; k++)
+        if (p->classes[k].cached)
+            p->slot_caches = TRUE;
 
     return p;
 }
 
+pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size) {
+    return mempool_new(shared, FALSE, size);
+}
+
+pa_mempool* pa_mempool_new_memfd(size_t size) {
+    return mempool_new(TRUE, TRUE, size);
+}
+
 void pa_mempool_free(pa_mempool *p) {
+    unsigned n;
+
     pa_assert(p);
 
     pa_mutex_lock(p->mutex);
@@ -770,44 +1278,63 @@ void pa_mempool_free(pa_mempool *p) {
 
     pa_mutex_unlock(p->mutex);
 
-    pa_flist_free(p->free_slots, NULL);
+    /* Take back the slots sitting in the caches of all threads, also
+     * of those that won't use the pool anymore but live on. Exiting
+     * threads do the same under the same lock, hence they can't get
+     * in our way. */
+    if (p->slot_caches) {
+        pa_mutex *m = pa_static_mutex_get(&slot_cache_mutex, FALSE, FALSE);
+
+        pa_mutex_lock(m);
+        while (p->caches)
+            slot_cache_unregister(p->caches);
+        pa_mutex_unlock(m);
+    }
 
     if (pa_atomic_load(&p->stat.n_allocated) > 0) {
 
         /* Ouch, somebody is retaining a memory block reference! */
 
 #ifdef DEBUG_REF
-        unsigned i;
+        unsigned i, j;
         pa_flist *list;
 
         /* Let's try to find at least one of those leaked memory blocks */
 
-        list = pa_flist_new(p->n_blocks);
+        for (n = 0; n < (unsigned) pa_atomic_load(&p->n_segments); n++) {
+            struct mempool_segment *seg = &p->segments[n];
 
-        for (i = 0; i < (unsigned) pa_atomic_load(&p->n_init); i++) {
-            struct mempool_slot *slot;
-            pa_memblock *b, *k;
+            for (j = 0; j < p->n_classes; j++) {
+                struct mempool_class *class = &p->classes[j];
 
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) i));
-            b = mempool_slot_data(slot);
+                list = pa_flist_new(class->n_blocks);
 
-            while ((k = pa_flist_pop(p->free_slots))) {
-                while (pa_flist_push(list, k) < 0)
-                    ;
+                for (i = 0; i < (unsigned) pa_atomic_load(&seg->n_init[j]); i++) {
+                    struct mempool_slot *slot;
+                    pa_memblock *b, *k;
 
-                if (b == k)
-                    break;
-            }
+                    slot = (struct mempool_slot*) ((uint8_t*) seg->memory.ptr + class->offset + (class->block_size * (size_t) i));
+                    b = mempool_slot_data(slot);
 
-            if (!k)
-                pa_log("REF: Leaked memory block %p", b);
+                    while ((k = pa_flist_pop(seg->free_slots[j]))) {
+                        while (pa_flist_push(list, k) < 0)
+                            ;
 
-            while ((k = pa_flist_pop(list)))
-                while (pa_flist_push(p->free_slots, k) < 0)
-                    ;
-        }
+                        if (b == k)
+                            break;
+                    }
+
+                    if (!k)
+                        pa_log("REF: Leaked memory block %p", b);
 
-        pa_flist_free(list, NULL);
+                    while ((k = pa_flist_pop(list)))
+                        while (pa_flist_push(seg->free_slots[j], k) < 0)
+                            ;
+                }
+
+                pa_flist_free(list, NULL);
+            }
+        }
 
 #endif
 
@@ -816,7 +1343,8 @@ void pa_mempool_free(pa_mempool *p) {
 /*         PA_DEBUG_TRAP; */
     }
 
-    pa_shm_free(&p->memory);
+    for (n = 0; n < (unsigned) pa_atomic_load(&p->n_segments); n++)
+        mempool_segment_done(p, &p->segments[n]);
 
     pa_mutex_free(p->mutex);
     pa_semaphore_free(p->semaphore);
@@ -835,40 +1363,68 @@ const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p) {
 size_t pa_mempool_block_size_max(pa_mempool *p) {
     pa_assert(p);
 
-    return p->block_size - PA_ALIGN(sizeof(pa_memblock));
+    return p->classes[p->default_class].block_size - PA_ALIGN(sizeof(pa_memblock));
 }
 
 /* No lock necessary */
 void pa_mempool_vacuum(pa_mempool *p) {
+    struct mempool_slot_cache *c;
     struct mempool_slot *slot;
     pa_flist *list;
+    unsigned i, k;
 
     pa_assert(p);
 
-    list = pa_flist_new(p->n_blocks);
+    /* The caches of other threads are left alone, they are small */
+    if (p->slot_caches && (c = slot_cache_find(p)))
+        slot_cache_drain_all(c);
+
+    for (i = 0; i < (unsigned) pa_atomic_load(&p->n_segments); i++) {
+        struct mempool_segment *seg = &p->segments[i];
 
-    while ((slot = pa_flist_pop(p->free_slots)))
-        while (pa_flist_push(list, slot) < 0)
-            ;
+        for (k = 0; k < p->n_classes; k++) {
+            list = pa_flist_new(p->classes[k].n_blocks);
 
-    while ((slot = pa_flist_pop(list))) {
-        pa_shm_punch(&p->memory, (size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr), p->block_size);
+            while ((slot = pa_flist_pop(seg->free_slots[k])))
+                while (pa_flist_push(list, slot) < 0)
+                    ;
+
+            while ((slot = pa_flist_pop(list))) {
+                pa_shm_punch(&seg->memory, (size_t) ((uint8_t*) slot - (uint8_t*) seg->memory.ptr), p->classes[k].block_size);
+
+                while (pa_flist_push(seg->free_slots[k], slot))
+                    ;
+            }
 
-        while (pa_flist_push(p->free_slots, slot))
-            ;
+            pa_flist_free(list, NULL);
+        }
     }
+}
+
+/* Self-locked */
+void pa_mempool_set_max_size(pa_mempool *p, size_t size) {
+    unsigned n;
 
-    pa_flist_free(list, NULL);
+    pa_assert(p);
+
+    if (size <= 0)
+        n = PA_MEMPOOL_SEGMENTS_DEFAULT;
+    else
+        n = PA_CLAMP_UNLIKELY((unsigned) (size / p->segment_size), 1U, (unsigned) PA_MEMPOOL_SEGMENTS_MAX);
+
+    pa_mutex_lock(p->mutex);
+    p->max_segments = PA_MAX(n, (unsigned) pa_atomic_load(&p->n_segments));
+    pa_mutex_unlock(p->mutex);
 }
 
 /* No lock necessary */
 int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id) {
     pa_assert(p);
 
-    if (!p->memory.shared)
+    if (!p->shared)
         return -1;
 
-    *id = p->memory.id;
+    *id = p->segments[0].memory.id;
 
     return 0;
 }
@@ -877,7 +1433,14 @@ int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id) {
 pa_bool_t pa_mempool_is_shared(pa_mempool *p) {
     pa_assert(p);
 
-    return !!p->memory.shared;
+    return p->shared;
+}
+
+/* No lock necessary */
+pa_bool_t pa_mempool_is_memfd(pa_mempool *p) {
+    pa_assert(p);
+
+    return p->memfd;
 }
 
 /* For receiving blocks from other nodes */
@@ -942,6 +1505,7 @@ static void segment_detach(pa_memimport_segment *seg) {
 void pa_memimport_free(pa_memimport *i) {
     pa_memexport *e;
     pa_memblock *b;
+    pa_memimport_segment *seg;
 
     pa_assert(i);
 
@@ -950,7 +1514,11 @@ void pa_memimport_free(pa_memimport *i) {
     while ((b = pa_hashmap_first(i->blocks)))
         memblock_replace_import(b);
 
-    pa_assert(pa_hashmap_size(i->segments) == 0);
+    while ((seg = pa_hashmap_first(i->segments))) {
+        pa_assert(seg->memory.memfd);
+        pa_assert(seg->n_blocks == 0);
+        segment_detach(seg);
+    }
 
     pa_mutex_unlock(i->mutex);
 
@@ -972,6 +1540,53 @@ void pa_memimport_free(pa_memimport *i) {
     pa_xfree(i);
 }
 
+/* Self-locked. Takes over the fd. */
+int pa_memimport_attach_memfd(pa_memimport *i, uint32_t shm_id, int memfd) {
+    pa_memimport_segment *seg;
+    int r = -1;
+
+    pa_assert(i);
+    pa_assert(memfd >= 0);
+
+    pa_mutex_lock(i->mutex);
+
+    if ((seg = pa_hashmap_get(i->segments, PA_UINT32_TO_PTR(shm_id)))) {
+
+        /* The other side is only supposed to send each segment once */
+        if (seg->n_blocks > 0) {
+            pa_log_warn("Memfd segment %u is already attached.", shm_id);
+            pa_close(memfd);
+            goto finish;
+        }
+
+        segment_detach(seg);
+    }
+
+    if (pa_hashmap_size(i->segments) >= PA_MEMIMPORT_SEGMENTS_MAX) {
+        pa_close(memfd);
+        goto finish;
+    }
+
+    seg = pa_xnew0(pa_memimport_segment, 1);
+
+    if (pa_shm_attach_memfd(&seg->memory, shm_id, memfd, FALSE) < 0) {
+        pa_xfree(seg);
+        goto finish;
+    }
+
+    /* Sealed segments can't shrink, so there is no need to trap SIGBUS */
+    seg->import = i;
+    seg->trap = NULL;
+
+    pa_hashmap_put(i->segments, PA_UINT32_TO_PTR(seg->memory.id), seg);
+    r = 0;
+
+finish:
+    pa_mutex_unlock(i->mutex);
+
+    return r;
+}
+
 /* Self-locked */
 pa_memblock* pa_memimport_get(pa_memimport *i, uint32_t block_id, uint32_t shm_id, size_t offset, size_t size) {
     pa_memblock *b = NULL;
@@ -1050,7 +1665,7 @@ pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void
     pa_assert(p);
     pa_assert(cb);
 
-    if (!p->memory.shared)
+    if (!p->shared)
         return NULL;
 
     e = pa_xnew(pa_memexport, 1);
@@ -1170,7 +1785,7 @@ static pa_memblock *memblock_shared_copy(pa_mempool *p, pa_memblock *b) {
 }
 
 /* Self-locked */
-int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32_t *shm_id, size_t *offset, size_t * size) {
+int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32_t *shm_id, size_t *offset, size_t * size, int *memfd) {
     pa_shm *memory;
     struct memexport_slot *slot;
     void *data;
@@ -1212,9 +1827,12 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32
         pa_assert(b->per_type.imported.segment);
         memory = &b->per_type.imported.segment->memory;
     } else {
+        struct mempool_segment *seg;
+
         pa_assert(b->type == PA_MEMBLOCK_POOL || b->type == PA_MEMBLOCK_POOL_EXTERNAL);
         pa_assert(b->pool);
-        memory = &b->pool->memory;
+        pa_assert_se(seg = mempool_segment_by_ptr(b->pool, data));
+        memory = &seg->memory;
     }
 
     pa_assert(data >= memory->ptr);
@@ -1224,6 +1842,9 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32
     *offset = (size_t) ((uint8_t*) data - (uint8_t*) memory->ptr);
     *size = b->length;
 
+    if (memfd)
+        *memfd = memory->memfd ? memory->fd : -1;
+
     pa_memblock_release(b);
 
     pa_atomic_inc(&e->pool->stat.n_exported);
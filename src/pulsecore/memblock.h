@@ -74,6 +74,17 @@ struct pa_mempool_stat {
     pa_atomic_t n_too_large_for_pool;
     pa_atomic_t n_pool_full;
 
+    /* Number of shm segments the pool consists of */
+    pa_atomic_t n_segments;
+
+    /* Per-thread slot caches: the number of caches alive, the slot
+     * allocations served from them and the batches of slots moved
+     * between them and the shared free list */
+    pa_atomic_t n_slot_caches;
+    pa_atomic_t n_slot_cache_hits;
+    pa_atomic_t n_slot_cache_refills;
+    pa_atomic_t n_slot_cache_drains;
+
     pa_atomic_t n_allocated_by_type[PA_MEMBLOCK_TYPE_MAX];
     pa_atomic_t n_accumulated_by_type[PA_MEMBLOCK_TYPE_MAX];
 };
@@ -120,23 +131,38 @@ pa_memblock *pa_memblock_will_need(pa_memblock *b);
 
 /* The memory block manager */
 pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size);
+/* A shared pool whose segments are memfds. Its blocks can only be
+ * imported by a peer that received the segment fd. Returns NULL if
+ * memfds are not available. */
+pa_mempool* pa_mempool_new_memfd(size_t size);
 void pa_mempool_free(pa_mempool *p);
 const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p);
 void pa_mempool_vacuum(pa_mempool *p);
+/* Limit the size the pool may grow to when it is full. 0 selects the
+ * default ceiling. */
+void pa_mempool_set_max_size(pa_mempool *p, size_t size);
+/* Returns the ID of the first segment of the pool */
 int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id);
 pa_bool_t pa_mempool_is_shared(pa_mempool *p);
+pa_bool_t pa_mempool_is_memfd(pa_mempool *p);
 size_t pa_mempool_block_size_max(pa_mempool *p);
 
 /* For receiving blocks from other nodes */
 pa_memimport* pa_memimport_new(pa_mempool *p, pa_memimport_release_cb_t cb, void *userdata);
 void pa_memimport_free(pa_memimport *i);
 pa_memblock* pa_memimport_get(pa_memimport *i, uint32_t block_id, uint32_t shm_id, size_t offset, size_t size);
+/* Make a memfd segment received from the other side known under its
+ * ID, so that blocks in it can be imported. Takes over the fd. */
+int pa_memimport_attach_memfd(pa_memimport *i, uint32_t shm_id, int memfd);
 int pa_memimport_process_revoke(pa_memimport *i, uint32_t block_id);
 
 /* For sending blocks to other nodes */
 pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void *userdata);
 void pa_memexport_free(pa_memexport *e);
-int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32_t *shm_id, size_t *offset, size_t *size);
+/* If memfd is not NULL it is set to the fd of the segment the block
+ * lives in if that is a memfd, or -1 otherwise. The fd stays owned by
+ * the segment. */
+int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32_t *shm_id, size_t *offset, size_t *size, int *memfd);
 int pa_memexport_process_release(pa_memexport *e, uint32_t id);
 
 #endif
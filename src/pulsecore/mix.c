@@ -67,7 +67,7 @@ static void calc_linear_float_volume(float linear[], const pa_cvolume *volume) {
 }
 
 static void calc_linear_integer_stream_volumes(pa_mix_info streams[], unsigned nstreams, const pa_cvolume *volume, const pa_sample_spec *spec) {
-    unsigned k, channel;
+    unsigned k, channel, padding;
     float linear[PA_CHANNELS_MAX + VOLUME_PADDING];
 
     pa_assert(streams);
@@ -78,15 +78,18 @@ static void calc_linear_integer_stream_volumes(pa_mix_info streams[], unsigned n
 
     for (k = 0; k < nstreams; k++) {
 
-        for (channel = 0; channel < spec->channels; channel++) {
-            pa_mix_info *m = streams + k;
+        pa_mix_info *m = streams + k;
+
+        for (channel = 0; channel < spec->channels; channel++)
             m->linear[channel].i = (int32_t) lrint(pa_sw_volume_to_linear(m->volume.values[channel]) * linear[channel] * 0x10000);
-        }
+
+        for (padding = 0; padding < PA_MIX_VOLUME_PADDING; padding++, channel++)
+            m->linear[channel].i = m->linear[padding].i;
     }
 }
 
 static void calc_linear_float_stream_volumes(pa_mix_info streams[], unsigned nstreams, const pa_cvolume *volume, const pa_sample_spec *spec) {
-    unsigned k, channel;
+    unsigned k, channel, padding;
     float linear[PA_CHANNELS_MAX + VOLUME_PADDING];
 
     pa_assert(streams);
@@ -97,10 +100,13 @@ static void calc_linear_float_stream_volumes(pa_mix_info streams[], unsigned nst
 
     for (k = 0; k < nstreams; k++) {
 
-        for (channel = 0; channel < spec->channels; channel++) {
-            pa_mix_info *m = streams + k;
+        pa_mix_info *m = streams + k;
+
+        for (channel = 0; channel < spec->channels; channel++)
             m->linear[channel].f = (float) (pa_sw_volume_to_linear(m->volume.values[channel]) * linear[channel]);
-        }
+
+        for (padding = 0; padding < PA_MIX_VOLUME_PADDING; padding++, channel++)
+            m->linear[channel].f = m->linear[padding].f;
     }
 }
 
@@ -649,6 +655,63 @@ size_t pa_mix(
     return length;
 }
 
+size_t pa_mix_tiered(
+        pa_mempool *pool,
+        pa_mix_info streams[],
+        unsigned nstreams,
+        void *data,
+        size_t length,
+        const pa_sample_spec *spec,
+        const pa_cvolume *volume,
+        pa_bool_t mute) {
+
+    pa_mix_info partial[PA_MIX_STREAMS_PER_TIER];
+    unsigned block, npartial, k;
+
+    pa_assert(pool);
+    pa_assert(streams);
+    pa_assert(data);
+    pa_assert(length);
+    pa_assert(spec);
+
+    if (nstreams <= PA_MIX_STREAMS_PER_TIER)
+        return pa_mix(streams, nstreams, data, length, spec, volume, mute);
+
+    if (mute || (volume && pa_cvolume_is_muted(volume))) {
+        pa_silence_memory(data, length, spec);
+        return length;
+    }
+
+    /* Find the smallest block size that leaves us with no more than
+     * PA_MIX_STREAMS_PER_TIER partial mixes to combine in this tier */
+    for (block = PA_MIX_STREAMS_PER_TIER; nstreams > block * PA_MIX_STREAMS_PER_TIER; block *= PA_MIX_STREAMS_PER_TIER)
+        ;
+
+    for (k = 0, npartial = 0; k < nstreams; k += block, npartial++) {
+        pa_mix_info *p = partial + npartial;
+        void *ptr;
+
+        /* The volume is applied in the lowest tier only, the
+         * partial mixes are combined at unity volume */
+        p->chunk.memblock = pa_memblock_new(pool, length);
+        p->chunk.index = 0;
+
+        ptr = pa_memblock_acquire(p->chunk.memblock);
+        p->chunk.length = pa_mix_tiered(pool, streams + k, PA_MIN(block, nstreams - k), ptr, length, spec, volume, FALSE);
+        pa_memblock_release(p->chunk.memblock);
+
+        pa_cvolume_reset(&p->volume, spec->channels);
+        p->userdata = NULL;
+    }
+
+    length = pa_mix(partial, npartial, data, length, spec, NULL, FALSE);
+
+    for (k = 0; k < npartial; k++)
+        pa_memblock_unref(partial[k].chunk.memblock);
+
+    return length;
+}
+
 pa_do_mix_func_t pa_get_mix_func(pa_sample_format_t f) {
     pa_assert(f >= 0);
     pa_assert(f < PA_SAMPLE_MAX);
@@ -723,3 +786,137 @@ void pa_volume_memchunk(
 
     pa_memblock_release(c->memblock);
 }
+
+void pa_volume_ramp_init(pa_volume_ramp *r, pa_volume_ramp_type_t type, float start, pa_volume_t target, size_t length) {
+    pa_assert(r);
+    pa_assert(type >= 0);
+    pa_assert(type < PA_VOLUME_RAMP_MAX);
+    pa_assert(PA_VOLUME_IS_VALID(target));
+
+    if (length <= 0) {
+        pa_volume_ramp_reset(r, target);
+        return;
+    }
+
+    r->type = type;
+    r->target = target;
+    r->end = (float) pa_sw_volume_to_linear(target);
+    r->length = length;
+
+    if (type == PA_VOLUME_RAMP_LINEAR) {
+        r->start = start;
+        r->step = (r->end - start) / (float) length;
+    } else {
+        r->start = PA_MAX(start, PA_VOLUME_RAMP_MIN_GAIN);
+        r->step = powf(PA_MAX(r->end, PA_VOLUME_RAMP_MIN_GAIN) / r->start, 1.0f / (float) length);
+    }
+}
+
+void pa_volume_ramp_reset(pa_volume_ramp *r, pa_volume_t target) {
+    pa_assert(r);
+    pa_assert(PA_VOLUME_IS_VALID(target));
+
+    r->type = PA_VOLUME_RAMP_LINEAR;
+    r->target = target;
+    r->start = r->end = (float) pa_sw_volume_to_linear(target);
+    r->step = 0;
+    r->length = 0;
+}
+
+float pa_volume_ramp_get_gain(const pa_volume_ramp *r, size_t frame) {
+    pa_assert(r);
+
+    if (frame >= r->length)
+        return r->end;
+
+    if (r->type == PA_VOLUME_RAMP_LINEAR)
+        return r->start + r->step * (float) frame;
+
+    return r->start * powf(r->step, (float) frame);
+}
+
+/* How many frames get the same gain when ramping formats without ramp
+ * functions */
+#define VOLUME_RAMP_STEP_FRAMES 32
+
+static void volume_ramp(void *ptr, const pa_sample_spec *spec, const pa_volume_ramp *r, size_t frame, size_t n) {
+    pa_do_volume_ramp_func_t do_ramp;
+    pa_do_volume_func_t do_volume;
+    volume_val linear[PA_CHANNELS_MAX + VOLUME_PADDING];
+    size_t fs, k;
+
+    fs = pa_frame_size(spec);
+
+    if ((do_ramp = pa_get_volume_ramp_func(spec->format, r->type))) {
+        float gains[PA_CHANNELS_MAX], steps[PA_CHANNELS_MAX];
+        unsigned channel;
+
+        /* Start off every chunk with an exact gain, so that rounding
+         * errors of the ramp functions don't pile up */
+        for (channel = 0; channel < spec->channels; channel++) {
+            gains[channel] = pa_volume_ramp_get_gain(r, frame);
+            steps[channel] = r->step;
+        }
+
+        do_ramp(ptr, gains, steps, spec->channels, (unsigned) (n * fs));
+        return;
+    }
+
+    do_volume = pa_get_volume_func(spec->format);
+    pa_assert(do_volume);
+
+    for (; n > 0; n -= k, frame += k, ptr = (uint8_t*) ptr + k * fs) {
+        pa_cvolume v;
+
+        k = PA_MIN(n, (size_t) VOLUME_RAMP_STEP_FRAMES);
+
+        pa_cvolume_set(&v, spec->channels, pa_sw_volume_from_linear(pa_volume_ramp_get_gain(r, frame + k / 2)));
+        calc_volume_table[spec->format] ((void *)linear, &v);
+
+        do_volume(ptr, (void *)linear, spec->channels, (unsigned) (k * fs));
+    }
+}
+
+void pa_volume_ramp_memchunk(
+        pa_memchunk *c,
+        const pa_sample_spec *spec,
+        const pa_volume_ramp *r,
+        size_t frame) {
+
+    pa_memchunk tail;
+    pa_cvolume v;
+    size_t fs, n;
+
+    pa_assert(c);
+    pa_assert(spec);
+    pa_assert(pa_sample_spec_valid(spec));
+    pa_assert(pa_frame_aligned(c->length, spec));
+    pa_assert(r);
+
+    if (pa_memblock_is_silence(c->memblock))
+        return;
+
+    fs = pa_frame_size(spec);
+    n = 0;
+
+    if (frame < r->length) {
+        void *ptr;
+
+        n = PA_MIN(c->length / fs, r->length - frame);
+
+        ptr = pa_memblock_acquire_chunk(c);
+        volume_ramp(ptr, spec, r, frame, n);
+        pa_memblock_release(c->memblock);
+    }
+
+    if (n * fs >= c->length)
+        return;
+
+    /* The rest of the chunk is past the end of the ramp */
+    tail = *c;
+    tail.index += n * fs;
+    tail.length -= n * fs;
+
+    pa_cvolume_set(&v, spec->channels, r->target);
+    pa_volume_memchunk(&tail, spec, &v);
+}
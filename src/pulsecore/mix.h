@@ -27,6 +27,13 @@
 #include <pulse/sample.h>
 #include <pulse/volume.h>
 #include <pulsecore/memchunk.h>
+#include <pulsecore/sample-util.h>
+
+/* The per-channel volumes in pa_mix_info are repeated for this many
+ * entries past the last channel, so that optimized mixing functions
+ * can load the volumes for a whole vector of samples starting at any
+ * channel. */
+#define PA_MIX_VOLUME_PADDING 16
 
 typedef struct pa_mix_info {
     pa_memchunk chunk;
@@ -39,7 +46,7 @@ typedef struct pa_mix_info {
     union {
         int32_t i;
         float f;
-    } linear[PA_CHANNELS_MAX];
+    } linear[PA_CHANNELS_MAX + PA_MIX_VOLUME_PADDING];
 } pa_mix_info;
 
 size_t pa_mix(
@@ -51,6 +58,26 @@ size_t pa_mix(
     const pa_cvolume *volume,
     pa_bool_t mute);
 
+/* pa_mix_tiered() never mixes more than this many streams in a single
+ * pass of the per-format mixing functions. */
+#define PA_MIX_STREAMS_PER_TIER 32
+
+/* Like pa_mix(), but suitable for an arbitrary number of streams. The
+ * streams are mixed in blocks of at most PA_MIX_STREAMS_PER_TIER, the
+ * partial mixes are stored in blocks allocated from the pool and are
+ * then mixed together in the next tier. Partial mixes are clamped to
+ * the sample format, hence the result can differ from pa_mix() for
+ * integer formats when individual blocks clip. */
+size_t pa_mix_tiered(
+    pa_mempool *pool,
+    pa_mix_info channels[],
+    unsigned nchannels,
+    void *data,
+    size_t length,
+    const pa_sample_spec *spec,
+    const pa_cvolume *volume,
+    pa_bool_t mute);
+
 typedef void (*pa_do_mix_func_t) (pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length);
 
 pa_do_mix_func_t pa_get_mix_func(pa_sample_format_t f);
@@ -61,4 +88,35 @@ void pa_volume_memchunk(
     const pa_sample_spec *spec,
     const pa_cvolume *volume);
 
+/* Logarithmic ramps can't start or end at zero, they start or end at
+ * this gain instead and the target volume applies right after them */
+#define PA_VOLUME_RAMP_MIN_GAIN (1.0f / 65536.0f)
+
+/* A ramp of the volume of all channels from the linear gain start to
+ * the volume target over length frames. Frames past the end of the
+ * ramp get target. */
+typedef struct pa_volume_ramp {
+    pa_volume_ramp_type_t type;
+    float start, step, end;
+    size_t length;
+    pa_volume_t target;
+} pa_volume_ramp;
+
+void pa_volume_ramp_init(pa_volume_ramp *r, pa_volume_ramp_type_t type, float start, pa_volume_t target, size_t length);
+
+/* A ramp that is already over */
+void pa_volume_ramp_reset(pa_volume_ramp *r, pa_volume_t target);
+
+/* The linear gain at frame of the ramp */
+float pa_volume_ramp_get_gain(const pa_volume_ramp *r, size_t frame);
+
+/* Applies the ramp to c, whose first frame is frame of the ramp. c
+ * needs to be writable. Formats without ramp functions are ramped in
+ * steps of a few frames with the static volume functions. */
+void pa_volume_ramp_memchunk(
+    pa_memchunk *c,
+    const pa_sample_spec *spec,
+    const pa_volume_ramp *r,
+    size_t frame);
+
 #endif
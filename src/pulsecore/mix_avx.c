@@ -0,0 +1,520 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-x86.h"
+#include "mix.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+#include <immintrin.h>
+
+/* The functions below are compiled for AVX2 and AVX-512 regardless of
+ * the flags the rest of the file is built with, and are only installed
+ * after checking the CPU flags at runtime. */
+#define AVX2 __attribute__ ((target ("avx2")))
+#define AVX512 __attribute__ ((target ("avx512f,avx512bw")))
+
+static pa_do_mix_func_t fallback[PA_SAMPLE_MAX];
+
+/* Returns how many of the n samples can be mixed in vectors of width
+ * samples, such that the remainder starts at the first channel again
+ * and can be handed to the fallback function. */
+static unsigned vector_samples(unsigned n, unsigned channels, unsigned width) {
+    unsigned step = width;
+
+    while (step % channels)
+        step += width;
+
+    return n - n % step;
+}
+
+static void mix_remainder(pa_sample_format_t f, pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length, unsigned done) {
+    unsigned i;
+
+    for (i = 0; i < nstreams; i++)
+        streams[i].ptr = (uint8_t*) streams[i].ptr + done;
+
+    fallback[f](streams, nstreams, channels, (uint8_t*) data + done, length - done);
+}
+
+/* AVX2 */
+
+/* Same as pa_mult_s16_volume() for eight samples. The samples must be
+ * zero extended to 32 bits, the volumes are 16.16 fixed point values */
+static inline AVX2 __m256i mult_s16_volume_avx2(__m256i v, __m256i cv) {
+    __m256i sign, lo, hi;
+
+    /* (v * lo) >> 16, computed unsigned and corrected for negative v */
+    sign = _mm256_and_si256(_mm256_cmpgt_epi16(_mm256_setzero_si256(), v), cv);
+    lo = _mm256_sub_epi32(_mm256_mulhi_epu16(v, cv), sign);
+
+    /* v * hi */
+    hi = _mm256_madd_epi16(v, _mm256_srli_epi32(cv, 16));
+
+    return _mm256_add_epi32(lo, hi);
+}
+
+/* (v * cv) >> 16 for the even 32 bit lanes of v and cv, as 64 bit values */
+static inline AVX2 __m256i mult_s32_volume_avx2(__m256i v, __m256i cv) {
+    __m256i p = _mm256_mul_epi32(v, cv);
+
+    /* There is no arithmetic 64 bit shift before AVX-512 */
+    return _mm256_or_si256(_mm256_srli_epi64(p, 16),
+                           _mm256_slli_epi64(_mm256_cmpgt_epi64(_mm256_setzero_si256(), p), 48));
+}
+
+static inline AVX2 __m256i clamp_s32_avx2(__m256i v) {
+    const __m256i max = _mm256_set1_epi64x(0x7FFFFFFFLL);
+    const __m256i min = _mm256_set1_epi64x(-0x80000000LL);
+
+    v = _mm256_blendv_epi8(v, max, _mm256_cmpgt_epi64(v, max));
+    return _mm256_blendv_epi8(v, min, _mm256_cmpgt_epi64(min, v));
+}
+
+static inline AVX2 __m256i swap16_avx2(__m256i v) {
+    return _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+}
+
+static inline AVX2 __m256i swap32_avx2(__m256i v) {
+    const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    return _mm256_shuffle_epi8(v, mask);
+}
+
+static inline AVX2 void mix_s16_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned n, pa_bool_t swap) {
+    unsigned channel = 0, i, k;
+
+    for (k = 0; k < n; k += 16) {
+        __m256i sum0 = _mm256_setzero_si256(), sum1 = _mm256_setzero_si256(), v;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            v = _mm256_loadu_si256((const __m256i*) ((const int16_t*) m->ptr + k));
+            if (swap)
+                v = swap16_avx2(v);
+
+            sum0 = _mm256_add_epi32(sum0, mult_s16_volume_avx2(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)),
+                                                               _mm256_loadu_si256((const __m256i*) &m->linear[channel].i)));
+            sum1 = _mm256_add_epi32(sum1, mult_s16_volume_avx2(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1)),
+                                                               _mm256_loadu_si256((const __m256i*) &m->linear[channel + 8].i)));
+        }
+
+        /* packs works on 128 bit lanes, put the samples back in order */
+        v = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum0, sum1), _MM_SHUFFLE(3, 1, 2, 0));
+        if (swap)
+            v = swap16_avx2(v);
+        _mm256_storeu_si256((__m256i*) (data + k), v);
+
+        for (channel += 16; channel >= channels; channel -= channels)
+            ;
+    }
+}
+
+static AVX2 void pa_mix_s16ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(int16_t), channels, 16);
+
+    mix_s16_avx2(streams, nstreams, channels, data, n, FALSE);
+    mix_remainder(PA_SAMPLE_S16NE, streams, nstreams, channels, data, length, n * sizeof(int16_t));
+}
+
+static AVX2 void pa_mix_s16re_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(int16_t), channels, 16);
+
+    mix_s16_avx2(streams, nstreams, channels, data, n, TRUE);
+    mix_remainder(PA_SAMPLE_S16RE, streams, nstreams, channels, data, length, n * sizeof(int16_t));
+}
+
+static AVX2 void pa_mix_u8_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, uint8_t *data, unsigned length) {
+    const __m256i offset = _mm256_set1_epi32(0x80);
+    const __m256i low = _mm256_set1_epi32(0xFFFF);
+    unsigned n = vector_samples(length, channels, 16);
+    unsigned channel = 0, i, k;
+
+    for (k = 0; k < n; k += 16) {
+        __m256i sum0 = _mm256_setzero_si256(), sum1 = _mm256_setzero_si256(), v;
+        __m128i r;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            const uint8_t *ptr = (const uint8_t*) m->ptr + k;
+
+            /* Signed 16 bit samples in the low half of each 32 bit lane */
+            v = _mm256_and_si256(_mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) ptr)), offset), low);
+            sum0 = _mm256_add_epi32(sum0, mult_s16_volume_avx2(v, _mm256_loadu_si256((const __m256i*) &m->linear[channel].i)));
+
+            v = _mm256_and_si256(_mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (ptr + 8))), offset), low);
+            sum1 = _mm256_add_epi32(sum1, mult_s16_volume_avx2(v, _mm256_loadu_si256((const __m256i*) &m->linear[channel + 8].i)));
+        }
+
+        v = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum0, sum1), _MM_SHUFFLE(3, 1, 2, 0));
+        r = _mm_packs_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        _mm_storeu_si128((__m128i*) (data + k), _mm_xor_si128(r, _mm_set1_epi8((char) 0x80)));
+
+        for (channel += 16; channel >= channels; channel -= channels)
+            ;
+    }
+
+    mix_remainder(PA_SAMPLE_U8, streams, nstreams, channels, data, length, n);
+}
+
+/* Handles s32 and s24-32, the latter are shifted to s32 on load and back
+ * on store */
+static inline AVX2 void mix_s32_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned n, pa_bool_t swap, pa_bool_t s24) {
+    unsigned channel = 0, i, k;
+
+    for (k = 0; k < n; k += 8) {
+        __m256i even = _mm256_setzero_si256(), odd = _mm256_setzero_si256(), v, cv;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            v = _mm256_loadu_si256((const __m256i*) ((const int32_t*) m->ptr + k));
+            if (swap)
+                v = swap32_avx2(v);
+            if (s24)
+                v = _mm256_slli_epi32(v, 8);
+
+            cv = _mm256_loadu_si256((const __m256i*) &m->linear[channel].i);
+
+            even = _mm256_add_epi64(even, mult_s32_volume_avx2(v, cv));
+            odd = _mm256_add_epi64(odd, mult_s32_volume_avx2(_mm256_srli_epi64(v, 32), _mm256_srli_epi64(cv, 32)));
+        }
+
+        v = _mm256_blend_epi32(clamp_s32_avx2(even), _mm256_slli_epi64(clamp_s32_avx2(odd), 32), 0xAA);
+        if (s24)
+            v = _mm256_srli_epi32(v, 8);
+        if (swap)
+            v = swap32_avx2(v);
+        _mm256_storeu_si256((__m256i*) (data + k), v);
+
+        for (channel += 8; channel >= channels; channel -= channels)
+            ;
+    }
+}
+
+static AVX2 void pa_mix_s32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(int32_t), channels, 8);
+
+    mix_s32_avx2(streams, nstreams, channels, data, n, FALSE, FALSE);
+    mix_remainder(PA_SAMPLE_S32NE, streams, nstreams, channels, data, length, n * sizeof(int32_t));
+}
+
+static AVX2 void pa_mix_s32re_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(int32_t), channels, 8);
+
+    mix_s32_avx2(streams, nstreams, channels, data, n, TRUE, FALSE);
+    mix_remainder(PA_SAMPLE_S32RE, streams, nstreams, channels, data, length, n * sizeof(int32_t));
+}
+
+static AVX2 void pa_mix_s24_32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(int32_t), channels, 8);
+
+    mix_s32_avx2(streams, nstreams, channels, data, n, FALSE, TRUE);
+    mix_remainder(PA_SAMPLE_S24_32NE, streams, nstreams, channels, data, length, n * sizeof(int32_t));
+}
+
+static inline AVX2 void mix_float32_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned n, pa_bool_t swap) {
+    unsigned channel = 0, i, k;
+
+    for (k = 0; k < n; k += 8) {
+        __m256 sum = _mm256_setzero_ps(), v;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            if (swap)
+                v = _mm256_castsi256_ps(swap32_avx2(_mm256_loadu_si256((const __m256i*) ((const float*) m->ptr + k))));
+            else
+                v = _mm256_loadu_ps((const float*) m->ptr + k);
+
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(v, _mm256_loadu_ps(&m->linear[channel].f)));
+        }
+
+        if (swap)
+            _mm256_storeu_si256((__m256i*) (data + k), swap32_avx2(_mm256_castps_si256(sum)));
+        else
+            _mm256_storeu_ps(data + k, sum);
+
+        for (channel += 8; channel >= channels; channel -= channels)
+            ;
+    }
+}
+
+static AVX2 void pa_mix_float32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(float), channels, 8);
+
+    mix_float32_avx2(streams, nstreams, channels, data, n, FALSE);
+    mix_remainder(PA_SAMPLE_FLOAT32NE, streams, nstreams, channels, data, length, n * sizeof(float));
+}
+
+static AVX2 void pa_mix_float32re_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(float), channels, 8);
+
+    mix_float32_avx2(streams, nstreams, channels, data, n, TRUE);
+    mix_remainder(PA_SAMPLE_FLOAT32RE, streams, nstreams, channels, data, length, n * sizeof(float));
+}
+
+/* AVX-512 */
+
+/* The plain AVX-512 intrinsics of GCC merge into an undefined vector
+ * that is made by initialising a variable with itself, which trips
+ * -Winit-self and -Wmaybe-uninitialized. Their zero-masking versions
+ * don't, and with all lanes enabled compile to the same instructions. */
+#define ALL32 ((__mmask16) 0xFFFF)
+#define ALL64 ((__mmask8) 0xFF)
+
+/* Same as pa_mult_s16_volume() for sixteen samples. The samples must be
+ * zero extended to 32 bits, the volumes are 16.16 fixed point values */
+static inline AVX512 __m512i mult_s16_volume_avx512(__m512i v, __m512i cv) {
+    __m512i sign, lo, hi;
+
+    sign = _mm512_maskz_mov_epi16(_mm512_cmpgt_epi16_mask(_mm512_setzero_si512(), v), cv);
+    lo = _mm512_sub_epi32(_mm512_mulhi_epu16(v, cv), sign);
+    hi = _mm512_madd_epi16(v, _mm512_maskz_srli_epi32(ALL32, cv, 16));
+
+    return _mm512_add_epi32(lo, hi);
+}
+
+static inline AVX512 __m512i mult_s32_volume_avx512(__m512i v, __m512i cv) {
+    return _mm512_maskz_srai_epi64(ALL64, _mm512_maskz_mul_epi32(ALL64, v, cv), 16);
+}
+
+static inline AVX512 __m512i clamp_s32_avx512(__m512i v) {
+    v = _mm512_maskz_min_epi64(ALL64, v, _mm512_set1_epi64(0x7FFFFFFFLL));
+    return _mm512_maskz_max_epi64(ALL64, v, _mm512_set1_epi64(-0x80000000LL));
+}
+
+static inline AVX512 __m512i swap32_avx512(__m512i v) {
+    const __m512i mask = _mm512_maskz_broadcast_i32x4(ALL32, _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+
+    return _mm512_shuffle_epi8(v, mask);
+}
+
+static inline AVX512 void mix_s16_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned n, pa_bool_t swap) {
+    unsigned channel = 0, i, k;
+
+    for (k = 0; k < n; k += 16) {
+        __m512i sum = _mm512_setzero_si512();
+        __m256i v;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            v = _mm256_loadu_si256((const __m256i*) ((const int16_t*) m->ptr + k));
+            if (swap)
+                v = swap16_avx2(v);
+
+            sum = _mm512_add_epi32(sum, mult_s16_volume_avx512(_mm512_maskz_cvtepu16_epi32(ALL32, v),
+                                                               _mm512_loadu_si512(&m->linear[channel].i)));
+        }
+
+        v = _mm512_maskz_cvtsepi32_epi16(ALL32, sum);
+        if (swap)
+            v = swap16_avx2(v);
+        _mm256_storeu_si256((__m256i*) (data + k), v);
+
+        for (channel += 16; channel >= channels; channel -= channels)
+            ;
+    }
+}
+
+static AVX512 void pa_mix_s16ne_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(int16_t), channels, 16);
+
+    mix_s16_avx512(streams, nstreams, channels, data, n, FALSE);
+    mix_remainder(PA_SAMPLE_S16NE, streams, nstreams, channels, data, length, n * sizeof(int16_t));
+}
+
+static AVX512 void pa_mix_s16re_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(int16_t), channels, 16);
+
+    mix_s16_avx512(streams, nstreams, channels, data, n, TRUE);
+    mix_remainder(PA_SAMPLE_S16RE, streams, nstreams, channels, data, length, n * sizeof(int16_t));
+}
+
+static AVX512 void pa_mix_u8_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, uint8_t *data, unsigned length) {
+    const __m512i offset = _mm512_set1_epi32(0x80);
+    const __m512i low = _mm512_set1_epi32(0xFFFF);
+    unsigned n = vector_samples(length, channels, 16);
+    unsigned channel = 0, i, k;
+
+    for (k = 0; k < n; k += 16) {
+        __m512i sum = _mm512_setzero_si512(), v;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            /* Signed 16 bit samples in the low half of each 32 bit lane */
+            v = _mm512_maskz_cvtepu8_epi32(ALL32, _mm_loadu_si128((const __m128i*) ((const uint8_t*) m->ptr + k)));
+            v = _mm512_and_si512(_mm512_sub_epi32(v, offset), low);
+
+            sum = _mm512_add_epi32(sum, mult_s16_volume_avx512(v, _mm512_loadu_si512(&m->linear[channel].i)));
+        }
+
+        _mm_storeu_si128((__m128i*) (data + k), _mm_xor_si128(_mm512_maskz_cvtsepi32_epi8(ALL32, sum), _mm_set1_epi8((char) 0x80)));
+
+        for (channel += 16; channel >= channels; channel -= channels)
+            ;
+    }
+
+    mix_remainder(PA_SAMPLE_U8, streams, nstreams, channels, data, length, n);
+}
+
+static inline AVX512 void mix_s32_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned n, pa_bool_t swap, pa_bool_t s24) {
+    unsigned channel = 0, i, k;
+
+    for (k = 0; k < n; k += 16) {
+        __m512i even = _mm512_setzero_si512(), odd = _mm512_setzero_si512(), v, cv;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            v = _mm512_loadu_si512((const int32_t*) m->ptr + k);
+            if (swap)
+                v = swap32_avx512(v);
+            if (s24)
+                v = _mm512_maskz_slli_epi32(ALL32, v, 8);
+
+            cv = _mm512_loadu_si512(&m->linear[channel].i);
+
+            even = _mm512_add_epi64(even, mult_s32_volume_avx512(v, cv));
+            odd = _mm512_add_epi64(odd, mult_s32_volume_avx512(_mm512_maskz_srli_epi64(ALL64, v, 32), _mm512_maskz_srli_epi64(ALL64, cv, 32)));
+        }
+
+        v = _mm512_mask_blend_epi32(0xAAAA, clamp_s32_avx512(even), _mm512_maskz_slli_epi64(ALL64, clamp_s32_avx512(odd), 32));
+        if (s24)
+            v = _mm512_maskz_srli_epi32(ALL32, v, 8);
+        if (swap)
+            v = swap32_avx512(v);
+        _mm512_storeu_si512(data + k, v);
+
+        for (channel += 16; channel >= channels; channel -= channels)
+            ;
+    }
+}
+
+static AVX512 void pa_mix_s32ne_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(int32_t), channels, 16);
+
+    mix_s32_avx512(streams, nstreams, channels, data, n, FALSE, FALSE);
+    mix_remainder(PA_SAMPLE_S32NE, streams, nstreams, channels, data, length, n * sizeof(int32_t));
+}
+
+static AVX512 void pa_mix_s32re_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(int32_t), channels, 16);
+
+    mix_s32_avx512(streams, nstreams, channels, data, n, TRUE, FALSE);
+    mix_remainder(PA_SAMPLE_S32RE, streams, nstreams, channels, data, length, n * sizeof(int32_t));
+}
+
+static AVX512 void pa_mix_s24_32ne_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(int32_t), channels, 16);
+
+    mix_s32_avx512(streams, nstreams, channels, data, n, FALSE, TRUE);
+    mix_remainder(PA_SAMPLE_S24_32NE, streams, nstreams, channels, data, length, n * sizeof(int32_t));
+}
+
+static inline AVX512 void mix_float32_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned n, pa_bool_t swap) {
+    unsigned channel = 0, i, k;
+
+    for (k = 0; k < n; k += 16) {
+        __m512 sum = _mm512_setzero_ps(), v;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            if (swap)
+                v = _mm512_castsi512_ps(swap32_avx512(_mm512_loadu_si512((const float*) m->ptr + k)));
+            else
+                v = _mm512_loadu_ps((const float*) m->ptr + k);
+
+            sum = _mm512_add_ps(sum, _mm512_mul_ps(v, _mm512_loadu_ps(&m->linear[channel].f)));
+        }
+
+        if (swap)
+            _mm512_storeu_si512(data + k, swap32_avx512(_mm512_castps_si512(sum)));
+        else
+            _mm512_storeu_ps(data + k, sum);
+
+        for (channel += 16; channel >= channels; channel -= channels)
+            ;
+    }
+}
+
+static AVX512 void pa_mix_float32ne_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(float), channels, 16);
+
+    mix_float32_avx512(streams, nstreams, channels, data, n, FALSE);
+    mix_remainder(PA_SAMPLE_FLOAT32NE, streams, nstreams, channels, data, length, n * sizeof(float));
+}
+
+static AVX512 void pa_mix_float32re_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(float), channels, 16);
+
+    mix_float32_avx512(streams, nstreams, channels, data, n, TRUE);
+    mix_remainder(PA_SAMPLE_FLOAT32RE, streams, nstreams, channels, data, length, n * sizeof(float));
+}
+
+static void set_mix_func(pa_sample_format_t f, pa_do_mix_func_t func) {
+    /* Don't end up calling ourselves for the remainder if we get
+     * initialised twice */
+    if (pa_get_mix_func(f) != func)
+        fallback[f] = pa_get_mix_func(f);
+    pa_set_mix_func(f, func);
+}
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+/* a-law, u-law and packed 24 bit samples are left to the generic
+ * functions, as are byte swapped s24-32 samples. */
+void pa_mix_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+    if ((flags & PA_CPU_X86_AVX512F) && (flags & PA_CPU_X86_AVX512BW)) {
+        pa_log_info("Initialising AVX-512 optimized mixing functions.");
+
+        set_mix_func(PA_SAMPLE_U8, (pa_do_mix_func_t) pa_mix_u8_avx512);
+        set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_avx512);
+        set_mix_func(PA_SAMPLE_S16RE, (pa_do_mix_func_t) pa_mix_s16re_avx512);
+        set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_avx512);
+        set_mix_func(PA_SAMPLE_S32RE, (pa_do_mix_func_t) pa_mix_s32re_avx512);
+        set_mix_func(PA_SAMPLE_S24_32NE, (pa_do_mix_func_t) pa_mix_s24_32ne_avx512);
+        set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_avx512);
+        set_mix_func(PA_SAMPLE_FLOAT32RE, (pa_do_mix_func_t) pa_mix_float32re_avx512);
+    } else if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized mixing functions.");
+
+        set_mix_func(PA_SAMPLE_U8, (pa_do_mix_func_t) pa_mix_u8_avx2);
+        set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_avx2);
+        set_mix_func(PA_SAMPLE_S16RE, (pa_do_mix_func_t) pa_mix_s16re_avx2);
+        set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_avx2);
+        set_mix_func(PA_SAMPLE_S32RE, (pa_do_mix_func_t) pa_mix_s32re_avx2);
+        set_mix_func(PA_SAMPLE_S24_32NE, (pa_do_mix_func_t) pa_mix_s24_32ne_avx2);
+        set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_avx2);
+        set_mix_func(PA_SAMPLE_FLOAT32RE, (pa_do_mix_func_t) pa_mix_float32re_avx2);
+    }
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
@@ -0,0 +1,226 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-x86.h"
+#include "mix.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+#include <emmintrin.h>
+
+/* The functions below are compiled for SSE2 regardless of the flags the
+ * rest of the file is built with, and are only installed after checking
+ * the CPU flags at runtime. */
+#define SSE2 __attribute__ ((target ("sse2")))
+
+static pa_do_mix_func_t fallback[PA_SAMPLE_MAX];
+
+/* Returns how many of the n samples can be mixed in vectors of width
+ * samples, such that the remainder starts at the first channel again
+ * and can be handed to the fallback function. */
+static unsigned vector_samples(unsigned n, unsigned channels, unsigned width) {
+    unsigned step = width;
+
+    while (step % channels)
+        step += width;
+
+    return n - n % step;
+}
+
+static void mix_remainder(pa_sample_format_t f, pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length, unsigned done) {
+    unsigned i;
+
+    for (i = 0; i < nstreams; i++)
+        streams[i].ptr = (uint8_t*) streams[i].ptr + done;
+
+    fallback[f](streams, nstreams, channels, (uint8_t*) data + done, length - done);
+}
+
+/* Same as pa_mult_s16_volume() for four samples. The samples must be
+ * zero extended to 32 bits, the volumes are 16.16 fixed point values */
+static inline SSE2 __m128i mult_s16_volume_sse2(__m128i v, __m128i cv) {
+    __m128i sign, lo, hi;
+
+    /* (v * lo) >> 16, computed unsigned and corrected for negative v */
+    sign = _mm_and_si128(_mm_cmpgt_epi16(_mm_setzero_si128(), v), cv);
+    lo = _mm_sub_epi32(_mm_mulhi_epu16(v, cv), sign);
+
+    /* v * hi */
+    hi = _mm_madd_epi16(v, _mm_srli_epi32(cv, 16));
+
+    return _mm_add_epi32(lo, hi);
+}
+
+static inline SSE2 __m128i swap16_sse2(__m128i v) {
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline SSE2 __m128i swap32_sse2(__m128i v) {
+    v = swap16_sse2(v);
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+static inline SSE2 void mix_s16_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned n, pa_bool_t swap) {
+    const __m128i zero = _mm_setzero_si128();
+    unsigned channel = 0, i, k;
+
+    for (k = 0; k < n; k += 8) {
+        __m128i sum0 = zero, sum1 = zero, v;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            v = _mm_loadu_si128((const __m128i*) ((const int16_t*) m->ptr + k));
+            if (swap)
+                v = swap16_sse2(v);
+
+            sum0 = _mm_add_epi32(sum0, mult_s16_volume_sse2(_mm_unpacklo_epi16(v, zero),
+                                                            _mm_loadu_si128((const __m128i*) &m->linear[channel].i)));
+            sum1 = _mm_add_epi32(sum1, mult_s16_volume_sse2(_mm_unpackhi_epi16(v, zero),
+                                                            _mm_loadu_si128((const __m128i*) &m->linear[channel + 4].i)));
+        }
+
+        v = _mm_packs_epi32(sum0, sum1);
+        if (swap)
+            v = swap16_sse2(v);
+        _mm_storeu_si128((__m128i*) (data + k), v);
+
+        for (channel += 8; channel >= channels; channel -= channels)
+            ;
+    }
+}
+
+static SSE2 void pa_mix_s16ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(int16_t), channels, 8);
+
+    mix_s16_sse2(streams, nstreams, channels, data, n, FALSE);
+    mix_remainder(PA_SAMPLE_S16NE, streams, nstreams, channels, data, length, n * sizeof(int16_t));
+}
+
+static SSE2 void pa_mix_s16re_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(int16_t), channels, 8);
+
+    mix_s16_sse2(streams, nstreams, channels, data, n, TRUE);
+    mix_remainder(PA_SAMPLE_S16RE, streams, nstreams, channels, data, length, n * sizeof(int16_t));
+}
+
+static SSE2 void pa_mix_u8_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, uint8_t *data, unsigned length) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i offset16 = _mm_set1_epi16(0x80);
+    const __m128i offset8 = _mm_set1_epi8((char) 0x80);
+    unsigned n = vector_samples(length, channels, 8);
+    unsigned channel = 0, i, k;
+
+    for (k = 0; k < n; k += 8) {
+        __m128i sum0 = zero, sum1 = zero, v;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            v = _mm_loadl_epi64((const __m128i*) ((const uint8_t*) m->ptr + k));
+            v = _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), offset16);
+
+            sum0 = _mm_add_epi32(sum0, mult_s16_volume_sse2(_mm_unpacklo_epi16(v, zero),
+                                                            _mm_loadu_si128((const __m128i*) &m->linear[channel].i)));
+            sum1 = _mm_add_epi32(sum1, mult_s16_volume_sse2(_mm_unpackhi_epi16(v, zero),
+                                                            _mm_loadu_si128((const __m128i*) &m->linear[channel + 4].i)));
+        }
+
+        v = _mm_packs_epi32(sum0, sum1);
+        v = _mm_xor_si128(_mm_packs_epi16(v, v), offset8);
+        _mm_storel_epi64((__m128i*) (data + k), v);
+
+        for (channel += 8; channel >= channels; channel -= channels)
+            ;
+    }
+
+    mix_remainder(PA_SAMPLE_U8, streams, nstreams, channels, data, length, n);
+}
+
+static inline SSE2 void mix_float32_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned n, pa_bool_t swap) {
+    unsigned channel = 0, i, k;
+
+    for (k = 0; k < n; k += 4) {
+        __m128 sum = _mm_setzero_ps(), v;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            if (swap)
+                v = _mm_castsi128_ps(swap32_sse2(_mm_loadu_si128((const __m128i*) ((const float*) m->ptr + k))));
+            else
+                v = _mm_loadu_ps((const float*) m->ptr + k);
+
+            sum = _mm_add_ps(sum, _mm_mul_ps(v, _mm_loadu_ps(&m->linear[channel].f)));
+        }
+
+        if (swap)
+            _mm_storeu_si128((__m128i*) (data + k), swap32_sse2(_mm_castps_si128(sum)));
+        else
+            _mm_storeu_ps(data + k, sum);
+
+        for (channel += 4; channel >= channels; channel -= channels)
+            ;
+    }
+}
+
+static SSE2 void pa_mix_float32ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(float), channels, 4);
+
+    mix_float32_sse2(streams, nstreams, channels, data, n, FALSE);
+    mix_remainder(PA_SAMPLE_FLOAT32NE, streams, nstreams, channels, data, length, n * sizeof(float));
+}
+
+static SSE2 void pa_mix_float32re_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    unsigned n = vector_samples(length / sizeof(float), channels, 4);
+
+    mix_float32_sse2(streams, nstreams, channels, data, n, TRUE);
+    mix_remainder(PA_SAMPLE_FLOAT32RE, streams, nstreams, channels, data, length, n * sizeof(float));
+}
+
+static void set_mix_func(pa_sample_format_t f, pa_do_mix_func_t func) {
+    /* Don't end up calling ourselves for the remainder if we get
+     * initialised twice */
+    if (pa_get_mix_func(f) != func)
+        fallback[f] = pa_get_mix_func(f);
+    pa_set_mix_func(f, func);
+}
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_mix_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+    if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized mixing functions.");
+
+        set_mix_func(PA_SAMPLE_U8, (pa_do_mix_func_t) pa_mix_u8_sse2);
+        set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_sse2);
+        set_mix_func(PA_SAMPLE_S16RE, (pa_do_mix_func_t) pa_mix_s16re_sse2);
+        set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_sse2);
+        set_mix_func(PA_SAMPLE_FLOAT32RE, (pa_do_mix_func_t) pa_mix_float32re_sse2);
+    }
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
@@ -176,9 +176,35 @@ enum {
     /* Supported since protocol v27 (3.0) */
     PA_COMMAND_SET_PORT_LATENCY_OFFSET,
 
+    /* Supported since protocol v30 (5.0) */
+    PA_COMMAND_ENABLE_PLAYBACK_RING,
+
+    /* Supported since protocol v32 (5.0) */
+    PA_COMMAND_GET_INFO_BATCH,
+
+    /* Supported since protocol v33 (5.0) */
+    PA_COMMAND_GET_SINK_IO_STATS,
+    PA_COMMAND_GET_SOURCE_IO_STATS,
+
     PA_COMMAND_MAX
 };
 
+/* Frame types in the shared memory ring of a playback stream. Data
+ * frames carry their seek mode as type, barrier frames a counter of
+ * the commands sent since the ring was enabled. */
+#define PA_PLAYBACK_RING_BARRIER 0x100U
+
+/* The object classes PA_COMMAND_GET_INFO_BATCH can return */
+#define PA_INFO_BATCH_MASK                      \
+    (PA_SUBSCRIPTION_MASK_SINK |                \
+     PA_SUBSCRIPTION_MASK_SOURCE |              \
+     PA_SUBSCRIPTION_MASK_SINK_INPUT |          \
+     PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT |       \
+     PA_SUBSCRIPTION_MASK_MODULE |              \
+     PA_SUBSCRIPTION_MASK_CLIENT |              \
+     PA_SUBSCRIPTION_MASK_SAMPLE_CACHE |        \
+     PA_SUBSCRIPTION_MASK_CARD)
+
 #define PA_NATIVE_COOKIE_LENGTH 256
 #define PA_NATIVE_COOKIE_FILE ".config/pulse/cookie"
 #define PA_NATIVE_COOKIE_FILE_FALLBACK ".pulse-cookie"
@@ -59,6 +59,19 @@ pa_packet* pa_packet_new_dynamic(void* data, size_t length) {
     return p;
 }
 
+pa_packet* pa_packet_resize(pa_packet *p, size_t length) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) == 1);
+    pa_assert(p->type == PA_PACKET_APPENDED);
+    pa_assert(length > 0);
+
+    p = pa_xrealloc(p, PA_ALIGN(sizeof(pa_packet)) + length);
+    p->length = length;
+    p->data = (uint8_t*) p + PA_ALIGN(sizeof(pa_packet));
+
+    return p;
+}
+
 pa_packet* pa_packet_ref(pa_packet *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) >= 1);
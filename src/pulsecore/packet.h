@@ -37,6 +37,10 @@ typedef struct pa_packet {
 pa_packet* pa_packet_new(size_t length);
 pa_packet* pa_packet_new_dynamic(void* data, size_t length);
 
+/* Changes the size of a packet created with pa_packet_new() that is
+ * not referenced anywhere else. The data may move. */
+pa_packet* pa_packet_resize(pa_packet *p, size_t length);
+
 pa_packet* pa_packet_ref(pa_packet *p);
 void pa_packet_unref(pa_packet *p);
 
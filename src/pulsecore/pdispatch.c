@@ -190,6 +190,16 @@ static const char *command_names[PA_COMMAND_MAX] = {
     [PA_COMMAND_SET_SOURCE_OUTPUT_VOLUME] = "SET_SOURCE_OUTPUT_VOLUME",
     [PA_COMMAND_SET_SOURCE_OUTPUT_MUTE] = "SET_SOURCE_OUTPUT_MUTE",
 
+    /* Supported since protocol v30 (5.0) */
+    [PA_COMMAND_ENABLE_PLAYBACK_RING] = "ENABLE_PLAYBACK_RING",
+
+    /* Supported since protocol v32 (5.0) */
+    [PA_COMMAND_GET_INFO_BATCH] = "GET_INFO_BATCH",
+
+    /* Supported since protocol v33 (5.0) */
+    [PA_COMMAND_GET_SINK_IO_STATS] = "GET_SINK_IO_STATS",
+    [PA_COMMAND_GET_SOURCE_IO_STATS] = "GET_SOURCE_IO_STATS",
+
 };
 
 #endif
@@ -57,6 +57,9 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/ipacl.h>
 #include <pulsecore/thread-mq.h>
+#include <pulsecore/shmring.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/poll.h>
 
 #include "protocol-native.h"
 
@@ -68,6 +71,10 @@
 /* Don't accept more connection than this */
 #define MAX_CONNECTIONS 64
 
+/* Tell about clients that have this many packets pending when a
+ * subscription event is queued for them */
+#define SUBSCRIPTION_BACKLOG_WARN 256
+
 #define MAX_MEMBLOCKQ_LENGTH (4*1024*1024) /* 4MB */
 #define DEFAULT_TLENGTH_MSEC 2000 /* 2s */
 #define DEFAULT_PROCESS_MSEC 20   /* 20ms */
@@ -133,6 +140,19 @@ typedef struct playback_stream {
     pa_atomic_t seek_or_post_in_queue;
     int64_t seek_windex;
 
+    /* Ring buffer the client writes its data to, bypassing the main
+     * loop. ring_barrier counts the commands the client announced
+     * with a barrier frame in the ring. */
+    pa_shmring *ring;
+    uint32_t ring_barrier;
+
+    /* Only accessed from the IO thread. Frames after a barrier are only
+     * read once the command it belongs to has been processed. */
+    pa_shmring *thread_ring;
+    pa_rtpoll_item *ring_rtpoll_item;
+    uint32_t ring_barrier_passed;
+    pa_bool_t ring_broken:1;
+
     pa_atomic_t missing;
     pa_usec_t configured_sink_latency;
     /* Requested buffer attributes */
@@ -173,6 +193,7 @@ struct pa_native_connection {
     pa_native_options *options;
     pa_bool_t authorized:1;
     pa_bool_t is_local:1;
+    pa_bool_t is_unix:1;
     uint32_t version;
     pa_client *client;
     pa_pstream *pstream;
@@ -180,6 +201,8 @@ struct pa_native_connection {
     pa_idxset *record_streams, *output_streams;
     uint32_t rrobin_index;
     pa_subscription *subscription;
+    pa_bool_t subscription_payload;
+    pa_bool_t omit_proplists;
     pa_time_event *auth_timeout_event;
 };
 
@@ -196,6 +219,9 @@ struct pa_native_protocol {
     pa_hook hooks[PA_NATIVE_HOOK_MAX];
 
     pa_hashmap *extensions;
+
+    /* Stands in for the property lists left out of batch replies */
+    pa_proplist *empty_proplist;
 };
 
 enum {
@@ -210,7 +236,8 @@ enum {
     SINK_INPUT_MESSAGE_SEEK,
     SINK_INPUT_MESSAGE_PREBUF_FORCE,
     SINK_INPUT_MESSAGE_UPDATE_LATENCY,
-    SINK_INPUT_MESSAGE_UPDATE_BUFFER_ATTR
+    SINK_INPUT_MESSAGE_UPDATE_BUFFER_ATTR,
+    SINK_INPUT_MESSAGE_SET_RING
 };
 
 enum {
@@ -219,7 +246,8 @@ enum {
     PLAYBACK_STREAM_MESSAGE_OVERFLOW,
     PLAYBACK_STREAM_MESSAGE_DRAIN_ACK,
     PLAYBACK_STREAM_MESSAGE_STARTED,
-    PLAYBACK_STREAM_MESSAGE_UPDATE_TLENGTH
+    PLAYBACK_STREAM_MESSAGE_UPDATE_TLENGTH,
+    PLAYBACK_STREAM_MESSAGE_RING_BROKEN
 };
 
 enum {
@@ -235,6 +263,8 @@ static bool sink_input_process_underrun_cb(pa_sink_input *i);
 static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk);
 static void sink_input_kill_cb(pa_sink_input *i);
 static void sink_input_suspend_cb(pa_sink_input *i, pa_bool_t suspend);
+static void sink_input_attach_cb(pa_sink_input *i);
+static void sink_input_detach_cb(pa_sink_input *i);
 static void sink_input_moving_cb(pa_sink_input *i, pa_sink *dest);
 static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes);
 static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes);
@@ -242,6 +272,7 @@ static void sink_input_update_max_request_cb(pa_sink_input *i, size_t nbytes);
 static void sink_input_send_event_cb(pa_sink_input *i, const char *event, pa_proplist *pl);
 
 static void native_connection_send_memblock(pa_native_connection *c);
+static void protocol_error(pa_native_connection *c);
 static void playback_stream_request_bytes(struct playback_stream*s);
 
 static void source_output_kill_cb(pa_source_output *o);
@@ -294,6 +325,9 @@ static void command_extension(pa_pdispatch *pd, uint32_t command, uint32_t tag,
 static void command_set_card_profile(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_sink_or_source_port(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_port_latency_offset(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_enable_playback_ring(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_get_info_batch(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_get_io_stats(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 
 static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_ERROR] = NULL,
@@ -397,6 +431,13 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
 
     [PA_COMMAND_SET_PORT_LATENCY_OFFSET] = command_set_port_latency_offset,
 
+    [PA_COMMAND_ENABLE_PLAYBACK_RING] = command_enable_playback_ring,
+
+    [PA_COMMAND_GET_INFO_BATCH] = command_get_info_batch,
+
+    [PA_COMMAND_GET_SINK_IO_STATS] = command_get_io_stats,
+    [PA_COMMAND_GET_SOURCE_IO_STATS] = command_get_io_stats,
+
     [PA_COMMAND_EXTENSION] = command_extension
 };
 
@@ -785,6 +826,9 @@ static void playback_stream_free(pa_object* o) {
 
     playback_stream_unlink(s);
 
+    if (s->ring)
+        pa_shmring_free(s->ring);
+
     pa_memblockq_free(s->memblockq);
     pa_xfree(s);
 }
@@ -893,6 +937,11 @@ static int playback_stream_process_msg(pa_msgobject *o, int code, void*userdata,
             }
 
             break;
+
+        case PLAYBACK_STREAM_MESSAGE_RING_BROKEN:
+            pa_log_warn("Ring buffer of playback stream %u is corrupt.", s->index);
+            protocol_error(s->connection);
+            break;
     }
 
     return 0;
@@ -1177,6 +1226,10 @@ static playback_stream* playback_stream_new(
     s->early_requests = early_requests;
     pa_atomic_store(&s->seek_or_post_in_queue, 0);
     s->seek_windex = -1;
+    s->ring = s->thread_ring = NULL;
+    s->ring_rtpoll_item = NULL;
+    s->ring_barrier = s->ring_barrier_passed = 0;
+    s->ring_broken = FALSE;
 
     s->sink_input->parent.process_msg = sink_input_process_msg;
     s->sink_input->pop = sink_input_pop_cb;
@@ -1188,6 +1241,8 @@ static playback_stream* playback_stream_new(
     s->sink_input->moving = sink_input_moving_cb;
     s->sink_input->suspend = sink_input_suspend_cb;
     s->sink_input->send_event = sink_input_send_event_cb;
+    s->sink_input->attach = sink_input_attach_cb;
+    s->sink_input->detach = sink_input_detach_cb;
     s->sink_input->userdata = s;
 
     start_index = ssync ? pa_memblockq_get_read_index(ssync->memblockq) : 0;
@@ -1438,6 +1493,140 @@ static void flush_write_no_account(pa_memblockq *q) {
     pa_memblockq_flush_write(q, FALSE);
 }
 
+/* Called from thread context */
+static void push_ring_data(playback_stream *s, const void *data, size_t length) {
+    pa_mempool *pool = s->sink_input->core->mempool;
+
+    while (length > 0) {
+        pa_memchunk chunk;
+        void *d;
+
+        /* The client may still scribble over the data, so copy it out
+         * of the ring right away */
+        chunk.index = 0;
+        chunk.length = PA_MIN(length, pa_mempool_block_size_max(pool));
+        chunk.memblock = pa_memblock_new(pool, chunk.length);
+
+        d = pa_memblock_acquire(chunk.memblock);
+        memcpy(d, data, chunk.length);
+        pa_memblock_release(chunk.memblock);
+
+        if (pa_memblockq_push_align(s->memblockq, &chunk) < 0) {
+            if (pa_log_ratelimit(PA_LOG_WARN))
+                pa_log_warn("Failed to push data into queue");
+            pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_OVERFLOW, NULL, 0, NULL, NULL);
+            pa_memblockq_seek(s->memblockq, (int64_t) chunk.length, PA_SEEK_RELATIVE, TRUE);
+        }
+
+        pa_memblock_unref(chunk.memblock);
+
+        data = (const uint8_t*) data + chunk.length;
+        length -= chunk.length;
+    }
+}
+
+/* Called from thread context. When called from within pop() we leave
+ * the rewinding alone, the data is about to be played anyway. */
+static void playback_stream_read_ring(playback_stream *s, pa_bool_t seek) {
+    pa_shmring_frame f;
+    const void *data;
+    int64_t windex;
+    pa_bool_t seen = FALSE;
+    int r;
+
+    playback_stream_assert_ref(s);
+
+    if (!s->thread_ring || s->ring_broken)
+        return;
+
+    windex = pa_memblockq_get_write_index(s->memblockq);
+
+    while ((r = pa_shmring_peek(s->thread_ring, &f, &data)) > 0) {
+
+        if (f.type == PA_PLAYBACK_RING_BARRIER) {
+
+            /* Wait for the command behind this barrier */
+            if ((int32_t) ((uint32_t) f.offset - s->ring_barrier_passed) > 0)
+                break;
+
+            pa_shmring_drop(s->thread_ring);
+            continue;
+        }
+
+        if (f.type > PA_SEEK_RELATIVE_END) {
+            pa_log_warn("Invalid frame type in ring buffer.");
+            r = -1;
+            break;
+        }
+
+        if (f.type != PA_SEEK_RELATIVE || f.offset != 0) {
+            pa_memblockq_seek(s->memblockq, f.offset, (pa_seek_mode_t) f.type, f.type == PA_SEEK_RELATIVE);
+            windex = PA_MIN(windex, pa_memblockq_get_write_index(s->memblockq));
+        }
+
+        push_ring_data(s, data, f.length);
+        pa_shmring_drop(s->thread_ring);
+
+        seen = TRUE;
+    }
+
+    if (r < 0) {
+        /* We can't tell what the client meant to play anymore */
+        s->ring_broken = TRUE;
+        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_RING_BROKEN, NULL, 0, NULL, NULL);
+        return;
+    }
+
+    if (!seen || !seek)
+        return;
+
+    /* Messages from the main loop still pending will rewind for us */
+    if (pa_atomic_load(&s->seek_or_post_in_queue) > 0)
+        s->seek_windex = s->seek_windex == -1 ? windex : PA_MIN(s->seek_windex, windex);
+    else
+        handle_seek(s, windex);
+}
+
+/* Called from thread context */
+static int ring_work_cb(pa_rtpoll_item *i) {
+    playback_stream_read_ring(pa_rtpoll_item_get_userdata(i), TRUE);
+    return 0;
+}
+
+/* Called from thread context */
+static void ring_after_cb(pa_rtpoll_item *i) {
+    playback_stream *s = pa_rtpoll_item_get_userdata(i);
+    struct pollfd *pollfd;
+
+    pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
+
+    if ((pollfd->revents & ~POLLIN) ||
+        ((pollfd->revents & POLLIN) && pa_shmring_after_event(s->thread_ring) < 0)) {
+
+        /* Don't spin on a bogus fd, data is still read when the sink
+         * asks for it */
+        pa_log_warn("Ring buffer wakeup fd failed, no longer polling it.");
+        pollfd->fd = -1;
+    }
+}
+
+/* Called from thread context */
+static void playback_stream_add_ring_rtpoll_item(playback_stream *s) {
+    struct pollfd *pollfd;
+
+    pa_assert(!s->ring_rtpoll_item);
+
+    s->ring_rtpoll_item = pa_rtpoll_item_new(s->sink_input->sink->thread_info.rtpoll, PA_RTPOLL_NORMAL, 1);
+
+    pollfd = pa_rtpoll_item_get_pollfd(s->ring_rtpoll_item, NULL);
+    pollfd->fd = pa_shmring_get_eventfd(s->thread_ring);
+    pollfd->events = POLLIN;
+
+    pa_rtpoll_item_set_work_callback(s->ring_rtpoll_item, ring_work_cb);
+    pa_rtpoll_item_set_after_callback(s->ring_rtpoll_item, ring_after_cb);
+    pa_rtpoll_item_set_userdata(s->ring_rtpoll_item, s);
+}
+
 /* Called from thread context */
 static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
     pa_sink_input *i = PA_SINK_INPUT(o);
@@ -1451,7 +1640,13 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
 
         case SINK_INPUT_MESSAGE_SEEK:
         case SINK_INPUT_MESSAGE_POST_DATA: {
-            int64_t windex = pa_memblockq_get_write_index(s->memblockq);
+            int64_t windex;
+
+            /* Whatever the client put into the ring was written before
+             * it fell back to the socket */
+            playback_stream_read_ring(s, TRUE);
+
+            windex = pa_memblockq_get_write_index(s->memblockq);
 
             if (code == SINK_INPUT_MESSAGE_SEEK) {
                 /* The client side is incapable of accounting correctly
@@ -1508,6 +1703,11 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
                     pa_assert_not_reached();
             }
 
+            /* Take in the data the client wrote before sending this
+             * command, up to the barrier it put into the ring for it */
+            s->ring_barrier_passed = (uint32_t) offset;
+            playback_stream_read_ring(s, TRUE);
+
             windex = pa_memblockq_get_write_index(s->memblockq);
             func(s->memblockq);
             handle_seek(s, windex);
@@ -1515,6 +1715,7 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
             /* Do the same for all other members in the sync group */
             for (isync = i->sync_prev; isync; isync = isync->sync_prev) {
                 playback_stream *ssync = PLAYBACK_STREAM(isync->userdata);
+                playback_stream_read_ring(ssync, TRUE);
                 windex = pa_memblockq_get_write_index(ssync->memblockq);
                 func(ssync->memblockq);
                 handle_seek(ssync, windex);
@@ -1522,6 +1723,7 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
 
             for (isync = i->sync_next; isync; isync = isync->sync_next) {
                 playback_stream *ssync = PLAYBACK_STREAM(isync->userdata);
+                playback_stream_read_ring(ssync, TRUE);
                 windex = pa_memblockq_get_write_index(ssync->memblockq);
                 func(ssync->memblockq);
                 handle_seek(ssync, windex);
@@ -1540,6 +1742,8 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
         }
 
         case SINK_INPUT_MESSAGE_UPDATE_LATENCY:
+            playback_stream_read_ring(s, TRUE);
+
             /* Atomically get a snapshot of all timing parameters... */
             s->read_index = pa_memblockq_get_read_index(s->memblockq);
             s->write_index = pa_memblockq_get_write_index(s->memblockq);
@@ -1578,6 +1782,17 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
             pa_memblockq_get_attr(s->memblockq, &s->buffer_attr);
             return 0;
         }
+
+        case SINK_INPUT_MESSAGE_SET_RING: {
+            pa_assert(!s->thread_ring);
+
+            s->thread_ring = userdata;
+
+            if (i->thread_info.attached)
+                playback_stream_add_ring_rtpoll_item(s);
+
+            return 0;
+        }
     }
 
     return pa_sink_input_process_msg(o, code, userdata, offset, chunk);
@@ -1634,6 +1849,9 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     pa_log("%s, pop(): %lu", pa_proplist_gets(i->proplist, PA_PROP_MEDIA_NAME), (unsigned long) pa_memblockq_get_length(s->memblockq));
 #endif
 
+    /* Pick up what the client wrote since we last looked */
+    playback_stream_read_ring(s, FALSE);
+
     if (!handle_input_underrun(s, false))
         s->is_underrun = false;
 
@@ -1758,6 +1976,32 @@ static void sink_input_suspend_cb(pa_sink_input *i, pa_bool_t suspend) {
     pa_pstream_send_tagstruct(s->connection->pstream, t);
 }
 
+/* Called from thread context */
+static void sink_input_attach_cb(pa_sink_input *i) {
+    playback_stream *s;
+
+    pa_sink_input_assert_ref(i);
+    s = PLAYBACK_STREAM(i->userdata);
+    playback_stream_assert_ref(s);
+
+    if (s->thread_ring)
+        playback_stream_add_ring_rtpoll_item(s);
+}
+
+/* Called from thread context */
+static void sink_input_detach_cb(pa_sink_input *i) {
+    playback_stream *s;
+
+    pa_sink_input_assert_ref(i);
+    s = PLAYBACK_STREAM(i->userdata);
+    playback_stream_assert_ref(s);
+
+    if (s->ring_rtpoll_item) {
+        pa_rtpoll_item_free(s->ring_rtpoll_item);
+        s->ring_rtpoll_item = NULL;
+    }
+}
+
 /* Called from main context */
 static void sink_input_moving_cb(pa_sink_input *i, pa_sink *dest) {
     playback_stream *s;
@@ -2570,7 +2814,7 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     const void*cookie;
     pa_tagstruct *reply;
-    pa_bool_t shm_on_remote = FALSE, do_shm;
+    pa_bool_t shm_on_remote = FALSE, memfd_on_remote = FALSE, do_shm, do_memfd;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
@@ -2593,7 +2837,12 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
        not. */
     if (c->version >= 13) {
         shm_on_remote = !!(c->version & 0x80000000U);
-        c->version &= 0x7FFFFFFFU;
+
+        /* Starting with protocol version 29 the second MSB tells
+         * whether the other side can receive memfd segments */
+        memfd_on_remote = !!(c->version & 0x40000000U);
+
+        c->version &= 0x3FFFFFFFU;
     }
 
     pa_log_debug("Protocol version: remote %u, local %u", c->version, PA_PROTOCOL_VERSION);
@@ -2680,8 +2929,14 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     pa_log_debug("Negotiated SHM: %s", pa_yes_no(do_shm));
     pa_pstream_enable_shm(c->pstream, do_shm);
 
+    /* Segment fds can only be passed over unix sockets */
+    do_memfd = do_shm && c->is_unix && c->version >= 29 && memfd_on_remote;
+
+    pa_log_debug("Negotiated memfd: %s", pa_yes_no(do_memfd));
+    pa_pstream_enable_memfd(c->pstream, do_memfd);
+
     reply = reply_new(tag);
-    pa_tagstruct_putu32(reply, PA_PROTOCOL_VERSION | (do_shm ? 0x80000000 : 0));
+    pa_tagstruct_putu32(reply, PA_PROTOCOL_VERSION | (do_shm ? 0x80000000 : 0) | (do_memfd ? 0x40000000 : 0));
 
 #ifdef HAVE_CREDS
 {
@@ -2775,6 +3030,18 @@ static void command_lookup(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_
     }
 }
 
+/* Called from main context. The client puts a barrier frame into the
+ * ring before each command that must be ordered with its data, so we
+ * count them the same way. */
+static uint32_t playback_stream_next_ring_barrier(playback_stream *s) {
+    playback_stream_assert_ref(s);
+
+    if (!s->ring)
+        return 0;
+
+    return ++s->ring_barrier;
+}
+
 static void command_drain_playback_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     uint32_t idx;
@@ -2794,7 +3061,7 @@ static void command_drain_playback_stream(pa_pdispatch *pd, uint32_t command, ui
     CHECK_VALIDITY(c->pstream, s, tag, PA_ERR_NOENTITY);
     CHECK_VALIDITY(c->pstream, playback_stream_isinstance(s), tag, PA_ERR_NOENTITY);
 
-    pa_asyncmsgq_post(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_DRAIN, PA_UINT_TO_PTR(tag), 0, NULL, NULL);
+    pa_asyncmsgq_post(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_DRAIN, PA_UINT_TO_PTR(tag), playback_stream_next_ring_barrier(s), NULL, NULL);
 }
 
 static void command_stat(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -3111,6 +3378,10 @@ static void fixup_sample_spec(pa_native_connection *c, pa_sample_spec *fixed, co
     }
 }
 
+static void put_object_proplist(pa_native_connection *c, pa_tagstruct *t, pa_proplist *p) {
+    pa_tagstruct_put_proplist(t, c->omit_proplists ? c->protocol->empty_proplist : p);
+}
+
 static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink *sink) {
     pa_sample_spec fixed_ss;
 
@@ -3137,7 +3408,7 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
         PA_TAG_INVALID);
 
     if (c->version >= 13) {
-        pa_tagstruct_put_proplist(t, sink->proplist);
+        put_object_proplist(c, t, sink->proplist);
         pa_tagstruct_put_usec(t, pa_sink_get_requested_latency(sink));
     }
 
@@ -3207,7 +3478,7 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
         PA_TAG_INVALID);
 
     if (c->version >= 13) {
-        pa_tagstruct_put_proplist(t, source->proplist);
+        put_object_proplist(c, t, source->proplist);
         pa_tagstruct_put_usec(t, pa_source_get_requested_latency(source));
     }
 
@@ -3261,7 +3532,7 @@ static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_c
     pa_tagstruct_puts(t, client->driver);
 
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, client->proplist);
+        put_object_proplist(c, t, client->proplist);
 }
 
 static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_card *card) {
@@ -3288,7 +3559,7 @@ static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_car
     }
 
     pa_tagstruct_puts(t, card->active_profile->name);
-    pa_tagstruct_put_proplist(t, card->proplist);
+    put_object_proplist(c, t, card->proplist);
 
     if (c->version < 26)
         return;
@@ -3303,7 +3574,7 @@ static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_car
         pa_tagstruct_putu32(t, port->priority);
         pa_tagstruct_putu32(t, port->available);
         pa_tagstruct_putu8(t, /* FIXME: port->direction */ (port->is_input ? PA_DIRECTION_INPUT : 0) | (port->is_output ? PA_DIRECTION_OUTPUT : 0));
-        pa_tagstruct_put_proplist(t, port->proplist);
+        put_object_proplist(c, t, port->proplist);
 
         pa_tagstruct_putu32(t, pa_hashmap_size(port->profiles));
 
@@ -3328,7 +3599,7 @@ static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_m
         pa_tagstruct_put_boolean(t, FALSE); /* autoload is obsolete */
 
     if (c->version >= 15)
-        pa_tagstruct_put_proplist(t, module->proplist);
+        put_object_proplist(c, t, module->proplist);
 }
 
 static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink_input *s) {
@@ -3363,7 +3634,7 @@ static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t,
     if (c->version >= 11)
         pa_tagstruct_put_boolean(t, pa_sink_input_get_mute(s));
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, s->proplist);
+        put_object_proplist(c, t, s->proplist);
     if (c->version >= 19)
         pa_tagstruct_put_boolean(t, (pa_sink_input_get_state(s) == PA_SINK_INPUT_CORKED));
     if (c->version >= 20) {
@@ -3403,7 +3674,7 @@ static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *
     pa_tagstruct_puts(t, pa_resample_method_to_string(pa_source_output_get_resample_method(s)));
     pa_tagstruct_puts(t, s->driver);
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, s->proplist);
+        put_object_proplist(c, t, s->proplist);
     if (c->version >= 19)
         pa_tagstruct_put_boolean(t, (pa_source_output_get_state(s) == PA_SOURCE_OUTPUT_CORKED));
     if (c->version >= 22) {
@@ -3444,7 +3715,7 @@ static void scache_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
     pa_tagstruct_puts(t, e->filename);
 
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, e->proplist);
+        put_object_proplist(c, t, e->proplist);
 }
 
 static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -3544,24 +3815,10 @@ static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, p
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
-static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
-    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+static void fill_info_list(pa_native_connection *c, pa_tagstruct *reply, uint32_t command) {
     pa_idxset *i;
     uint32_t idx;
     void *p;
-    pa_tagstruct *reply;
-
-    pa_native_connection_assert_ref(c);
-    pa_assert(t);
-
-    if (!pa_tagstruct_eof(t)) {
-        protocol_error(c);
-        return;
-    }
-
-    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
-
-    reply = reply_new(tag);
 
     if (command == PA_COMMAND_GET_SINK_INFO_LIST)
         i = c->protocol->core->sinks;
@@ -3604,6 +3861,165 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
             }
         }
     }
+}
+
+static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    pa_tagstruct *reply;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (!pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+
+    reply = reply_new(tag);
+    fill_info_list(c, reply, command);
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
+
+static void command_get_info_batch(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    static const uint32_t list_commands[] = {
+        [PA_SUBSCRIPTION_EVENT_SINK] = PA_COMMAND_GET_SINK_INFO_LIST,
+        [PA_SUBSCRIPTION_EVENT_SOURCE] = PA_COMMAND_GET_SOURCE_INFO_LIST,
+        [PA_SUBSCRIPTION_EVENT_SINK_INPUT] = PA_COMMAND_GET_SINK_INPUT_INFO_LIST,
+        [PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT] = PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST,
+        [PA_SUBSCRIPTION_EVENT_MODULE] = PA_COMMAND_GET_MODULE_INFO_LIST,
+        [PA_SUBSCRIPTION_EVENT_CLIENT] = PA_COMMAND_GET_CLIENT_INFO_LIST,
+        [PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE] = PA_COMMAND_GET_SAMPLE_INFO_LIST,
+        [PA_SUBSCRIPTION_EVENT_CARD] = PA_COMMAND_GET_CARD_INFO_LIST
+    };
+
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    pa_subscription_mask_t m;
+    uint32_t flags, facility;
+    pa_tagstruct *reply;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &m) < 0 ||
+        pa_tagstruct_getu32(t, &flags) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+    CHECK_VALIDITY(c->pstream, m != 0, tag, PA_ERR_INVALID);
+    CHECK_VALIDITY(c->pstream, (m & ~PA_INFO_BATCH_MASK) == 0, tag, PA_ERR_INVALID);
+    CHECK_VALIDITY(c->pstream, (flags & ~PA_INFO_BATCH_NO_PROPLISTS) == 0, tag, PA_ERR_INVALID);
+
+    reply = reply_new(tag);
+    c->omit_proplists = !!(flags & PA_INFO_BATCH_NO_PROPLISTS);
+
+    /* Everything is collected in one go, so the lists are consistent
+     * with each other. Each list is put in a blob of its own, laid out
+     * like the reply to the matching list command. */
+    for (facility = 0; facility < PA_ELEMENTSOF(list_commands); facility++) {
+        pa_tagstruct *list;
+        const uint8_t *data;
+        size_t length;
+
+        if (!pa_subscription_match_flags(m, facility))
+            continue;
+
+        list = pa_tagstruct_new(NULL, 0);
+        fill_info_list(c, list, list_commands[facility]);
+        data = pa_tagstruct_data(list, &length);
+
+        pa_tagstruct_putu32(reply, facility);
+        pa_tagstruct_putu32(reply, (uint32_t) length);
+        pa_tagstruct_put_arbitrary(reply, data, length);
+
+        pa_tagstruct_free(list);
+    }
+
+    c->omit_proplists = FALSE;
+
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
+
+static void put_histogram(pa_tagstruct *t, const char *name, const pa_histogram *h) {
+    uint32_t counts[PA_HISTOGRAM_BUCKETS];
+    pa_usec_t max;
+    unsigned i;
+
+    pa_histogram_get(h, counts, &max);
+
+    pa_tagstruct_puts(t, name);
+    pa_tagstruct_put_usec(t, max);
+    pa_tagstruct_putu32(t, PA_HISTOGRAM_BUCKETS);
+
+    for (i = 0; i < PA_HISTOGRAM_BUCKETS; i++)
+        pa_tagstruct_putu32(t, counts[i]);
+}
+
+static void command_get_io_stats(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    uint32_t idx;
+    const char *name = NULL;
+    pa_sink *sink = NULL;
+    pa_source *source = NULL;
+    pa_tagstruct *reply;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &idx) < 0 ||
+        pa_tagstruct_gets(t, &name) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+    CHECK_VALIDITY(c->pstream, !name ||
+                   pa_namereg_is_valid_name_or_wildcard(name, command == PA_COMMAND_GET_SINK_IO_STATS ? PA_NAMEREG_SINK : PA_NAMEREG_SOURCE),
+                   tag, PA_ERR_INVALID);
+    CHECK_VALIDITY(c->pstream, idx == PA_INVALID_INDEX || !name, tag, PA_ERR_INVALID);
+
+    if (command == PA_COMMAND_GET_SINK_IO_STATS) {
+        if (idx != PA_INVALID_INDEX)
+            sink = pa_idxset_get_by_index(c->protocol->core->sinks, idx);
+        else
+            sink = pa_namereg_get(c->protocol->core, name, PA_NAMEREG_SINK);
+
+        CHECK_VALIDITY(c->pstream, sink, tag, PA_ERR_NOENTITY);
+    } else {
+        pa_assert(command == PA_COMMAND_GET_SOURCE_IO_STATS);
+
+        if (idx != PA_INVALID_INDEX)
+            source = pa_idxset_get_by_index(c->protocol->core->sources, idx);
+        else
+            source = pa_namereg_get(c->protocol->core, name, PA_NAMEREG_SOURCE);
+
+        CHECK_VALIDITY(c->pstream, source, tag, PA_ERR_NOENTITY);
+    }
+
+    /* A list of named histograms, so that new ones can be added
+     * without changing the protocol */
+    reply = reply_new(tag);
+
+    if (sink) {
+        pa_tagstruct_putu32(reply, sink->index);
+        pa_tagstruct_putu32(reply, 6);
+        put_histogram(reply, "wakeup-lateness", &sink->io_stats.wakeup_lateness);
+        put_histogram(reply, "render-time", &sink->io_stats.render_time);
+        put_histogram(reply, "peek-time", &sink->io_stats.peek_time);
+        put_histogram(reply, "convert-time", &sink->io_stats.convert_time);
+        put_histogram(reply, "mix-time", &sink->io_stats.mix_time);
+        put_histogram(reply, "join-time", &sink->io_stats.join_time);
+    } else {
+        pa_tagstruct_putu32(reply, source->index);
+        pa_tagstruct_putu32(reply, 2);
+        put_histogram(reply, "wakeup-lateness", &source->io_stats.wakeup_lateness);
+        put_histogram(reply, "post-time", &source->io_stats.post_time);
+    }
 
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
@@ -3654,7 +4070,92 @@ static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
-static void subscription_cb(pa_core *core, pa_subscription_event_type_t e, uint32_t idx, void *userdata) {
+/* Appends the current values of the fields a change event is about,
+ * so that the client doesn't need to query the whole object again */
+static void put_subscription_payload(pa_core *core, pa_tagstruct *t, pa_subscription_event_type_t e, uint32_t idx, pa_subscription_field_t fields) {
+    const pa_cvolume *volume = NULL;
+    pa_cvolume v;
+    pa_bool_t found = FALSE, mute = FALSE;
+    uint32_t state = 0;
+
+    switch (e & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) {
+
+        case PA_SUBSCRIPTION_EVENT_SINK: {
+            pa_sink *sink;
+
+            if (!(sink = pa_idxset_get_by_index(core->sinks, idx)))
+                break;
+
+            found = TRUE;
+            volume = pa_sink_get_volume(sink, FALSE);
+            mute = pa_sink_get_mute(sink, FALSE);
+            state = pa_sink_get_state(sink);
+            break;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE: {
+            pa_source *source;
+
+            if (!(source = pa_idxset_get_by_index(core->sources, idx)))
+                break;
+
+            found = TRUE;
+            volume = pa_source_get_volume(source, FALSE);
+            mute = pa_source_get_mute(source, FALSE);
+            state = pa_source_get_state(source);
+            break;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT: {
+            pa_sink_input *i;
+
+            if (!(i = pa_idxset_get_by_index(core->sink_inputs, idx)))
+                break;
+
+            found = TRUE;
+            if (pa_sink_input_is_volume_readable(i))
+                volume = pa_sink_input_get_volume(i, &v, TRUE);
+            mute = pa_sink_input_get_mute(i);
+            state = pa_sink_input_get_state(i) == PA_SINK_INPUT_CORKED;
+            break;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT: {
+            pa_source_output *o;
+
+            if (!(o = pa_idxset_get_by_index(core->source_outputs, idx)))
+                break;
+
+            found = TRUE;
+            if (pa_source_output_is_volume_readable(o))
+                volume = pa_source_output_get_volume(o, &v, TRUE);
+            mute = pa_source_output_get_mute(o);
+            state = pa_source_output_get_state(o) == PA_SOURCE_OUTPUT_CORKED;
+            break;
+        }
+    }
+
+    /* Other objects have no payload, and for vanished ones a remove
+     * event follows anyway */
+    if (!found)
+        fields = PA_SUBSCRIPTION_FIELD_OTHER;
+
+    /* Streams without a readable volume report a neutral one in their
+     * info, nothing to tell about it here */
+    if (!volume)
+        fields &= ~PA_SUBSCRIPTION_FIELD_VOLUME;
+
+    pa_tagstruct_putu32(t, fields);
+
+    if (fields & PA_SUBSCRIPTION_FIELD_VOLUME)
+        pa_tagstruct_put_cvolume(t, volume);
+    if (fields & PA_SUBSCRIPTION_FIELD_MUTE)
+        pa_tagstruct_put_boolean(t, mute);
+    if (fields & PA_SUBSCRIPTION_FIELD_STATE)
+        pa_tagstruct_putu32(t, state);
+}
+
+static void subscription_cb(pa_core *core, pa_subscription_event_type_t e, uint32_t idx, pa_subscription_field_t fields, void *userdata) {
     pa_tagstruct *t;
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
 
@@ -3665,17 +4166,36 @@ static void subscription_cb(pa_core *core, pa_subscription_event_type_t e, uint3
     pa_tagstruct_putu32(t, (uint32_t) -1);
     pa_tagstruct_putu32(t, e);
     pa_tagstruct_putu32(t, idx);
+
+    if (c->subscription_payload && (e & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE)
+        put_subscription_payload(core, t, e, idx, fields);
+
     pa_pstream_send_tagstruct(c->pstream, t);
+
+    c->client->n_subscription_events++;
+    c->client->subscription_backlog = pa_pstream_get_pending(c->pstream);
+
+    if (c->client->subscription_backlog > c->client->subscription_backlog_max) {
+
+        if (c->client->subscription_backlog_max < SUBSCRIPTION_BACKLOG_WARN &&
+            c->client->subscription_backlog >= SUBSCRIPTION_BACKLOG_WARN)
+            pa_log_info("Client %u doesn't keep up with its subscription events, %u packets pending.",
+                        c->client->index, c->client->subscription_backlog);
+
+        c->client->subscription_backlog_max = c->client->subscription_backlog;
+    }
 }
 
 static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     pa_subscription_mask_t m;
+    pa_bool_t payload = FALSE;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
 
     if (pa_tagstruct_getu32(t, &m) < 0 ||
+        (c->version >= 31 && pa_tagstruct_get_boolean(t, &payload) < 0) ||
         !pa_tagstruct_eof(t)) {
         protocol_error(c);
         return;
@@ -3687,8 +4207,10 @@ static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag,
     if (c->subscription)
         pa_subscription_free(c->subscription);
 
+    c->subscription_payload = payload;
+
     if (m != 0) {
-        c->subscription = pa_subscription_new(c->protocol->core, m, subscription_cb, c);
+        c->subscription = pa_subscription_new_with_fields(c->protocol->core, m, subscription_cb, c);
         pa_assert(c->subscription);
     } else
         c->subscription = NULL;
@@ -3935,15 +4457,15 @@ static void command_trigger_or_flush_or_prebuf_playback_stream(pa_pdispatch *pd,
 
     switch (command) {
         case PA_COMMAND_FLUSH_PLAYBACK_STREAM:
-            pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_FLUSH, NULL, 0, NULL);
+            pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_FLUSH, NULL, playback_stream_next_ring_barrier(s), NULL);
             break;
 
         case PA_COMMAND_PREBUF_PLAYBACK_STREAM:
-            pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_PREBUF_FORCE, NULL, 0, NULL);
+            pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_PREBUF_FORCE, NULL, playback_stream_next_ring_barrier(s), NULL);
             break;
 
         case PA_COMMAND_TRIGGER_PLAYBACK_STREAM:
-            pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_TRIGGER, NULL, 0, NULL);
+            pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_TRIGGER, NULL, playback_stream_next_ring_barrier(s), NULL);
             break;
 
         default:
@@ -4805,6 +5327,53 @@ static void command_set_port_latency_offset(pa_pdispatch *pd, uint32_t command,
     pa_pstream_send_simple_ack(c->pstream, tag);
 }
 
+static void command_enable_playback_ring(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    uint32_t idx, size;
+    playback_stream *s;
+    int fds[2];
+    unsigned n;
+    pa_shmring *ring;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &idx) < 0 ||
+        pa_tagstruct_getu32(t, &size) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    /* Any fds we don't take are closed by the pstream */
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+    CHECK_VALIDITY(c->pstream, c->version >= 30 && pa_pstream_get_memfd(c->pstream), tag, PA_ERR_NOTSUPPORTED);
+    s = pa_idxset_get_by_index(c->output_streams, idx);
+    CHECK_VALIDITY(c->pstream, s, tag, PA_ERR_NOENTITY);
+    CHECK_VALIDITY(c->pstream, playback_stream_isinstance(s), tag, PA_ERR_NOENTITY);
+    CHECK_VALIDITY(c->pstream, !s->ring, tag, PA_ERR_EXIST);
+
+    if ((n = pa_pstream_steal_packet_fds(c->pstream, fds, 2)) != 2) {
+        if (n > 0)
+            pa_close(fds[0]);
+
+        pa_pstream_send_error(c->pstream, tag, PA_ERR_INVALID);
+        return;
+    }
+
+    if (!(ring = pa_shmring_attach(fds[0], fds[1], size))) {
+        pa_pstream_send_error(c->pstream, tag, PA_ERR_INVALID);
+        return;
+    }
+
+    s->ring = ring;
+    pa_assert_se(pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_SET_RING, ring, 0, NULL) == 0);
+
+    pa_log_debug("Playback stream %u now reads from a shared memory ring.", s->index);
+
+    pa_pstream_send_simple_ack(c->pstream, tag);
+}
+
 /*** pstream callbacks ***/
 
 static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
@@ -5028,6 +5597,11 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
         c->auth_timeout_event = NULL;
 
     c->is_local = pa_iochannel_socket_is_local(io);
+#ifdef HAVE_CREDS
+    c->is_unix = pa_iochannel_creds_supported(io);
+#else
+    c->is_unix = FALSE;
+#endif
     c->version = 8;
 
     c->client = client;
@@ -5050,6 +5624,8 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
 
     c->rrobin_index = PA_IDXSET_INVALID;
     c->subscription = NULL;
+    c->subscription_payload = FALSE;
+    c->omit_proplists = FALSE;
 
     pa_idxset_put(p->connections, c, NULL);
 
@@ -5087,6 +5663,7 @@ static pa_native_protocol* native_protocol_new(pa_core *c) {
     p->servers = NULL;
 
     p->extensions = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    p->empty_proplist = pa_proplist_new();
 
     for (h = 0; h < PA_NATIVE_HOOK_MAX; h++)
         pa_hook_init(&p->hooks[h], p);
@@ -5135,6 +5712,7 @@ void pa_native_protocol_unref(pa_native_protocol *p) {
         pa_hook_done(&p->hooks[h]);
 
     pa_hashmap_free(p->extensions, NULL);
+    pa_proplist_free(p->empty_proplist);
 
     pa_assert_se(pa_shared_remove(p->core, "native-protocol") >= 0);
 
@@ -27,19 +27,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
 
 #ifdef HAVE_NETINET_IN_H
 #include <netinet/in.h>
 #endif
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/socket.h>
+#include <pulsecore/core-error.h>
 #include <pulsecore/queue.h>
 #include <pulsecore/log.h>
 #include <pulsecore/creds.h>
 #include <pulsecore/refcnt.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/core-util.h>
 #include <pulsecore/macro.h>
 
 #include "pstream.h"
@@ -49,6 +58,9 @@
 #define PA_FLAG_SHMRELEASE 0x40000000LU
 #define PA_FLAG_SHMREVOKE  0xC0000000LU
 #define PA_FLAG_SHMMASK    0xFF000000LU
+/* Set in addition to PA_FLAG_SHMDATA on the first frame that refers
+ * to a memfd segment, the fd of the segment is passed with it */
+#define PA_FLAG_SHMMEMFD   0x20000000LU
 #define PA_FLAG_SEEKMASK   0x000000FFLU
 
 /* The sequence descriptor header consists of 5 32bit integers: */
@@ -76,6 +88,26 @@ typedef uint32_t pa_pstream_descriptor[PA_PSTREAM_DESCRIPTOR_MAX];
 
 #define MINIBUF_SIZE (256)
 
+/* The most frames and bytes we pass to the kernel with a single
+ * writev(). We only ever batch what is queued already, so this adds no
+ * latency. */
+#ifdef HAVE_SYS_UIO_H
+#define WRITE_BATCH_FRAMES (16)
+#else
+#define WRITE_BATCH_FRAMES (1)
+
+/* Just enough to describe a buffer where there is no writev() */
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+#endif
+#define WRITE_BATCH_SIZE (64*1024)
+
+/* Reads for less than this go through a buffer that may pick up the
+ * following frames as well, larger payloads are read directly */
+#define READ_BUFFER_SIZE (4096)
+
 /* To allow uploading a single sample in one frame, this value should be the
  * same size (16 MB) as PA_SCACHE_ENTRY_SIZE_MAX from pulsecore/core-scache.h.
  */
@@ -97,6 +129,9 @@ struct item_info {
     pa_bool_t with_creds;
     pa_creds creds;
 #endif
+    /* fds passed along with the packet, owned by the item */
+    int fds[PA_IOCHANNEL_FDS_MAX];
+    unsigned n_fds;
 
     /* memblock info */
     pa_memchunk chunk;
@@ -108,6 +143,33 @@ struct item_info {
     uint32_t block_id;
 };
 
+/* A frame taken from the send queue, on its way out */
+struct write_frame {
+    union {
+        uint8_t minibuf[MINIBUF_SIZE];
+        pa_pstream_descriptor descriptor;
+    };
+    struct item_info* current;
+    void *data;
+    size_t index;
+    int minibuf_validsize;
+    pa_memchunk memchunk;
+
+    /* Segment fd to pass with this frame, not owned */
+    int memfd;
+
+    /* fds to pass with the first write of this frame, not owned */
+    const int *fds;
+    unsigned n_fds;
+
+#ifdef HAVE_CREDS
+    pa_creds creds;
+    pa_bool_t send_creds_now;
+#endif
+};
+
+static pa_pstream_stat pstream_stat;
+
 struct pa_pstream {
     PA_REFCNT_DECLARE;
 
@@ -116,20 +178,14 @@ struct pa_pstream {
     pa_iochannel *io;
 
     pa_queue *send_queue;
+    unsigned n_send_queue;
 
     pa_bool_t dead;
 
-    struct {
-        union {
-            uint8_t minibuf[MINIBUF_SIZE];
-            pa_pstream_descriptor descriptor;
-        };
-        struct item_info* current;
-        void *data;
-        size_t index;
-        int minibuf_validsize;
-        pa_memchunk memchunk;
-    } write;
+    /* Frames are written out together where possible. The first one
+     * might be written partially already. */
+    struct write_frame write[WRITE_BATCH_FRAMES];
+    unsigned write_first, write_n;
 
     struct {
         pa_pstream_descriptor descriptor;
@@ -138,9 +194,35 @@ struct pa_pstream {
         uint32_t shm_info[PA_PSTREAM_SHM_MAX];
         void *data;
         size_t index;
+
+        /* Segment fd received with this frame */
+        int memfd;
+
+        /* fds received with this packet, until the receiver takes
+         * them with pa_pstream_steal_packet_fds() */
+        int fds[PA_IOCHANNEL_FDS_MAX];
+        unsigned n_fds;
+
+        /* What we read ahead from the socket */
+        uint8_t buffer[READ_BUFFER_SIZE];
+        size_t buffer_index, buffer_length;
+        pa_bool_t buffer_creds_valid;
+
+        /* Bytes of the stream passed on to frames so far */
+        uint64_t position;
+
+        /* fds that came with the buffer. They belong to the last frame
+         * starting before pending_fds_until, see take_frame_fds() */
+        int pending_fds[PA_IOCHANNEL_FDS_MAX];
+        unsigned n_pending_fds;
+        uint64_t pending_fds_until;
     } read;
 
     pa_bool_t use_shm;
+    pa_bool_t use_memfd;
+
+    /* IDs of the memfd segments whose fd we already passed */
+    pa_idxset *memfd_segments;
     pa_memimport *import;
     pa_memexport *export;
 
@@ -165,8 +247,8 @@ struct pa_pstream {
     pa_mempool *mempool;
 
 #ifdef HAVE_CREDS
-    pa_creds read_creds, write_creds;
-    pa_bool_t read_creds_valid, send_creds_now;
+    pa_creds read_creds;
+    pa_bool_t read_creds_valid;
 #endif
 };
 
@@ -245,13 +327,19 @@ pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *poo
     m->defer_enable(p->defer_event, 0);
 
     p->send_queue = pa_queue_new();
+    p->n_send_queue = 0;
 
-    p->write.current = NULL;
-    p->write.index = 0;
-    pa_memchunk_reset(&p->write.memchunk);
+    p->write_first = p->write_n = 0;
     p->read.memblock = NULL;
     p->read.packet = NULL;
     p->read.index = 0;
+    p->read.memfd = -1;
+    p->read.n_fds = 0;
+    p->read.buffer_index = p->read.buffer_length = 0;
+    p->read.buffer_creds_valid = FALSE;
+    p->read.position = 0;
+    p->read.n_pending_fds = 0;
+    p->read.pending_fds_until = 0;
 
     p->receive_packet_callback = NULL;
     p->receive_packet_callback_userdata = NULL;
@@ -269,6 +357,8 @@ pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *poo
     p->mempool = pool;
 
     p->use_shm = FALSE;
+    p->use_memfd = FALSE;
+    p->memfd_segments = pa_idxset_new(NULL, NULL);
     p->export = NULL;
 
     /* We do importing unconditionally */
@@ -278,12 +368,35 @@ pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *poo
     pa_iochannel_socket_set_sndbuf(io, pa_mempool_block_size_max(p->mempool));
 
 #ifdef HAVE_CREDS
-    p->send_creds_now = FALSE;
     p->read_creds_valid = FALSE;
 #endif
     return p;
 }
 
+static void close_read_fds(pa_pstream *p) {
+    unsigned i;
+
+    for (i = 0; i < p->read.n_fds; i++)
+        pa_close(p->read.fds[i]);
+
+    p->read.n_fds = 0;
+}
+
+static void close_pending_fds(pa_pstream *p) {
+    unsigned i;
+
+    for (i = 0; i < p->read.n_pending_fds; i++)
+        pa_close(p->read.pending_fds[i]);
+
+    p->read.n_pending_fds = 0;
+}
+
+static struct write_frame* get_write_frame(pa_pstream *p, unsigned i) {
+    pa_assert(i < p->write_n);
+
+    return &p->write[(p->write_first + i) % WRITE_BATCH_FRAMES];
+}
+
 static void item_free(void *item) {
     struct item_info *i = item;
     pa_assert(i);
@@ -292,8 +405,14 @@ static void item_free(void *item) {
         pa_assert(i->chunk.memblock);
         pa_memblock_unref(i->chunk.memblock);
     } else if (i->type == PA_PSTREAM_ITEM_PACKET) {
+        unsigned j;
+
         pa_assert(i->packet);
         pa_packet_unref(i->packet);
+
+        for (j = 0; j < i->n_fds; j++)
+            pa_close(i->fds[j]);
+        i->n_fds = 0;
     }
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(items), i) < 0)
@@ -301,17 +420,22 @@ static void item_free(void *item) {
 }
 
 static void pstream_free(pa_pstream *p) {
+    unsigned i;
+
     pa_assert(p);
 
     pa_pstream_unlink(p);
 
     pa_queue_free(p->send_queue, item_free);
 
-    if (p->write.current)
-        item_free(p->write.current);
+    for (i = 0; i < p->write_n; i++) {
+        struct write_frame *w = get_write_frame(p, i);
 
-    if (p->write.memchunk.memblock)
-        pa_memblock_unref(p->write.memchunk.memblock);
+        item_free(w->current);
+
+        if (w->memchunk.memblock)
+            pa_memblock_unref(w->memchunk.memblock);
+    }
 
     if (p->read.memblock)
         pa_memblock_unref(p->read.memblock);
@@ -319,33 +443,98 @@ static void pstream_free(pa_pstream *p) {
     if (p->read.packet)
         pa_packet_unref(p->read.packet);
 
+    if (p->read.memfd >= 0)
+        pa_close(p->read.memfd);
+
+    close_read_fds(p);
+    close_pending_fds(p);
+
+    pa_idxset_free(p->memfd_segments, NULL);
+
     pa_xfree(p);
 }
 
-void pa_pstream_send_packet(pa_pstream*p, pa_packet *packet, const pa_creds *creds) {
-    struct item_info *i;
-
-    pa_assert(p);
-    pa_assert(PA_REFCNT_VALUE(p) > 0);
-    pa_assert(packet);
+static void queue_item(pa_pstream *p, struct item_info *i) {
+    pa_queue_push(p->send_queue, i);
+    p->n_send_queue++;
+}
 
-    if (p->dead)
-        return;
+static struct item_info *packet_item_new(pa_packet *packet, const pa_creds *creds) {
+    struct item_info *i;
 
     if (!(i = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
         i = pa_xnew(struct item_info, 1);
 
     i->type = PA_PSTREAM_ITEM_PACKET;
     i->packet = pa_packet_ref(packet);
+    i->n_fds = 0;
 
 #ifdef HAVE_CREDS
     if ((i->with_creds = !!creds))
         i->creds = *creds;
 #endif
 
-    pa_queue_push(p->send_queue, i);
+    return i;
+}
+
+void pa_pstream_send_packet(pa_pstream*p, pa_packet *packet, const pa_creds *creds) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(packet);
+
+    if (p->dead)
+        return;
+
+    queue_item(p, packet_item_new(packet, creds));
+
+    p->mainloop->defer_enable(p->defer_event, 1);
+}
+
+int pa_pstream_send_packet_with_fds(pa_pstream*p, pa_packet *packet, const int *fds, unsigned n_fds) {
+    struct item_info *i;
+    unsigned j;
+
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(packet);
+    pa_assert(fds);
+    pa_assert(n_fds > 0 && n_fds <= PA_IOCHANNEL_FDS_MAX);
+    pa_assert(p->use_memfd);
+
+    if (p->dead)
+        return -1;
+
+    i = packet_item_new(packet, NULL);
+
+    for (j = 0; j < n_fds; j++) {
+        if ((i->fds[j] = fcntl(fds[j], F_DUPFD_CLOEXEC, 3)) < 0) {
+            pa_log("fcntl(F_DUPFD_CLOEXEC) failed: %s", pa_cstrerror(errno));
+            item_free(i);
+            return -1;
+        }
+
+        i->n_fds++;
+    }
+
+    queue_item(p, i);
 
     p->mainloop->defer_enable(p->defer_event, 1);
+    return 0;
+}
+
+unsigned pa_pstream_steal_packet_fds(pa_pstream *p, int *fds, unsigned n_max) {
+    unsigned n;
+
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(fds);
+
+    n = PA_MIN(p->read.n_fds, n_max);
+    memcpy(fds, p->read.fds, sizeof(int) * n);
+    memmove(p->read.fds, p->read.fds + n, sizeof(int) * (p->read.n_fds - n));
+    p->read.n_fds -= n;
+
+    return n;
 }
 
 void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa_seek_mode_t seek_mode, const pa_memchunk *chunk) {
@@ -381,11 +570,12 @@ void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa
         i->channel = channel;
         i->offset = offset;
         i->seek_mode = seek_mode;
+        i->n_fds = 0;
 #ifdef HAVE_CREDS
         i->with_creds = FALSE;
 #endif
 
-        pa_queue_push(p->send_queue, i);
+        queue_item(p, i);
 
         idx += n;
         length -= n;
@@ -408,11 +598,12 @@ void pa_pstream_send_release(pa_pstream *p, uint32_t block_id) {
         item = pa_xnew(struct item_info, 1);
     item->type = PA_PSTREAM_ITEM_SHMRELEASE;
     item->block_id = block_id;
+    item->n_fds = 0;
 #ifdef HAVE_CREDS
     item->with_creds = FALSE;
 #endif
 
-    pa_queue_push(p->send_queue, item);
+    queue_item(p, item);
     p->mainloop->defer_enable(p->defer_event, 1);
 }
 
@@ -445,11 +636,12 @@ void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id) {
         item = pa_xnew(struct item_info, 1);
     item->type = PA_PSTREAM_ITEM_SHMREVOKE;
     item->block_id = block_id;
+    item->n_fds = 0;
 #ifdef HAVE_CREDS
     item->with_creds = FALSE;
 #endif
 
-    pa_queue_push(p->send_queue, item);
+    queue_item(p, item);
     p->mainloop->defer_enable(p->defer_event, 1);
 }
 
@@ -466,185 +658,395 @@ static void memexport_revoke_cb(pa_memexport *e, uint32_t block_id, void *userda
         pa_pstream_send_revoke(p, block_id);
 }
 
-static void prepare_next_write_item(pa_pstream *p) {
+/* Takes the next item from the send queue and sets up its frame */
+static struct write_frame* prepare_next_write_frame(pa_pstream *p) {
+    struct item_info *item;
+    struct write_frame *w;
+
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(p->write_n < WRITE_BATCH_FRAMES);
 
-    p->write.current = pa_queue_pop(p->send_queue);
+    if (!(item = pa_queue_pop(p->send_queue)))
+        return NULL;
 
-    if (!p->write.current)
-        return;
-    p->write.index = 0;
-    p->write.data = NULL;
-    p->write.minibuf_validsize = 0;
-    pa_memchunk_reset(&p->write.memchunk);
-
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
-
-    if (p->write.current->type == PA_PSTREAM_ITEM_PACKET) {
-
-        pa_assert(p->write.current->packet);
-        p->write.data = p->write.current->packet->data;
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->packet->length);
-
-        if (p->write.current->packet->length <= MINIBUF_SIZE - PA_PSTREAM_DESCRIPTOR_SIZE) {
-            memcpy(&p->write.minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], p->write.data, p->write.current->packet->length);
-            p->write.minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + p->write.current->packet->length;
+    p->n_send_queue--;
+
+    w = &p->write[(p->write_first + p->write_n) % WRITE_BATCH_FRAMES];
+    p->write_n++;
+
+    w->current = item;
+    w->index = 0;
+    w->data = NULL;
+    w->minibuf_validsize = 0;
+    pa_memchunk_reset(&w->memchunk);
+
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
+    w->n_fds = 0;
+
+    if (w->current->type == PA_PSTREAM_ITEM_PACKET) {
+
+        pa_assert(w->current->packet);
+        w->data = w->current->packet->data;
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) w->current->packet->length);
+
+        if (w->current->packet->length <= MINIBUF_SIZE - PA_PSTREAM_DESCRIPTOR_SIZE) {
+            memcpy(&w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], w->data, w->current->packet->length);
+            w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + w->current->packet->length;
         }
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
+        w->fds = w->current->fds;
+        w->n_fds = w->current->n_fds;
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
+
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
     } else {
         uint32_t flags;
         pa_bool_t send_payload = TRUE;
 
-        pa_assert(p->write.current->type == PA_PSTREAM_ITEM_MEMBLOCK);
-        pa_assert(p->write.current->chunk.memblock);
+        pa_assert(w->current->type == PA_PSTREAM_ITEM_MEMBLOCK);
+        pa_assert(w->current->chunk.memblock);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(p->write.current->channel);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) p->write.current->offset) >> 32));
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) p->write.current->offset));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(w->current->channel);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) w->current->offset) >> 32));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) w->current->offset));
 
-        flags = (uint32_t) (p->write.current->seek_mode & PA_FLAG_SEEKMASK);
+        flags = (uint32_t) (w->current->seek_mode & PA_FLAG_SEEKMASK);
 
         if (p->use_shm) {
             uint32_t block_id, shm_id;
             size_t offset, length;
-            uint32_t *shm_info = (uint32_t *) &p->write.minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
+            int memfd;
+            uint32_t *shm_info = (uint32_t *) &w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
             size_t shm_size = sizeof(uint32_t) * PA_PSTREAM_SHM_MAX;
 
             pa_assert(p->export);
 
             if (pa_memexport_put(p->export,
-                                 p->write.current->chunk.memblock,
+                                 w->current->chunk.memblock,
                                  &block_id,
                                  &shm_id,
                                  &offset,
-                                 &length) >= 0) {
+                                 &length,
+                                 &memfd) >= 0) {
+
+                if (memfd >= 0 && !p->use_memfd) {
 
-                flags |= PA_FLAG_SHMDATA;
-                send_payload = FALSE;
+                    /* The other side has no way to map this segment,
+                     * so undo the export and send the data inline */
+                    pa_memexport_process_release(p->export, block_id);
 
-                shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
-                shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
-                shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + p->write.current->chunk.index));
-                shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
+                } else {
 
-                p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
-                p->write.minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
+                    flags |= PA_FLAG_SHMDATA;
+                    send_payload = FALSE;
+
+                    /* Pass the segment fd along the first time it is
+                     * referenced */
+                    if (memfd >= 0 && pa_idxset_put(p->memfd_segments, PA_UINT32_TO_PTR(shm_id), NULL) >= 0) {
+                        flags |= PA_FLAG_SHMMEMFD;
+                        w->memfd = memfd;
+                        w->fds = &w->memfd;
+                        w->n_fds = 1;
+                    }
+
+                    shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
+                    shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
+                    shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + w->current->chunk.index));
+                    shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) w->current->chunk.length);
+
+                    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
+                    w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
+                }
             }
 /*             else */
 /*                 pa_log_warn("Failed to export memory block."); */
         }
 
         if (send_payload) {
-            p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
-            p->write.memchunk = p->write.current->chunk;
-            pa_memblock_ref(p->write.memchunk.memblock);
-            p->write.data = NULL;
+            w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) w->current->chunk.length);
+            w->memchunk = w->current->chunk;
+            pa_memblock_ref(w->memchunk.memblock);
+            w->data = NULL;
         }
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
     }
 
 #ifdef HAVE_CREDS
-    if ((p->send_creds_now = p->write.current->with_creds))
-        p->write_creds = p->write.current->creds;
+    if ((w->send_creds_now = w->current->with_creds))
+        w->creds = w->current->creds;
 #endif
+
+    return w;
 }
 
-static int do_write(pa_pstream *p) {
+static pa_bool_t write_frame_has_ancillary_data(struct write_frame *w) {
+#ifdef HAVE_CREDS
+    return w->n_fds > 0 || w->send_creds_now;
+#else
+    return FALSE;
+#endif
+}
+
+/* Describes what is left of the frame in iov, returns the number of
+ * buffers used. The memblock returned in release_memblock has to be
+ * released after the write. */
+static unsigned write_frame_get_iov(struct write_frame *w, struct iovec *iov, pa_memblock **release_memblock) {
+    size_t length, skip;
+    unsigned n = 0;
     void *d;
-    size_t l;
+
+    *release_memblock = NULL;
+
+    if (w->minibuf_validsize > 0) {
+        iov[0].iov_base = w->minibuf + w->index;
+        iov[0].iov_len = w->minibuf_validsize - w->index;
+        return 1;
+    }
+
+    if (w->index < PA_PSTREAM_DESCRIPTOR_SIZE) {
+        iov[n].iov_base = (uint8_t*) w->descriptor + w->index;
+        iov[n].iov_len = PA_PSTREAM_DESCRIPTOR_SIZE - w->index;
+        n++;
+    }
+
+    if ((length = ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) <= 0)
+        return n;
+
+    pa_assert(w->data || w->memchunk.memblock);
+
+    if (w->data)
+        d = w->data;
+    else {
+        d = pa_memblock_acquire_chunk(&w->memchunk);
+        *release_memblock = w->memchunk.memblock;
+    }
+
+    skip = w->index > PA_PSTREAM_DESCRIPTOR_SIZE ? w->index - PA_PSTREAM_DESCRIPTOR_SIZE : 0;
+    iov[n].iov_base = (uint8_t*) d + skip;
+    iov[n].iov_len = length - skip;
+    n++;
+
+    return n;
+}
+
+static int do_write(pa_pstream *p) {
+    struct iovec iov[WRITE_BATCH_FRAMES * 2];
+    pa_memblock *release_memblocks[WRITE_BATCH_FRAMES];
+    unsigned n_iov = 0, n_frames = 0, i;
+    size_t size = 0;
+    struct write_frame *w;
+    pa_bool_t frame_done = FALSE;
     ssize_t r;
-    pa_memblock *release_memblock = NULL;
 
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-    if (!p->write.current)
-        prepare_next_write_item(p);
+    /* Collect the queued frames we can write in one go. Ancillary data
+     * goes with the first byte of a write, hence a frame carrying some
+     * has to start a write of its own. */
+    while (n_frames < WRITE_BATCH_FRAMES && size < WRITE_BATCH_SIZE) {
+        unsigned j, k;
 
-    if (!p->write.current)
-        return 0;
+        if (n_frames >= p->write_n && !prepare_next_write_frame(p))
+            break;
 
-    if (p->write.minibuf_validsize > 0) {
-        d = p->write.minibuf + p->write.index;
-        l = p->write.minibuf_validsize - p->write.index;
-    } else if (p->write.index < PA_PSTREAM_DESCRIPTOR_SIZE) {
-        d = (uint8_t*) p->write.descriptor + p->write.index;
-        l = PA_PSTREAM_DESCRIPTOR_SIZE - p->write.index;
-    } else {
-        pa_assert(p->write.data || p->write.memchunk.memblock);
+        w = get_write_frame(p, n_frames);
 
-        if (p->write.data)
-            d = p->write.data;
-        else {
-            d = pa_memblock_acquire_chunk(&p->write.memchunk);
-            release_memblock = p->write.memchunk.memblock;
-        }
+        if (n_frames > 0 && write_frame_has_ancillary_data(w))
+            break;
+
+        k = write_frame_get_iov(w, iov + n_iov, &release_memblocks[n_frames]);
 
-        d = (uint8_t*) d + p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE;
-        l = ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE);
+        for (j = 0; j < k; j++)
+            size += iov[n_iov + j].iov_len;
+
+        n_iov += k;
+        n_frames++;
+
+        if (write_frame_has_ancillary_data(w))
+            break;
     }
 
-    pa_assert(l > 0);
+    if (n_frames <= 0)
+        return 0;
+
+    pa_assert(n_iov > 0);
+    w = get_write_frame(p, 0);
 
 #ifdef HAVE_CREDS
-    if (p->send_creds_now) {
+    if (w->n_fds > 0) {
 
-        if ((r = pa_iochannel_write_with_creds(p->io, d, l, &p->write_creds)) < 0)
-            goto fail;
+        if ((r = pa_iochannel_write_with_fds(p->io, iov[0].iov_base, iov[0].iov_len, w->fds, w->n_fds)) >= 0)
+            w->n_fds = 0;
+
+    } else if (w->send_creds_now) {
+
+        if ((r = pa_iochannel_write_with_creds(p->io, iov[0].iov_base, iov[0].iov_len, &w->creds)) >= 0)
+            w->send_creds_now = FALSE;
 
-        p->send_creds_now = FALSE;
     } else
 #endif
+#ifdef HAVE_SYS_UIO_H
+    if (n_iov > 1)
+        r = pa_iochannel_writev(p->io, iov, n_iov);
+    else
+#endif
+        r = pa_iochannel_write(p->io, iov[0].iov_base, iov[0].iov_len);
 
-    if ((r = pa_iochannel_write(p->io, d, l)) < 0)
-        goto fail;
+    for (i = 0; i < n_frames; i++)
+        if (release_memblocks[i])
+            pa_memblock_release(release_memblocks[i]);
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+    if (r < 0)
+        return -1;
+
+    pa_atomic_inc(&pstream_stat.n_write_calls);
+
+    /* Retire the frames that went out completely */
+    while (r > 0) {
+        size_t left;
+
+        w = get_write_frame(p, 0);
+        left = PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - w->index;
+
+        if ((size_t) r < left) {
+            w->index += (size_t) r;
+            break;
+        }
+
+        r -= (ssize_t) left;
 
-    p->write.index += (size_t) r;
+        item_free(w->current);
+        w->current = NULL;
 
-    if (p->write.index >= PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) {
-        pa_assert(p->write.current);
-        item_free(p->write.current);
-        p->write.current = NULL;
+        if (w->memchunk.memblock)
+            pa_memblock_unref(w->memchunk.memblock);
 
-        if (p->write.memchunk.memblock)
-            pa_memblock_unref(p->write.memchunk.memblock);
+        pa_memchunk_reset(&w->memchunk);
 
-        pa_memchunk_reset(&p->write.memchunk);
+        p->write_first = (p->write_first + 1) % WRITE_BATCH_FRAMES;
+        p->write_n--;
 
-        if (p->drain_callback && !pa_pstream_is_pending(p))
-            p->drain_callback(p, p->drain_callback_userdata);
+        pa_atomic_inc(&pstream_stat.n_frames_written);
+        frame_done = TRUE;
     }
 
+    if (frame_done && p->drain_callback && !pa_pstream_is_pending(p))
+        p->drain_callback(p, p->drain_callback_userdata);
+
     return 0;
+}
 
-fail:
+static ssize_t read_socket(pa_pstream *p, void *d, size_t l, pa_bool_t *creds_valid) {
+    ssize_t r;
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+    *creds_valid = FALSE;
 
-    return -1;
+#ifdef HAVE_CREDS
+    r = pa_iochannel_read_with_creds(p->io, d, l, &p->read_creds, creds_valid);
+#else
+    r = pa_iochannel_read(p->io, d, l);
+#endif
+
+    if (r >= 0)
+        pa_atomic_inc(&pstream_stat.n_read_calls);
+
+    return r;
 }
 
-static int do_read(pa_pstream *p) {
+/* Passes on up to l bytes of the stream to the frame being read, from
+ * what we read ahead or straight from the socket */
+static ssize_t read_stream(pa_pstream *p, void *d, size_t l) {
+    ssize_t r;
+    pa_bool_t b;
+
+    if (p->read.buffer_index >= p->read.buffer_length) {
+
+        /* Large payloads go directly to their destination. fds come
+         * with the first read that touches the data they were sent
+         * with, which is the start of a frame. While the fds of the
+         * buffer wait for their frame we stick to reading exactly what
+         * that frame needs, so that no further fds show up. */
+        if (l >= READ_BUFFER_SIZE || p->read.n_pending_fds > 0) {
+
+            if ((r = read_socket(p, d, l, &b)) <= 0)
+                return r;
+
+#ifdef HAVE_CREDS
+            p->read_creds_valid = p->read_creds_valid || b;
+#endif
+            p->read.position += (uint64_t) r;
+            return r;
+        }
+
+        if ((r = read_socket(p, p->read.buffer, sizeof(p->read.buffer), &b)) <= 0)
+            return r;
+
+        p->read.buffer_index = 0;
+        p->read.buffer_length = (size_t) r;
+        p->read.buffer_creds_valid = b;
+
+#ifdef HAVE_CREDS
+        if ((p->read.n_pending_fds = pa_iochannel_steal_received_fds(p->io, p->read.pending_fds, PA_IOCHANNEL_FDS_MAX)) > 0)
+            p->read.pending_fds_until = p->read.position + (uint64_t) r;
+#endif
+    }
+
+    r = (ssize_t) PA_MIN(l, p->read.buffer_length - p->read.buffer_index);
+    memcpy(d, p->read.buffer + p->read.buffer_index, (size_t) r);
+
+    p->read.buffer_index += (size_t) r;
+    p->read.position += (uint64_t) r;
+
+#ifdef HAVE_CREDS
+    p->read_creds_valid = p->read_creds_valid || p->read.buffer_creds_valid;
+#endif
+
+    return r;
+}
+
+/* Called when the descriptor of a frame with the specified payload
+ * length is complete. The fds of the buffer belong to the last frame
+ * that starts in it, as they are always sent with a write of their
+ * own. Whatever doesn't fit into fds is closed. */
+static unsigned take_frame_fds(pa_pstream *p, uint32_t length, int *fds, unsigned n_max) {
+    uint64_t start;
+    unsigned n;
+
+    if (p->read.n_pending_fds <= 0)
+        return 0;
+
+    start = p->read.position - PA_PSTREAM_DESCRIPTOR_SIZE;
+
+    if (start >= p->read.pending_fds_until ||
+        start + PA_PSTREAM_DESCRIPTOR_SIZE + length < p->read.pending_fds_until)
+        return 0;
+
+    n = PA_MIN(p->read.n_pending_fds, n_max);
+    memcpy(fds, p->read.pending_fds, sizeof(int) * n);
+    memmove(p->read.pending_fds, p->read.pending_fds + n, sizeof(int) * (p->read.n_pending_fds - n));
+    p->read.n_pending_fds -= n;
+
+    close_pending_fds(p);
+
+    return n;
+}
+
+static int do_read_frame(pa_pstream *p) {
     void *d;
     size_t l;
     ssize_t r;
@@ -669,19 +1071,8 @@ static int do_read(pa_pstream *p) {
         l = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (p->read.index - PA_PSTREAM_DESCRIPTOR_SIZE);
     }
 
-#ifdef HAVE_CREDS
-    {
-        pa_bool_t b = 0;
-
-        if ((r = pa_iochannel_read_with_creds(p->io, d, l, &p->read_creds, &b)) <= 0)
-            goto fail;
-
-        p->read_creds_valid = p->read_creds_valid || b;
-    }
-#else
-    if ((r = pa_iochannel_read(p->io, d, l)) <= 0)
+    if ((r = read_stream(p, d, l)) <= 0)
         goto fail;
-#endif
 
     if (release_memblock)
         pa_memblock_release(release_memblock);
@@ -744,6 +1135,11 @@ static int do_read(pa_pstream *p) {
             p->read.packet = pa_packet_new(length);
             p->read.data = p->read.packet->data;
 
+            /* fds are only expected once their use has been
+             * negotiated, anything else is dropped here */
+            pa_assert(p->read.n_fds == 0);
+            p->read.n_fds = take_frame_fds(p, length, p->read.fds, p->use_memfd ? PA_IOCHANNEL_FDS_MAX : 0);
+
         } else {
 
             if ((flags & PA_FLAG_SEEKMASK) > PA_SEEK_RELATIVE_END) {
@@ -751,6 +1147,24 @@ static int do_read(pa_pstream *p) {
                 return -1;
             }
 
+            if ((flags & PA_FLAG_SHMMASK) == (PA_FLAG_SHMDATA|PA_FLAG_SHMMEMFD)) {
+
+                if (!p->use_memfd) {
+                    pa_log_warn("Received memfd frame on a socket where memfd is disabled.");
+                    return -1;
+                }
+
+                if (take_frame_fds(p, length, &p->read.memfd, 1) < 1)
+                    p->read.memfd = -1;
+
+                if (p->read.memfd < 0) {
+                    pa_log_warn("Received memfd frame without file descriptor.");
+                    return -1;
+                }
+
+                flags &= ~PA_FLAG_SHMMEMFD;
+            }
+
             if ((flags & PA_FLAG_SHMMASK) == PA_FLAG_SHMDATA) {
 
                 if (length != sizeof(p->read.shm_info)) {
@@ -829,14 +1243,24 @@ static int do_read(pa_pstream *p) {
                     p->receive_packet_callback(p, p->read.packet, NULL, p->receive_packet_callback_userdata);
 #endif
 
+                /* Close whatever the receiver didn't take */
+                close_read_fds(p);
+
                 pa_packet_unref(p->read.packet);
             } else {
                 pa_memblock *b;
 
-                pa_assert((ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SHMMASK) == PA_FLAG_SHMDATA);
+                pa_assert((ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SHMMASK & ~PA_FLAG_SHMMEMFD) == PA_FLAG_SHMDATA);
 
                 pa_assert(p->import);
 
+                if (p->read.memfd >= 0) {
+                    if (pa_memimport_attach_memfd(p->import, ntohl(p->read.shm_info[PA_PSTREAM_SHM_SHMID]), p->read.memfd) < 0)
+                        pa_log_warn("Failed to attach memfd segment.");
+
+                    p->read.memfd = -1;
+                }
+
                 if (!(b = pa_memimport_get(p->import,
                                           ntohl(p->read.shm_info[PA_PSTREAM_SHM_BLOCKID]),
                                           ntohl(p->read.shm_info[PA_PSTREAM_SHM_SHMID]),
@@ -888,6 +1312,14 @@ frame_done:
     p->read_creds_valid = FALSE;
 #endif
 
+    /* The frame the fds were meant for is gone */
+    if (p->read.n_pending_fds > 0 && p->read.position >= p->read.pending_fds_until) {
+        pa_log_warn("Received file descriptors with a frame that doesn't take any.");
+        close_pending_fds(p);
+    }
+
+    pa_atomic_inc(&pstream_stat.n_frames_read);
+
     return 0;
 
 fail:
@@ -897,6 +1329,18 @@ fail:
     return -1;
 }
 
+static int do_read(pa_pstream *p) {
+
+    /* A single read from the socket might have brought in several
+     * frames, handle all of them */
+    do {
+        if (do_read_frame(p) < 0)
+            return -1;
+    } while (!p->dead && p->read.buffer_index < p->read.buffer_length);
+
+    return 0;
+}
+
 void pa_pstream_set_die_callback(pa_pstream *p, pa_pstream_notify_cb_t cb, void *userdata) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
@@ -945,6 +1389,16 @@ void pa_pstream_set_revoke_callback(pa_pstream *p, pa_pstream_block_id_cb_t cb,
     p->release_callback_userdata = userdata;
 }
 
+unsigned pa_pstream_get_pending(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (p->dead)
+        return 0;
+
+    return p->write_n + p->n_send_queue;
+}
+
 pa_bool_t pa_pstream_is_pending(pa_pstream *p) {
     pa_bool_t b;
 
@@ -954,7 +1408,7 @@ pa_bool_t pa_pstream_is_pending(pa_pstream *p) {
     if (p->dead)
         b = FALSE;
     else
-        b = p->write.current || !pa_queue_isempty(p->send_queue);
+        b = p->write_n > 0 || !pa_queue_isempty(p->send_queue);
 
     return b;
 }
@@ -1026,12 +1480,38 @@ void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable) {
             pa_memexport_free(p->export);
             p->export = NULL;
         }
+
+        p->use_memfd = FALSE;
     }
 }
 
+void pa_pstream_enable_memfd(pa_pstream *p, pa_bool_t enable) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(!enable || p->use_shm);
+
+    /* Passing fds needs the same socket features as credentials */
+#ifdef HAVE_CREDS
+    p->use_memfd = enable;
+#else
+    pa_assert(!enable);
+#endif
+}
+
+pa_bool_t pa_pstream_get_memfd(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    return p->use_memfd;
+}
+
 pa_bool_t pa_pstream_get_shm(pa_pstream *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
     return p->use_shm;
 }
+
+const pa_pstream_stat* pa_pstream_get_stat(void) {
+    return &pstream_stat;
+}
@@ -33,10 +33,20 @@
 #include <pulsecore/iochannel.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/creds.h>
+#include <pulsecore/atomic.h>
 #include <pulsecore/macro.h>
 
 typedef struct pa_pstream pa_pstream;
 
+/* Counted over all pstreams of the process. A single read or write
+ * call may carry several frames. */
+typedef struct pa_pstream_stat {
+    pa_atomic_t n_read_calls;
+    pa_atomic_t n_frames_read;
+    pa_atomic_t n_write_calls;
+    pa_atomic_t n_frames_written;
+} pa_pstream_stat;
+
 typedef void (*pa_pstream_packet_cb_t)(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata);
 typedef void (*pa_pstream_memblock_cb_t)(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata);
 typedef void (*pa_pstream_notify_cb_t)(pa_pstream *p, void *userdata);
@@ -50,6 +60,11 @@ void pa_pstream_unref(pa_pstream*p);
 void pa_pstream_unlink(pa_pstream *p);
 
 void pa_pstream_send_packet(pa_pstream*p, pa_packet *packet, const pa_creds *creds);
+/* Passes copies of fds along with the packet, needs memfd to be
+ * enabled. The receiver can take them with pa_pstream_steal_packet_fds()
+ * from within its packet callback, they are closed afterwards. */
+int pa_pstream_send_packet_with_fds(pa_pstream*p, pa_packet *packet, const int *fds, unsigned n_fds);
+unsigned pa_pstream_steal_packet_fds(pa_pstream *p, int *fds, unsigned n_max);
 void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk);
 void pa_pstream_send_release(pa_pstream *p, uint32_t block_id);
 void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id);
@@ -63,7 +78,17 @@ void pa_pstream_set_revoke_callback(pa_pstream *p, pa_pstream_block_id_cb_t cb,
 
 pa_bool_t pa_pstream_is_pending(pa_pstream *p);
 
+/* Number of packets and memory blocks not completely written yet */
+unsigned pa_pstream_get_pending(pa_pstream *p);
+
 void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable);
 pa_bool_t pa_pstream_get_shm(pa_pstream *p);
 
+/* Allow referring to blocks in memfd segments, by passing the segment
+ * fds along. Needs SHM to be enabled. */
+void pa_pstream_enable_memfd(pa_pstream *p, pa_bool_t enable);
+pa_bool_t pa_pstream_get_memfd(pa_pstream *p);
+
+const pa_pstream_stat* pa_pstream_get_stat(void);
+
 #endif
@@ -0,0 +1,203 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/semaphore.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "render-pool.h"
+
+struct pa_render_pool {
+    pa_thread **threads;
+    unsigned n_threads;
+
+    pa_bool_t realtime;
+    int rtprio;
+
+    /* Held by the thread whose batch is running */
+    pa_mutex *mutex;
+
+    /* Every post lets one worker take part in the current batch, and
+     * every worker that did posts done once it ran out of jobs */
+    pa_semaphore *start;
+    pa_semaphore *done;
+
+    /* The current batch, only changed while no worker takes part */
+    pa_render_pool_job_cb_t cb;
+    void *userdata;
+    unsigned n;
+    pa_thread_mq *thread_mq;
+    pa_atomic_t next;
+
+    pa_bool_t quit;
+};
+
+static void run_jobs(pa_render_pool *p) {
+    unsigned k;
+
+    while ((k = (unsigned) pa_atomic_inc(&p->next)) < p->n)
+        p->cb(k, p->userdata);
+}
+
+static void thread_func(void *userdata) {
+    pa_render_pool *p = userdata;
+
+    pa_assert(p);
+
+    if (p->realtime)
+        pa_make_realtime(p->rtprio);
+
+    for (;;) {
+        pa_semaphore_wait(p->start);
+
+        if (p->quit)
+            break;
+
+        if (p->thread_mq)
+            pa_thread_mq_install(p->thread_mq);
+
+        run_jobs(p);
+
+        if (p->thread_mq)
+            pa_thread_mq_uninstall();
+
+        pa_semaphore_post(p->done);
+    }
+}
+
+pa_render_pool* pa_render_pool_new(unsigned n_threads, pa_bool_t realtime, int rtprio) {
+    pa_render_pool *p;
+    unsigned i;
+
+    pa_assert(n_threads > 0);
+
+    p = pa_xnew0(pa_render_pool, 1);
+    p->realtime = realtime;
+    p->rtprio = rtprio;
+    p->mutex = pa_mutex_new(FALSE, FALSE);
+    p->start = pa_semaphore_new(0);
+    p->done = pa_semaphore_new(0);
+    pa_atomic_store(&p->next, 0);
+
+    p->threads = pa_xnew0(pa_thread*, n_threads);
+
+    for (i = 0; i < n_threads; i++) {
+        char name[16];
+
+        pa_snprintf(name, sizeof(name), "render-%u", i);
+
+        if (!(p->threads[i] = pa_thread_new(name, thread_func, p))) {
+            pa_log("Failed to create render thread.");
+            break;
+        }
+
+        p->n_threads++;
+    }
+
+    if (p->n_threads <= 0) {
+        pa_render_pool_free(p);
+        return NULL;
+    }
+
+    pa_log_info("Using %u render threads.", p->n_threads);
+
+    return p;
+}
+
+void pa_render_pool_free(pa_render_pool *p) {
+    unsigned i;
+
+    pa_assert(p);
+
+    p->quit = TRUE;
+
+    for (i = 0; i < p->n_threads; i++)
+        pa_semaphore_post(p->start);
+
+    for (i = 0; i < p->n_threads; i++)
+        pa_thread_free(p->threads[i]);
+
+    pa_xfree(p->threads);
+
+    pa_semaphore_free(p->start);
+    pa_semaphore_free(p->done);
+    pa_mutex_free(p->mutex);
+
+    pa_xfree(p);
+}
+
+unsigned pa_render_pool_get_n_threads(pa_render_pool *p) {
+    pa_assert(p);
+
+    return p->n_threads;
+}
+
+int pa_render_pool_run(pa_render_pool *p, unsigned n, pa_render_pool_job_cb_t cb, void *userdata, pa_usec_t *join_wait) {
+    unsigned n_workers, i;
+    pa_usec_t t = 0;
+
+    pa_assert(p);
+    pa_assert(cb);
+
+    if (!pa_mutex_try_lock(p->mutex))
+        return -1;
+
+    p->cb = cb;
+    p->userdata = userdata;
+    p->n = n;
+    p->thread_mq = pa_thread_mq_get();
+    pa_atomic_store(&p->next, 0);
+
+    /* We take one share of the jobs ourselves */
+    n_workers = PA_MIN(p->n_threads, n > 0 ? n - 1 : 0);
+
+    for (i = 0; i < n_workers; i++)
+        pa_semaphore_post(p->start);
+
+    run_jobs(p);
+
+    if (join_wait)
+        t = pa_rtclock_now();
+
+    for (i = 0; i < n_workers; i++)
+        pa_semaphore_wait(p->done);
+
+    if (join_wait)
+        *join_wait = pa_rtclock_now() - t;
+
+    p->cb = NULL;
+    p->userdata = NULL;
+    p->thread_mq = NULL;
+
+    pa_mutex_unlock(p->mutex);
+
+    return 0;
+}
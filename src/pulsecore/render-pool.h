@@ -0,0 +1,55 @@
+#ifndef foopulserenderpoolhfoo
+#define foopulserenderpoolhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+#include <pulsecore/macro.h>
+
+/* A set of worker threads an IO thread can hand a batch of independent
+ * jobs to, e.g. peeking every input of a sink. The calling thread works
+ * on the batch too and pa_render_pool_run() only returns once every job
+ * is finished, so for the jobs' code it looks as if they were run one
+ * after another from the calling IO thread: the workers have that
+ * thread's pa_thread_mq installed while they run a job, and everything
+ * they wrote is visible to the caller when pa_render_pool_run()
+ * returns.
+ *
+ * The pool is shared by all IO threads but runs only one batch at a
+ * time. If it is busy pa_render_pool_run() fails right away instead of
+ * blocking, and the caller is expected to do the jobs itself. */
+
+typedef struct pa_render_pool pa_render_pool;
+
+typedef void (*pa_render_pool_job_cb_t)(unsigned idx, void *userdata);
+
+pa_render_pool* pa_render_pool_new(unsigned n_threads, pa_bool_t realtime, int rtprio);
+void pa_render_pool_free(pa_render_pool *p);
+
+unsigned pa_render_pool_get_n_threads(pa_render_pool *p);
+
+/* Calls cb for every idx from 0 to n-1, in no particular order and
+ * spread over the worker threads and the calling thread. Returns -1 if
+ * another batch is running. If join_wait is not NULL it is set to the
+ * time the caller spent waiting for the workers after running out of
+ * jobs of its own. */
+int pa_render_pool_run(pa_render_pool *p, unsigned n, pa_render_pool_job_cb_t cb, void *userdata, pa_usec_t *join_wait);
+
+#endif
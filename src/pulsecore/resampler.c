@@ -24,6 +24,7 @@
 #endif
 
 #include <string.h>
+#include <math.h>
 
 #ifdef HAVE_LIBSAMPLERATE
 #include <samplerate.h>
@@ -35,11 +36,14 @@
 
 #include <pulse/xmalloc.h>
 #include <pulsecore/sconv.h>
+#include <pulsecore/sample-util.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/remap.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/mutex.h>
 #include "ffmpeg/avcodec.h"
 
 #include "resampler.h"
@@ -47,6 +51,12 @@
 /* Number of samples of extra space we allow the resamplers to return */
 #define EXTRA_FRAMES 128
 
+/* How much silence the resampler filters get before we stop running
+ * them on silent input. Longer than any of their impulse responses. */
+#define SILENCE_FLUSH_MSEC 10
+
+typedef struct polyphase_table polyphase_table;
+
 struct pa_resampler {
     pa_resample_method_t method;
     pa_resample_flags_t flags;
@@ -79,6 +89,16 @@ struct pa_resampler {
     void (*impl_update_rates)(pa_resampler *r);
     void (*impl_resample)(pa_resampler *r, const pa_memchunk *in, unsigned in_samples, pa_memchunk *out, unsigned *out_samples);
     void (*impl_reset)(pa_resampler *r);
+    /* Moves the state on as if in_samples of silence had been resampled
+     * and returns how many samples that would have given */
+    void (*impl_skip)(pa_resampler *r, unsigned in_samples, unsigned *out_samples);
+
+    /* Silent input is passed through the resampler as usual until its
+     * filters had SILENCE_FLUSH_MSEC of it, after that we just hand out
+     * silence of the right length, see run_silence() */
+    unsigned silence_flushed_frames;
+    bool skip_silence;
+    pa_memblock *silence_block;
 
     struct { /* data specific to the trivial resampler */
         unsigned o_counter;
@@ -110,6 +130,25 @@ struct pa_resampler {
         struct AVResampleContext *state;
         pa_memchunk buf[PA_CHANNELS_MAX];
     } ffmpeg;
+
+    struct { /* data specific to the polyphase resampler */
+        polyphase_table *table;
+        const float *filter;
+        float *coefs;
+        unsigned taps, phases;
+        bool interpolate;
+        double cutoff;
+
+        /* Planar input history, history_size frames per channel */
+        float *history;
+        unsigned history_frames, history_size;
+
+        /* Position of the next output frame: first tap at input frame
+         * index, plus phase/o_rate frames */
+        unsigned index;
+        uint32_t phase;
+        uint32_t o_rate;
+    } polyphase;
 };
 
 static int copy_init(pa_resampler *r);
@@ -119,6 +158,7 @@ static int speex_init(pa_resampler*r);
 #endif
 static int ffmpeg_init(pa_resampler*r);
 static int peaks_init(pa_resampler*r);
+static int polyphase_init(pa_resampler*r);
 #ifdef HAVE_LIBSAMPLERATE
 static int libsamplerate_init(pa_resampler*r);
 #endif
@@ -191,6 +231,7 @@ static int (* const init_table[])(pa_resampler*r) = {
     [PA_RESAMPLER_AUTO]                    = NULL,
     [PA_RESAMPLER_COPY]                    = copy_init,
     [PA_RESAMPLER_PEAKS]                   = peaks_init,
+    [PA_RESAMPLER_POLYPHASE]               = polyphase_init,
 };
 
 pa_resampler* pa_resampler_new(
@@ -365,6 +406,8 @@ void pa_resampler_free(pa_resampler *r) {
         pa_memblock_unref(r->resample_buf.memblock);
     if (r->from_work_format_buf.memblock)
         pa_memblock_unref(r->from_work_format_buf.memblock);
+    if (r->silence_block)
+        pa_memblock_unref(r->silence_block);
 
     pa_xfree(r);
 }
@@ -377,6 +420,8 @@ void pa_resampler_set_input_rate(pa_resampler *r, uint32_t rate) {
         return;
 
     r->i_ss.rate = rate;
+    r->skip_silence = false;
+    r->silence_flushed_frames = 0;
 
     r->impl_update_rates(r);
 }
@@ -389,6 +434,8 @@ void pa_resampler_set_output_rate(pa_resampler *r, uint32_t rate) {
         return;
 
     r->o_ss.rate = rate;
+    r->skip_silence = false;
+    r->silence_flushed_frames = 0;
 
     r->impl_update_rates(r);
 }
@@ -460,6 +507,8 @@ void pa_resampler_reset(pa_resampler *r) {
         r->impl_reset(r);
 
     r->remap_buf_contains_leftover_data = false;
+    r->skip_silence = false;
+    r->silence_flushed_frames = 0;
 }
 
 pa_resample_method_t pa_resampler_get_method(pa_resampler *r) {
@@ -524,7 +573,8 @@ static const char * const resample_methods[] = {
     "ffmpeg",
     "auto",
     "copy",
-    "peaks"
+    "peaks",
+    "polyphase"
 };
 
 const char *pa_resample_method_to_string(pa_resample_method_t m) {
@@ -1209,6 +1259,47 @@ static pa_memchunk *convert_from_work_format(pa_resampler *r, pa_memchunk *input
     return &r->from_work_format_buf;
 }
 
+/* Hands out as much silence as the resampler would have made of the
+ * input. The implementation counts the output frames and keeps its
+ * position, so that nothing is lost or gained when the input stops being
+ * silent again. */
+static void run_silence(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out) {
+    unsigned in_n_frames, out_n_frames;
+    size_t length;
+
+    in_n_frames = (unsigned) (in->length / r->i_fz);
+
+    if (r->impl_skip)
+        r->impl_skip(r, in_n_frames, &out_n_frames);
+    else
+        out_n_frames = in_n_frames;
+
+    if (out_n_frames == 0) {
+        pa_memchunk_reset(out);
+        return;
+    }
+
+    length = out_n_frames * r->o_fz;
+
+    if (!r->silence_block) {
+        r->silence_block = pa_memblock_new(r->mempool, pa_frame_align(pa_mempool_block_size_max(r->mempool), &r->o_ss));
+        pa_silence_memblock(r->silence_block, &r->o_ss);
+        pa_memblock_set_is_silence(r->silence_block, TRUE);
+    }
+
+    if (length <= pa_memblock_get_length(r->silence_block))
+        out->memblock = pa_memblock_ref(r->silence_block);
+    else {
+        /* Too much for the shared block, this one is used only once */
+        out->memblock = pa_memblock_new(r->mempool, length);
+        pa_silence_memblock(out->memblock, &r->o_ss);
+        pa_memblock_set_is_silence(out->memblock, TRUE);
+    }
+
+    out->index = 0;
+    out->length = length;
+}
+
 void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out) {
     pa_memchunk *buf;
 
@@ -1219,6 +1310,23 @@ void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out)
     pa_assert(in->memblock);
     pa_assert(in->length % r->i_fz == 0);
 
+    if (!pa_memblock_is_silence(in->memblock)) {
+        r->skip_silence = false;
+        r->silence_flushed_frames = 0;
+
+    } else if (r->skip_silence) {
+        run_silence(r, in, out);
+        return;
+
+    } else if (!r->impl_resample || r->impl_skip) {
+
+        /* Let the filters ring out before we stop feeding them */
+        r->silence_flushed_frames += (unsigned) (in->length / r->i_fz);
+
+        if (!r->impl_resample || r->silence_flushed_frames >= r->i_ss.rate * SILENCE_FLUSH_MSEC / 1000)
+            r->skip_silence = true;
+    }
+
     buf = (pa_memchunk*) in;
     buf = convert_to_work_format(r, buf);
     /* Try to save resampling effort: if we have more output channels than
@@ -1483,6 +1591,29 @@ static void trivial_resample(pa_resampler *r, const pa_memchunk *input, unsigned
     }
 }
 
+static void trivial_skip(pa_resampler *r, unsigned in_n_frames, unsigned *out_n_frames) {
+    uint64_t o_end;
+
+    pa_assert(r);
+    pa_assert(out_n_frames);
+
+    /* trivial_resample() hands out every output frame whose input frame
+     * lies before i_counter + in_n_frames */
+    o_end = (((uint64_t) r->trivial.i_counter + in_n_frames) * r->o_ss.rate + r->i_ss.rate - 1) / r->i_ss.rate;
+    *out_n_frames = o_end > r->trivial.o_counter ? (unsigned) (o_end - r->trivial.o_counter) : 0;
+
+    r->trivial.o_counter += *out_n_frames;
+    r->trivial.i_counter += in_n_frames;
+
+    /* Normalize counters */
+    while (r->trivial.i_counter >= r->i_ss.rate) {
+        pa_assert(r->trivial.o_counter >= r->o_ss.rate);
+
+        r->trivial.i_counter -= r->i_ss.rate;
+        r->trivial.o_counter -= r->o_ss.rate;
+    }
+}
+
 static void trivial_update_rates_or_reset(pa_resampler *r) {
     pa_assert(r);
 
@@ -1498,6 +1629,7 @@ static int trivial_init(pa_resampler*r) {
     r->impl_resample = trivial_resample;
     r->impl_update_rates = trivial_update_rates_or_reset;
     r->impl_reset = trivial_update_rates_or_reset;
+    r->impl_skip = trivial_skip;
 
     return 0;
 }
@@ -1730,6 +1862,463 @@ static int ffmpeg_init(pa_resampler *r) {
     return 0;
 }
 
+/*** polyphase windowed-sinc implementation ***/
+
+/* Filter length for upsampling, roughly matching speex-float-3. When
+ * downsampling the filter is stretched by the rate ratio. */
+#define POLYPHASE_TAPS 48
+#define POLYPHASE_MAX_TAPS 1024
+#define POLYPHASE_BANDWIDTH 0.92
+#define POLYPHASE_KAISER_BETA 8.6
+
+/* Rate ratios that reduce to at most this many output frames get one
+ * exact filter phase per output position. Anything else, including all
+ * variable rate resamplers, interpolates between a fixed number of
+ * phases. */
+#define POLYPHASE_MAX_EXACT_PHASES 512
+#define POLYPHASE_INTERPOLATED_PHASES 256
+
+static float dot_c(const float *a, const float *b, unsigned n) {
+    float sum = 0;
+
+    for (; n > 0; n--)
+        sum += *a++ * *b++;
+
+    return sum;
+}
+
+static pa_resampler_dot_func_t dot_func = dot_c;
+
+pa_resampler_dot_func_t pa_get_resampler_dot_func(void) {
+    return dot_func;
+}
+
+void pa_set_resampler_dot_func(pa_resampler_dot_func_t func) {
+    pa_assert(func);
+
+    dot_func = func;
+}
+
+static double bessel_i0(double x) {
+    double sum = 1, term = 1;
+    unsigned k;
+
+    for (k = 1; term > sum * 1e-12; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+/* Kaiser windowed sinc, t is the distance in input frames from the
+ * output position */
+static double polyphase_coef(double t, double cutoff, unsigned taps) {
+    double x = t / (taps / 2), s;
+
+    if (fabs(x) >= 1)
+        return 0;
+
+    s = fabs(t) < 1e-9 ? 1 : sin(M_PI * cutoff * t) / (M_PI * cutoff * t);
+
+    return cutoff * s * bessel_i0(POLYPHASE_KAISER_BETA * sqrt(1 - x * x)) / bessel_i0(POLYPHASE_KAISER_BETA);
+}
+
+static void polyphase_ensure_history(pa_resampler *r, unsigned frames) {
+    float *history;
+    unsigned size, c;
+
+    if (frames <= r->polyphase.history_size)
+        return;
+
+    size = PA_MAX(frames, 2 * r->polyphase.history_size);
+    history = pa_xnew(float, size * r->work_channels);
+
+    if (r->polyphase.history)
+        for (c = 0; c < r->work_channels; c++)
+            memcpy(history + c * size,
+                   r->polyphase.history + c * r->polyphase.history_size,
+                   r->polyphase.history_frames * sizeof(float));
+
+    pa_xfree(r->polyphase.history);
+    r->polyphase.history = history;
+    r->polyphase.history_size = size;
+}
+
+/* Move the frames from index on to the start of the history, or, if shift
+ * is negative, insert -shift frames of silence in front of them. */
+static void polyphase_shift_history(pa_resampler *r, int shift) {
+    unsigned c, n = r->polyphase.history_frames;
+
+    if (shift == 0)
+        return;
+
+    if (shift > 0) {
+        if ((shift = PA_MIN((unsigned) shift, n)) == 0)
+            return;
+        n -= shift;
+    } else
+        polyphase_ensure_history(r, n - shift);
+
+    for (c = 0; c < r->work_channels; c++) {
+        float *h = r->polyphase.history + c * r->polyphase.history_size;
+
+        if (shift > 0)
+            memmove(h, h + shift, n * sizeof(float));
+        else {
+            memmove(h - shift, h, n * sizeof(float));
+            memset(h, 0, -shift * sizeof(float));
+        }
+    }
+
+    r->polyphase.history_frames = n + (shift < 0 ? -shift : 0);
+}
+
+/* Filter tables only depend on their design parameters, so all
+ * resamplers share them. Tables that are no longer used are kept around
+ * for a while, because clients tend to come and go with the same rates. */
+#define POLYPHASE_MAX_UNUSED_TABLES 8
+
+struct polyphase_table {
+    unsigned ref;
+    unsigned taps, rows;
+    /* The cutoff is lowered by num/den when downsampling */
+    unsigned num, den;
+    float *filter;
+    PA_LLIST_FIELDS(polyphase_table);
+};
+
+static pa_static_mutex tables_mutex = PA_STATIC_MUTEX_INIT;
+static PA_LLIST_HEAD(polyphase_table, tables) = NULL;
+static unsigned n_unused_tables = 0;
+static pa_resampler_cache_stat cache_stat;
+
+const pa_resampler_cache_stat* pa_resampler_get_cache_stat(void) {
+    return &cache_stat;
+}
+
+static void polyphase_table_free(polyphase_table *t) {
+    pa_atomic_dec(&cache_stat.n_tables);
+    pa_atomic_sub(&cache_stat.tables_size, (int) (t->rows * t->taps * sizeof(float)));
+
+    pa_xfree(t->filter);
+    pa_xfree(t);
+}
+
+static polyphase_table *polyphase_table_find(unsigned taps, unsigned rows, unsigned num, unsigned den) {
+    polyphase_table *t;
+
+    PA_LLIST_FOREACH(t, tables)
+        if (t->taps == taps && t->rows == rows && t->num == num && t->den == den)
+            return t;
+
+    return NULL;
+}
+
+/* rows is the number of phases, plus one if the table is interpolated */
+static polyphase_table *polyphase_table_get(unsigned taps, unsigned phases, unsigned rows, unsigned num, unsigned den) {
+    polyphase_table *t, *n;
+    pa_mutex *mutex;
+    double cutoff;
+    unsigned p, k;
+
+    mutex = pa_static_mutex_get(&tables_mutex, FALSE, FALSE);
+    pa_mutex_lock(mutex);
+
+    if ((t = polyphase_table_find(taps, rows, num, den))) {
+        if (t->ref++ == 0)
+            n_unused_tables--;
+
+        /* Keep the list in most recently used order */
+        PA_LLIST_REMOVE(polyphase_table, tables, t);
+        PA_LLIST_PREPEND(polyphase_table, tables, t);
+
+        pa_mutex_unlock(mutex);
+
+        pa_atomic_inc(&cache_stat.n_hits);
+        return t;
+    }
+
+    pa_mutex_unlock(mutex);
+
+    pa_atomic_inc(&cache_stat.n_misses);
+
+    /* Calculate the table without holding the lock, this is the slow
+     * part */
+    n = pa_xnew0(polyphase_table, 1);
+    n->ref = 1;
+    n->taps = taps;
+    n->rows = rows;
+    n->num = num;
+    n->den = den;
+    n->filter = pa_xnew(float, rows * taps);
+
+    cutoff = POLYPHASE_BANDWIDTH * num / den;
+
+    for (p = 0; p < rows; p++)
+        for (k = 0; k < taps; k++)
+            n->filter[p * taps + k] = (float) polyphase_coef((double) k - (taps / 2 - 1) - (double) p / phases, cutoff, taps);
+
+    pa_mutex_lock(mutex);
+
+    /* Somebody else might have been faster */
+    if ((t = polyphase_table_find(taps, rows, num, den))) {
+        if (t->ref++ == 0)
+            n_unused_tables--;
+
+        pa_mutex_unlock(mutex);
+
+        pa_xfree(n->filter);
+        pa_xfree(n);
+        return t;
+    }
+
+    PA_LLIST_PREPEND(polyphase_table, tables, n);
+
+    pa_atomic_inc(&cache_stat.n_tables);
+    pa_atomic_add(&cache_stat.tables_size, (int) (rows * taps * sizeof(float)));
+
+    pa_mutex_unlock(mutex);
+
+    return n;
+}
+
+static void polyphase_table_unref(polyphase_table *t) {
+    polyphase_table *i, *last = NULL;
+    pa_mutex *mutex;
+
+    pa_assert(t);
+
+    mutex = pa_static_mutex_get(&tables_mutex, FALSE, FALSE);
+    pa_mutex_lock(mutex);
+
+    pa_assert(t->ref >= 1);
+
+    if (--t->ref == 0 && ++n_unused_tables > POLYPHASE_MAX_UNUSED_TABLES) {
+
+        /* Drop the least recently used table nobody refers to */
+        PA_LLIST_FOREACH(i, tables)
+            if (i->ref == 0)
+                last = i;
+
+        PA_LLIST_REMOVE(polyphase_table, tables, last);
+        n_unused_tables--;
+        polyphase_table_free(last);
+    }
+
+    pa_mutex_unlock(mutex);
+}
+
+static void polyphase_calc_filter(pa_resampler *r) {
+    unsigned taps, phases, gcd, num = 1, den = 1;
+    double cutoff;
+    bool interpolate;
+
+    pa_assert(r);
+
+    gcd = pa_gcd(r->i_ss.rate, r->o_ss.rate);
+    interpolate = (r->flags & PA_RESAMPLER_VARIABLE_RATE) || r->o_ss.rate / gcd > POLYPHASE_MAX_EXACT_PHASES;
+    phases = interpolate ? POLYPHASE_INTERPOLATED_PHASES : r->o_ss.rate / gcd;
+
+    taps = POLYPHASE_TAPS;
+
+    if (r->i_ss.rate > r->o_ss.rate) {
+        num = r->o_ss.rate / gcd;
+        den = r->i_ss.rate / gcd;
+        taps = PA_ROUND_UP((unsigned) ceil((double) taps * r->i_ss.rate / r->o_ss.rate), 16U);
+        taps = PA_MIN(taps, (unsigned) POLYPHASE_MAX_TAPS);
+    }
+
+    cutoff = POLYPHASE_BANDWIDTH * num / den;
+
+    /* With an interpolated table small rate adjustments don't require a
+     * new filter, which is what the drift compensation relies on */
+    if (r->polyphase.table && interpolate && r->polyphase.interpolate &&
+        taps == r->polyphase.taps && fabs(cutoff - r->polyphase.cutoff) < 0.01 * r->polyphase.cutoff)
+        return;
+
+    /* Keep the output position aligned with the center of the filter */
+    if (r->polyphase.history && taps != r->polyphase.taps) {
+        int shift = (int) (r->polyphase.taps / 2) - (int) (taps / 2);
+
+        if (shift < 0 && r->polyphase.index >= (unsigned) -shift)
+            r->polyphase.index += shift;
+        else if (shift < 0) {
+            polyphase_shift_history(r, (int) r->polyphase.index + shift);
+            r->polyphase.index = 0;
+        } else
+            r->polyphase.index += shift;
+    }
+
+    pa_log_debug("Polyphase filter with %u taps and %u %s phases", taps, phases, interpolate ? "interpolated" : "exact");
+
+    r->polyphase.taps = taps;
+    r->polyphase.phases = phases;
+    r->polyphase.interpolate = interpolate;
+    r->polyphase.cutoff = cutoff;
+
+    if (r->polyphase.table)
+        polyphase_table_unref(r->polyphase.table);
+
+    /* The extra row is the filter for a phase of exactly one frame, the
+     * upper end for interpolating the last phase */
+    r->polyphase.table = polyphase_table_get(taps, phases, interpolate ? phases + 1 : phases, num, den);
+    r->polyphase.filter = r->polyphase.table->filter;
+
+    pa_xfree(r->polyphase.coefs);
+    r->polyphase.coefs = pa_xnew(float, taps);
+}
+
+static void polyphase_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
+    pa_resampler_dot_func_t dot = dot_func;
+    unsigned channels = r->work_channels, taps = r->polyphase.taps;
+    uint32_t i_rate = r->i_ss.rate, o_rate = r->o_ss.rate;
+    unsigned o_index, u, c;
+    const float *src;
+    float *dst;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(output);
+    pa_assert(out_n_frames);
+
+    /* Append the input to the planar history */
+    polyphase_ensure_history(r, r->polyphase.history_frames + in_n_frames);
+
+    src = pa_memblock_acquire_chunk(input);
+    for (c = 0; c < channels; c++) {
+        float *h = r->polyphase.history + c * r->polyphase.history_size + r->polyphase.history_frames;
+
+        for (u = 0; u < in_n_frames; u++)
+            h[u] = src[u * channels + c];
+    }
+    pa_memblock_release(input->memblock);
+
+    r->polyphase.history_frames += in_n_frames;
+
+    dst = pa_memblock_acquire_chunk(output);
+
+    for (o_index = 0; o_index < *out_n_frames && r->polyphase.index + taps <= r->polyphase.history_frames; o_index++) {
+        const float *h;
+
+        if (r->polyphase.interpolate) {
+            uint64_t x = (uint64_t) r->polyphase.phase * r->polyphase.phases;
+            const float *a = r->polyphase.filter + (x / o_rate) * taps, *b = a + taps;
+            float frac = (float) (x % o_rate) / (float) o_rate;
+
+            for (u = 0; u < taps; u++)
+                r->polyphase.coefs[u] = a[u] + frac * (b[u] - a[u]);
+
+            h = r->polyphase.coefs;
+        } else
+            h = r->polyphase.filter + ((uint64_t) r->polyphase.phase * r->polyphase.phases / o_rate) * taps;
+
+        for (c = 0; c < channels; c++)
+            *(dst++) = dot(r->polyphase.history + c * r->polyphase.history_size + r->polyphase.index, h, taps);
+
+        r->polyphase.phase += i_rate;
+        r->polyphase.index += r->polyphase.phase / o_rate;
+        r->polyphase.phase %= o_rate;
+    }
+
+    pa_memblock_release(output->memblock);
+
+    *out_n_frames = o_index;
+
+    /* Drop the frames that no output position will need anymore */
+    u = PA_MIN(r->polyphase.index, r->polyphase.history_frames);
+    polyphase_shift_history(r, (int) u);
+    r->polyphase.index -= u;
+}
+
+static void polyphase_skip(pa_resampler *r, unsigned in_n_frames, unsigned *out_n_frames) {
+    unsigned taps = r->polyphase.taps, keep, zeros, c;
+    uint32_t i_rate = r->i_ss.rate, o_rate = r->o_ss.rate;
+    uint64_t frames, pos, end, n = 0;
+
+    pa_assert(r);
+    pa_assert(out_n_frames);
+
+    /* Count the output positions polyphase_resample() would have
+     * visited, in units of 1/o_rate input frames */
+    frames = (uint64_t) r->polyphase.history_frames + in_n_frames;
+    pos = (uint64_t) r->polyphase.index * o_rate + r->polyphase.phase;
+
+    if (frames >= taps && (end = (frames - taps + 1) * o_rate) > pos)
+        n = (end - pos + i_rate - 1) / i_rate;
+
+    pos += n * i_rate;
+    r->polyphase.index = (unsigned) (pos / o_rate);
+    r->polyphase.phase = (uint32_t) (pos % o_rate);
+    *out_n_frames = (unsigned) n;
+
+    /* Drop what no output position will need anymore, and only store
+     * the silence that still reaches into the filter */
+    keep = r->polyphase.index < r->polyphase.history_frames ? r->polyphase.history_frames - r->polyphase.index : 0;
+    zeros = (unsigned) (frames - PA_MIN((uint64_t) r->polyphase.index, frames)) - keep;
+
+    polyphase_shift_history(r, (int) (r->polyphase.history_frames - keep));
+    polyphase_ensure_history(r, keep + zeros);
+
+    for (c = 0; c < r->work_channels; c++)
+        memset(r->polyphase.history + c * r->polyphase.history_size + keep, 0, zeros * sizeof(float));
+
+    r->polyphase.history_frames = keep + zeros;
+    r->polyphase.index -= (unsigned) PA_MIN((uint64_t) r->polyphase.index, frames);
+}
+
+static void polyphase_update_rates(pa_resampler *r) {
+    pa_assert(r);
+
+    /* Keep the fractional position between two input frames */
+    r->polyphase.phase = (uint32_t) ((uint64_t) r->polyphase.phase * r->o_ss.rate / r->polyphase.o_rate);
+    r->polyphase.o_rate = r->o_ss.rate;
+
+    polyphase_calc_filter(r);
+
+    /* The exact filter table only has the phases the new ratio can reach */
+    if (!r->polyphase.interpolate)
+        r->polyphase.phase -= r->polyphase.phase % pa_gcd(r->i_ss.rate, r->o_ss.rate);
+}
+
+static void polyphase_reset(pa_resampler *r) {
+    pa_assert(r);
+
+    /* Put the first input frame at the center of the filter */
+    r->polyphase.history_frames = 0;
+    r->polyphase.index = 0;
+    r->polyphase.phase = 0;
+    polyphase_shift_history(r, -(int) (r->polyphase.taps / 2 - 1));
+}
+
+static void polyphase_free(pa_resampler *r) {
+    pa_assert(r);
+
+    if (r->polyphase.table)
+        polyphase_table_unref(r->polyphase.table);
+
+    pa_xfree(r->polyphase.coefs);
+    pa_xfree(r->polyphase.history);
+}
+
+static int polyphase_init(pa_resampler *r) {
+    pa_assert(r);
+    pa_assert(r->work_format == PA_SAMPLE_FLOAT32NE);
+
+    r->polyphase.o_rate = r->o_ss.rate;
+
+    polyphase_calc_filter(r);
+    polyphase_reset(r);
+
+    r->impl_free = polyphase_free;
+    r->impl_resample = polyphase_resample;
+    r->impl_update_rates = polyphase_update_rates;
+    r->impl_reset = polyphase_reset;
+    r->impl_skip = polyphase_skip;
+
+    return 0;
+}
+
 /*** copy (noop) implementation ***/
 
 static int copy_init(pa_resampler *r) {
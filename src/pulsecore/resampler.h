@@ -26,6 +26,7 @@
 #include <pulse/channelmap.h>
 #include <pulsecore/memblock.h>
 #include <pulsecore/memchunk.h>
+#include <pulsecore/atomic.h>
 
 typedef struct pa_resampler pa_resampler;
 
@@ -45,6 +46,7 @@ typedef enum pa_resample_method {
     PA_RESAMPLER_AUTO, /* automatic select based on sample format */
     PA_RESAMPLER_COPY,
     PA_RESAMPLER_PEAKS,
+    PA_RESAMPLER_POLYPHASE,
     PA_RESAMPLER_MAX
 } pa_resample_method_t;
 
@@ -99,6 +101,24 @@ const char *pa_resample_method_to_string(pa_resample_method_t m);
 /* Return 1 when the specified resampling method is supported */
 int pa_resample_method_supported(pa_resample_method_t m);
 
+/* Dot product of two float vectors as used by the polyphase resampler. n
+ * is always a multiple of 16. */
+typedef float (*pa_resampler_dot_func_t) (const float *a, const float *b, unsigned n);
+
+pa_resampler_dot_func_t pa_get_resampler_dot_func(void);
+void pa_set_resampler_dot_func(pa_resampler_dot_func_t func);
+
+/* Statistics of the filter table cache shared by all resamplers. Like
+ * pa_mempool_stat these are not updated atomically as a whole. */
+typedef struct pa_resampler_cache_stat {
+    pa_atomic_t n_tables;
+    pa_atomic_t tables_size;
+    pa_atomic_t n_hits;
+    pa_atomic_t n_misses;
+} pa_resampler_cache_stat;
+
+const pa_resampler_cache_stat* pa_resampler_get_cache_stat(void);
+
 const pa_channel_map* pa_resampler_input_channel_map(pa_resampler *r);
 const pa_sample_spec* pa_resampler_input_sample_spec(pa_resampler *r);
 const pa_channel_map* pa_resampler_output_channel_map(pa_resampler *r);
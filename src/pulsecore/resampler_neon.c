@@ -0,0 +1,54 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-arm.h"
+#include "resampler.h"
+
+#include <arm_neon.h>
+
+static float dot_neon(const float *a, const float *b, unsigned n) {
+    float32x4_t sum0 = vdupq_n_f32(0), sum1 = vdupq_n_f32(0);
+    float32x4_t sum2 = vdupq_n_f32(0), sum3 = vdupq_n_f32(0);
+    float32x2_t s;
+
+    for (; n > 0; n -= 16, a += 16, b += 16) {
+        sum0 = vmlaq_f32(sum0, vld1q_f32(a), vld1q_f32(b));
+        sum1 = vmlaq_f32(sum1, vld1q_f32(a + 4), vld1q_f32(b + 4));
+        sum2 = vmlaq_f32(sum2, vld1q_f32(a + 8), vld1q_f32(b + 8));
+        sum3 = vmlaq_f32(sum3, vld1q_f32(a + 12), vld1q_f32(b + 12));
+    }
+
+    sum0 = vaddq_f32(vaddq_f32(sum0, sum1), vaddq_f32(sum2, sum3));
+    s = vadd_f32(vget_low_f32(sum0), vget_high_f32(sum0));
+    s = vpadd_f32(s, s);
+
+    return vget_lane_f32(s, 0);
+}
+
+void pa_resampler_func_init_neon(pa_cpu_arm_flag_t flags) {
+    pa_log_info("Initialising ARM NEON optimized resampler functions.");
+    pa_set_resampler_dot_func(dot_neon);
+}
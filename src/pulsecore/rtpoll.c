@@ -29,6 +29,11 @@
 #include <string.h>
 #include <errno.h>
 
+#ifdef __linux__
+#include <sys/timerfd.h>
+#define HAVE_TIMERFD 1
+#endif
+
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
 
@@ -53,6 +58,14 @@ struct pa_rtpoll {
     struct timeval next_elapse;
     pa_bool_t timer_enabled:1;
 
+    /* If >= 0 the timer is a timerfd polled along with the items, and
+     * timer_fd_elapse is what it is currently armed for */
+    int timer_fd;
+    struct timeval timer_fd_elapse;
+
+    /* Where to account how late we woke up for the timer, may be NULL */
+    pa_histogram *lateness;
+
     pa_bool_t scan_for_dead:1;
     pa_bool_t running:1;
     pa_bool_t rebuild_needed:1;
@@ -95,6 +108,8 @@ pa_rtpoll *pa_rtpoll_new(void) {
     p->pollfd = pa_xnew(struct pollfd, p->n_pollfd_alloc);
     p->pollfd2 = pa_xnew(struct pollfd, p->n_pollfd_alloc);
 
+    p->timer_fd = -1;
+
 #ifdef DEBUG_TIMING
     p->timestamp = pa_rtclock_now();
 #endif
@@ -112,9 +127,10 @@ static void rtpoll_rebuild(pa_rtpoll *p) {
 
     p->rebuild_needed = FALSE;
 
-    if (p->n_pollfd_used > p->n_pollfd_alloc) {
+    /* There's always room for the timerfd after the items' fds */
+    if (p->n_pollfd_used + 1 > p->n_pollfd_alloc) {
         /* Hmm, we have to allocate some more space */
-        p->n_pollfd_alloc = p->n_pollfd_used * 2;
+        p->n_pollfd_alloc = (p->n_pollfd_used + 1) * 2;
         p->pollfd2 = pa_xrealloc(p->pollfd2, p->n_pollfd_alloc * sizeof(struct pollfd));
         ra = 1;
     }
@@ -173,9 +189,63 @@ void pa_rtpoll_free(pa_rtpoll *p) {
     pa_xfree(p->pollfd);
     pa_xfree(p->pollfd2);
 
+    if (p->timer_fd >= 0)
+        pa_close(p->timer_fd);
+
     pa_xfree(p);
 }
 
+int pa_rtpoll_enable_timerfd(pa_rtpoll *p) {
+    pa_assert(p);
+
+    if (p->timer_fd >= 0)
+        return 0;
+
+#ifdef HAVE_TIMERFD
+    /* pa_rtclock_get() is based on CLOCK_MONOTONIC too */
+    if ((p->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC|TFD_NONBLOCK)) >= 0) {
+        pa_zero(p->timer_fd_elapse);
+        return 0;
+    }
+
+    pa_log_debug("timerfd_create() failed: %s", pa_cstrerror(errno));
+#endif
+
+    return -1;
+}
+
+#ifdef HAVE_TIMERFD
+/* Arms the timerfd for next_elapse, or disarms it */
+static void timer_fd_update(pa_rtpoll *p, pa_bool_t enabled) {
+    struct itimerspec its;
+    struct timeval elapse;
+
+    pa_zero(its);
+    pa_zero(elapse);
+
+    if (enabled) {
+        elapse = p->next_elapse;
+
+        /* A zero value would disarm it */
+        if (elapse.tv_sec == 0 && elapse.tv_usec == 0)
+            elapse.tv_usec = 1;
+
+        its.it_value.tv_sec = elapse.tv_sec;
+        its.it_value.tv_nsec = elapse.tv_usec * PA_NSEC_PER_USEC;
+    }
+
+    if (pa_timeval_cmp(&p->timer_fd_elapse, &elapse) == 0)
+        return;
+
+    if (timerfd_settime(p->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+        pa_log_error("timerfd_settime(): %s", pa_cstrerror(errno));
+        return;
+    }
+
+    p->timer_fd_elapse = elapse;
+}
+#endif
+
 static void reset_revents(pa_rtpoll_item *i) {
     struct pollfd *f;
     unsigned n;
@@ -207,6 +277,11 @@ int pa_rtpoll_run(pa_rtpoll *p, pa_bool_t wait_op) {
     pa_rtpoll_item *i;
     int r = 0;
     struct timeval timeout;
+    unsigned n_pollfd;
+    pa_bool_t use_timeout;
+#ifdef HAVE_TIMERFD
+    struct pollfd *timer_fd_pollfd = NULL;
+#endif
 
     pa_assert(p);
     pa_assert(!p->running);
@@ -282,10 +357,32 @@ int pa_rtpoll_run(pa_rtpoll *p, pa_bool_t wait_op) {
     if (p->rebuild_needed)
         rtpoll_rebuild(p);
 
+    n_pollfd = p->n_pollfd_used;
     pa_zero(timeout);
 
+    /* Whether poll() gets a timeout, otherwise it sleeps until an fd
+     * becomes ready */
+    use_timeout = !wait_op || p->quit || p->timer_enabled;
+
+#ifdef HAVE_TIMERFD
+    /* The deadline is handed to the kernel as it is, instead of being
+     * turned into a relative timeout that poll() rounds up */
+    if (p->timer_fd >= 0 && !use_timeout)
+        timer_fd_update(p, FALSE);
+    else if (p->timer_fd >= 0 && wait_op && !p->quit) {
+        timer_fd_update(p, TRUE);
+
+        p->pollfd[n_pollfd].fd = p->timer_fd;
+        p->pollfd[n_pollfd].events = POLLIN;
+        p->pollfd[n_pollfd].revents = 0;
+        timer_fd_pollfd = &p->pollfd[n_pollfd++];
+
+        use_timeout = FALSE;
+    }
+#endif
+
     /* Calculate timeout */
-    if (wait_op && !p->quit && p->timer_enabled) {
+    if (use_timeout && wait_op && !p->quit && p->timer_enabled) {
         struct timeval now;
         pa_rtclock_get(&now);
 
@@ -298,7 +395,7 @@ int pa_rtpoll_run(pa_rtpoll *p, pa_bool_t wait_op) {
         pa_usec_t now = pa_rtclock_now();
         p->awake = now - p->timestamp;
         p->timestamp = now;
-        if (!wait_op || p->quit || p->timer_enabled)
+        if (use_timeout)
             pa_log("poll timeout: %d ms ",(int) ((timeout.tv_sec*1000) + (timeout.tv_usec / 1000)));
         else
             pa_log("poll timeout is ZERO");
@@ -311,13 +408,37 @@ int pa_rtpoll_run(pa_rtpoll *p, pa_bool_t wait_op) {
         struct timespec ts;
         ts.tv_sec = timeout.tv_sec;
         ts.tv_nsec = timeout.tv_usec * 1000;
-        r = ppoll(p->pollfd, p->n_pollfd_used, (!wait_op || p->quit || p->timer_enabled) ? &ts : NULL, NULL);
+        r = ppoll(p->pollfd, n_pollfd, use_timeout ? &ts : NULL, NULL);
     }
 #else
-    r = pa_poll(p->pollfd, p->n_pollfd_used, (!wait_op || p->quit || p->timer_enabled) ? (int) ((timeout.tv_sec*1000) + (timeout.tv_usec / 1000)) : -1);
+    r = pa_poll(p->pollfd, n_pollfd, use_timeout ? (int) ((timeout.tv_sec*1000) + (timeout.tv_usec / 1000)) : -1);
 #endif
 
-    p->timer_elapsed = r == 0;
+#ifdef HAVE_TIMERFD
+    if (timer_fd_pollfd) {
+        p->timer_elapsed = r > 0 && (timer_fd_pollfd->revents & POLLIN);
+
+        if (p->timer_elapsed) {
+            uint64_t expirations;
+
+            /* Once expired it needs to be armed again even for the
+             * same deadline */
+            (void) pa_read(p->timer_fd, &expirations, sizeof(expirations), NULL);
+            pa_zero(p->timer_fd_elapse);
+        }
+    } else
+#endif
+        p->timer_elapsed = r == 0;
+
+    if (p->timer_elapsed && p->lateness) {
+        pa_usec_t now, elapse;
+
+        now = pa_rtclock_now();
+        elapse = pa_timeval_load(&p->next_elapse);
+
+        /* poll() rounds the timeout, so we might even be early */
+        pa_histogram_add(p->lateness, now > elapse ? now - elapse : 0);
+    }
 
 #ifdef DEBUG_TIMING
     {
@@ -631,6 +752,15 @@ void pa_rtpoll_quit(pa_rtpoll *p) {
     p->quit = TRUE;
 }
 
+void pa_rtpoll_set_lateness_histogram(pa_rtpoll *p, pa_histogram *h) {
+    pa_assert(p);
+
+    /* Several sinks and sources may share an rtpoll, the first one
+     * gets the numbers */
+    if (!h || !p->lateness)
+        p->lateness = h;
+}
+
 pa_bool_t pa_rtpoll_timer_elapsed(pa_rtpoll *p) {
     pa_assert(p);
 
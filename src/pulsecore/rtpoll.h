@@ -28,6 +28,7 @@
 #include <pulse/sample.h>
 #include <pulsecore/asyncmsgq.h>
 #include <pulsecore/fdsem.h>
+#include <pulsecore/histogram.h>
 #include <pulsecore/macro.h>
 
 /* An implementation of a "real-time" poll loop. Basically, this is
@@ -71,6 +72,15 @@ void pa_rtpoll_set_timer_disabled(pa_rtpoll *p);
  * the last pa_rtpoll_run() invocation to finish */
 pa_bool_t pa_rtpoll_timer_elapsed(pa_rtpoll *p);
 
+/* Wake up for the timer via a timerfd armed with the absolute
+ * deadline, instead of a poll() timeout that is relative and rounded.
+ * Returns negative if timerfds are not available. */
+int pa_rtpoll_enable_timerfd(pa_rtpoll *p);
+
+/* Account in h how late each wakeup for the timer was. Only the first
+ * histogram set is used, pass NULL to reset. */
+void pa_rtpoll_set_lateness_histogram(pa_rtpoll *p, pa_histogram *h);
+
 /* A new fd wakeup item for pa_rtpoll */
 pa_rtpoll_item *pa_rtpoll_item_new(pa_rtpoll *p, pa_rtpoll_priority_t prio, unsigned n_fds);
 void pa_rtpoll_item_free(pa_rtpoll_item *i);
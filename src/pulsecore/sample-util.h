@@ -85,6 +85,23 @@ typedef void (*pa_do_volume_func_t) (void *samples, const void *volumes, unsigne
 pa_do_volume_func_t pa_get_volume_func(pa_sample_format_t f);
 void pa_set_volume_func(pa_sample_format_t f, pa_do_volume_func_t func);
 
+typedef enum pa_volume_ramp_type {
+    PA_VOLUME_RAMP_LINEAR,      /* The gain changes by a fixed amount per frame */
+    PA_VOLUME_RAMP_LOGARITHMIC, /* The gain changes by a fixed factor per frame, i.e. linearly in dB */
+    PA_VOLUME_RAMP_MAX
+} pa_volume_ramp_type_t;
+
+/* Multiplies the samples of each frame with the gains of their channels
+ * and then moves the gains on by one step, i.e. adds the steps for
+ * linear ramps and multiplies with them for logarithmic ones. The
+ * gains are linear factors and are left at where the next frame would
+ * start. length is in bytes. */
+typedef void (*pa_do_volume_ramp_func_t) (void *samples, float *gains, const float *steps, unsigned channels, unsigned length);
+
+/* Returns NULL for formats without ramp functions */
+pa_do_volume_ramp_func_t pa_get_volume_ramp_func(pa_sample_format_t f, pa_volume_ramp_type_t t);
+void pa_set_volume_ramp_func(pa_sample_format_t f, pa_volume_ramp_type_t t, pa_do_volume_ramp_func_t func);
+
 size_t pa_convert_size(size_t size, const pa_sample_spec *from, const pa_sample_spec *to);
 
 #define PA_CHANNEL_POSITION_MASK_LEFT                                   \
@@ -39,6 +39,10 @@
 #include <sys/mman.h>
 #endif
 
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+
 /* This is deprecated on glibc but is still used by FreeBSD */
 #if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
 # define MAP_ANONYMOUS MAP_ANON
@@ -77,6 +81,35 @@
 #undef SHM_ID_LEN
 #endif
 
+#if defined(__linux__) && defined(SYS_memfd_create)
+#define HAVE_MEMFD 1
+
+/* Older kernel and libc headers may lack these */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS (1024 + 9)
+#define F_GET_SEALS (1024 + 10)
+#endif
+#ifndef F_SEAL_SEAL
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+/* The segment may not change its size after it has been handed out,
+ * so that mapping it is safe without trapping SIGBUS */
+#define MEMFD_SEALS (F_SEAL_SHRINK|F_SEAL_GROW|F_SEAL_SEAL)
+
+static int memfd_create_wrap(const char *name, unsigned flags) {
+    return (int) syscall(SYS_memfd_create, name, flags);
+}
+#endif
+
 #define SHM_MARKER ((int) 0xbeefcafe)
 
 /* We now put this SHM marker at the end of each segment. It's
@@ -121,6 +154,9 @@ int pa_shm_create_rw(pa_shm *m, size_t size, pa_bool_t shared, mode_t mode) {
     /* Round up to make it page aligned */
     size = PA_PAGE_ALIGN(size);
 
+    m->fd = -1;
+    m->memfd = FALSE;
+
     if (!shared) {
         m->id = 0;
         m->size = size;
@@ -220,6 +256,11 @@ void pa_shm_free(pa_shm *m) {
 #else
         pa_xfree(m->ptr);
 #endif
+    } else if (m->memfd) {
+        if (munmap(m->ptr, PA_PAGE_ALIGN(m->size)) < 0)
+            pa_log("munmap() failed: %s", pa_cstrerror(errno));
+
+        pa_assert_se(pa_close(m->fd) == 0);
     } else {
 #ifdef HAVE_SHM_OPEN
         if (munmap(m->ptr, PA_PAGE_ALIGN(m->size)) < 0)
@@ -297,6 +338,9 @@ int pa_shm_attach_ro(pa_shm *m, unsigned id) {
 
     pa_assert(m);
 
+    m->fd = -1;
+    m->memfd = FALSE;
+
     segment_name(fn, sizeof(fn), m->id = id);
 
     if ((fd = shm_open(fn, O_RDONLY, 0)) < 0) {
@@ -346,6 +390,124 @@ int pa_shm_attach_ro(pa_shm *m, unsigned id) {
 
 #endif /* HAVE_SHM_OPEN */
 
+#ifdef HAVE_MEMFD
+
+int pa_shm_create_memfd(pa_shm *m, size_t size) {
+    int fd = -1;
+
+    pa_assert(m);
+    pa_assert(size > 0);
+    pa_assert(size <= MAX_SHM_SIZE);
+
+    size = PA_PAGE_ALIGN(size);
+
+    if ((fd = memfd_create_wrap("pulseaudio", MFD_CLOEXEC|MFD_ALLOW_SEALING)) < 0) {
+        pa_log("memfd_create() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    if (ftruncate(fd, (off_t) size) < 0) {
+        pa_log("ftruncate() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    if (fcntl(fd, F_ADD_SEALS, MEMFD_SEALS) < 0) {
+        pa_log("fcntl(F_ADD_SEALS) failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+    if ((m->ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_NORESERVE, fd, (off_t) 0)) == MAP_FAILED) {
+        pa_log("mmap() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    /* The ID is only used to refer to the segment on the wire, there
+     * is no name to collide with */
+    pa_random(&m->id, sizeof(m->id));
+    m->size = size;
+    m->fd = fd;
+    m->do_unlink = FALSE;
+    m->shared = TRUE;
+    m->memfd = TRUE;
+
+    return 0;
+
+fail:
+    if (fd >= 0)
+        pa_close(fd);
+
+    return -1;
+}
+
+int pa_shm_attach_memfd(pa_shm *m, unsigned id, int fd, pa_bool_t writable) {
+    struct stat st;
+    int seals;
+
+    pa_assert(m);
+    pa_assert(fd >= 0);
+
+    /* Only accept segments that the creator can't shrink under our
+     * feet anymore */
+    if ((seals = fcntl(fd, F_GET_SEALS)) < 0) {
+        pa_log("fcntl(F_GET_SEALS) failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    if ((seals & MEMFD_SEALS) != MEMFD_SEALS) {
+        pa_log("Shared memory segment is not sealed");
+        goto fail;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        pa_log("fstat() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    if (st.st_size <= 0 ||
+        st.st_size > (off_t) MAX_SHM_SIZE ||
+        PA_ALIGN((size_t) st.st_size) != (size_t) st.st_size) {
+        pa_log("Invalid shared memory segment size");
+        goto fail;
+    }
+
+    m->size = (size_t) st.st_size;
+
+    if ((m->ptr = mmap(NULL, PA_PAGE_ALIGN(m->size), writable ? PROT_READ|PROT_WRITE : PROT_READ, MAP_SHARED, fd, (off_t) 0)) == MAP_FAILED) {
+        pa_log("mmap() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    m->id = id;
+    m->fd = fd;
+    m->do_unlink = FALSE;
+    m->shared = TRUE;
+    m->memfd = TRUE;
+
+    return 0;
+
+fail:
+    pa_close(fd);
+
+    return -1;
+}
+
+#else /* HAVE_MEMFD */
+
+int pa_shm_create_memfd(pa_shm *m, size_t size) {
+    return -1;
+}
+
+int pa_shm_attach_memfd(pa_shm *m, unsigned id, int fd, pa_bool_t writable) {
+    pa_close(fd);
+    return -1;
+}
+
+#endif /* HAVE_MEMFD */
+
 int pa_shm_cleanup(void) {
 
 #ifdef HAVE_SHM_OPEN
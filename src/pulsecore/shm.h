@@ -30,13 +30,25 @@ typedef struct pa_shm {
     unsigned id;
     void *ptr;
     size_t size;
+    int fd;
     pa_bool_t do_unlink:1;
     pa_bool_t shared:1;
+    pa_bool_t memfd:1;
 } pa_shm;
 
 int pa_shm_create_rw(pa_shm *m, size_t size, pa_bool_t shared, mode_t mode);
 int pa_shm_attach_ro(pa_shm *m, unsigned id);
 
+/* Segments backed by an anonymous memfd instead of a named POSIX SHM
+ * object. They are sealed against resizing, keep their fd open and
+ * can only be shared by passing that fd to the other side, which then
+ * attaches with pa_shm_attach_memfd(), which takes over the fd even
+ * on failure. The memory is gone as soon as the last mapping and fd
+ * are closed. Segments are attached read-only unless writable is
+ * TRUE. */
+int pa_shm_create_memfd(pa_shm *m, size_t size);
+int pa_shm_attach_memfd(pa_shm *m, unsigned id, int fd, pa_bool_t writable);
+
 void pa_shm_punch(pa_shm *m, size_t offset, size_t size);
 
 void pa_shm_free(pa_shm *m);
@@ -0,0 +1,369 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/shm.h>
+#include <pulsecore/log.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/macro.h>
+
+#include "shmring.h"
+
+/* The two indexes live in separate cache lines at the start of the
+ * segment, the frames follow. The indexes count bytes and wrap around
+ * at 2^32, the ring size is a power of two below that. */
+#define CONTROL_SIZE 128
+#define WRITE_INDEX_OFFSET 0
+#define READ_INDEX_OFFSET 64
+
+/* Frames start at multiples of the header size, so that there is
+ * always room for a header at the end of the ring */
+#define FRAME_ALIGN sizeof(pa_shmring_frame)
+#define FRAME_SIZE(length) ((sizeof(pa_shmring_frame) + (size_t) (length) + FRAME_ALIGN - 1) & ~(FRAME_ALIGN - 1))
+
+/* Fills the rest of the ring up to its end, the next frame starts at
+ * the beginning again */
+#define FRAME_TYPE_PAD 0xFFFFFFFFU
+
+#define SIZE_MIN (4U*1024U)
+#define SIZE_MAX_ALLOW (16U*1024U*1024U)
+
+struct pa_shmring {
+    pa_shm memory;
+    pa_bool_t writer;
+
+    uint8_t *frames;
+    uint32_t size;
+
+    pa_atomic_t *write_index;
+    pa_atomic_t *read_index;
+
+    /* Our own copies of the indexes we own, the ones in the segment
+     * might have been fiddled with by the other side */
+    uint32_t index;
+    uint32_t read_index_local;
+
+    /* Size of the frame last returned by pa_shmring_peek() */
+    size_t peeked;
+
+    int event_fd;
+};
+
+static void setup(pa_shmring *r, uint32_t size) {
+    r->frames = (uint8_t*) r->memory.ptr + CONTROL_SIZE;
+    r->size = size;
+    r->write_index = (pa_atomic_t*) ((uint8_t*) r->memory.ptr + WRITE_INDEX_OFFSET);
+    r->read_index = (pa_atomic_t*) ((uint8_t*) r->memory.ptr + READ_INDEX_OFFSET);
+    r->index = r->read_index_local = 0;
+    r->peeked = 0;
+}
+
+pa_shmring* pa_shmring_new(size_t size) {
+#ifdef HAVE_SYS_EVENTFD_H
+    pa_shmring *r;
+    size_t s;
+
+    pa_assert(size > 0);
+
+    size = PA_CLAMP_UNLIKELY(size, SIZE_MIN, SIZE_MAX_ALLOW);
+
+    for (s = SIZE_MIN; s < size; s <<= 1)
+        ;
+
+    r = pa_xnew0(pa_shmring, 1);
+    r->writer = TRUE;
+
+    if ((r->event_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK)) < 0) {
+        pa_log("eventfd() failed: %s", pa_cstrerror(errno));
+        pa_xfree(r);
+        return NULL;
+    }
+
+    if (pa_shm_create_memfd(&r->memory, CONTROL_SIZE + s) < 0) {
+        pa_close(r->event_fd);
+        pa_xfree(r);
+        return NULL;
+    }
+
+    setup(r, (uint32_t) s);
+
+    pa_atomic_store(r->write_index, 0);
+    pa_atomic_store(r->read_index, 0);
+
+    return r;
+#else
+    return NULL;
+#endif
+}
+
+pa_shmring* pa_shmring_attach(int memfd, int event_fd, size_t size) {
+    pa_shmring *r;
+
+    pa_assert(memfd >= 0);
+    pa_assert(event_fd >= 0);
+
+    r = pa_xnew0(pa_shmring, 1);
+    r->writer = FALSE;
+    r->event_fd = event_fd;
+
+    pa_make_fd_nonblock(r->event_fd);
+
+    /* The reader stores its index in the segment, hence writable */
+    if (pa_shm_attach_memfd(&r->memory, 0, memfd, TRUE) < 0)
+        goto fail;
+
+    /* Page alignment might have grown the segment, hence it may be
+     * larger than the ring */
+    if (size < SIZE_MIN || size > SIZE_MAX_ALLOW || (size & (size - 1)) != 0) {
+        pa_log("Invalid ring buffer size %lu.", (unsigned long) size);
+        pa_shm_free(&r->memory);
+        goto fail;
+    }
+
+    if (r->memory.size < CONTROL_SIZE + size) {
+        pa_log("Ring buffer segment too small.");
+        pa_shm_free(&r->memory);
+        goto fail;
+    }
+
+    setup(r, (uint32_t) size);
+
+    /* The writer might have pushed frames already. If it lied about
+     * where we start we'll notice in pa_shmring_peek() */
+    r->read_index_local = (uint32_t) pa_atomic_load(r->read_index);
+
+    return r;
+
+fail:
+    pa_close(r->event_fd);
+    pa_xfree(r);
+
+    return NULL;
+}
+
+void pa_shmring_free(pa_shmring *r) {
+    pa_assert(r);
+
+    pa_shm_free(&r->memory);
+    pa_close(r->event_fd);
+    pa_xfree(r);
+}
+
+size_t pa_shmring_get_size(pa_shmring *r) {
+    pa_assert(r);
+
+    return r->size;
+}
+
+int pa_shmring_get_memfd(pa_shmring *r) {
+    pa_assert(r);
+
+    return r->memory.fd;
+}
+
+int pa_shmring_get_eventfd(pa_shmring *r) {
+    pa_assert(r);
+
+    return r->event_fd;
+}
+
+/* Free space in total and until the end of the ring */
+static void get_space(pa_shmring *r, uint32_t *total, uint32_t *contiguous) {
+    uint32_t used;
+
+    used = r->index - (uint32_t) pa_atomic_load(r->read_index);
+    *total = used <= r->size ? r->size - used : 0;
+    *contiguous = r->size - (r->index & (r->size - 1));
+}
+
+size_t pa_shmring_push_max(pa_shmring *r) {
+    uint32_t total, contiguous, n, wrapped;
+
+    pa_assert(r);
+    pa_assert(r->writer);
+
+    get_space(r, &total, &contiguous);
+
+    /* Either the frame fits before the end of the ring, or we pad up
+     * to the end and put it at the beginning */
+    n = PA_MIN(total, contiguous);
+    wrapped = total > contiguous ? total - contiguous : 0;
+    n = PA_MAX(n, wrapped);
+
+    return n >= sizeof(pa_shmring_frame) ? n - sizeof(pa_shmring_frame) : 0;
+}
+
+static void write_header(pa_shmring *r, uint32_t idx, uint32_t type, int64_t offset, uint32_t length) {
+    pa_shmring_frame f;
+
+    f.length = length;
+    f.type = type;
+    f.offset = offset;
+
+    memcpy(r->frames + (idx & (r->size - 1)), &f, sizeof(f));
+}
+
+int pa_shmring_push(pa_shmring *r, uint32_t type, int64_t offset, const void *data, size_t length) {
+    uint32_t total, contiguous, pad = 0, old_index;
+    size_t frame_size;
+
+    pa_assert(r);
+    pa_assert(r->writer);
+    pa_assert(type < PA_SHMRING_TYPE_MAX);
+    pa_assert(data || length == 0);
+
+    if (length > r->size)
+        return -1;
+
+    frame_size = FRAME_SIZE(length);
+    get_space(r, &total, &contiguous);
+
+    if (frame_size > contiguous)
+        pad = contiguous;
+
+    if (pad + frame_size > total)
+        return -1;
+
+    old_index = r->index;
+
+    if (pad > 0) {
+        write_header(r, r->index, FRAME_TYPE_PAD, 0, pad - (uint32_t) sizeof(pa_shmring_frame));
+        r->index += pad;
+    }
+
+    write_header(r, r->index, type, offset, (uint32_t) length);
+
+    if (length > 0)
+        memcpy(r->frames + (r->index & (r->size - 1)) + sizeof(pa_shmring_frame), data, length);
+
+    r->index += (uint32_t) frame_size;
+
+    /* The atomic operations imply full barriers, so the frame is in
+     * place before the reader can see the index, and the reader either
+     * sees the new index on its last check or we see that it caught
+     * up with the old one and wake it up */
+    pa_atomic_store(r->write_index, (int) r->index);
+
+    if ((uint32_t) pa_atomic_load(r->read_index) == old_index) {
+#ifdef HAVE_SYS_EVENTFD_H
+        uint64_t u = 1;
+
+        if (pa_write(r->event_fd, &u, sizeof(u), NULL) != sizeof(u) && errno != EAGAIN)
+            pa_log_warn("Failed to signal ring buffer reader: %s", pa_cstrerror(errno));
+#endif
+    }
+
+    return 0;
+}
+
+int pa_shmring_peek(pa_shmring *r, pa_shmring_frame *f, const void **data) {
+    uint32_t avail;
+
+    pa_assert(r);
+    pa_assert(f);
+    pa_assert(data);
+
+    for (;;) {
+        uint32_t contiguous;
+        size_t frame_size;
+
+        avail = (uint32_t) pa_atomic_load(r->write_index) - r->read_index_local;
+
+        if (avail == 0)
+            return 0;
+
+        if (avail > r->size || (avail % FRAME_ALIGN) != 0) {
+            pa_log_warn("Ring buffer write index out of range.");
+            return -1;
+        }
+
+        contiguous = r->size - (r->read_index_local & (r->size - 1));
+        memcpy(f, r->frames + (r->read_index_local & (r->size - 1)), sizeof(*f));
+
+        if (f->type == FRAME_TYPE_PAD) {
+
+            if (f->length != contiguous - sizeof(pa_shmring_frame) || avail < contiguous) {
+                pa_log_warn("Invalid padding in ring buffer.");
+                return -1;
+            }
+
+            r->read_index_local += contiguous;
+            pa_atomic_store(r->read_index, (int) r->read_index_local);
+            continue;
+        }
+
+        if (f->type >= PA_SHMRING_TYPE_MAX || f->length > r->size) {
+            pa_log_warn("Invalid frame header in ring buffer.");
+            return -1;
+        }
+
+        frame_size = FRAME_SIZE(f->length);
+
+        if (frame_size > contiguous || frame_size > avail) {
+            pa_log_warn("Frame exceeds ring buffer contents.");
+            return -1;
+        }
+
+        *data = r->frames + (r->read_index_local & (r->size - 1)) + sizeof(pa_shmring_frame);
+        r->peeked = frame_size;
+
+        return 1;
+    }
+}
+
+void pa_shmring_drop(pa_shmring *r) {
+    pa_assert(r);
+    pa_assert(r->peeked > 0);
+
+    r->read_index_local += (uint32_t) r->peeked;
+    r->peeked = 0;
+
+    pa_atomic_store(r->read_index, (int) r->read_index_local);
+}
+
+int pa_shmring_after_event(pa_shmring *r) {
+    uint64_t u;
+    ssize_t n;
+
+    pa_assert(r);
+    pa_assert(!r->writer);
+
+    if ((n = pa_read(r->event_fd, &u, sizeof(u), NULL)) == sizeof(u))
+        return 0;
+
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return 0;
+
+    return -1;
+}
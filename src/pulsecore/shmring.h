@@ -0,0 +1,85 @@
+#ifndef foopulseshmringhfoo
+#define foopulseshmringhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+#include <pulsecore/macro.h>
+
+/* A single producer, single consumer ring buffer of frames in a memfd
+ * segment, for passing data between two processes without going
+ * through a socket. The writer creates the ring and an eventfd which
+ * is signalled whenever a frame is pushed into a ring the reader had
+ * completely emptied. Both fds and the size of the ring are handed to
+ * the reader, which attaches with pa_shmring_attach().
+ *
+ * The reader does not trust anything the writer put into the shared
+ * memory: the frame headers are validated and copied before use, and
+ * the payload may change under its feet until it has been copied
+ * out. pa_shmring_peek() returns -1 once the ring has been found
+ * inconsistent. */
+
+typedef struct pa_shmring pa_shmring;
+
+typedef struct pa_shmring_frame {
+    uint32_t length;
+    uint32_t type;
+    int64_t offset;
+} pa_shmring_frame;
+
+/* Writer side. size is the number of bytes for frames and is rounded
+ * up to a power of two. */
+pa_shmring* pa_shmring_new(size_t size);
+
+/* The rounded up size, to be passed to pa_shmring_attach() */
+size_t pa_shmring_get_size(pa_shmring *r);
+int pa_shmring_get_memfd(pa_shmring *r);
+int pa_shmring_get_eventfd(pa_shmring *r);
+
+/* The largest payload a frame pushed right now may carry */
+size_t pa_shmring_push_max(pa_shmring *r);
+
+/* Returns -1 if the frame does not fit. type must be below
+ * PA_SHMRING_TYPE_MAX. */
+int pa_shmring_push(pa_shmring *r, uint32_t type, int64_t offset, const void *data, size_t length);
+
+#define PA_SHMRING_TYPE_MAX 0xFFFF0000U
+
+/* Reader side, takes over both fds even on failure. Fails if size
+ * isn't one pa_shmring_new() could have picked or the segment is too
+ * small for it. */
+pa_shmring* pa_shmring_attach(int memfd, int event_fd, size_t size);
+
+/* Returns 1 and the next frame if there is one, 0 if the ring is
+ * empty and -1 if it is corrupt. The frame stays in the ring until
+ * pa_shmring_drop() is called. The writer may use these too, to take
+ * back the frames of a ring no reader ever attached to. */
+int pa_shmring_peek(pa_shmring *r, pa_shmring_frame *f, const void **data);
+void pa_shmring_drop(pa_shmring *r);
+
+/* To be called when the eventfd became readable. Returns -1 if
+ * reading it didn't go as expected for an eventfd. */
+int pa_shmring_after_event(pa_shmring *r);
+
+void pa_shmring_free(pa_shmring *r);
+
+#endif
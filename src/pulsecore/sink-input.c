@@ -28,6 +28,7 @@
 #include <stdlib.h>
 
 #include <pulse/utf8.h>
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
 #include <pulse/internal.h>
@@ -53,6 +54,12 @@ struct volume_factor_entry {
     pa_cvolume volume;
 };
 
+struct volume_ramp_request {
+    pa_volume_t volume;
+    pa_usec_t duration;
+    pa_volume_ramp_type_t type;
+};
+
 static struct volume_factor_entry *volume_factor_entry_new(const char *key, const pa_cvolume *volume) {
     struct volume_factor_entry *entry;
 
@@ -547,6 +554,9 @@ int pa_sink_input_new(
     i->thread_info.underrun_for = (uint64_t) -1;
     i->thread_info.underrun_for_sink = 0;
     i->thread_info.playing_for = 0;
+    pa_volume_ramp_reset(&i->thread_info.ramp, PA_VOLUME_NORM);
+    i->thread_info.ramp_start_index = 0;
+    i->thread_info.ramp_pending = FALSE;
     i->thread_info.direct_outputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
 
     pa_assert_se(pa_idxset_put(core->sink_inputs, i, &i->index) == 0);
@@ -641,7 +651,7 @@ static void sink_input_set_state(pa_sink_input *i, pa_sink_input_state_t state)
             pa_hook_fire(&i->core->hooks[PA_CORE_HOOK_SINK_INPUT_STATE_CHANGED], ssync);
 
         if (PA_SINK_INPUT_IS_LINKED(state))
-            pa_subscription_post(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index);
+            pa_subscription_post_fields(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index, PA_SUBSCRIPTION_FIELD_STATE);
     }
 
     pa_sink_update_status(i->sink);
@@ -840,10 +850,56 @@ pa_usec_t pa_sink_input_get_latency(pa_sink_input *i, pa_usec_t *sink_latency) {
     return r[0];
 }
 
+/* Called from thread context. The frame of the volume ramp that is
+ * rendered at index of render_memblockq. */
+static size_t ramp_frame(pa_sink_input *i, int64_t index) {
+    index -= i->thread_info.ramp_start_index;
+
+    return index > 0 ? (size_t) index / pa_frame_size(&i->sink->sample_spec) : 0;
+}
+
+/* Called from thread context. Starts a pending ramp at the next frame
+ * we render, at the gain the previous ramp has there. */
+static void volume_ramp_start(pa_sink_input *i) {
+    int64_t index;
+
+    if (!i->thread_info.ramp_pending)
+        return;
+
+    index = pa_memblockq_get_write_index(i->thread_info.render_memblockq);
+
+    pa_volume_ramp_init(&i->thread_info.ramp, i->thread_info.ramp_pending_type,
+                        pa_volume_ramp_get_gain(&i->thread_info.ramp, ramp_frame(i, index)),
+                        i->thread_info.ramp_pending_target,
+                        i->thread_info.ramp_pending_length);
+    i->thread_info.ramp_start_index = index;
+    i->thread_info.ramp_pending = FALSE;
+}
+
+/* Called from thread context. Skips to the end of the ramps, the
+ * pending one included. */
+static void volume_ramp_finish(pa_sink_input *i) {
+    pa_volume_ramp_reset(&i->thread_info.ramp, i->thread_info.ramp_pending ? i->thread_info.ramp_pending_target : i->thread_info.ramp.target);
+    i->thread_info.ramp_start_index = 0;
+    i->thread_info.ramp_pending = FALSE;
+}
+
+/* Called from thread context */
+static void volume_ramp_memchunk(pa_sink_input *i, pa_memchunk *chunk) {
+
+    if (pa_memblock_is_silence(chunk->memblock))
+        return;
+
+    pa_memchunk_make_writable(chunk, 0);
+    pa_volume_ramp_memchunk(chunk, &i->sink->sample_spec, &i->thread_info.ramp,
+                            ramp_frame(i, pa_memblockq_get_write_index(i->thread_info.render_memblockq)));
+}
+
 /* Called from thread context */
 void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa_memchunk *chunk, pa_cvolume *volume) {
     pa_bool_t do_volume_adj_here, need_volume_factor_sink;
-    pa_bool_t volume_is_norm;
+    pa_bool_t volume_is_norm, ramping;
+    pa_cvolume volume_factor_sink;
     size_t block_size_max_sink, block_size_max_sink_input;
     size_t ilength;
     size_t ilength_full;
@@ -893,7 +949,20 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
 
     do_volume_adj_here = !pa_channel_map_equal(&i->channel_map, &i->sink->channel_map);
     volume_is_norm = pa_cvolume_is_norm(&i->thread_info.soft_volume) && !i->thread_info.muted;
-    need_volume_factor_sink = !pa_cvolume_is_norm(&i->volume_factor_sink);
+
+    /* A ramp whose rewind never came starts right here */
+    volume_ramp_start(i);
+
+    /* Once the ramp is over its volume is merged into the sink volume
+     * factor and costs nothing extra */
+    ramping = ramp_frame(i, pa_memblockq_get_write_index(i->thread_info.render_memblockq)) < i->thread_info.ramp.length;
+
+    if (!ramping && i->thread_info.ramp.target != PA_VOLUME_NORM)
+        pa_sw_cvolume_multiply_scalar(&volume_factor_sink, &i->volume_factor_sink, i->thread_info.ramp.target);
+    else
+        volume_factor_sink = i->volume_factor_sink;
+
+    need_volume_factor_sink = !pa_cvolume_is_norm(&volume_factor_sink);
 
     while (!pa_memblockq_is_readable(i->thread_info.render_memblockq)) {
         pa_memchunk tchunk;
@@ -929,6 +998,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
         while (tchunk.length > 0) {
             pa_memchunk wchunk;
             pa_bool_t nvfs = need_volume_factor_sink;
+            pa_bool_t silent;
 
             wchunk = tchunk;
             pa_memblock_ref(wchunk.memblock);
@@ -936,8 +1006,16 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
             if (wchunk.length > block_size_max_sink_input)
                 wchunk.length = block_size_max_sink_input;
 
+            /* Silence stays silence whatever the volume, and making it
+             * writable would only copy it into a block that isn't
+             * known to be silent anymore. The volume factor of the
+             * sink is applied after resampling though, and the
+             * resampler may still ring out the previous data. */
+            if ((silent = pa_memblock_is_silence(wchunk.memblock)) && do_volume_adj_here && !volume_is_norm)
+                pa_atomic_inc(&i->sink->io_stats.silent_volume_skips);
+
             /* It might be necessary to adjust the volume here */
-            if (do_volume_adj_here && !volume_is_norm) {
+            if (do_volume_adj_here && !volume_is_norm && !silent) {
                 pa_memchunk_make_writable(&wchunk, 0);
 
                 if (i->thread_info.muted) {
@@ -950,7 +1028,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
                     /* If we don't need a resampler we can merge the
                      * post and the pre volume adjustment into one */
 
-                    pa_sw_cvolume_multiply(&v, &i->thread_info.soft_volume, &i->volume_factor_sink);
+                    pa_sw_cvolume_multiply(&v, &i->thread_info.soft_volume, &volume_factor_sink);
                     pa_volume_memchunk(&wchunk, &i->thread_info.sample_spec, &v);
                     nvfs = FALSE;
 
@@ -960,15 +1038,27 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
 
             if (!i->thread_info.resampler) {
 
+                if (nvfs && silent) {
+                    pa_atomic_inc(&i->sink->io_stats.silent_volume_skips);
+                    nvfs = FALSE;
+                }
+
                 if (nvfs) {
                     pa_memchunk_make_writable(&wchunk, 0);
-                    pa_volume_memchunk(&wchunk, &i->sink->sample_spec, &i->volume_factor_sink);
+                    pa_volume_memchunk(&wchunk, &i->sink->sample_spec, &volume_factor_sink);
                 }
 
+                if (ramping)
+                    volume_ramp_memchunk(i, &wchunk);
+
                 pa_memblockq_push_align(i->thread_info.render_memblockq, &wchunk);
             } else {
                 pa_memchunk rchunk;
+                pa_usec_t start;
+
+                start = pa_rtclock_now();
                 pa_resampler_run(i->thread_info.resampler, &wchunk, &rchunk);
+                i->thread_info.convert_time += pa_rtclock_now() - start;
 
 #ifdef SINK_INPUT_DEBUG
                 pa_log_debug("pushing %lu", (unsigned long) rchunk.length);
@@ -976,11 +1066,22 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
 
                 if (rchunk.memblock) {
 
+                    if (silent && pa_memblock_is_silence(rchunk.memblock))
+                        pa_atomic_inc(&i->sink->io_stats.silent_resample_skips);
+
+                    if (nvfs && pa_memblock_is_silence(rchunk.memblock)) {
+                        pa_atomic_inc(&i->sink->io_stats.silent_volume_skips);
+                        nvfs = FALSE;
+                    }
+
                     if (nvfs) {
                         pa_memchunk_make_writable(&rchunk, 0);
-                        pa_volume_memchunk(&rchunk, &i->sink->sample_spec, &i->volume_factor_sink);
+                        pa_volume_memchunk(&rchunk, &i->sink->sample_spec, &volume_factor_sink);
                     }
 
+                    if (ramping)
+                        volume_ramp_memchunk(i, &rchunk);
+
                     pa_memblockq_push_align(i->thread_info.render_memblockq, &rchunk);
                     pa_memblock_unref(rchunk.memblock);
                 }
@@ -1126,6 +1227,10 @@ void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sam
     i->thread_info.rewrite_nbytes = 0;
     i->thread_info.rewrite_flush = FALSE;
     i->thread_info.dont_rewind_render = FALSE;
+
+    /* Now that we know how far we were rewound, that's where a new
+     * ramp starts */
+    volume_ramp_start(i);
 }
 
 /* Called from thread context */
@@ -1289,7 +1394,7 @@ void pa_sink_input_set_volume(pa_sink_input *i, const pa_cvolume *volume, pa_boo
         i->volume_changed(i);
 
     /* The virtual volume changed, let's tell people so */
-    pa_subscription_post(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index);
+    pa_subscription_post_fields(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index, PA_SUBSCRIPTION_FIELD_VOLUME);
 }
 
 void pa_sink_input_add_volume_factor(pa_sink_input *i, const char *key, const pa_cvolume *volume_factor) {
@@ -1348,6 +1453,27 @@ void pa_sink_input_remove_volume_factor(pa_sink_input *i, const char *key) {
     pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME, NULL, 0, NULL) == 0);
 }
 
+/* Called from main context */
+void pa_sink_input_set_volume_ramp(pa_sink_input *i, pa_volume_t volume, pa_usec_t duration, pa_volume_ramp_type_t type) {
+    struct volume_ramp_request r;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_ctl_context();
+    pa_assert(PA_SINK_INPUT_IS_LINKED(i->state));
+    pa_assert(PA_VOLUME_IS_VALID(volume));
+    pa_assert(type < PA_VOLUME_RAMP_MAX);
+
+    /* Like the other volumes this makes no sense for compressed data */
+    if (pa_sink_input_is_passthrough(i))
+        return;
+
+    r.volume = volume;
+    r.duration = duration;
+    r.type = type;
+
+    pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_VOLUME_RAMP, &r, 0, NULL) == 0);
+}
+
 /* Called from main context */
 static void set_real_ratio(pa_sink_input *i, const pa_cvolume *v) {
     pa_sink_input_assert_ref(i);
@@ -1425,7 +1551,7 @@ void pa_sink_input_set_mute(pa_sink_input *i, pa_bool_t mute, pa_bool_t save) {
     if (i->mute_changed)
         i->mute_changed(i);
 
-    pa_subscription_post(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index);
+    pa_subscription_post_fields(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index, PA_SUBSCRIPTION_FIELD_MUTE);
 }
 
 /* Called from main context */
@@ -1692,7 +1818,7 @@ static void update_volume_due_to_moving(pa_sink_input *i, pa_sink *dest) {
                 if (i->volume_changed)
                     i->volume_changed(i);
 
-                pa_subscription_post(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index);
+                pa_subscription_post_fields(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index, PA_SUBSCRIPTION_FIELD_VOLUME);
             }
         }
 
@@ -1768,7 +1894,7 @@ static void update_volume_due_to_moving(pa_sink_input *i, pa_sink *dest) {
             if (i->volume_changed)
                 i->volume_changed(i);
 
-            pa_subscription_post(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index);
+            pa_subscription_post_fields(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index, PA_SUBSCRIPTION_FIELD_VOLUME);
         }
     }
 
@@ -1826,6 +1952,11 @@ int pa_sink_input_finish_move(pa_sink_input *i, pa_sink *dest, pa_bool_t save) {
 
     pa_cvolume_remap(&i->volume_factor_sink, &i->channel_map, &i->sink->channel_map);
 
+    /* We're not attached to any IO thread right now. A ramp that is
+     * still going on wouldn't line up with the data of the new sink,
+     * so let's just skip to its end. */
+    volume_ramp_finish(i);
+
     if (pa_sink_input_get_state(i) == PA_SINK_INPUT_CORKED)
         i->sink->n_corked++;
 
@@ -1965,6 +2096,22 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
             }
             return 0;
 
+        case PA_SINK_INPUT_MESSAGE_SET_VOLUME_RAMP: {
+            struct volume_ramp_request *r = userdata;
+
+            /* Where we are playing right now is only known once the
+             * sink has processed the rewind, the read index of
+             * render_memblockq is the end of what the sink already
+             * has. pa_sink_input_process_rewind() starts the ramp. */
+            i->thread_info.ramp_pending = TRUE;
+            i->thread_info.ramp_pending_type = r->type;
+            i->thread_info.ramp_pending_target = r->volume;
+            i->thread_info.ramp_pending_length = pa_usec_to_bytes(r->duration, &i->sink->sample_spec) / pa_frame_size(&i->sink->sample_spec);
+
+            pa_sink_input_request_rewind(i, 0, TRUE, FALSE, FALSE);
+            return 0;
+        }
+
         case PA_SINK_INPUT_MESSAGE_SET_SOFT_MUTE:
             if (i->thread_info.muted != i->muted) {
                 i->thread_info.muted = i->muted;
@@ -2239,6 +2386,10 @@ int pa_sink_input_update_rate(pa_sink_input *i) {
             &i->sink->silence);
     pa_xfree(memblockq_name);
 
+    /* The indexes of the new queue have nothing to do with where the
+     * ramp started */
+    volume_ramp_finish(i);
+
     i->actual_resample_method = new_resampler ? pa_resampler_get_method(new_resampler) : PA_RESAMPLER_INVALID;
 
     pa_log_debug("Updated resampler for sink input %d", i->index);
@@ -30,6 +30,7 @@ typedef struct pa_sink_input pa_sink_input;
 #include <pulse/sample.h>
 #include <pulse/format.h>
 #include <pulsecore/memblockq.h>
+#include <pulsecore/mix.h>
 #include <pulsecore/resampler.h>
 #include <pulsecore/module.h>
 #include <pulsecore/client.h>
@@ -246,6 +247,25 @@ struct pa_sink_input {
         /* We maintain a history of resampled audio data here. */
         pa_memblockq *render_memblockq;
 
+        /* Applied on top of volume_factor_sink while rendering into
+         * render_memblockq. The ramp starts at ramp_start_index of
+         * render_memblockq, which makes rewound data get the same gain
+         * again when it is rendered anew. */
+        pa_volume_ramp ramp;
+        int64_t ramp_start_index;
+
+        /* A ramp that was asked for but hasn't started yet. It starts
+         * at the first frame that is rendered after the rewind it
+         * requested, where we really are playing then. */
+        pa_bool_t ramp_pending;
+        pa_volume_ramp_type_t ramp_pending_type;
+        pa_volume_t ramp_pending_target;
+        size_t ramp_pending_length;
+
+        /* Time spent in the resampler since the sink last collected
+         * it for its convert-time histogram */
+        pa_usec_t convert_time;
+
         pa_sink_input *sync_prev, *sync_next;
 
         /* The requested latency for the sink */
@@ -268,6 +288,7 @@ enum {
     PA_SINK_INPUT_MESSAGE_SET_STATE,
     PA_SINK_INPUT_MESSAGE_SET_REQUESTED_LATENCY,
     PA_SINK_INPUT_MESSAGE_GET_REQUESTED_LATENCY,
+    PA_SINK_INPUT_MESSAGE_SET_VOLUME_RAMP,
     PA_SINK_INPUT_MESSAGE_MAX
 };
 
@@ -372,6 +393,11 @@ pa_bool_t pa_sink_input_is_volume_readable(pa_sink_input *i);
 void pa_sink_input_set_volume(pa_sink_input *i, const pa_cvolume *volume, pa_bool_t save, pa_bool_t absolute);
 void pa_sink_input_add_volume_factor(pa_sink_input *i, const char *key, const pa_cvolume *volume_factor);
 void pa_sink_input_remove_volume_factor(pa_sink_input *i, const char *key);
+
+/* Fades the volume of the stream to volume over duration, on top of
+ * all the other volumes. The ramp starts at the gain the stream is
+ * played at right now and volume keeps applying after it. */
+void pa_sink_input_set_volume_ramp(pa_sink_input *i, pa_volume_t volume, pa_usec_t duration, pa_volume_ramp_type_t type);
 pa_cvolume *pa_sink_input_get_volume(pa_sink_input *i, pa_cvolume *volume, pa_bool_t absolute);
 
 void pa_sink_input_set_mute(pa_sink_input *i, pa_bool_t mute, pa_bool_t save);
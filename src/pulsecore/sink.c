@@ -48,15 +48,19 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/play-memblockq.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/render-pool.h>
 
 #include "sink.h"
 
-#define MAX_MIX_CHANNELS 32
 #define MIX_BUFFER_LENGTH (PA_PAGE_SIZE)
 #define ABSOLUTE_MIN_LATENCY (500)
 #define ABSOLUTE_MAX_LATENCY (10*PA_USEC_PER_SEC)
 #define DEFAULT_FIXED_LATENCY (250*PA_USEC_PER_MSEC)
 
+/* Below this many inputs waking up the render threads costs more than
+ * it saves */
+#define PARALLEL_RENDER_MIN_INPUTS 4
+
 PA_DEFINE_PUBLIC_CLASS(pa_sink, pa_msgobject);
 
 struct pa_sink_volume_change {
@@ -129,6 +133,13 @@ void pa_sink_new_data_set_muted(pa_sink_new_data *data, pa_bool_t mute) {
     data->muted = !!mute;
 }
 
+void pa_sink_new_data_set_rewind_free(pa_sink_new_data *data, pa_bool_t rewind_free) {
+    pa_assert(data);
+
+    data->rewind_free_is_set = TRUE;
+    data->rewind_free = !!rewind_free;
+}
+
 void pa_sink_new_data_set_port(pa_sink_new_data *data, const char *port) {
     pa_assert(data);
 
@@ -229,6 +240,9 @@ pa_sink* pa_sink_new(
     if (!data->muted_is_set)
         data->muted = FALSE;
 
+    if (!data->rewind_free_is_set)
+        data->rewind_free = core->rewind_free_sinks;
+
     if (data->card)
         pa_proplist_update(data->proplist, PA_UPDATE_MERGE, data->card->proplist);
 
@@ -323,6 +337,7 @@ pa_sink* pa_sink_new(
 
     s->save_volume = data->save_volume;
     s->save_muted = data->save_muted;
+    s->rewind_free = data->rewind_free;
 
     pa_silence_memchunk_get(
             &core->silence_cache,
@@ -331,14 +346,39 @@ pa_sink* pa_sink_new(
             &s->sample_spec,
             0);
 
+    pa_histogram_reset(&s->io_stats.wakeup_lateness);
+    pa_histogram_reset(&s->io_stats.render_time);
+    pa_histogram_reset(&s->io_stats.peek_time);
+    pa_histogram_reset(&s->io_stats.convert_time);
+    pa_histogram_reset(&s->io_stats.mix_time);
+    pa_histogram_reset(&s->io_stats.join_time);
+    pa_atomic_store(&s->io_stats.silent_renders, 0);
+    pa_atomic_store(&s->io_stats.silent_mix_skips, 0);
+    pa_atomic_store(&s->io_stats.silent_volume_skips, 0);
+    pa_atomic_store(&s->io_stats.silent_resample_skips, 0);
+    pa_atomic_store(&s->io_stats.single_input_renders, 0);
+    pa_atomic_store(&s->io_stats.passthrough_renders, 0);
+
     s->thread_info.rtpoll = NULL;
     s->thread_info.inputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    s->thread_info.n_mix_info = PA_MIX_STREAMS_PER_TIER;
+    s->thread_info.mix_info = pa_xnew(pa_mix_info, s->thread_info.n_mix_info);
+    s->thread_info.render_inputs = pa_xnew(pa_sink_input*, s->thread_info.n_mix_info);
+    s->thread_info.render_parallel = FALSE;
+    s->thread_info.rewind_mutex = pa_mutex_new(FALSE, FALSE);
+    s->thread_info.render_depth = 0;
+    s->thread_info.render_started = FALSE;
     s->thread_info.soft_volume =  s->soft_volume;
     s->thread_info.soft_muted = s->muted;
     s->thread_info.state = s->state;
     s->thread_info.rewind_nbytes = 0;
     s->thread_info.rewind_requested = FALSE;
     s->thread_info.max_rewind = 0;
+    s->thread_info.rewind_free = s->rewind_free;
+    s->thread_info.device_max_rewind = 0;
+    s->thread_info.rewind_free_max_latency = core->rewind_free_max_latency_msec * PA_USEC_PER_MSEC;
+    pa_zero(s->thread_info.rewind_stats);
+    s->thread_info.rewind_stats.since = pa_rtclock_now();
     s->thread_info.max_request = 0;
     s->thread_info.requested_latency_valid = FALSE;
     s->thread_info.requested_latency = 0;
@@ -437,7 +477,7 @@ static int sink_set_state(pa_sink *s, pa_sink_state_t state) {
 
     if (state != PA_SINK_UNLINKED) { /* if we enter UNLINKED state pa_sink_unlink() will fire the appropriate events */
         pa_hook_fire(&s->core->hooks[PA_CORE_HOOK_SINK_STATE_CHANGED], s);
-        pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SINK | PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
+        pa_subscription_post_fields(s->core, PA_SUBSCRIPTION_EVENT_SINK | PA_SUBSCRIPTION_EVENT_CHANGE, s->index, PA_SUBSCRIPTION_FIELD_STATE);
     }
 
     if (suspend_change) {
@@ -740,6 +780,9 @@ static void sink_free(pa_object *o) {
 
     pa_idxset_free(s->inputs, NULL);
     pa_hashmap_free(s->thread_info.inputs, (pa_free_cb_t) pa_sink_input_unref);
+    pa_xfree(s->thread_info.mix_info);
+    pa_xfree(s->thread_info.render_inputs);
+    pa_mutex_free(s->thread_info.rewind_mutex);
 
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
@@ -815,6 +858,9 @@ void pa_sink_set_rtpoll(pa_sink *s, pa_rtpoll *p) {
 
     s->thread_info.rtpoll = p;
 
+    if (p)
+        pa_rtpoll_set_lateness_histogram(p, &s->io_stats.wakeup_lateness);
+
     if (s->monitor_source)
         pa_source_set_rtpoll(s->monitor_source, p);
 }
@@ -990,6 +1036,9 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     s->thread_info.rewind_requested = FALSE;
 
     if (nbytes > 0) {
+        s->thread_info.rewind_stats.rewinds++;
+        s->thread_info.rewind_stats.rewound_bytes += nbytes;
+
         pa_log_debug("Processing rewind...");
         if (s->flags & PA_SINK_DEFERRED_VOLUME)
             pa_sink_volume_change_rewind(s, nbytes);
@@ -1006,38 +1055,137 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     }
 }
 
+struct peek_batch {
+    size_t length;
+    pa_sink_input **inputs;
+    pa_mix_info *info;
+};
+
+/* Called from IO thread context or a render thread on its behalf */
+static void peek_job(unsigned idx, void *userdata) {
+    struct peek_batch *b = userdata;
+
+    pa_sink_input_peek(b->inputs[idx], b->length, &b->info[idx].chunk, &b->info[idx].volume);
+}
+
+/* Called from IO thread context. Peeks all inputs with the help of the
+ * render threads, storing the chunk of the nth input in the nth entry of
+ * mix_info. Returns FALSE if there are too few inputs for this to pay
+ * off or the render pool is busy with another sink. */
+static pa_bool_t peek_parallel(pa_sink *s, size_t length, unsigned n_inputs) {
+    struct peek_batch b;
+    pa_sink_input *i;
+    void *state = NULL;
+    unsigned k = 0;
+    pa_usec_t join_wait;
+    int r;
+
+    if (!s->core->render_pool || n_inputs < PARALLEL_RENDER_MIN_INPUTS)
+        return FALSE;
+
+    while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL))) {
+        pa_sink_input_assert_ref(i);
+        s->thread_info.render_inputs[k++] = i;
+    }
+
+    pa_assert(k == n_inputs);
+
+    b.length = length;
+    b.inputs = s->thread_info.render_inputs;
+    b.info = s->thread_info.mix_info;
+
+    /* Each input is peeked by exactly one thread, and we only touch
+     * their state again after the join, so the thread_info of the
+     * inputs still has a single owner at any time */
+    s->thread_info.render_parallel = TRUE;
+    r = pa_render_pool_run(s->core->render_pool, n_inputs, peek_job, &b, &join_wait);
+    s->thread_info.render_parallel = FALSE;
+
+    if (r < 0)
+        return FALSE;
+
+    pa_histogram_add(&s->io_stats.join_time, join_wait);
+    return TRUE;
+}
+
 /* Called from IO thread context */
-static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, unsigned maxinfo) {
+static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info **ret_info) {
     pa_sink_input *i;
-    unsigned n = 0;
+    pa_mix_info *info;
+    unsigned n = 0, n_inputs, k;
     void *state = NULL;
     size_t mixlength = *length;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
-    pa_assert(info);
+    pa_assert(ret_info);
+
+    n_inputs = pa_hashmap_size(s->thread_info.inputs);
+
+    /* Grow the scratch array in steps of a full mixing tier, so that
+     * we don't have to reallocate every time a stream is added */
+    if (n_inputs > s->thread_info.n_mix_info) {
+        s->thread_info.n_mix_info = PA_ROUND_UP(n_inputs, PA_MIX_STREAMS_PER_TIER);
+        pa_xfree(s->thread_info.mix_info);
+        s->thread_info.mix_info = pa_xnew(pa_mix_info, s->thread_info.n_mix_info);
+        pa_xfree(s->thread_info.render_inputs);
+        s->thread_info.render_inputs = pa_xnew(pa_sink_input*, s->thread_info.n_mix_info);
+    }
 
-    while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL)) && maxinfo > 0) {
-        pa_sink_input_assert_ref(i);
+    info = *ret_info = s->thread_info.mix_info;
 
-        pa_sink_input_peek(i, *length, &info->chunk, &info->volume);
+    if (peek_parallel(s, *length, n_inputs)) {
 
-        if (mixlength == 0 || info->chunk.length < mixlength)
-            mixlength = info->chunk.length;
+        /* Now drop the silent chunks, in the same order as below so
+         * that the result doesn't depend on who peeked which input */
+        for (k = 0; k < n_inputs; k++) {
+            pa_mix_info *m = s->thread_info.mix_info + k;
 
-        if (pa_memblock_is_silence(info->chunk.memblock)) {
-            pa_memblock_unref(info->chunk.memblock);
-            continue;
+            if (mixlength == 0 || m->chunk.length < mixlength)
+                mixlength = m->chunk.length;
+
+            if (pa_memblock_is_silence(m->chunk.memblock)) {
+                pa_memblock_unref(m->chunk.memblock);
+                pa_atomic_inc(&s->io_stats.silent_mix_skips);
+                continue;
+            }
+
+            if (info != m)
+                *info = *m;
+
+            info->userdata = pa_sink_input_ref(s->thread_info.render_inputs[k]);
+
+            pa_assert(info->chunk.memblock);
+            pa_assert(info->chunk.length > 0);
+
+            info++;
+            n++;
         }
 
-        info->userdata = pa_sink_input_ref(i);
+    } else {
+
+        while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL))) {
+            pa_sink_input_assert_ref(i);
+
+            pa_sink_input_peek(i, *length, &info->chunk, &info->volume);
+
+            if (mixlength == 0 || info->chunk.length < mixlength)
+                mixlength = info->chunk.length;
+
+            if (pa_memblock_is_silence(info->chunk.memblock)) {
+                pa_memblock_unref(info->chunk.memblock);
+                pa_atomic_inc(&s->io_stats.silent_mix_skips);
+                continue;
+            }
 
-        pa_assert(info->chunk.memblock);
-        pa_assert(info->chunk.length > 0);
+            info->userdata = pa_sink_input_ref(i);
 
-        info++;
-        n++;
-        maxinfo--;
+            pa_assert(info->chunk.memblock);
+            pa_assert(info->chunk.length > 0);
+
+            info++;
+            n++;
+        }
     }
 
     if (mixlength > 0)
@@ -1046,8 +1194,10 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
     return n;
 }
 
-/* Called from IO thread context */
-static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *result) {
+/* Called from IO thread context. The monitor source gets monitor_data
+ * if it is not NULL, which must then have the same contents as result
+ * and is usually the block of a single input result was copied from */
+static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *result, pa_memchunk *monitor_data) {
     pa_sink_input *i;
     void *state;
     unsigned p = 0;
@@ -1096,8 +1246,10 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
                     pa_assert(result->length <= c.length);
                     c.length = result->length;
 
-                    pa_memchunk_make_writable(&c, 0);
-                    pa_volume_memchunk(&c, &s->sample_spec, &m->volume);
+                    if (!pa_cvolume_is_norm(&m->volume)) {
+                        pa_memchunk_make_writable(&c, 0);
+                        pa_volume_memchunk(&c, &s->sample_spec, &m->volume);
+                    }
                 } else {
                     c = s->silence;
                     pa_memblock_ref(c.memblock);
@@ -1140,14 +1292,72 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
     }
 
     if (s->monitor_source && PA_SOURCE_IS_LINKED(s->monitor_source->thread_info.state))
-        pa_source_post(s->monitor_source, result);
+        pa_source_post(s->monitor_source, monitor_data ? monitor_data : result);
+}
+
+/* Called from IO thread context */
+static void render_begin(pa_sink *s) {
+    if (s->thread_info.render_depth++ > 0)
+        return;
+
+    s->thread_info.render_started = FALSE;
+    s->thread_info.render_peek_time = s->thread_info.render_mix_time = 0;
+    s->thread_info.render_mixed = FALSE;
+}
+
+/* Called from IO thread context. The render starts with the first
+ * peek, which saves us a clock read. */
+static void account_render_time(pa_sink *s, unsigned n, pa_usec_t start, pa_usec_t peeked, pa_usec_t mixed) {
+    pa_assert(s->thread_info.render_depth > 0);
+
+    if (!s->thread_info.render_started) {
+        s->thread_info.render_start = start;
+        s->thread_info.render_started = TRUE;
+    }
+
+    s->thread_info.render_peek_time += peeked - start;
+
+    if (n > 0) {
+        s->thread_info.render_mix_time += mixed - peeked;
+        s->thread_info.render_mixed = TRUE;
+    }
+}
+
+/* Called from IO thread context. Adds one sample per histogram for the
+ * whole render, however often pa_sink_render_full() and friends had
+ * to peek the inputs. */
+static void render_end(pa_sink *s) {
+    pa_sink_input *i;
+    void *state = NULL;
+    pa_usec_t convert_time = 0;
+
+    pa_assert(s->thread_info.render_depth > 0);
+
+    if (--s->thread_info.render_depth > 0 || !s->thread_info.render_started)
+        return;
+
+    pa_histogram_add(&s->io_stats.render_time, pa_rtclock_now() - s->thread_info.render_start);
+    pa_histogram_add(&s->io_stats.peek_time, s->thread_info.render_peek_time);
+
+    if (s->thread_info.render_mixed)
+        pa_histogram_add(&s->io_stats.mix_time, s->thread_info.render_mix_time);
+
+    /* Resampling is part of the peek time, this tells how much of it */
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
+        convert_time += i->thread_info.convert_time;
+        i->thread_info.convert_time = 0;
+    }
+
+    if (convert_time > 0)
+        pa_histogram_add(&s->io_stats.convert_time, convert_time);
 }
 
 /* Called from IO thread context */
 void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
-    pa_mix_info info[MAX_MIX_CHANNELS];
+    pa_mix_info *info;
     unsigned n;
     size_t block_size_max;
+    pa_usec_t start, peeked, mixed;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1166,6 +1376,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     }
 
     pa_sink_ref(s);
+    render_begin(s);
 
     if (length <= 0)
         length = pa_frame_align(MIX_BUFFER_LENGTH, &s->sample_spec);
@@ -1176,7 +1387,9 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     pa_assert(length > 0);
 
-    n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
+    start = pa_rtclock_now();
+    n = fill_mix_info(s, &length, &info);
+    peeked = pa_rtclock_now();
 
     if (n == 0) {
 
@@ -1186,6 +1399,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
         if (result->length > length)
             result->length = length;
 
+        pa_atomic_inc(&s->io_stats.silent_renders);
+
     } else if (n == 1) {
         pa_cvolume volume;
 
@@ -1196,8 +1411,12 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
             result->length = length;
 
         pa_sw_cvolume_multiply(&volume, &s->thread_info.soft_volume, &info[0].volume);
+        pa_atomic_inc(&s->io_stats.single_input_renders);
 
-        if (s->thread_info.soft_muted || pa_cvolume_is_muted(&volume)) {
+        if (!s->thread_info.soft_muted && pa_cvolume_is_norm(&volume)) {
+            /* We hand out the input's own block, for the monitor too */
+            pa_atomic_inc(&s->io_stats.passthrough_renders);
+        } else if (s->thread_info.soft_muted || pa_cvolume_is_muted(&volume)) {
             pa_memblock_unref(result->memblock);
             pa_silence_memchunk_get(&s->core->silence_cache,
                                     s->core->mempool,
@@ -1205,34 +1424,57 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
                                     &s->sample_spec,
                                     result->length);
         } else if (!pa_cvolume_is_norm(&volume)) {
-            pa_memchunk_make_writable(result, 0);
-            pa_volume_memchunk(result, &s->sample_spec, &volume);
+            void *ptr;
+
+            /* Apply the volume while copying the data into a new
+             * block, instead of copying first and then walking the
+             * copy again to adjust the volume in place. */
+            pa_memblock_unref(result->memblock);
+            result->memblock = pa_memblock_new(s->core->mempool, result->length);
+
+            ptr = pa_memblock_acquire(result->memblock);
+            result->length = pa_mix(info, 1,
+                                    ptr, result->length,
+                                    &s->sample_spec,
+                                    &s->thread_info.soft_volume,
+                                    FALSE);
+            pa_memblock_release(result->memblock);
+
+            result->index = 0;
         }
     } else {
         void *ptr;
         result->memblock = pa_memblock_new(s->core->mempool, length);
 
         ptr = pa_memblock_acquire(result->memblock);
-        result->length = pa_mix(info, n,
-                                ptr, length,
-                                &s->sample_spec,
-                                &s->thread_info.soft_volume,
-                                s->thread_info.soft_muted);
+        result->length = pa_mix_tiered(s->core->mempool,
+                                       info, n,
+                                       ptr, length,
+                                       &s->sample_spec,
+                                       &s->thread_info.soft_volume,
+                                       s->thread_info.soft_muted);
         pa_memblock_release(result->memblock);
 
         result->index = 0;
     }
 
-    inputs_drop(s, info, n, result);
+    mixed = pa_rtclock_now();
+
+    inputs_drop(s, info, n, result, NULL);
+
+    account_render_time(s, n, start, peeked, mixed);
+    render_end(s);
 
     pa_sink_unref(s);
 }
 
 /* Called from IO thread context */
 void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
-    pa_mix_info info[MAX_MIX_CHANNELS];
+    pa_mix_info *info;
     unsigned n;
     size_t length, block_size_max;
+    pa_usec_t start, peeked, mixed;
+    pa_memchunk monitor_data;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1251,6 +1493,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
     }
 
     pa_sink_ref(s);
+    render_begin(s);
 
     length = target->length;
     block_size_max = pa_mempool_block_size_max(s->core->mempool);
@@ -1259,13 +1502,18 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     pa_assert(length > 0);
 
-    n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
+    start = pa_rtclock_now();
+    n = fill_mix_info(s, &length, &info);
+    peeked = pa_rtclock_now();
+
+    pa_memchunk_reset(&monitor_data);
 
     if (n == 0) {
         if (target->length > length)
             target->length = length;
 
         pa_silence_memchunk(target, &s->sample_spec);
+        pa_atomic_inc(&s->io_stats.silent_renders);
     } else if (n == 1) {
         pa_cvolume volume;
 
@@ -1273,25 +1521,40 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
             target->length = length;
 
         pa_sw_cvolume_multiply(&volume, &s->thread_info.soft_volume, &info[0].volume);
+        pa_atomic_inc(&s->io_stats.single_input_renders);
 
         if (s->thread_info.soft_muted || pa_cvolume_is_muted(&volume))
             pa_silence_memchunk(target, &s->sample_spec);
-        else {
-            pa_memchunk vchunk;
+        else if (!pa_cvolume_is_norm(&volume)) {
+            void *ptr;
 
-            vchunk = info[0].chunk;
-            pa_memblock_ref(vchunk.memblock);
+            /* Mix the single input straight into the target, so that
+             * the stream and sink volume are applied and the result is
+             * clamped in one pass over the data. */
+            ptr = pa_memblock_acquire(target->memblock);
 
-            if (vchunk.length > length)
-                vchunk.length = length;
+            target->length = pa_mix(info, 1,
+                                    (uint8_t*) ptr + target->index, target->length,
+                                    &s->sample_spec,
+                                    &s->thread_info.soft_volume,
+                                    FALSE);
 
-            if (!pa_cvolume_is_norm(&volume)) {
-                pa_memchunk_make_writable(&vchunk, 0);
-                pa_volume_memchunk(&vchunk, &s->sample_spec, &volume);
-            }
+            pa_memblock_release(target->memblock);
+        } else {
 
-            pa_memchunk_memcpy(target, &vchunk);
-            pa_memblock_unref(vchunk.memblock);
+            /* The input's data goes straight into the target, which
+             * usually is the device buffer. The monitor source gets the
+             * input's block rather than the target: if that is a fixed
+             * block it would otherwise have to be copied once the
+             * caller is done with it. */
+            monitor_data = info[0].chunk;
+            pa_memblock_ref(monitor_data.memblock);
+
+            if (monitor_data.length > length)
+                monitor_data.length = length;
+
+            pa_memchunk_memcpy(target, &monitor_data);
+            pa_atomic_inc(&s->io_stats.passthrough_renders);
         }
 
     } else {
@@ -1299,16 +1562,25 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
         ptr = pa_memblock_acquire(target->memblock);
 
-        target->length = pa_mix(info, n,
-                                (uint8_t*) ptr + target->index, length,
-                                &s->sample_spec,
-                                &s->thread_info.soft_volume,
-                                s->thread_info.soft_muted);
+        target->length = pa_mix_tiered(s->core->mempool,
+                                       info, n,
+                                       (uint8_t*) ptr + target->index, length,
+                                       &s->sample_spec,
+                                       &s->thread_info.soft_volume,
+                                       s->thread_info.soft_muted);
 
         pa_memblock_release(target->memblock);
     }
 
-    inputs_drop(s, info, n, target);
+    mixed = pa_rtclock_now();
+
+    inputs_drop(s, info, n, target, monitor_data.memblock ? &monitor_data : NULL);
+
+    if (monitor_data.memblock)
+        pa_memblock_unref(monitor_data.memblock);
+
+    account_render_time(s, n, start, peeked, mixed);
+    render_end(s);
 
     pa_sink_unref(s);
 }
@@ -1335,6 +1607,7 @@ void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target) {
     }
 
     pa_sink_ref(s);
+    render_begin(s);
 
     l = target->length;
     d = 0;
@@ -1349,6 +1622,7 @@ void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target) {
         l -= chunk.length;
     }
 
+    render_end(s);
     pa_sink_unref(s);
 }
 
@@ -1365,9 +1639,42 @@ void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result) {
     pa_assert(s->thread_info.rewind_nbytes == 0);
 
     pa_sink_ref(s);
+    render_begin(s);
 
     pa_sink_render(s, length, result);
 
+    /* As long as all we get is the shared silence block there is no
+     * need to fill a block of our own, so filter sinks and the like see
+     * that the data is silent */
+    while (result->length < length &&
+           pa_memblock_is_silence(result->memblock) &&
+           result->index + length <= pa_memblock_get_length(result->memblock)) {
+        pa_memchunk chunk, dst;
+
+        pa_sink_render(s, length - result->length, &chunk);
+
+        if (chunk.memblock == result->memblock &&
+            chunk.index == result->index) {
+
+            result->length += chunk.length;
+            pa_memblock_unref(chunk.memblock);
+            continue;
+        }
+
+        /* Not silent after all, continue in a block of our own */
+        pa_memchunk_make_writable(result, length);
+
+        dst.memblock = result->memblock;
+        dst.index = result->index + result->length;
+        dst.length = chunk.length;
+
+        pa_memchunk_memcpy(&dst, &chunk);
+        result->length += chunk.length;
+
+        pa_memblock_unref(chunk.memblock);
+        break;
+    }
+
     if (result->length < length) {
         pa_memchunk chunk;
 
@@ -1382,6 +1689,7 @@ void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result) {
         result->length = length;
     }
 
+    render_end(s);
     pa_sink_unref(s);
 }
 
@@ -1848,7 +2156,7 @@ static void update_real_volume(pa_sink *s, const pa_cvolume *new_volume, pa_chan
                     if (i->volume_changed)
                         i->volume_changed(i);
 
-                    pa_subscription_post(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index);
+                    pa_subscription_post_fields(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index, PA_SUBSCRIPTION_FIELD_VOLUME);
                 }
             }
 
@@ -1931,7 +2239,7 @@ static void propagate_reference_volume(pa_sink *s) {
             if (i->volume_changed)
                 i->volume_changed(i);
 
-            pa_subscription_post(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index);
+            pa_subscription_post_fields(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index, PA_SUBSCRIPTION_FIELD_VOLUME);
         }
     }
 }
@@ -1960,7 +2268,7 @@ static pa_bool_t update_reference_volume(pa_sink *s, const pa_cvolume *v, const
     s->save_volume = (!reference_volume_changed && s->save_volume) || save;
 
     if (reference_volume_changed)
-        pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
+        pa_subscription_post_fields(s->core, PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE, s->index, PA_SUBSCRIPTION_FIELD_VOLUME);
     else if (!(s->flags & PA_SINK_SHARE_VOLUME_WITH_MASTER))
         /* If the root sink's volume doesn't change, then there can't be any
          * changes in the other sinks in the sink tree either.
@@ -2153,7 +2461,7 @@ static void propagate_real_volume(pa_sink *s, const pa_cvolume *old_real_volume)
                 if (i->volume_changed)
                     i->volume_changed(i);
 
-                pa_subscription_post(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index);
+                pa_subscription_post_fields(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index, PA_SUBSCRIPTION_FIELD_VOLUME);
             }
 
             if (i->origin_sink && (i->origin_sink->flags & PA_SINK_SHARE_VOLUME_WITH_MASTER))
@@ -2236,7 +2544,7 @@ void pa_sink_set_mute(pa_sink *s, pa_bool_t mute, pa_bool_t save) {
     pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_SET_MUTE, NULL, 0, NULL) == 0);
 
     if (old_muted != s->muted)
-        pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
+        pa_subscription_post_fields(s->core, PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE, s->index, PA_SUBSCRIPTION_FIELD_MUTE);
 }
 
 /* Called from main thread */
@@ -2257,7 +2565,7 @@ pa_bool_t pa_sink_get_mute(pa_sink *s, pa_bool_t force_refresh) {
         if (old_muted != s->muted) {
             s->save_muted = TRUE;
 
-            pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
+            pa_subscription_post_fields(s->core, PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE, s->index, PA_SUBSCRIPTION_FIELD_MUTE);
 
             /* Make sure the soft mute status stays in sync */
             pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_SET_MUTE, NULL, 0, NULL) == 0);
@@ -2281,7 +2589,7 @@ void pa_sink_mute_changed(pa_sink *s, pa_bool_t new_muted) {
     s->muted = new_muted;
     s->save_muted = TRUE;
 
-    pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
+    pa_subscription_post_fields(s->core, PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE, s->index, PA_SUBSCRIPTION_FIELD_MUTE);
 }
 
 /* Called from main thread */
@@ -2861,6 +3169,11 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             *((size_t*) userdata) = s->thread_info.max_request;
             return 0;
 
+        case PA_SINK_MESSAGE_GET_REWIND_STATS:
+
+            *((pa_sink_rewind_stats*) userdata) = s->thread_info.rewind_stats;
+            return 0;
+
         case PA_SINK_MESSAGE_SET_MAX_REWIND:
 
             pa_sink_set_max_rewind_within_thread(s, (size_t) offset);
@@ -2978,24 +3291,42 @@ void pa_sink_attach_within_thread(pa_sink *s) {
 
 /* Called from IO thread */
 void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
+    pa_bool_t parallel;
+
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
     pa_assert(PA_SINK_IS_LINKED(s->thread_info.state));
 
+    /* Our inputs might be peeked by several render threads right now */
+    if ((parallel = s->thread_info.render_parallel))
+        pa_mutex_lock(s->thread_info.rewind_mutex);
+
+    s->thread_info.rewind_stats.requests++;
+    s->thread_info.rewind_stats.requested_bytes += PA_MIN(nbytes, s->thread_info.device_max_rewind);
+
     if (nbytes == (size_t) -1)
         nbytes = s->thread_info.max_rewind;
 
+    /* In rewind-free mode this is always 0. The inputs still get to
+     * rewrite what they haven't passed to us yet. */
     nbytes = PA_MIN(nbytes, s->thread_info.max_rewind);
 
-    if (s->thread_info.rewind_requested &&
-        nbytes <= s->thread_info.rewind_nbytes)
-        return;
+    if (!s->thread_info.rewind_requested ||
+        nbytes > s->thread_info.rewind_nbytes) {
 
-    s->thread_info.rewind_nbytes = nbytes;
-    s->thread_info.rewind_requested = TRUE;
+        s->thread_info.rewind_nbytes = nbytes;
+        s->thread_info.rewind_requested = TRUE;
+
+        /* Still locked, the callbacks read rewind_nbytes and aren't
+         * safe against each other. They only ever hand the request on
+         * to the master sink, so we lock from filter sink to master
+         * and can't deadlock. */
+        if (s->request_rewind)
+            s->request_rewind(s);
+    }
 
-    if (s->request_rewind)
-        s->request_rewind(s);
+    if (parallel)
+        pa_mutex_unlock(s->thread_info.rewind_mutex);
 }
 
 /* Called from IO thread */
@@ -3025,6 +3356,10 @@ pa_usec_t pa_sink_get_requested_latency_within_thread(pa_sink *s) {
         (result == (pa_usec_t) -1 || result > monitor_latency))
         result = monitor_latency;
 
+    if (s->thread_info.rewind_free &&
+        (result == (pa_usec_t) -1 || result > s->thread_info.rewind_free_max_latency))
+        result = s->thread_info.rewind_free_max_latency;
+
     if (result != (pa_usec_t) -1)
         result = PA_CLAMP(result, s->thread_info.min_latency, s->thread_info.max_latency);
 
@@ -3061,6 +3396,11 @@ void pa_sink_set_max_rewind_within_thread(pa_sink *s, size_t max_rewind) {
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
 
+    s->thread_info.device_max_rewind = max_rewind;
+
+    if (s->thread_info.rewind_free)
+        max_rewind = 0;
+
     if (max_rewind == s->thread_info.max_rewind)
         return;
 
@@ -3335,6 +3675,20 @@ size_t pa_sink_get_max_rewind(pa_sink *s) {
     return r;
 }
 
+/* Called from main context */
+void pa_sink_get_rewind_stats(pa_sink *s, pa_sink_rewind_stats *stats) {
+    pa_assert_ctl_context();
+    pa_sink_assert_ref(s);
+    pa_assert(stats);
+
+    if (!PA_SINK_IS_LINKED(s->state)) {
+        *stats = s->thread_info.rewind_stats;
+        return;
+    }
+
+    pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_GET_REWIND_STATS, stats, 0, NULL) == 0);
+}
+
 /* Called from main context */
 size_t pa_sink_get_max_request(pa_sink *s) {
     size_t r;
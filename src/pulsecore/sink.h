@@ -36,6 +36,8 @@ typedef struct pa_sink_volume_change pa_sink_volume_change;
 
 #include <pulsecore/core.h>
 #include <pulsecore/idxset.h>
+#include <pulsecore/histogram.h>
+#include <pulsecore/mutex.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/source.h>
 #include <pulsecore/module.h>
@@ -47,8 +49,9 @@ typedef struct pa_sink_volume_change pa_sink_volume_change;
 #include <pulsecore/queue.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/sink-input.h>
+#include <pulsecore/mix.h>
 
-#define PA_MAX_INPUTS_PER_SINK 32
+#define PA_MAX_INPUTS_PER_SINK 1024
 
 /* Returns true if sink is linked: registered and accessible from client side. */
 static inline pa_bool_t PA_SINK_IS_LINKED(pa_sink_state_t x) {
@@ -58,6 +61,15 @@ static inline pa_bool_t PA_SINK_IS_LINKED(pa_sink_state_t x) {
 /* A generic definition for void callback functions */
 typedef void(*pa_sink_cb_t)(pa_sink *s);
 
+/* Counted by the IO thread, see pa_sink_get_rewind_stats() */
+typedef struct pa_sink_rewind_stats {
+    uint64_t requests;        /* Calls to pa_sink_request_rewind() */
+    uint64_t requested_bytes; /* What these asked for, as far as the device could have rewound */
+    uint64_t rewinds;         /* Rewinds actually done */
+    uint64_t rewound_bytes;
+    pa_usec_t since;          /* When counting started */
+} pa_sink_rewind_stats;
+
 struct pa_sink {
     pa_msgobject parent;
 
@@ -101,6 +113,9 @@ struct pa_sink {
     pa_bool_t save_volume:1;
     pa_bool_t save_muted:1;
 
+    /* Never rewind, keep the latency low instead. Fixed at creation. */
+    pa_bool_t rewind_free:1;
+
     /* Saved volume state while we're in passthrough mode */
     pa_cvolume saved_volume;
     pa_bool_t saved_save_volume:1;
@@ -232,12 +247,59 @@ struct pa_sink {
      * main thread. */
     pa_bool_t (*update_rate)(pa_sink *s, uint32_t rate);
 
+    /* Filled in by the IO thread, may be read from anywhere. One
+     * sample per rendered block, convert_time is the part of peek_time
+     * the inputs spent in their resamplers. */
+    struct {
+        pa_histogram wakeup_lateness;
+        pa_histogram render_time;
+        pa_histogram peek_time;
+        pa_histogram convert_time;
+        pa_histogram mix_time;
+        pa_histogram join_time;
+
+        /* Work skipped because the data was known to be silent: renders
+         * that found every input silent, silent chunks left out of a
+         * mix, and volume adjustments and resampler runs the inputs
+         * skipped */
+        pa_atomic_t silent_renders;
+        pa_atomic_t silent_mix_skips;
+        pa_atomic_t silent_volume_skips;
+        pa_atomic_t silent_resample_skips;
+
+        /* Renders with a single non-silent input, and those of them
+         * that passed its data on without touching it */
+        pa_atomic_t single_input_renders;
+        pa_atomic_t passthrough_renders;
+    } io_stats;
+
     /* Contains copies of the above data so that the real-time worker
      * thread can work without access locking */
     struct {
         pa_sink_state_t state;
         pa_hashmap *inputs;
 
+        /* Scratch array for pa_sink_render() and friends, grown on
+         * demand to fit all inputs */
+        pa_mix_info *mix_info;
+        unsigned n_mix_info;
+
+        /* The inputs in the order of mix_info while they are peeked
+         * by the render pool, and whether that is going on right now.
+         * pa_sink_request_rewind() may then be called from several
+         * threads at once and serializes itself with rewind_mutex. */
+        pa_sink_input **render_inputs;
+        pa_bool_t render_parallel;
+        pa_mutex *rewind_mutex;
+
+        /* pa_sink_render_full() and friends call each other, the times
+         * of the render in progress are summed up and accounted when
+         * the outermost one returns */
+        unsigned render_depth;
+        pa_usec_t render_start, render_peek_time, render_mix_time;
+        pa_bool_t render_started:1;
+        pa_bool_t render_mixed:1;
+
         pa_rtpoll *rtpoll;
 
         pa_cvolume soft_volume;
@@ -261,6 +323,17 @@ struct pa_sink {
         size_t rewind_nbytes;
         pa_bool_t rewind_requested;
 
+        /* In rewind-free mode max_rewind stays 0, whatever the
+         * implementor set is kept in device_max_rewind, and dynamic
+         * latencies are limited to rewind_free_max_latency. Changes
+         * are then heard after at most that much time without
+         * rewriting anything. */
+        pa_bool_t rewind_free;
+        size_t device_max_rewind;
+        pa_usec_t rewind_free_max_latency;
+
+        pa_sink_rewind_stats rewind_stats;
+
         /* Both dynamic and fixed latencies will be clamped to this
          * range. */
         pa_usec_t min_latency; /* we won't go below this latency */
@@ -324,6 +397,7 @@ typedef enum pa_sink_message {
     PA_SINK_MESSAGE_SET_PORT,
     PA_SINK_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SINK_MESSAGE_SET_LATENCY_OFFSET,
+    PA_SINK_MESSAGE_GET_REWIND_STATS,
     PA_SINK_MESSAGE_MAX
 } pa_sink_message_t;
 
@@ -357,6 +431,9 @@ typedef struct pa_sink_new_data {
     pa_bool_t save_port:1;
     pa_bool_t save_volume:1;
     pa_bool_t save_muted:1;
+
+    pa_bool_t rewind_free:1;
+    pa_bool_t rewind_free_is_set:1;
 } pa_sink_new_data;
 
 pa_sink_new_data* pa_sink_new_data_init(pa_sink_new_data *data);
@@ -366,6 +443,7 @@ void pa_sink_new_data_set_channel_map(pa_sink_new_data *data, const pa_channel_m
 void pa_sink_new_data_set_alternate_sample_rate(pa_sink_new_data *data, const uint32_t alternate_sample_rate);
 void pa_sink_new_data_set_volume(pa_sink_new_data *data, const pa_cvolume *volume);
 void pa_sink_new_data_set_muted(pa_sink_new_data *data, pa_bool_t mute);
+void pa_sink_new_data_set_rewind_free(pa_sink_new_data *data, pa_bool_t rewind_free);
 void pa_sink_new_data_set_port(pa_sink_new_data *data, const char *port);
 void pa_sink_new_data_done(pa_sink_new_data *data);
 
@@ -421,6 +499,7 @@ void pa_sink_get_latency_range(pa_sink *s, pa_usec_t *min_latency, pa_usec_t *ma
 pa_usec_t pa_sink_get_fixed_latency(pa_sink *s);
 
 size_t pa_sink_get_max_rewind(pa_sink *s);
+void pa_sink_get_rewind_stats(pa_sink *s, pa_sink_rewind_stats *stats);
 size_t pa_sink_get_max_request(pa_sink *s);
 
 int pa_sink_update_status(pa_sink*s);
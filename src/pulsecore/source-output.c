@@ -543,7 +543,7 @@ static void source_output_set_state(pa_source_output *o, pa_source_output_state_
         pa_hook_fire(&o->core->hooks[PA_CORE_HOOK_SOURCE_OUTPUT_STATE_CHANGED], o);
 
         if (PA_SOURCE_OUTPUT_IS_LINKED(state))
-            pa_subscription_post(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index);
+            pa_subscription_post_fields(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index, PA_SUBSCRIPTION_FIELD_STATE);
     }
 
     pa_source_update_status(o->source);
@@ -763,6 +763,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
     while ((length = pa_memblockq_get_length(o->thread_info.delay_memblockq)) > limit) {
         pa_memchunk qchunk;
         pa_bool_t nvfs = need_volume_factor_source;
+        pa_bool_t silent;
 
         length -= limit;
 
@@ -773,8 +774,14 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
 
         pa_assert(qchunk.length > 0);
 
+        /* Leave silence alone, so that it stays marked as such for the
+         * resampler and whoever we push it to. The volume factor of the
+         * source is applied after resampling though, and the resampler
+         * may still ring out the previous data. */
+        silent = pa_memblock_is_silence(qchunk.memblock);
+
         /* It might be necessary to adjust the volume here */
-        if (!volume_is_norm) {
+        if (!volume_is_norm && !silent) {
             pa_memchunk_make_writable(&qchunk, 0);
 
             if (o->thread_info.muted) {
@@ -796,7 +803,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
         }
 
         if (!o->thread_info.resampler) {
-            if (nvfs) {
+            if (nvfs && !silent) {
                 pa_memchunk_make_writable(&qchunk, 0);
                 pa_volume_memchunk(&qchunk, &o->thread_info.sample_spec, &o->volume_factor_source);
             }
@@ -814,7 +821,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
             pa_resampler_run(o->thread_info.resampler, &qchunk, &rchunk);
 
             if (rchunk.length > 0) {
-                if (nvfs) {
+                if (nvfs && !pa_memblock_is_silence(rchunk.memblock)) {
                     pa_memchunk_make_writable(&rchunk, 0);
                     pa_volume_memchunk(&rchunk, &o->thread_info.sample_spec, &o->volume_factor_source);
                 }
@@ -997,7 +1004,7 @@ void pa_source_output_set_volume(pa_source_output *o, const pa_cvolume *volume,
         o->volume_changed(o);
 
     /* The virtual volume changed, let's tell people so */
-    pa_subscription_post(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index);
+    pa_subscription_post_fields(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index, PA_SUBSCRIPTION_FIELD_VOLUME);
 }
 
 /* Called from main context */
@@ -1077,7 +1084,7 @@ void pa_source_output_set_mute(pa_source_output *o, pa_bool_t mute, pa_bool_t sa
     if (o->mute_changed)
         o->mute_changed(o);
 
-    pa_subscription_post(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index);
+    pa_subscription_post_fields(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index, PA_SUBSCRIPTION_FIELD_MUTE);
 }
 
 /* Called from main context */
@@ -1326,7 +1333,7 @@ static void update_volume_due_to_moving(pa_source_output *o, pa_source *dest) {
                 if (o->volume_changed)
                     o->volume_changed(o);
 
-                pa_subscription_post(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index);
+                pa_subscription_post_fields(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index, PA_SUBSCRIPTION_FIELD_VOLUME);
             }
         }
 
@@ -1402,7 +1409,7 @@ static void update_volume_due_to_moving(pa_source_output *o, pa_source *dest) {
             if (o->volume_changed)
                 o->volume_changed(o);
 
-            pa_subscription_post(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index);
+            pa_subscription_post_fields(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index, PA_SUBSCRIPTION_FIELD_VOLUME);
         }
     }
 
@@ -318,6 +318,9 @@ pa_source* pa_source_new(
             &s->sample_spec,
             0);
 
+    pa_histogram_reset(&s->io_stats.wakeup_lateness);
+    pa_histogram_reset(&s->io_stats.post_time);
+
     s->thread_info.rtpoll = NULL;
     s->thread_info.outputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
     s->thread_info.soft_volume = s->soft_volume;
@@ -390,7 +393,7 @@ static int source_set_state(pa_source *s, pa_source_state_t state) {
 
     if (state != PA_SOURCE_UNLINKED) { /* if we enter UNLINKED state pa_source_unlink() will fire the appropriate events */
         pa_hook_fire(&s->core->hooks[PA_CORE_HOOK_SOURCE_STATE_CHANGED], s);
-        pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SOURCE | PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
+        pa_subscription_post_fields(s->core, PA_SUBSCRIPTION_EVENT_SOURCE | PA_SUBSCRIPTION_EVENT_CHANGE, s->index, PA_SUBSCRIPTION_FIELD_STATE);
     }
 
     if (suspend_change) {
@@ -733,6 +736,9 @@ void pa_source_set_rtpoll(pa_source *s, pa_rtpoll *p) {
     pa_source_assert_io_context(s);
 
     s->thread_info.rtpoll = p;
+
+    if (p)
+        pa_rtpoll_set_lateness_histogram(p, &s->io_stats.wakeup_lateness);
 }
 
 /* Called from main context */
@@ -906,6 +912,7 @@ void pa_source_process_rewind(pa_source *s, size_t nbytes) {
 void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
     pa_source_output *o;
     void *state = NULL;
+    pa_usec_t start;
 
     pa_source_assert_ref(s);
     pa_source_assert_io_context(s);
@@ -915,6 +922,8 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
     if (s->thread_info.state == PA_SOURCE_SUSPENDED)
         return;
 
+    start = pa_rtclock_now();
+
     if (s->thread_info.soft_muted || !pa_cvolume_is_norm(&s->thread_info.soft_volume)) {
         pa_memchunk vchunk = *chunk;
 
@@ -943,6 +952,8 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
                 pa_source_output_push(o, chunk);
         }
     }
+
+    pa_histogram_add(&s->io_stats.post_time, pa_rtclock_now() - start);
 }
 
 /* Called from IO thread context */
@@ -1404,7 +1415,7 @@ static void update_real_volume(pa_source *s, const pa_cvolume *new_volume, pa_ch
                     if (o->volume_changed)
                         o->volume_changed(o);
 
-                    pa_subscription_post(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index);
+                    pa_subscription_post_fields(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index, PA_SUBSCRIPTION_FIELD_VOLUME);
                 }
             }
 
@@ -1487,7 +1498,7 @@ static void propagate_reference_volume(pa_source *s) {
             if (o->volume_changed)
                 o->volume_changed(o);
 
-            pa_subscription_post(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index);
+            pa_subscription_post_fields(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index, PA_SUBSCRIPTION_FIELD_VOLUME);
         }
     }
 }
@@ -1516,7 +1527,7 @@ static pa_bool_t update_reference_volume(pa_source *s, const pa_cvolume *v, cons
     s->save_volume = (!reference_volume_changed && s->save_volume) || save;
 
     if (reference_volume_changed)
-        pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SOURCE|PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
+        pa_subscription_post_fields(s->core, PA_SUBSCRIPTION_EVENT_SOURCE|PA_SUBSCRIPTION_EVENT_CHANGE, s->index, PA_SUBSCRIPTION_FIELD_VOLUME);
     else if (!(s->flags & PA_SOURCE_SHARE_VOLUME_WITH_MASTER))
         /* If the root source's volume doesn't change, then there can't be any
          * changes in the other source in the source tree either.
@@ -1709,7 +1720,7 @@ static void propagate_real_volume(pa_source *s, const pa_cvolume *old_real_volum
                 if (o->volume_changed)
                     o->volume_changed(o);
 
-                pa_subscription_post(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index);
+                pa_subscription_post_fields(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index, PA_SUBSCRIPTION_FIELD_VOLUME);
             }
 
             if (o->destination_source && (o->destination_source->flags & PA_SOURCE_SHARE_VOLUME_WITH_MASTER))
@@ -1792,7 +1803,7 @@ void pa_source_set_mute(pa_source *s, pa_bool_t mute, pa_bool_t save) {
     pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_SET_MUTE, NULL, 0, NULL) == 0);
 
     if (old_muted != s->muted)
-        pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SOURCE|PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
+        pa_subscription_post_fields(s->core, PA_SUBSCRIPTION_EVENT_SOURCE|PA_SUBSCRIPTION_EVENT_CHANGE, s->index, PA_SUBSCRIPTION_FIELD_MUTE);
 }
 
 /* Called from main thread */
@@ -1813,7 +1824,7 @@ pa_bool_t pa_source_get_mute(pa_source *s, pa_bool_t force_refresh) {
         if (old_muted != s->muted) {
             s->save_muted = TRUE;
 
-            pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SOURCE|PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
+            pa_subscription_post_fields(s->core, PA_SUBSCRIPTION_EVENT_SOURCE|PA_SUBSCRIPTION_EVENT_CHANGE, s->index, PA_SUBSCRIPTION_FIELD_MUTE);
 
             /* Make sure the soft mute status stays in sync */
             pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_SET_MUTE, NULL, 0, NULL) == 0);
@@ -1837,7 +1848,7 @@ void pa_source_mute_changed(pa_source *s, pa_bool_t new_muted) {
     s->muted = new_muted;
     s->save_muted = TRUE;
 
-    pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SOURCE|PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
+    pa_subscription_post_fields(s->core, PA_SUBSCRIPTION_EVENT_SOURCE|PA_SUBSCRIPTION_EVENT_CHANGE, s->index, PA_SUBSCRIPTION_FIELD_MUTE);
 }
 
 /* Called from main thread */
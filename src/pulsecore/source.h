@@ -36,6 +36,7 @@ typedef struct pa_source_volume_change pa_source_volume_change;
 
 #include <pulsecore/core.h>
 #include <pulsecore/idxset.h>
+#include <pulsecore/histogram.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/sink.h>
 #include <pulsecore/module.h>
@@ -189,6 +190,12 @@ struct pa_source {
      * main thread. */
     pa_bool_t (*update_rate)(pa_source *s, uint32_t rate);
 
+    /* Filled in by the IO thread, may be read from anywhere */
+    struct {
+        pa_histogram wakeup_lateness;
+        pa_histogram post_time;
+    } io_stats;
+
     /* Contains copies of the above data so that the real-time worker
      * thread can work without access locking */
     struct {
@@ -24,6 +24,8 @@
 #include <config.h>
 #endif
 
+#include <math.h>
+
 #include <pulsecore/macro.h>
 #include <pulsecore/g711.h>
 #include <pulsecore/endianmacros.h>
@@ -273,3 +275,146 @@ void pa_set_volume_func(pa_sample_format_t f, pa_do_volume_func_t func) {
 
     do_volume_table[f] = func;
 }
+
+/* The ramp type is a constant in all callers of this, hence it is
+ * resolved at compile time and the loops below don't branch on it */
+static inline float ramp_step(float gain, float step, pa_volume_ramp_type_t t) {
+    return t == PA_VOLUME_RAMP_LINEAR ? gain + step : gain * step;
+}
+
+static inline void volume_ramp_s16ne(int16_t *samples, float *gains, const float *steps, unsigned channels, unsigned length, pa_volume_ramp_type_t t) {
+    unsigned channel;
+
+    length /= sizeof(int16_t) * channels;
+
+    for (; length; length--) {
+        for (channel = 0; channel < channels; channel++) {
+            long v = lrintf(*samples * gains[channel]);
+
+            *samples++ = (int16_t) PA_CLAMP_UNLIKELY(v, -0x8000, 0x7FFF);
+            gains[channel] = ramp_step(gains[channel], steps[channel], t);
+        }
+    }
+}
+
+static inline void volume_ramp_s16re(int16_t *samples, float *gains, const float *steps, unsigned channels, unsigned length, pa_volume_ramp_type_t t) {
+    unsigned channel;
+
+    length /= sizeof(int16_t) * channels;
+
+    for (; length; length--) {
+        for (channel = 0; channel < channels; channel++) {
+            long v = lrintf(PA_INT16_SWAP(*samples) * gains[channel]);
+
+            *samples++ = PA_INT16_SWAP((int16_t) PA_CLAMP_UNLIKELY(v, -0x8000, 0x7FFF));
+            gains[channel] = ramp_step(gains[channel], steps[channel], t);
+        }
+    }
+}
+
+static inline void volume_ramp_float32ne(float *samples, float *gains, const float *steps, unsigned channels, unsigned length, pa_volume_ramp_type_t t) {
+    unsigned channel;
+
+    length /= sizeof(float) * channels;
+
+    for (; length; length--) {
+        for (channel = 0; channel < channels; channel++) {
+            *samples++ *= gains[channel];
+            gains[channel] = ramp_step(gains[channel], steps[channel], t);
+        }
+    }
+}
+
+static inline void volume_ramp_float32re(float *samples, float *gains, const float *steps, unsigned channels, unsigned length, pa_volume_ramp_type_t t) {
+    unsigned channel;
+
+    length /= sizeof(float) * channels;
+
+    for (; length; length--) {
+        for (channel = 0; channel < channels; channel++) {
+            float v = PA_FLOAT32_SWAP(*samples) * gains[channel];
+
+            *samples++ = PA_FLOAT32_SWAP(v);
+            gains[channel] = ramp_step(gains[channel], steps[channel], t);
+        }
+    }
+}
+
+static inline void volume_ramp_s32ne(int32_t *samples, float *gains, const float *steps, unsigned channels, unsigned length, pa_volume_ramp_type_t t) {
+    unsigned channel;
+
+    length /= sizeof(int32_t) * channels;
+
+    for (; length; length--) {
+        for (channel = 0; channel < channels; channel++) {
+            long long v = llrint((double) *samples * gains[channel]);
+
+            *samples++ = (int32_t) PA_CLAMP_UNLIKELY(v, -0x80000000LL, 0x7FFFFFFFLL);
+            gains[channel] = ramp_step(gains[channel], steps[channel], t);
+        }
+    }
+}
+
+static inline void volume_ramp_s32re(int32_t *samples, float *gains, const float *steps, unsigned channels, unsigned length, pa_volume_ramp_type_t t) {
+    unsigned channel;
+
+    length /= sizeof(int32_t) * channels;
+
+    for (; length; length--) {
+        for (channel = 0; channel < channels; channel++) {
+            long long v = llrint((double) PA_INT32_SWAP(*samples) * gains[channel]);
+
+            *samples++ = PA_INT32_SWAP((int32_t) PA_CLAMP_UNLIKELY(v, -0x80000000LL, 0x7FFFFFFFLL));
+            gains[channel] = ramp_step(gains[channel], steps[channel], t);
+        }
+    }
+}
+
+#define DEFINE_VOLUME_RAMP_FUNCS(format, type)                                                                          \
+    static void pa_volume_ramp_linear_##format##_c(type *samples, float *gains, const float *steps, unsigned channels, unsigned length) { \
+        volume_ramp_##format(samples, gains, steps, channels, length, PA_VOLUME_RAMP_LINEAR);                          \
+    }                                                                                                                   \
+    static void pa_volume_ramp_log_##format##_c(type *samples, float *gains, const float *steps, unsigned channels, unsigned length) { \
+        volume_ramp_##format(samples, gains, steps, channels, length, PA_VOLUME_RAMP_LOGARITHMIC);                     \
+    }
+
+DEFINE_VOLUME_RAMP_FUNCS(s16ne, int16_t)
+DEFINE_VOLUME_RAMP_FUNCS(s16re, int16_t)
+DEFINE_VOLUME_RAMP_FUNCS(float32ne, float)
+DEFINE_VOLUME_RAMP_FUNCS(float32re, float)
+DEFINE_VOLUME_RAMP_FUNCS(s32ne, int32_t)
+DEFINE_VOLUME_RAMP_FUNCS(s32re, int32_t)
+
+#define VOLUME_RAMP_FUNCS(format) {                                                             \
+        [PA_VOLUME_RAMP_LINEAR]      = (pa_do_volume_ramp_func_t) pa_volume_ramp_linear_##format##_c, \
+        [PA_VOLUME_RAMP_LOGARITHMIC] = (pa_do_volume_ramp_func_t) pa_volume_ramp_log_##format##_c     \
+    }
+
+/* Formats that are missing here are ramped in steps with the functions
+ * from do_volume_table, see pa_volume_ramp_memchunk() */
+static pa_do_volume_ramp_func_t do_volume_ramp_table[PA_SAMPLE_MAX][PA_VOLUME_RAMP_MAX] = {
+    [PA_SAMPLE_S16NE]     = VOLUME_RAMP_FUNCS(s16ne),
+    [PA_SAMPLE_S16RE]     = VOLUME_RAMP_FUNCS(s16re),
+    [PA_SAMPLE_FLOAT32NE] = VOLUME_RAMP_FUNCS(float32ne),
+    [PA_SAMPLE_FLOAT32RE] = VOLUME_RAMP_FUNCS(float32re),
+    [PA_SAMPLE_S32NE]     = VOLUME_RAMP_FUNCS(s32ne),
+    [PA_SAMPLE_S32RE]     = VOLUME_RAMP_FUNCS(s32re)
+};
+
+pa_do_volume_ramp_func_t pa_get_volume_ramp_func(pa_sample_format_t f, pa_volume_ramp_type_t t) {
+    pa_assert(f >= 0);
+    pa_assert(f < PA_SAMPLE_MAX);
+    pa_assert(t >= 0);
+    pa_assert(t < PA_VOLUME_RAMP_MAX);
+
+    return do_volume_ramp_table[f][t];
+}
+
+void pa_set_volume_ramp_func(pa_sample_format_t f, pa_volume_ramp_type_t t, pa_do_volume_ramp_func_t func) {
+    pa_assert(f >= 0);
+    pa_assert(f < PA_SAMPLE_MAX);
+    pa_assert(t >= 0);
+    pa_assert(t < PA_VOLUME_RAMP_MAX);
+
+    do_volume_ramp_table[f][t] = func;
+}
@@ -24,6 +24,8 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulse/rtclock.h>
 
 #include <pulsecore/random.h>
@@ -36,6 +38,8 @@
 
 #if defined (__i386__) || defined (__amd64__)
 
+#include <emmintrin.h>
+
 #define VOLUME_32x16(s,v)                  /* .. |   vh  |   vl  | */                   \
       " pxor %%xmm4, %%xmm4          \n\t" /* .. |    0  |    0  | */                   \
       " punpcklwd %%xmm4, "#s"       \n\t" /* .. |    0  |   p0  | */                   \
@@ -252,6 +256,141 @@ static void pa_volume_s16re_sse2(int16_t *samples, const int32_t *volumes, unsig
     );
 }
 
+/* Unlike the static volume functions above the ramp functions are
+ * written with intrinsics, compiled for SSE2 regardless of the flags
+ * the rest of the file is built with and only installed after checking
+ * the CPU flags at runtime. */
+#define SSE2 __attribute__ ((target ("sse2")))
+
+static pa_do_volume_ramp_func_t ramp_fallback[PA_SAMPLE_MAX][PA_VOLUME_RAMP_MAX];
+
+/* The ramp functions work on 8 samples per iteration, in two vectors
+ * of 4 lanes each. That's 8 / channels frames, which only lines up
+ * with the frames for 1, 2 and 4 channels, everything else is left to
+ * the fallback. Sets up the gains of the lanes of both vectors and by
+ * how much they move on per iteration. */
+static void ramp_lanes(float lanes[8], float lane_steps[4], const float *gains, const float *steps, unsigned channels, pa_volume_ramp_type_t t) {
+    unsigned j, k;
+
+    for (j = 0; j < 8; j++) {
+        lanes[j] = gains[j % channels];
+
+        for (k = 0; k < j / channels; k++)
+            lanes[j] = t == PA_VOLUME_RAMP_LINEAR ? lanes[j] + steps[j % channels] : lanes[j] * steps[j % channels];
+    }
+
+    for (j = 0; j < 4; j++) {
+        lane_steps[j] = t == PA_VOLUME_RAMP_LINEAR ? 0.0f : 1.0f;
+
+        for (k = 0; k < 8 / channels; k++)
+            lane_steps[j] = t == PA_VOLUME_RAMP_LINEAR ? lane_steps[j] + steps[j % channels] : lane_steps[j] * steps[j % channels];
+    }
+}
+
+static SSE2 inline __m128 ramp_advance(__m128 g, __m128 d, pa_volume_ramp_type_t t) {
+    return t == PA_VOLUME_RAMP_LINEAR ? _mm_add_ps(g, d) : _mm_mul_ps(g, d);
+}
+
+static SSE2 inline void volume_ramp_s16ne_sse2(int16_t *samples, float *gains, const float *steps, unsigned channels, unsigned length, pa_volume_ramp_type_t t) {
+    float lanes[8], lane_steps[4];
+    __m128 g0, g1, d;
+    unsigned n;
+
+    n = length / sizeof(int16_t);
+
+    if (channels > 4 || channels == 3 || n < 8) {
+        ramp_fallback[PA_SAMPLE_S16NE][t](samples, gains, steps, channels, length);
+        return;
+    }
+
+    ramp_lanes(lanes, lane_steps, gains, steps, channels, t);
+    g0 = _mm_loadu_ps(lanes);
+    g1 = _mm_loadu_ps(lanes + 4);
+    d = _mm_loadu_ps(lane_steps);
+
+    for (; n >= 8; n -= 8, samples += 8) {
+        __m128i s, lo, hi;
+
+        s = _mm_loadu_si128((const __m128i*) samples);
+
+        /* Sign extend to 32 bit */
+        lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+
+        lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), g0));
+        hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), g1));
+
+        /* Packing saturates, which does the clamping for us */
+        _mm_storeu_si128((__m128i*) samples, _mm_packs_epi32(lo, hi));
+
+        g0 = ramp_advance(g0, d, t);
+        g1 = ramp_advance(g1, d, t);
+    }
+
+    /* The first lanes hold the gains for the next frame */
+    _mm_storeu_ps(lanes, g0);
+    memcpy(gains, lanes, channels * sizeof(float));
+
+    if (n > 0)
+        ramp_fallback[PA_SAMPLE_S16NE][t](samples, gains, steps, channels, n * sizeof(int16_t));
+}
+
+static SSE2 inline void volume_ramp_float32ne_sse2(float *samples, float *gains, const float *steps, unsigned channels, unsigned length, pa_volume_ramp_type_t t) {
+    float lanes[8], lane_steps[4];
+    __m128 g0, g1, d;
+    unsigned n;
+
+    n = length / sizeof(float);
+
+    if (channels > 4 || channels == 3 || n < 8) {
+        ramp_fallback[PA_SAMPLE_FLOAT32NE][t](samples, gains, steps, channels, length);
+        return;
+    }
+
+    ramp_lanes(lanes, lane_steps, gains, steps, channels, t);
+    g0 = _mm_loadu_ps(lanes);
+    g1 = _mm_loadu_ps(lanes + 4);
+    d = _mm_loadu_ps(lane_steps);
+
+    for (; n >= 8; n -= 8, samples += 8) {
+        _mm_storeu_ps(samples, _mm_mul_ps(_mm_loadu_ps(samples), g0));
+        _mm_storeu_ps(samples + 4, _mm_mul_ps(_mm_loadu_ps(samples + 4), g1));
+
+        g0 = ramp_advance(g0, d, t);
+        g1 = ramp_advance(g1, d, t);
+    }
+
+    _mm_storeu_ps(lanes, g0);
+    memcpy(gains, lanes, channels * sizeof(float));
+
+    if (n > 0)
+        ramp_fallback[PA_SAMPLE_FLOAT32NE][t](samples, gains, steps, channels, n * sizeof(float));
+}
+
+static SSE2 void pa_volume_ramp_linear_s16ne_sse2(int16_t *samples, float *gains, const float *steps, unsigned channels, unsigned length) {
+    volume_ramp_s16ne_sse2(samples, gains, steps, channels, length, PA_VOLUME_RAMP_LINEAR);
+}
+
+static SSE2 void pa_volume_ramp_log_s16ne_sse2(int16_t *samples, float *gains, const float *steps, unsigned channels, unsigned length) {
+    volume_ramp_s16ne_sse2(samples, gains, steps, channels, length, PA_VOLUME_RAMP_LOGARITHMIC);
+}
+
+static SSE2 void pa_volume_ramp_linear_float32ne_sse2(float *samples, float *gains, const float *steps, unsigned channels, unsigned length) {
+    volume_ramp_float32ne_sse2(samples, gains, steps, channels, length, PA_VOLUME_RAMP_LINEAR);
+}
+
+static SSE2 void pa_volume_ramp_log_float32ne_sse2(float *samples, float *gains, const float *steps, unsigned channels, unsigned length) {
+    volume_ramp_float32ne_sse2(samples, gains, steps, channels, length, PA_VOLUME_RAMP_LOGARITHMIC);
+}
+
+static void set_volume_ramp_func(pa_sample_format_t f, pa_volume_ramp_type_t t, pa_do_volume_ramp_func_t func) {
+    /* Don't end up calling ourselves for the remainder if we get
+     * initialised twice */
+    if (pa_get_volume_ramp_func(f, t) != func)
+        ramp_fallback[f][t] = pa_get_volume_ramp_func(f, t);
+    pa_set_volume_ramp_func(f, t, func);
+}
+
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 void pa_volume_func_init_sse(pa_cpu_x86_flag_t flags) {
@@ -261,6 +400,11 @@ void pa_volume_func_init_sse(pa_cpu_x86_flag_t flags) {
 
         pa_set_volume_func(PA_SAMPLE_S16NE, (pa_do_volume_func_t) pa_volume_s16ne_sse2);
         pa_set_volume_func(PA_SAMPLE_S16RE, (pa_do_volume_func_t) pa_volume_s16re_sse2);
+
+        set_volume_ramp_func(PA_SAMPLE_S16NE, PA_VOLUME_RAMP_LINEAR, (pa_do_volume_ramp_func_t) pa_volume_ramp_linear_s16ne_sse2);
+        set_volume_ramp_func(PA_SAMPLE_S16NE, PA_VOLUME_RAMP_LOGARITHMIC, (pa_do_volume_ramp_func_t) pa_volume_ramp_log_s16ne_sse2);
+        set_volume_ramp_func(PA_SAMPLE_FLOAT32NE, PA_VOLUME_RAMP_LINEAR, (pa_do_volume_ramp_func_t) pa_volume_ramp_linear_float32ne_sse2);
+        set_volume_ramp_func(PA_SAMPLE_FLOAT32NE, PA_VOLUME_RAMP_LOGARITHMIC, (pa_do_volume_ramp_func_t) pa_volume_ramp_log_float32ne_sse2);
     }
 #endif /* defined (__i386__) || defined (__amd64__) */
 }
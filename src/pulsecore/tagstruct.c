@@ -37,62 +37,93 @@
 
 #include <pulsecore/socket.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/flist.h>
 
 #include "tagstruct.h"
 
 #define MAX_TAG_SIZE (64*1024)
 
+/* Most commands and replies fit into this, introspection replies with
+ * property lists take a few KiB and are reached by doubling */
+#define INITIAL_SIZE 256
+
 struct pa_tagstruct {
     uint8_t *data;
     size_t length, allocated;
     size_t rindex;
 
+    /* Dynamic tagstructs are built right in the data of a packet, so
+     * that they can be sent without copying them again */
+    pa_packet *packet;
     pa_bool_t dynamic;
 };
 
+PA_STATIC_FLIST_DECLARE(tagstructs, 0, pa_xfree);
+
 pa_tagstruct *pa_tagstruct_new(const uint8_t* data, size_t length) {
     pa_tagstruct*t;
 
     pa_assert(!data || (data && length));
 
-    t = pa_xnew(pa_tagstruct, 1);
+    if (!(t = pa_flist_pop(PA_STATIC_FLIST_GET(tagstructs))))
+        t = pa_xnew(pa_tagstruct, 1);
+
     t->data = (uint8_t*) data;
     t->allocated = t->length = data ? length : 0;
     t->rindex = 0;
+    t->packet = NULL;
     t->dynamic = !data;
 
     return t;
 }
 
+static void release(pa_tagstruct *t) {
+    if (pa_flist_push(PA_STATIC_FLIST_GET(tagstructs), t) < 0)
+        pa_xfree(t);
+}
+
 void pa_tagstruct_free(pa_tagstruct*t) {
     pa_assert(t);
 
-    if (t->dynamic)
-        pa_xfree(t->data);
-    pa_xfree(t);
+    if (t->packet)
+        pa_packet_unref(t->packet);
+    release(t);
 }
 
-uint8_t* pa_tagstruct_free_data(pa_tagstruct*t, size_t *l) {
-    uint8_t *p;
+pa_packet* pa_tagstruct_free_to_packet(pa_tagstruct*t) {
+    pa_packet *p;
 
     pa_assert(t);
     pa_assert(t->dynamic);
-    pa_assert(l);
+    pa_assert(t->packet);
 
-    p = t->data;
-    *l = t->length;
-    pa_xfree(t);
+    /* The rest of the allocation is simply not sent */
+    p = t->packet;
+    p->length = t->length;
+
+    release(t);
     return p;
 }
 
 static void extend(pa_tagstruct*t, size_t l) {
+    size_t allocated;
+
     pa_assert(t);
     pa_assert(t->dynamic);
 
     if (t->length+l <= t->allocated)
         return;
 
-    t->data = pa_xrealloc(t->data, t->allocated = t->length+l+100);
+    allocated = PA_MAX(t->allocated*2, t->length+l);
+    allocated = PA_MAX(allocated, (size_t) INITIAL_SIZE);
+
+    if (t->packet)
+        t->packet = pa_packet_resize(t->packet, allocated);
+    else
+        t->packet = pa_packet_new(allocated);
+
+    t->data = t->packet->data;
+    t->allocated = allocated;
 }
 
 void pa_tagstruct_puts(pa_tagstruct*t, const char *s) {
@@ -150,7 +181,7 @@ void pa_tagstruct_put_arbitrary(pa_tagstruct *t, const void *p, size_t length) {
     uint32_t tmp;
 
     pa_assert(t);
-    pa_assert(p);
+    pa_assert(p || length == 0);
 
     extend(t, 5+length);
     t->data[t->length] = PA_TAG_ARBITRARY;
@@ -305,9 +336,7 @@ void pa_tagstruct_put_format_info(pa_tagstruct *t, pa_format_info *f) {
 }
 
 int pa_tagstruct_gets(pa_tagstruct*t, const char **s) {
-    int error = 0;
-    size_t n;
-    char *c;
+    const uint8_t *c, *e;
 
     pa_assert(t);
     pa_assert(s);
@@ -327,19 +356,15 @@ int pa_tagstruct_gets(pa_tagstruct*t, const char **s) {
     if (t->data[t->rindex] != PA_TAG_STRING)
         return -1;
 
-    error = 1;
-    for (n = 0, c = (char*) (t->data+t->rindex+1); t->rindex+1+n < t->length; n++, c++)
-        if (!*c) {
-            error = 0;
-            break;
-        }
+    c = t->data+t->rindex+1;
 
-    if (error)
+    if (!(e = memchr(c, 0, t->length-t->rindex-1)))
         return -1;
 
-    *s = (char*) (t->data+t->rindex+1);
+    /* No copy, the string stays in our data */
+    *s = (const char*) c;
 
-    t->rindex += n+2;
+    t->rindex += (size_t) (e-c)+2;
     return 0;
 }
 
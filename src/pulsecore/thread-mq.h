@@ -42,6 +42,10 @@ void pa_thread_mq_done(pa_thread_mq *q);
 /* Install the specified pa_thread_mq object for the current thread */
 void pa_thread_mq_install(pa_thread_mq *q);
 
+/* Remove the pa_thread_mq object installed for the current thread, for
+ * threads that work on behalf of different IO threads over time */
+void pa_thread_mq_uninstall(void);
+
 /* Return the pa_thread_mq object that is set for the current thread */
 pa_thread_mq *pa_thread_mq_get(void);
 
@@ -35,14 +35,14 @@
 #include <pulse/mainloop.h>
 
 #include <pulsecore/sink.h>
-
-/* Set the number of streams such that it allows two simultaneous instances of
- * connect-stress to be run and not go above the max limit for streams-per-sink.
- * This leaves enough room for a couple other streams from regular system usage,
- * which makes a non-error abort less likely (although still easily possible of
- * playing >=3 streams outside of the test - including internal loopback, rtp,
- * combine, remap streams etc.) */
-#define NSTREAMS ((PA_MAX_INPUTS_PER_SINK/2) - 1)
+#include <pulsecore/pstream.h>
+
+/* The number of streams used to be derived from the max limit for
+ * streams-per-sink, such that two simultaneous instances of connect-stress
+ * could run without going above it. That limit is much higher now, so the
+ * value it used to give is kept to not turn this into a much longer and
+ * different test. */
+#define NSTREAMS 15
 #define NTESTS 1000
 #define SAMPLE_HZ 44100
 
@@ -50,6 +50,7 @@ static pa_context *context = NULL;
 static pa_stream *streams[NSTREAMS];
 static pa_threaded_mainloop *mainloop = NULL;
 static char *bname;
+static uint64_t bytes_written = 0;
 
 static const pa_sample_spec sample_spec = {
     .format = PA_SAMPLE_FLOAT32,
@@ -59,7 +60,7 @@ static const pa_sample_spec sample_spec = {
 
 static void context_state_callback(pa_context *c, void *userdata);
 
-static void connect(const char *name, int *try) {
+static void connect_context(const char *name, int *try) {
     int ret;
     pa_mainloop_api *api;
 
@@ -123,6 +124,7 @@ static void stream_write_callback(pa_stream *stream, size_t nbytes, void *userda
     while (nbytes) {
         int n = PA_MIN(sizeof(silence), nbytes);
         pa_stream_write(stream, silence, n, NULL, 0, 0);
+        bytes_written += n;
         nbytes -= n;
     }
 }
@@ -192,18 +194,30 @@ static void context_state_callback(pa_context *c, void *userdata) {
 
 START_TEST (connect_stress_test) {
     int i;
+    const pa_pstream_stat *pstat;
+    double seconds;
 
     for (i = 0; i < NSTREAMS; i++)
         streams[i] = NULL;
 
     for (i = 0; i < NTESTS; i++) {
-        connect(bname, &i);
+        connect_context(bname, &i);
         usleep(rand() % 500000);
         disconnect();
         usleep(rand() % 500000);
     }
 
     fprintf(stderr, "Done.\n");
+
+    pstat = pa_pstream_get_stat();
+    seconds = (double) bytes_written / (double) pa_bytes_per_second(&sample_spec);
+
+    fprintf(stderr, "Socket calls: %u reads for %u frames, %u writes for %u frames, %.1f calls per second of audio.\n",
+            (unsigned) pa_atomic_load(&pstat->n_read_calls),
+            (unsigned) pa_atomic_load(&pstat->n_frames_read),
+            (unsigned) pa_atomic_load(&pstat->n_write_calls),
+            (unsigned) pa_atomic_load(&pstat->n_frames_written),
+            seconds > 0 ? (pa_atomic_load(&pstat->n_read_calls) + pa_atomic_load(&pstat->n_write_calls)) / seconds : 0.0);
 }
 END_TEST
 
@@ -35,6 +35,7 @@
 #include <pulsecore/remap.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/mix.h>
+#include <pulsecore/resampler.h>
 
 #define PA_CPU_TEST_RUN_START(l, t1, t2)                        \
 {                                                               \
@@ -250,6 +251,141 @@ START_TEST (svolume_orc_test) {
 }
 END_TEST
 
+/* Ramps from quiet to a bit above PA_VOLUME_NORM, to have the clamping
+ * checked too. The functions may add the steps up in a different order
+ * and hence are allowed to be off by a rounding error. */
+static void run_volume_ramp_test(
+        pa_do_volume_ramp_func_t func,
+        pa_do_volume_ramp_func_t orig_func,
+        pa_sample_format_t format,
+        pa_volume_ramp_type_t type,
+        int align,
+        int channels,
+        pa_bool_t correct,
+        pa_bool_t perf) {
+
+    PA_DECLARE_ALIGNED(8, float, s[SAMPLES]) = { 0 };
+    PA_DECLARE_ALIGNED(8, float, s_ref[SAMPLES]) = { 0 };
+    PA_DECLARE_ALIGNED(8, float, s_orig[SAMPLES]) = { 0 };
+    float start[PA_CHANNELS_MAX], steps[PA_CHANNELS_MAX];
+    float gains[PA_CHANNELS_MAX], gains_ref[PA_CHANNELS_MAX];
+    void *samples, *samples_ref, *samples_orig;
+    int i, nsamples, nframes, size;
+    size_t ss;
+
+    ss = pa_sample_size_of_format(format);
+
+    /* Force sample alignment as requested */
+    samples = (uint8_t*) s + (8 - align) * ss;
+    samples_ref = (uint8_t*) s_ref + (8 - align) * ss;
+    samples_orig = (uint8_t*) s_orig + (8 - align) * ss;
+    nsamples = SAMPLES - (8 - align);
+    if (nsamples % channels)
+        nsamples -= nsamples % channels;
+    nframes = nsamples / channels;
+    size = nsamples * ss;
+
+    if (format == PA_SAMPLE_FLOAT32NE) {
+        for (i = 0; i < nsamples; i++)
+            ((float*) samples_orig)[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+    } else
+        pa_random(samples_orig, size);
+
+    for (i = 0; i < channels; i++) {
+        start[i] = type == PA_VOLUME_RAMP_LINEAR ? 0.1f * (i + 1) : PA_VOLUME_RAMP_MIN_GAIN * (i + 1);
+        steps[i] = type == PA_VOLUME_RAMP_LINEAR ?
+            (1.2f - start[i]) / nframes :
+            powf(1.2f / start[i], 1.0f / nframes);
+    }
+
+    if (correct) {
+        memcpy(samples, samples_orig, size);
+        memcpy(samples_ref, samples_orig, size);
+        memcpy(gains, start, sizeof(start));
+        memcpy(gains_ref, start, sizeof(start));
+
+        orig_func(samples_ref, gains_ref, steps, channels, size);
+        func(samples, gains, steps, channels, size);
+
+        for (i = 0; i < nsamples; i++) {
+            pa_bool_t ok;
+
+            if (format == PA_SAMPLE_FLOAT32NE)
+                ok = fabsf(((float*) samples)[i] - ((float*) samples_ref)[i]) <= 1e-4f;
+            else
+                ok = abs(((int16_t*) samples)[i] - ((int16_t*) samples_ref)[i]) <= 1;
+
+            if (!ok) {
+                pa_log_debug("Correctness test failed: format=%s, type=%d, align=%d, channels=%d",
+                        pa_sample_format_to_string(format), type, align, channels);
+                pa_log_debug("%d: differs from the reference", i);
+                fail();
+            }
+        }
+
+        for (i = 0; i < channels; i++)
+            fail_unless(fabsf(gains[i] - gains_ref[i]) <= 1e-4f);
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %s svolume ramp %dch performance with %d sample alignment",
+                pa_sample_format_to_string(format), channels, align);
+
+        PA_CPU_TEST_RUN_START("func", TIMES, TIMES2) {
+            memcpy(samples, samples_orig, size);
+            memcpy(gains, start, sizeof(start));
+            func(samples, gains, steps, channels, size);
+        } PA_CPU_TEST_RUN_STOP
+
+        PA_CPU_TEST_RUN_START("orig", TIMES, TIMES2) {
+            memcpy(samples_ref, samples_orig, size);
+            memcpy(gains_ref, start, sizeof(start));
+            orig_func(samples_ref, gains_ref, steps, channels, size);
+        } PA_CPU_TEST_RUN_STOP
+    }
+}
+
+#if defined (__i386__) || defined (__amd64__)
+START_TEST (svolume_ramp_sse_test) {
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_S16NE, PA_SAMPLE_FLOAT32NE };
+    pa_do_volume_ramp_func_t orig_func[2][PA_VOLUME_RAMP_MAX], sse_func[2][PA_VOLUME_RAMP_MAX];
+    pa_cpu_x86_flag_t flags = 0;
+    unsigned f, t;
+    int i, j;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++)
+        for (t = 0; t < PA_VOLUME_RAMP_MAX; t++)
+            orig_func[f][t] = pa_get_volume_ramp_func(formats[f], t);
+
+    pa_volume_func_init_sse(flags);
+
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++)
+        for (t = 0; t < PA_VOLUME_RAMP_MAX; t++)
+            sse_func[f][t] = pa_get_volume_ramp_func(formats[f], t);
+
+    pa_log_debug("Checking SSE2 svolume ramps");
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++) {
+        for (t = 0; t < PA_VOLUME_RAMP_MAX; t++) {
+            for (i = 1; i <= 6; i++) {
+                for (j = 0; j < 7; j++)
+                    run_volume_ramp_test(sse_func[f][t], orig_func[f][t], formats[f], t, j, i, TRUE, FALSE);
+            }
+
+            run_volume_ramp_test(sse_func[f][t], orig_func[f][t], formats[f], t, 7, 1, TRUE, TRUE);
+            run_volume_ramp_test(sse_func[f][t], orig_func[f][t], formats[f], t, 7, 2, TRUE, TRUE);
+        }
+    }
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
 #undef SAMPLES
 #undef TIMES
 #undef TIMES2
@@ -849,6 +985,142 @@ END_TEST
 #endif /* defined (__arm__) && defined (__linux__) */
 /* End mix tests */
 
+/* Start resampler tests */
+#if defined (__i386__) || defined (__amd64__) || (defined (__arm__) && defined (__linux__) && defined (HAVE_NEON))
+#define DOT_TAPS 112
+#define DOT_TIMES 100000
+#define DOT_TIMES2 100
+
+static void run_resampler_dot_test(
+        pa_resampler_dot_func_t func,
+        pa_resampler_dot_func_t orig_func,
+        int align,
+        pa_bool_t correct,
+        pa_bool_t perf) {
+
+    PA_DECLARE_ALIGNED(16, float, in[DOT_TAPS + 4]);
+    PA_DECLARE_ALIGNED(16, float, coefs[DOT_TAPS]);
+    float *samples;
+    float sum = 0, sum_ref = 0;
+    unsigned n, i;
+
+    /* The history the resampler works on is not aligned */
+    samples = in + (4 - align);
+
+    for (i = 0; i < DOT_TAPS; i++) {
+        samples[i] = 2.0f * (float) rand() / RAND_MAX - 1.0f;
+        coefs[i] = 2.0f * (float) rand() / RAND_MAX - 1.0f;
+    }
+
+    if (correct) {
+        for (n = 16; n <= DOT_TAPS; n += 16) {
+            sum = func(samples, coefs, n);
+            sum_ref = orig_func(samples, coefs, n);
+
+            if (fabsf(sum - sum_ref) > 0.0001f) {
+                pa_log_debug("Correctness test failed: align=%d, n=%u", align, n);
+                pa_log_debug("%f != %f", sum, sum_ref);
+                fail();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing resampler dot product performance with %d sample alignment", align);
+
+        PA_CPU_TEST_RUN_START("func", DOT_TIMES, DOT_TIMES2) {
+            sum += func(samples, coefs, DOT_TAPS);
+        } PA_CPU_TEST_RUN_STOP
+
+        PA_CPU_TEST_RUN_START("orig", DOT_TIMES, DOT_TIMES2) {
+            sum_ref += orig_func(samples, coefs, DOT_TAPS);
+        } PA_CPU_TEST_RUN_STOP
+
+        /* Keep the compiler from dropping the loops */
+        pa_log_debug("(%f %f)", sum, sum_ref);
+    }
+}
+#endif
+
+#if defined (__i386__) || defined (__amd64__)
+START_TEST (resampler_sse_test) {
+    pa_resampler_dot_func_t orig_func, sse_func;
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE)) {
+        pa_log_info("SSE not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_resampler_dot_func();
+    pa_resampler_func_init_sse(flags & ~PA_CPU_X86_AVX);
+    sse_func = pa_get_resampler_dot_func();
+
+    pa_log_debug("Checking SSE resampler dot product");
+    run_resampler_dot_test(sse_func, orig_func, 0, TRUE, FALSE);
+    run_resampler_dot_test(sse_func, orig_func, 1, TRUE, FALSE);
+    run_resampler_dot_test(sse_func, orig_func, 3, TRUE, TRUE);
+
+    pa_set_resampler_dot_func(orig_func);
+}
+END_TEST
+
+START_TEST (resampler_avx_test) {
+    pa_resampler_dot_func_t orig_func, avx_func;
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX)) {
+        pa_log_info("AVX not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_resampler_dot_func();
+    pa_resampler_func_init_sse(flags);
+    avx_func = pa_get_resampler_dot_func();
+
+    pa_log_debug("Checking AVX resampler dot product");
+    run_resampler_dot_test(avx_func, orig_func, 0, TRUE, FALSE);
+    run_resampler_dot_test(avx_func, orig_func, 1, TRUE, FALSE);
+    run_resampler_dot_test(avx_func, orig_func, 3, TRUE, TRUE);
+
+    pa_set_resampler_dot_func(orig_func);
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+#if defined (__arm__) && defined (__linux__)
+#ifdef HAVE_NEON
+START_TEST (resampler_neon_test) {
+    pa_resampler_dot_func_t orig_func, neon_func;
+    pa_cpu_arm_flag_t flags = 0;
+
+    pa_cpu_get_arm_flags(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_resampler_dot_func();
+    pa_resampler_func_init_neon(flags);
+    neon_func = pa_get_resampler_dot_func();
+
+    pa_log_debug("Checking NEON resampler dot product");
+    run_resampler_dot_test(neon_func, orig_func, 0, TRUE, FALSE);
+    run_resampler_dot_test(neon_func, orig_func, 1, TRUE, FALSE);
+    run_resampler_dot_test(neon_func, orig_func, 3, TRUE, TRUE);
+
+    pa_set_resampler_dot_func(orig_func);
+}
+END_TEST
+#endif /* HAVE_NEON */
+#endif /* defined (__arm__) && defined (__linux__) */
+/* End resampler tests */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -865,6 +1137,7 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, svolume_mmx_test);
     tcase_add_test(tc, svolume_sse_test);
+    tcase_add_test(tc, svolume_ramp_sse_test);
 #endif
 #if defined (__arm__) && defined (__linux__)
     tcase_add_test(tc, svolume_arm_test);
@@ -901,6 +1174,19 @@ int main(int argc, char *argv[]) {
 #if HAVE_NEON
     tcase_add_test(tc, mix_neon_test);
 #endif
+#endif
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+    /* Resampler tests */
+    tc = tcase_create("resampler");
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, resampler_sse_test);
+    tcase_add_test(tc, resampler_avx_test);
+#endif
+#if defined (__arm__) && defined (__linux__)
+#if HAVE_NEON
+    tcase_add_test(tc, resampler_neon_test);
+#endif
 #endif
     tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
@@ -0,0 +1,200 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+
+#include <pulsecore/iochannel.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#ifdef HAVE_CREDS
+
+/* We pass copies of the write end of a pipe. Once all of them are
+ * closed, the read end sees EOF, hence we can tell if the iochannel
+ * leaked any. */
+struct fixture {
+    pa_mainloop *m;
+    int sockets[2];
+    int pipe[2];
+    pa_iochannel *io;
+};
+
+static void fixture_setup(struct fixture *f) {
+    f->m = pa_mainloop_new();
+    fail_unless(f->m != NULL);
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, f->sockets) == 0);
+    fail_unless(pipe(f->pipe) == 0);
+    pa_make_fd_nonblock(f->pipe[0]);
+
+    f->io = pa_iochannel_new(pa_mainloop_get_api(f->m), f->sockets[0], -1);
+    fail_unless(f->io != NULL);
+}
+
+static void fixture_teardown(struct fixture *f) {
+    if (f->io)
+        pa_iochannel_free(f->io);
+
+    pa_close(f->sockets[1]);
+    pa_close(f->pipe[0]);
+    pa_mainloop_free(f->m);
+}
+
+/* Closes our own write end and checks that no copy is left */
+static pa_bool_t all_copies_closed(struct fixture *f) {
+    char c;
+
+    pa_close(f->pipe[1]);
+    return read(f->pipe[0], &c, 1) == 0;
+}
+
+/* Sends n copies of the write end of the pipe with one byte of data */
+static void send_fds(struct fixture *f, unsigned n) {
+    struct msghdr mh;
+    struct iovec iov;
+    union {
+        struct cmsghdr hdr;
+        uint8_t data[CMSG_SPACE(sizeof(int) * 4)];
+    } cmsg;
+    char c = 'x';
+    unsigned i;
+
+    pa_assert(n <= 4);
+
+    pa_zero(iov);
+    iov.iov_base = &c;
+    iov.iov_len = 1;
+
+    pa_zero(cmsg);
+    cmsg.hdr.cmsg_len = CMSG_LEN(sizeof(int) * n);
+    cmsg.hdr.cmsg_level = SOL_SOCKET;
+    cmsg.hdr.cmsg_type = SCM_RIGHTS;
+
+    for (i = 0; i < n; i++)
+        memcpy(CMSG_DATA(&cmsg.hdr) + sizeof(int) * i, &f->pipe[1], sizeof(int));
+
+    pa_zero(mh);
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = &cmsg;
+    mh.msg_controllen = CMSG_SPACE(sizeof(int) * n);
+
+    fail_unless(sendmsg(f->sockets[1], &mh, 0) == 1);
+}
+
+static void receive(struct fixture *f) {
+    char c;
+    pa_creds creds;
+    pa_bool_t creds_valid;
+
+    fail_unless(pa_iochannel_read_with_creds(f->io, &c, 1, &creds, &creds_valid) == 1);
+    fail_unless(c == 'x');
+}
+
+START_TEST (too_many_fds_test) {
+    struct fixture f;
+    int fds[4];
+    unsigned i, n;
+
+    fixture_setup(&f);
+
+    /* The fds beyond PA_IOCHANNEL_FDS_MAX are closed right away */
+    send_fds(&f, PA_IOCHANNEL_FDS_MAX + 1);
+    receive(&f);
+
+    n = pa_iochannel_steal_received_fds(f.io, fds, PA_ELEMENTSOF(fds));
+    fail_unless(n == PA_IOCHANNEL_FDS_MAX);
+
+    for (i = 0; i < n; i++)
+        pa_close(fds[i]);
+
+    fail_unless(all_copies_closed(&f));
+    fixture_teardown(&f);
+}
+END_TEST
+
+START_TEST (untaken_fds_test) {
+    struct fixture f;
+    int fd;
+
+    fixture_setup(&f);
+
+    /* fds nobody took are closed when the next ones arrive... */
+    send_fds(&f, 2);
+    receive(&f);
+    send_fds(&f, 1);
+    receive(&f);
+
+    fail_unless(pa_iochannel_steal_received_fds(f.io, &fd, 1) == 1);
+    pa_close(fd);
+
+    /* ...when the caller takes fewer than were passed... */
+    send_fds(&f, 2);
+    receive(&f);
+    fail_unless(pa_iochannel_steal_received_fds(f.io, &fd, 1) == 1);
+    pa_close(fd);
+
+    /* ...and when the iochannel is freed */
+    send_fds(&f, 1);
+    receive(&f);
+    pa_iochannel_free(f.io);
+    f.io = NULL;
+
+    fail_unless(all_copies_closed(&f));
+    fixture_teardown(&f);
+}
+END_TEST
+
+#endif
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("IO Channel");
+    tc = tcase_create("iochannel");
+#ifdef HAVE_CREDS
+    tcase_add_test(tc, too_many_fds_test);
+    tcase_add_test(tc, untaken_fds_test);
+#endif
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
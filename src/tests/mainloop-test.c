@@ -22,8 +22,11 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <dirent.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <assert.h>
 #include <check.h>
 
@@ -32,6 +35,7 @@
 
 #include <pulsecore/core-util.h>
 #include <pulsecore/core-rtclock.h>
+#include <pulsecore/macro.h>
 
 #ifdef GLIB_MAIN_LOOP
 
@@ -122,6 +126,335 @@ START_TEST (mainloop_test) {
 }
 END_TEST
 
+#ifndef GLIB_MAIN_LOOP
+
+/* Lots of idle connections and one busy one, like a daemon with many
+ * clients connected. Each pipe takes two fds. */
+#define N_PIPES 400
+#define N_WAKEUPS 10000
+
+/* Makes sure we may open n more fds than the few we use anyway */
+static pa_bool_t enough_fds(unsigned n) {
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0)
+        return FALSE;
+
+    n += 64;
+
+    if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < n) {
+        if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < n)
+            return FALSE;
+
+        rl.rlim_cur = n;
+
+        if (setrlimit(RLIMIT_NOFILE, &rl) < 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Counts our epoll fds, to see which backend a main loop uses. Returns
+ * -1 if we can't tell. */
+static int n_epoll_fds(void) {
+#ifdef __linux__
+    DIR *d;
+    struct dirent *entry;
+    int n = 0;
+
+    if (!(d = opendir("/proc/self/fd")))
+        return -1;
+
+    while ((entry = readdir(d))) {
+        char path[64], target[64];
+        ssize_t l;
+
+        pa_snprintf(path, sizeof(path), "/proc/self/fd/%s", entry->d_name);
+
+        if ((l = readlink(path, target, sizeof(target) - 1)) < 0)
+            continue;
+
+        target[l] = 0;
+
+        if (pa_streq(target, "anon_inode:[eventpoll]"))
+            n++;
+    }
+
+    closedir(d);
+    return n;
+#else
+    return -1;
+#endif
+}
+
+static unsigned n_dispatched;
+
+static void pipe_cb(pa_mainloop_api*a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    unsigned char c;
+
+    pa_assert_se(read(fd, &c, sizeof(c)) == 1);
+    pa_assert_se(c == (unsigned char) PA_PTR_TO_UINT(userdata));
+    n_dispatched++;
+}
+
+static pa_usec_t run_many_fds(pa_bool_t epoll) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    pa_io_event *ioe[N_PIPES];
+    int pipes[N_PIPES][2];
+    pa_usec_t start, stop;
+    unsigned i;
+    int n_epoll;
+
+    if (epoll)
+        setenv("PULSE_MAINLOOP_EPOLL", "1", 1);
+    else
+        unsetenv("PULSE_MAINLOOP_EPOLL");
+
+    n_epoll = n_epoll_fds();
+    fail_unless((m = pa_mainloop_new()) != NULL);
+    a = pa_mainloop_get_api(m);
+
+    for (i = 0; i < N_PIPES; i++) {
+        fail_unless(pipe(pipes[i]) == 0);
+        ioe[i] = a->io_new(a, pipes[i][0], PA_IO_EVENT_INPUT, pipe_cb, PA_UINT_TO_PTR(i & 0xFF));
+    }
+
+    /* Freeing and adding an io event for the same fd again must work */
+    a->io_free(ioe[0]);
+    ioe[0] = a->io_new(a, pipes[0][0], PA_IO_EVENT_INPUT, pipe_cb, PA_UINT_TO_PTR(0));
+
+    /* Disabled io events must not fire */
+    a->io_enable(ioe[1], 0);
+    fail_unless(write(pipes[1][1], "\1", 1) == 1);
+    fail_unless(pa_mainloop_iterate(m, 0, NULL) == 0);
+    a->io_enable(ioe[1], PA_IO_EVENT_INPUT);
+    fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+
+    n_dispatched = 0;
+    start = pa_rtclock_now();
+
+    for (i = 0; i < N_WAKEUPS; i++) {
+        unsigned char c = (unsigned char) ((i * 7) % N_PIPES);
+
+        fail_unless(write(pipes[(i * 7) % N_PIPES][1], &c, 1) == 1);
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) == 1);
+    }
+
+    stop = pa_rtclock_now();
+    fail_unless(n_dispatched == N_WAKEUPS);
+
+    /* Make sure we measured what we meant to, i.e. the main loop
+     * didn't fall back to poll() */
+    if (n_epoll >= 0)
+        fail_unless(n_epoll_fds() == n_epoll + (epoll ? 1 : 0));
+
+    for (i = 0; i < N_PIPES; i++) {
+        a->io_free(ioe[i]);
+        pa_close_pipe(pipes[i]);
+    }
+
+    pa_mainloop_free(m);
+
+    return stop - start;
+}
+
+START_TEST (many_fds_test) {
+    pa_usec_t t_poll, t_epoll;
+
+    if (!enough_fds(2 * N_PIPES)) {
+        fprintf(stderr, "Not enough fds allowed, skipping.\n");
+        return;
+    }
+
+    t_poll = run_many_fds(FALSE);
+    t_epoll = run_many_fds(TRUE);
+
+    fprintf(stderr, "%u wakeups with %u fds: poll() %llu usec, epoll %llu usec\n",
+            N_WAKEUPS, N_PIPES, (unsigned long long) t_poll, (unsigned long long) t_epoll);
+
+    unsetenv("PULSE_MAINLOOP_EPOLL");
+}
+END_TEST
+
+static void closed_fd_cb(pa_mainloop_api*a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    unsigned char c;
+
+    /* Freed io events must never be dispatched */
+    fail_unless(PA_PTR_TO_UINT(userdata) != 0);
+
+    pa_assert_se(read(fd, &c, sizeof(c)) == 1);
+    n_dispatched++;
+}
+
+/* Dispatches what is pending. Bounded, so that a stale registration
+ * that fires all the time shows up as a failure instead of a hang. */
+static void iterate_all(pa_mainloop *m) {
+    unsigned i;
+
+    for (i = 0; i < 10; i++)
+        if (pa_mainloop_iterate(m, 0, NULL) <= 0)
+            break;
+}
+
+START_TEST (closed_fd_test) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    pa_io_event *e1, *e2, *e3;
+    int pipe1[2], pipe2[2], pipe3[2], dup_fd, n_epoll;
+
+    setenv("PULSE_MAINLOOP_EPOLL", "1", 1);
+    n_epoll = n_epoll_fds();
+    fail_unless((m = pa_mainloop_new()) != NULL);
+    a = pa_mainloop_get_api(m);
+
+    /* The owner closes the fd before freeing the io event, while a dup
+     * of it is still open, so the kernel keeps the registration */
+    fail_unless(pipe(pipe1) == 0);
+    fail_unless((dup_fd = dup(pipe1[0])) >= 0);
+    e1 = a->io_new(a, pipe1[0], PA_IO_EVENT_INPUT, closed_fd_cb, PA_UINT_TO_PTR(0));
+    pa_close(pipe1[0]);
+    a->io_free(e1);
+
+    /* A new io event gets the same fd number */
+    fail_unless(pipe(pipe2) == 0);
+    fail_unless(pipe2[0] == pipe1[0]);
+    e2 = a->io_new(a, pipe2[0], PA_IO_EVENT_INPUT, closed_fd_cb, PA_UINT_TO_PTR(2));
+
+    n_dispatched = 0;
+    fail_unless(write(pipe1[1], "x", 1) == 1);
+    fail_unless(write(pipe2[1], "x", 1) == 1);
+    iterate_all(m);
+    fail_unless(n_dispatched == 1);
+
+    /* Once more without the dup: the kernel forgets about the closed
+     * fd and another io event registers the same number, which must
+     * stay registered when the old io event is freed */
+    pa_close(pipe2[0]);
+    fail_unless(pipe(pipe3) == 0);
+    fail_unless(pipe3[0] == pipe2[0]);
+    e3 = a->io_new(a, pipe3[0], PA_IO_EVENT_INPUT, closed_fd_cb, PA_UINT_TO_PTR(3));
+    a->io_free(e2);
+
+    n_dispatched = 0;
+    fail_unless(write(pipe3[1], "x", 1) == 1);
+    iterate_all(m);
+    fail_unless(n_dispatched == 1);
+
+    /* All this without falling back to poll() */
+    if (n_epoll >= 0)
+        fail_unless(n_epoll_fds() == n_epoll + 1);
+
+    a->io_free(e3);
+    pa_mainloop_free(m);
+
+    pa_close(dup_fd);
+    pa_close(pipe1[1]);
+    pa_close(pipe2[1]);
+    pa_close_pipe(pipe3);
+    unsetenv("PULSE_MAINLOOP_EPOLL");
+}
+END_TEST
+
+#define N_TIMERS 1000
+
+static pa_time_event *timers[N_TIMERS];
+static pa_usec_t last_fired;
+static unsigned n_fired;
+
+static void timer_cb(pa_mainloop_api*a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    unsigned i = PA_PTR_TO_UINT(userdata);
+    struct timeval ttv = *tv;
+    pa_usec_t t;
+
+    ttv.tv_usec &= ~PA_TIMEVAL_RTCLOCK;
+    t = pa_timeval_load(&ttv);
+
+    /* In order, and never early */
+    fail_unless(t >= last_fired);
+    fail_unless(pa_rtclock_now() >= t);
+    last_fired = t;
+    n_fired++;
+
+    /* Shake up the events that are still pending a bit */
+    if (i % 3 == 0 && i + 1 < N_TIMERS && timers[i + 1]) {
+        a->time_free(timers[i + 1]);
+        timers[i + 1] = NULL;
+    } else if (i % 3 == 1 && i + 1 < N_TIMERS && timers[i + 1])
+        a->time_restart(timers[i + 1], NULL);
+
+    a->time_free(e);
+    timers[i] = NULL;
+}
+
+START_TEST (time_events_test) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    pa_usec_t now, start, stop;
+    struct timeval tv;
+    unsigned i, j, n_disabled = 0, n_freed = 0;
+
+    fail_unless((m = pa_mainloop_new()) != NULL);
+    a = pa_mainloop_get_api(m);
+
+    now = pa_rtclock_now();
+
+    for (i = 0; i < N_TIMERS; i++)
+        timers[i] = a->time_new(a, NULL, timer_cb, PA_UINT_TO_PTR(i));
+
+    /* Lots of restarts, as streams updating their timing info do */
+    start = pa_rtclock_now();
+    for (j = 0; j < 100; j++)
+        for (i = 0; i < N_TIMERS; i++)
+            a->time_restart(timers[i], pa_timeval_rtstore(&tv, now + 20 * PA_USEC_PER_MSEC + ((i * 7919 + j * 104729) % 50000), TRUE));
+    stop = pa_rtclock_now();
+
+    fprintf(stderr, "%u time event restarts with %u events: %llu usec\n",
+            100 * N_TIMERS, N_TIMERS, (unsigned long long) (stop - start));
+
+    for (i = 0; i < N_TIMERS; i++)
+        if (i % 3 == 2)
+            a->time_restart(timers[i], NULL), n_disabled++;
+
+    last_fired = 0;
+    n_fired = 0;
+
+    while (n_fired + n_disabled + n_freed < N_TIMERS) {
+        fail_unless(pa_mainloop_iterate(m, 1, NULL) >= 0);
+
+        for (i = 0, n_freed = 0; i < N_TIMERS; i++)
+            if (!timers[i])
+                n_freed++;
+        n_freed -= n_fired;
+    }
+
+    for (i = 0; i < N_TIMERS; i++)
+        if (timers[i])
+            a->time_free(timers[i]);
+
+    /* With enough slack, events due close to each other are
+     * dispatched in one go */
+    pa_mainloop_set_timer_slack(m, 50 * PA_USEC_PER_MSEC);
+    n_fired = 0;
+    last_fired = 0;
+    now = pa_rtclock_now();
+
+    timers[2] = a->time_new(a, pa_timeval_rtstore(&tv, now + 10 * PA_USEC_PER_MSEC, TRUE), timer_cb, PA_UINT_TO_PTR(2));
+    timers[5] = a->time_new(a, pa_timeval_rtstore(&tv, now + 30 * PA_USEC_PER_MSEC, TRUE), timer_cb, PA_UINT_TO_PTR(5));
+    timers[8] = a->time_new(a, pa_timeval_rtstore(&tv, now + 500 * PA_USEC_PER_MSEC, TRUE), timer_cb, PA_UINT_TO_PTR(8));
+
+    fail_unless(pa_mainloop_iterate(m, 1, NULL) == 2);
+    fail_unless(n_fired == 2);
+    fail_unless(timers[8] != NULL);
+
+    a->time_free(timers[8]);
+    pa_mainloop_free(m);
+}
+END_TEST
+
+#endif /* GLIB_MAIN_LOOP */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -131,6 +464,11 @@ int main(int argc, char *argv[]) {
     s = suite_create("MainLoop");
     tc = tcase_create("mainloop");
     tcase_add_test(tc, mainloop_test);
+#ifndef GLIB_MAIN_LOOP
+    tcase_add_test(tc, many_fds_test);
+    tcase_add_test(tc, closed_fd_test);
+    tcase_add_test(tc, time_events_test);
+#endif
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -22,6 +22,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <check.h>
@@ -29,8 +30,11 @@
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/log.h>
+#include <pulsecore/core-util.h>
 #include <pulsecore/memblock.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/semaphore.h>
+#include <pulsecore/thread.h>
 
 static void release_cb(pa_memimport *i, uint32_t block_id, void *userdata) {
     pa_log("%s: Imported block %u is released.", (char*) userdata, block_id);
@@ -54,6 +58,11 @@ static void print_stats(pa_mempool *p, const char *text) {
                  "\texported_size = %u\n"
                  "\tn_too_large_for_pool = %u\n"
                  "\tn_pool_full = %u\n"
+                 "\tn_segments = %u\n"
+                 "\tn_slot_caches = %u\n"
+                 "\tn_slot_cache_hits = %u\n"
+                 "\tn_slot_cache_refills = %u\n"
+                 "\tn_slot_cache_drains = %u\n"
                  "}",
            text,
            (unsigned) pa_atomic_load(&s->n_allocated),
@@ -65,7 +74,12 @@ static void print_stats(pa_mempool *p, const char *text) {
            (unsigned) pa_atomic_load(&s->imported_size),
            (unsigned) pa_atomic_load(&s->exported_size),
            (unsigned) pa_atomic_load(&s->n_too_large_for_pool),
-           (unsigned) pa_atomic_load(&s->n_pool_full));
+           (unsigned) pa_atomic_load(&s->n_pool_full),
+           (unsigned) pa_atomic_load(&s->n_segments),
+           (unsigned) pa_atomic_load(&s->n_slot_caches),
+           (unsigned) pa_atomic_load(&s->n_slot_cache_hits),
+           (unsigned) pa_atomic_load(&s->n_slot_cache_refills),
+           (unsigned) pa_atomic_load(&s->n_slot_cache_drains));
 }
 
 START_TEST (memblock_test) {
@@ -124,7 +138,7 @@ START_TEST (memblock_test) {
         import_c = pa_memimport_new(pool_c, release_cb, (void*) "C");
         fail_unless(import_b != NULL);
 
-        r = pa_memexport_put(export_a, mb_a, &id, &shm_id, &offset, &size);
+        r = pa_memexport_put(export_a, mb_a, &id, &shm_id, &offset, &size, NULL);
         fail_unless(r >= 0);
         fail_unless(shm_id == id_a);
 
@@ -132,7 +146,7 @@ START_TEST (memblock_test) {
 
         mb_b = pa_memimport_get(import_b, id, shm_id, offset, size);
         fail_unless(mb_b != NULL);
-        r = pa_memexport_put(export_b, mb_b, &id, &shm_id, &offset, &size);
+        r = pa_memexport_put(export_b, mb_b, &id, &shm_id, &offset, &size, NULL);
         fail_unless(r >= 0);
         fail_unless(shm_id == id_a || shm_id == id_b);
         pa_memblock_unref(mb_b);
@@ -177,6 +191,351 @@ START_TEST (memblock_test) {
 }
 END_TEST
 
+/* Number of slots in a pool of the default size */
+#define POOL_SLOTS 1024
+
+#define CACHE_THREADS 4
+#define CACHE_ROUNDS 10000
+#define CACHE_BLOCKS 24
+
+static void slot_cache_thread(void *userdata) {
+    pa_mempool *pool = userdata;
+    pa_memblock *blocks[CACHE_BLOCKS];
+    unsigned i, j;
+
+    for (i = 0; i < CACHE_ROUNDS; i++) {
+        unsigned n = 1 + i % CACHE_BLOCKS;
+
+        for (j = 0; j < n; j++) {
+            fail_unless((blocks[j] = pa_memblock_new_pool(pool, 1024)) != NULL);
+            *(unsigned*) pa_memblock_acquire(blocks[j]) = i;
+            pa_memblock_release(blocks[j]);
+        }
+
+        for (j = 0; j < n; j++)
+            pa_memblock_unref(blocks[j]);
+    }
+}
+
+START_TEST (slot_cache_test) {
+    pa_mempool *pool;
+    const pa_mempool_stat *s;
+    pa_thread *threads[CACHE_THREADS];
+    pa_memblock **blocks;
+    unsigned i, n;
+
+    pool = pa_mempool_new(FALSE, 0);
+    fail_unless(pool != NULL);
+    s = pa_mempool_get_stat(pool);
+
+    /* Don't grow, we want to see the pool getting full */
+    pa_mempool_set_max_size(pool, 1);
+
+    for (i = 0; i < CACHE_THREADS; i++)
+        fail_unless((threads[i] = pa_thread_new("slot-cache", slot_cache_thread, pool)) != NULL);
+
+    slot_cache_thread(pool);
+
+    for (i = 0; i < CACHE_THREADS; i++)
+        pa_thread_free(threads[i]);
+
+    print_stats(pool, "slot cache");
+
+    /* Only the cache of this thread is left, and most allocations were
+     * served from the caches */
+    fail_unless(pa_atomic_load(&s->n_slot_caches) == 1);
+    fail_unless(pa_atomic_load(&s->n_allocated) == 0);
+    fail_unless(pa_atomic_load(&s->n_slot_cache_refills) > 0);
+    fail_unless(pa_atomic_load(&s->n_slot_cache_drains) > 0);
+    fail_unless(pa_atomic_load(&s->n_slot_cache_hits) > pa_atomic_load(&s->n_slot_cache_refills) * 4);
+
+    /* The slots returned by the threads that exited are still usable */
+    blocks = pa_xnew(pa_memblock*, POOL_SLOTS * 2);
+
+    for (n = 0; n < POOL_SLOTS * 2; n++)
+        if (!(blocks[n] = pa_memblock_new_pool(pool, (size_t) -1)))
+            break;
+
+    fail_unless(n >= POOL_SLOTS);
+    fail_unless(n < POOL_SLOTS * 2);
+    fail_unless(pa_atomic_load(&s->n_pool_full) == 1);
+
+    for (i = 0; i < n; i++)
+        pa_memblock_unref(blocks[i]);
+
+    pa_xfree(blocks);
+    pa_mempool_free(pool);
+}
+END_TEST
+
+struct parked_thread {
+    pa_mempool *pool;
+    pa_semaphore *parked, *resume;
+};
+
+static void parked_thread(void *userdata) {
+    struct parked_thread *t = userdata;
+
+    /* Leave some slots in our cache and sleep while the pool goes away */
+    slot_cache_thread(t->pool);
+    pa_semaphore_post(t->parked);
+    pa_semaphore_wait(t->resume);
+
+    /* Now use a new pool, the dead cache must not get in the way */
+    slot_cache_thread(t->pool);
+}
+
+START_TEST (slot_cache_free_test) {
+    struct parked_thread t;
+    pa_mempool *other;
+    const pa_mempool_stat *s;
+    pa_thread *thread;
+
+    t.pool = pa_mempool_new(FALSE, 0);
+    fail_unless(t.pool != NULL);
+    t.parked = pa_semaphore_new(0);
+    t.resume = pa_semaphore_new(0);
+
+    /* A second pool used by both threads, which keeps its caches */
+    other = pa_mempool_new(FALSE, 0);
+    fail_unless(other != NULL);
+    s = pa_mempool_get_stat(other);
+
+    fail_unless((thread = pa_thread_new("slot-cache-parked", parked_thread, &t)) != NULL);
+    slot_cache_thread(other);
+    slot_cache_thread(t.pool);
+    pa_semaphore_wait(t.parked);
+
+    /* Both threads still hold caches of the pool we free */
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(t.pool)->n_slot_caches) == 2);
+    pa_mempool_free(t.pool);
+
+    t.pool = other;
+    pa_semaphore_post(t.resume);
+    pa_thread_free(thread);
+
+    /* Only our cache is left after the other thread exited */
+    fail_unless(pa_atomic_load(&s->n_slot_caches) == 1);
+    fail_unless(pa_atomic_load(&s->n_allocated) == 0);
+
+    pa_mempool_free(other);
+    pa_semaphore_free(t.parked);
+    pa_semaphore_free(t.resume);
+}
+END_TEST
+
+#define SMALL_SIZE 256
+#define LARGE_SIZE (512*1024)
+
+START_TEST (size_class_test) {
+    pa_mempool *pool_a, *pool_b;
+    pa_memexport *export_a;
+    pa_memimport *import_b;
+    pa_memblock **blocks, *mb_a, *mb_b;
+    uint32_t id, shm_id;
+    size_t offset, size;
+    uint8_t *x, *y;
+    unsigned i;
+
+    pool_a = pa_mempool_new(TRUE, 0);
+    fail_unless(pool_a != NULL);
+    pool_b = pa_mempool_new(TRUE, 0);
+    fail_unless(pool_b != NULL);
+
+    /* Small blocks don't take away default slots */
+    blocks = pa_xnew(pa_memblock*, POOL_SLOTS * 2);
+
+    for (i = 0; i < POOL_SLOTS; i++)
+        fail_unless((blocks[i] = pa_memblock_new_pool(pool_a, SMALL_SIZE)) != NULL);
+
+    for (i = POOL_SLOTS; i < POOL_SLOTS * 2; i++)
+        fail_unless((blocks[i] = pa_memblock_new_pool(pool_a, pa_mempool_block_size_max(pool_a))) != NULL);
+
+    for (i = 0; i < POOL_SLOTS * 2; i++)
+        pa_memblock_unref(blocks[i]);
+
+    pa_xfree(blocks);
+
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool_a)->n_pool_full) == 0);
+
+    /* Blocks larger than a default slot live in the pool too and can
+     * be exported */
+    mb_a = pa_memblock_new_pool(pool_a, LARGE_SIZE);
+    fail_unless(mb_a != NULL);
+
+    x = pa_memblock_acquire(mb_a);
+    for (i = 0; i < LARGE_SIZE; i++)
+        x[i] = (uint8_t) i;
+    pa_memblock_release(mb_a);
+
+    export_a = pa_memexport_new(pool_a, revoke_cb, (void*) "A");
+    fail_unless(export_a != NULL);
+    import_b = pa_memimport_new(pool_b, release_cb, (void*) "B");
+    fail_unless(import_b != NULL);
+
+    fail_unless(pa_memexport_put(export_a, mb_a, &id, &shm_id, &offset, &size, NULL) >= 0);
+    fail_unless(size == LARGE_SIZE);
+
+    mb_b = pa_memimport_get(import_b, id, shm_id, offset, size);
+    fail_unless(mb_b != NULL);
+
+    x = pa_memblock_acquire(mb_a);
+    y = pa_memblock_acquire(mb_b);
+    fail_unless(memcmp(x, y, LARGE_SIZE) == 0);
+    pa_memblock_release(mb_b);
+    pa_memblock_release(mb_a);
+
+    pa_memblock_unref(mb_b);
+    pa_memimport_free(import_b);
+    pa_memblock_unref(mb_a);
+    pa_memexport_free(export_a);
+
+    pa_mempool_free(pool_a);
+    pa_mempool_free(pool_b);
+}
+END_TEST
+
+#define GROW_SEGMENTS 2
+
+START_TEST (grow_test) {
+    pa_mempool *pool_a, *pool_b;
+    const pa_mempool_stat *s;
+    pa_memexport *export_a;
+    pa_memimport *import_b;
+    pa_memblock **blocks, *mb_b;
+    uint32_t id, shm_id, first_shm_id;
+    size_t offset, size;
+    unsigned i, n, max;
+
+    pool_a = pa_mempool_new(TRUE, 0);
+    fail_unless(pool_a != NULL);
+    pool_b = pa_mempool_new(TRUE, 0);
+    fail_unless(pool_b != NULL);
+
+    s = pa_mempool_get_stat(pool_a);
+    fail_unless(pa_atomic_load(&s->n_segments) == 1);
+    fail_unless(pa_mempool_get_shm_id(pool_a, &first_shm_id) == 0);
+
+    /* Segments are about one and a half times the default size, leave
+     * room for two of them */
+    pa_mempool_set_max_size(pool_a, GROW_SEGMENTS * 64 * 1024 * POOL_SLOTS * 3 / 2);
+
+    max = POOL_SLOTS * (GROW_SEGMENTS + 1) * 2;
+    blocks = pa_xnew(pa_memblock*, max);
+
+    for (n = 0; n < max; n++)
+        if (!(blocks[n] = pa_memblock_new_pool(pool_a, pa_mempool_block_size_max(pool_a))))
+            break;
+
+    print_stats(pool_a, "grown");
+
+    fail_unless(pa_atomic_load(&s->n_segments) == GROW_SEGMENTS);
+    fail_unless(n >= POOL_SLOTS * GROW_SEGMENTS);
+    fail_unless(n < max);
+
+    /* The last block lives in the new segment, which importers attach
+     * by its own shm ID */
+    export_a = pa_memexport_new(pool_a, revoke_cb, (void*) "A");
+    fail_unless(export_a != NULL);
+    import_b = pa_memimport_new(pool_b, release_cb, (void*) "B");
+    fail_unless(import_b != NULL);
+
+    *(unsigned*) pa_memblock_acquire(blocks[n-1]) = 0xdeadbeef;
+    pa_memblock_release(blocks[n-1]);
+
+    fail_unless(pa_memexport_put(export_a, blocks[n-1], &id, &shm_id, &offset, &size, NULL) >= 0);
+    fail_unless(shm_id != first_shm_id);
+
+    mb_b = pa_memimport_get(import_b, id, shm_id, offset, size);
+    fail_unless(mb_b != NULL);
+    fail_unless(*(unsigned*) pa_memblock_acquire(mb_b) == 0xdeadbeef);
+    pa_memblock_release(mb_b);
+    pa_memblock_unref(mb_b);
+
+    pa_memimport_free(import_b);
+    pa_memexport_free(export_a);
+
+    for (i = 0; i < n; i++)
+        pa_memblock_unref(blocks[i]);
+
+    pa_xfree(blocks);
+
+    pa_mempool_free(pool_a);
+    pa_mempool_free(pool_b);
+}
+END_TEST
+
+START_TEST (memfd_test) {
+    pa_mempool *pool_a, *pool_b;
+    pa_memexport *export_a;
+    pa_memimport *import_b;
+    pa_memblock *mb_a, *mb_b;
+    uint32_t id, shm_id;
+    size_t offset, size;
+    int memfd, fds[2];
+    uint8_t *x, *y;
+
+    if (!(pool_a = pa_mempool_new_memfd(0))) {
+        pa_log_info("No memfd support, skipping.");
+        return;
+    }
+
+    pool_b = pa_mempool_new(TRUE, 0);
+    fail_unless(pool_b != NULL);
+
+    fail_unless(pa_mempool_is_shared(pool_a));
+    fail_unless(pa_mempool_is_memfd(pool_a));
+    fail_unless(!pa_mempool_is_memfd(pool_b));
+
+    mb_a = pa_memblock_new_pool(pool_a, 1024);
+    fail_unless(mb_a != NULL);
+
+    x = pa_memblock_acquire(mb_a);
+    memset(x, 'A', 1024);
+    pa_memblock_release(mb_a);
+
+    export_a = pa_memexport_new(pool_a, revoke_cb, (void*) "A");
+    fail_unless(export_a != NULL);
+    import_b = pa_memimport_new(pool_b, release_cb, (void*) "B");
+    fail_unless(import_b != NULL);
+
+    fail_unless(pa_memexport_put(export_a, mb_a, &id, &shm_id, &offset, &size, &memfd) >= 0);
+    fail_unless(memfd >= 0);
+
+    /* The segment has no name, it can only be reached through the fd */
+    fail_unless(pa_memimport_get(import_b, id, shm_id, offset, size) == NULL);
+
+    /* Anything that isn't a sealed memfd is refused */
+    fail_unless(pipe(fds) == 0);
+    pa_close(fds[1]);
+    fail_unless(pa_memimport_attach_memfd(import_b, shm_id, fds[0]) < 0);
+
+    fail_unless(pa_memimport_attach_memfd(import_b, shm_id, dup(memfd)) == 0);
+
+    mb_b = pa_memimport_get(import_b, id, shm_id, offset, size);
+    fail_unless(mb_b != NULL);
+
+    x = pa_memblock_acquire(mb_a);
+    y = pa_memblock_acquire(mb_b);
+    fail_unless(memcmp(x, y, 1024) == 0);
+    pa_memblock_release(mb_b);
+    pa_memblock_release(mb_a);
+
+    /* The segment stays attached after its last block is gone */
+    pa_memblock_unref(mb_b);
+    mb_b = pa_memimport_get(import_b, id, shm_id, offset, size);
+    fail_unless(mb_b != NULL);
+    pa_memblock_unref(mb_b);
+
+    pa_memimport_free(import_b);
+    pa_memblock_unref(mb_a);
+    pa_memexport_free(export_a);
+
+    pa_mempool_free(pool_a);
+    pa_mempool_free(pool_b);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -189,6 +548,11 @@ int main(int argc, char *argv[]) {
     s = suite_create("Memblock");
     tc = tcase_create("memblock");
     tcase_add_test(tc, memblock_test);
+    tcase_add_test(tc, slot_cache_test);
+    tcase_add_test(tc, slot_cache_free_test);
+    tcase_add_test(tc, size_class_test);
+    tcase_add_test(tc, grow_test);
+    tcase_add_test(tc, memfd_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
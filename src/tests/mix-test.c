@@ -26,14 +26,18 @@
 
 #include <check.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/sample.h>
 #include <pulse/volume.h>
+#include <pulse/xmalloc.h>
 
 #include <pulsecore/macro.h>
+#include <pulsecore/random.h>
 #include <pulsecore/endianmacros.h>
 #include <pulsecore/memblock.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/mix.h>
+#include <pulsecore/cpu-x86.h>
 
 
 /* PA_SAMPLE_U8 */
@@ -466,6 +470,326 @@ START_TEST (mix_test) {
 }
 END_TEST
 
+#define TIERED_FRAMES 1024
+#define TIERED_WORK (64 * 1024)
+
+static void run_tiered_mix_test(pa_mempool *pool, unsigned nstreams) {
+    pa_sample_spec ss;
+    pa_cvolume volume;
+    pa_mix_info *m;
+    int16_t *out, *out_ref;
+    size_t length;
+    unsigned i, j, times;
+    pa_usec_t start, stop;
+
+    ss.format = PA_SAMPLE_S16NE;
+    ss.rate = 48000;
+    ss.channels = 2;
+    length = TIERED_FRAMES * pa_frame_size(&ss);
+
+    pa_cvolume_set(&volume, ss.channels, pa_sw_volume_from_linear(0.8));
+
+    m = pa_xnew(pa_mix_info, nstreams);
+    out = pa_xmalloc(length);
+    out_ref = pa_xmalloc(length);
+
+    for (i = 0; i < nstreams; i++) {
+        int16_t *d;
+
+        m[i].chunk.memblock = pa_memblock_new(pool, length);
+        m[i].chunk.index = 0;
+        m[i].chunk.length = length;
+        pa_cvolume_set(&m[i].volume, ss.channels, pa_sw_volume_from_linear(0.5 + (double) i / (2 * nstreams)));
+
+        /* Keep the samples quiet enough so that no tier clips and the
+         * result is comparable with a single pass of pa_mix() */
+        d = pa_memblock_acquire(m[i].chunk.memblock);
+        pa_random(d, length);
+        for (j = 0; j < TIERED_FRAMES * ss.channels; j++)
+            d[j] >>= 9;
+        pa_memblock_release(m[i].chunk.memblock);
+    }
+
+    fail_unless(pa_mix(m, nstreams, out_ref, length, &ss, &volume, FALSE) == length);
+    fail_unless(pa_mix_tiered(pool, m, nstreams, out, length, &ss, &volume, FALSE) == length);
+    fail_unless(memcmp(out, out_ref, length) == 0);
+
+    /* Do the same amount of work for each stream count, so that the
+     * cost per stream can be compared directly */
+    times = PA_MAX(TIERED_WORK / nstreams, 1U);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < times; i++)
+        pa_mix_tiered(pool, m, nstreams, out, length, &ss, &volume, FALSE);
+    stop = pa_rtclock_now();
+
+    pa_log_debug("tiered mix of %u streams: %llu usec for %u runs, %g nsec per stream and frame",
+                 nstreams, (unsigned long long) (stop - start), times,
+                 (double) (stop - start) * 1000 / ((double) times * nstreams * TIERED_FRAMES));
+
+    for (i = 0; i < nstreams; i++)
+        pa_memblock_unref(m[i].chunk.memblock);
+
+    pa_xfree(m);
+    pa_xfree(out);
+    pa_xfree(out_ref);
+}
+
+START_TEST (mix_tiered_test) {
+    pa_mempool *pool;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    fail_unless((pool = pa_mempool_new(FALSE, 0)) != NULL, NULL);
+
+    run_tiered_mix_test(pool, 8);
+    run_tiered_mix_test(pool, 32);
+    run_tiered_mix_test(pool, 128);
+    run_tiered_mix_test(pool, 512);
+
+    pa_mempool_free(pool);
+}
+END_TEST
+
+#define VOLUME_FRAMES 8192
+#define VOLUME_TIMES 1000
+
+START_TEST (mix_volume_test) {
+    pa_mempool *pool;
+    pa_sample_spec ss;
+    pa_cvolume volume;
+    pa_mix_info m;
+    pa_memchunk c;
+    int16_t *in, *out, *out_ref;
+    size_t length;
+    unsigned i;
+    pa_usec_t start, stop;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    fail_unless((pool = pa_mempool_new(FALSE, 0)) != NULL, NULL);
+
+    ss.format = PA_SAMPLE_S16NE;
+    ss.rate = 48000;
+    ss.channels = 2;
+    length = VOLUME_FRAMES * pa_frame_size(&ss);
+
+    /* A single input with a sink volume that is not unity, as rendered
+     * by pa_sink_render_into() */
+    m.chunk.memblock = pa_memblock_new(pool, length);
+    m.chunk.index = 0;
+    m.chunk.length = length;
+    pa_cvolume_set(&m.volume, ss.channels, pa_sw_volume_from_linear(1.5));
+    pa_cvolume_set(&volume, ss.channels, pa_sw_volume_from_linear(0.9));
+
+    in = pa_memblock_acquire(m.chunk.memblock);
+    pa_random(in, length);
+    pa_memblock_release(m.chunk.memblock);
+
+    out = pa_xmalloc(length);
+    out_ref = pa_xmalloc(length);
+
+    fail_unless(pa_mix(&m, 1, out, length, &ss, &volume, FALSE) == length);
+
+    /* The old way: copy, then adjust the volume of the copy */
+    c.memblock = pa_memblock_new(pool, length);
+    c.index = 0;
+    c.length = length;
+
+    memcpy(pa_memblock_acquire(c.memblock), pa_memblock_acquire(m.chunk.memblock), length);
+    pa_memblock_release(c.memblock);
+    pa_memblock_release(m.chunk.memblock);
+
+    pa_sw_cvolume_multiply(&volume, &volume, &m.volume);
+    pa_volume_memchunk(&c, &ss, &volume);
+
+    memcpy(out_ref, pa_memblock_acquire(c.memblock), length);
+    pa_memblock_release(c.memblock);
+
+    /* The volumes are combined at different precision, so allow the
+     * results to be off by one */
+    for (i = 0; i < VOLUME_FRAMES * ss.channels; i++)
+        fail_unless(abs(out[i] - out_ref[i]) <= 1);
+
+    pa_cvolume_set(&volume, ss.channels, pa_sw_volume_from_linear(0.9));
+
+    start = pa_rtclock_now();
+    for (i = 0; i < VOLUME_TIMES; i++)
+        pa_mix(&m, 1, out, length, &ss, &volume, FALSE);
+    stop = pa_rtclock_now();
+    pa_log_debug("mix with volume: %llu usec for %u runs", (unsigned long long) (stop - start), VOLUME_TIMES);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < VOLUME_TIMES; i++) {
+        memcpy(pa_memblock_acquire(c.memblock), pa_memblock_acquire(m.chunk.memblock), length);
+        pa_memblock_release(m.chunk.memblock);
+        pa_memblock_release(c.memblock);
+        pa_volume_memchunk(&c, &ss, &m.volume);
+        memcpy(out, pa_memblock_acquire(c.memblock), length);
+        pa_memblock_release(c.memblock);
+    }
+    stop = pa_rtclock_now();
+    pa_log_debug("copy, volume and copy: %llu usec for %u runs", (unsigned long long) (stop - start), VOLUME_TIMES);
+
+    pa_memblock_unref(c.memblock);
+    pa_memblock_unref(m.chunk.memblock);
+    pa_xfree(out);
+    pa_xfree(out_ref);
+
+    pa_mempool_free(pool);
+}
+END_TEST
+
+#if defined (__i386__) || defined (__amd64__)
+#define SIMD_SAMPLES 1027
+#define SIMD_STREAMS 5
+
+static void fill_simd_samples(pa_sample_format_t f, void *d, unsigned n) {
+    unsigned i;
+
+    pa_random(d, n * pa_sample_size_of_format(f));
+
+    /* Random bits would give us NaNs and huge floats, keep them
+     * in a sensible range instead */
+    if (f == PA_SAMPLE_FLOAT32NE || f == PA_SAMPLE_FLOAT32RE) {
+        uint32_t *u = d;
+        float *p = d;
+
+        for (i = 0; i < n; i++) {
+            float v = (int16_t) u[i] / 16384.0f;
+
+            p[i] = PA_MAYBE_FLOAT32_SWAP(f == PA_SAMPLE_FLOAT32RE, v);
+        }
+    }
+}
+
+static void compare_simd_samples(pa_sample_format_t f, const void *a, const void *b, unsigned n) {
+    unsigned i;
+
+    if (f != PA_SAMPLE_FLOAT32NE && f != PA_SAMPLE_FLOAT32RE) {
+        fail_unless(memcmp(a, b, n * pa_sample_size_of_format(f)) == 0);
+        return;
+    }
+
+    /* The vectorized float mixers may use fused multiply-adds, so allow
+     * for the rounding errors of the individual products */
+    for (i = 0; i < n; i++) {
+        float fa = ((const float*) a)[i], fb = ((const float*) b)[i];
+
+        if (f == PA_SAMPLE_FLOAT32RE) {
+            fa = PA_FLOAT32_SWAP(fa);
+            fb = PA_FLOAT32_SWAP(fb);
+        }
+
+        fail_unless(fabsf(fa - fb) <= 1e-5f);
+    }
+}
+
+static void run_simd_mix_test(pa_mempool *pool, pa_sample_format_t f, pa_do_mix_func_t orig_func, pa_do_mix_func_t simd_func) {
+    pa_sample_spec ss;
+    pa_cvolume volume;
+    pa_mix_info m[SIMD_STREAMS];
+    void *out, *out_ref;
+    size_t length;
+    unsigned i, channels, nstreams, frames;
+
+    ss.format = f;
+    ss.rate = 48000;
+
+    for (channels = 1; channels <= 8; channels++) {
+        ss.channels = channels;
+
+        /* Cover the vector loop as well as the remainder */
+        for (frames = 1; frames <= SIMD_SAMPLES / channels; frames += frames < 40 ? 1 : 97) {
+            length = frames * pa_frame_size(&ss);
+            out = pa_xmalloc(length);
+            out_ref = pa_xmalloc(length);
+
+            for (nstreams = 1; nstreams <= SIMD_STREAMS; nstreams += 2) {
+                for (i = 0; i < nstreams; i++) {
+                    unsigned c;
+
+                    m[i].chunk.memblock = pa_memblock_new(pool, length);
+                    m[i].chunk.index = 0;
+                    m[i].chunk.length = length;
+
+                    /* Go above PA_VOLUME_NORM so that the result clips */
+                    m[i].volume.channels = channels;
+                    for (c = 0; c < channels; c++)
+                        m[i].volume.values[c] = (pa_volume_t) (rand() % (2 * PA_VOLUME_NORM));
+
+                    fill_simd_samples(f, pa_memblock_acquire(m[i].chunk.memblock), frames * channels);
+                    pa_memblock_release(m[i].chunk.memblock);
+                }
+
+                pa_cvolume_set(&volume, channels, pa_sw_volume_from_linear(0.9));
+
+                fail_unless(pa_mix(m, nstreams, out_ref, length, &ss, &volume, FALSE) == length);
+                pa_set_mix_func(f, simd_func);
+                fail_unless(pa_mix(m, nstreams, out, length, &ss, &volume, FALSE) == length);
+                pa_set_mix_func(f, orig_func);
+
+                compare_simd_samples(f, out, out_ref, frames * channels);
+
+                for (i = 0; i < nstreams; i++)
+                    pa_memblock_unref(m[i].chunk.memblock);
+            }
+
+            pa_xfree(out);
+            pa_xfree(out_ref);
+        }
+    }
+
+    pa_log_debug("Checked optimized mixing function for %s", pa_sample_format_to_string(f));
+}
+
+START_TEST (mix_simd_test) {
+    /* Check each instruction set on its own, from oldest to newest */
+    static const pa_cpu_x86_flag_t masks[] = {
+        PA_CPU_X86_SSE2,
+        PA_CPU_X86_SSE2 | PA_CPU_X86_AVX2,
+        PA_CPU_X86_SSE2 | PA_CPU_X86_AVX2 | PA_CPU_X86_AVX512F | PA_CPU_X86_AVX512BW
+    };
+    pa_cpu_x86_flag_t flags = 0;
+    pa_do_mix_func_t orig_funcs[PA_SAMPLE_MAX], simd_funcs[PA_SAMPLE_MAX];
+    pa_mempool *pool;
+    pa_sample_format_t f;
+    unsigned i;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_cpu_get_x86_flags(&flags);
+
+    fail_unless((pool = pa_mempool_new(FALSE, 0)) != NULL, NULL);
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++)
+        orig_funcs[f] = pa_get_mix_func(f);
+
+    for (i = 0; i < PA_ELEMENTSOF(masks); i++) {
+        if ((flags & masks[i]) != masks[i])
+            break;
+
+        pa_mix_func_init_sse(masks[i]);
+        pa_mix_func_init_avx(masks[i]);
+
+        for (f = 0; f < PA_SAMPLE_MAX; f++) {
+            simd_funcs[f] = pa_get_mix_func(f);
+            pa_set_mix_func(f, orig_funcs[f]);
+        }
+
+        for (f = 0; f < PA_SAMPLE_MAX; f++)
+            if (simd_funcs[f] != orig_funcs[f])
+                run_simd_mix_test(pool, f, orig_funcs[f], simd_funcs[f]);
+    }
+
+    pa_mempool_free(pool);
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -475,6 +799,12 @@ int main(int argc, char *argv[]) {
     s = suite_create("Mix");
     tc = tcase_create("mix");
     tcase_add_test(tc, mix_test);
+    tcase_add_test(tc, mix_tiered_test);
+    tcase_add_test(tc, mix_volume_test);
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, mix_simd_test);
+#endif
+    tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -0,0 +1,400 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+
+#include <pulsecore/pstream.h>
+#include <pulsecore/iochannel.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#define N_PACKETS_MAX 16
+#define MEMBLOCK_CHANNEL 7
+#define MEMBLOCK_BYTES 60000
+#define ITERATIONS_MAX 1000
+
+/* Every frame starts with five 32 bit integers */
+#define DESCRIPTOR_SIZE (5 * sizeof(uint32_t))
+#define PACKET_FRAME_SIZE (DESCRIPTOR_SIZE + sizeof(uint32_t))
+
+/* What the reader got with a packet, whose payload is its number */
+struct received_packet {
+    uint32_t index;
+    size_t memblock_bytes_before;
+    pa_bool_t creds_valid;
+    pa_creds creds;
+    unsigned n_fds;
+    ino_t fd_inode;
+};
+
+/* Two pstreams on the ends of a socket pair. They have a main loop
+ * each, so that we can let the writer run while the reader waits. */
+struct fixture {
+    pa_mainloop *writer_m, *reader_m;
+    pa_mempool *pool;
+    int sockets[2];
+    pa_iochannel *reader_io;
+    pa_pstream *writer, *reader;
+
+    struct received_packet packets[N_PACKETS_MAX];
+    unsigned n_packets;
+
+    uint8_t memblock_data[MEMBLOCK_BYTES];
+    size_t memblock_bytes;
+
+    pa_pstream_stat stat;
+};
+
+static void packet_cb(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
+    struct fixture *f = userdata;
+    struct received_packet *r;
+    int fd;
+
+    fail_unless(f->n_packets < N_PACKETS_MAX);
+    fail_unless(packet->length == sizeof(uint32_t));
+
+    r = &f->packets[f->n_packets++];
+    r->index = ntohl(*(uint32_t*) packet->data);
+    r->memblock_bytes_before = f->memblock_bytes;
+
+    if ((r->creds_valid = !!creds))
+        r->creds = *creds;
+
+    r->n_fds = 0;
+
+#ifdef HAVE_CREDS
+    if ((r->n_fds = pa_pstream_steal_packet_fds(p, &fd, 1)) > 0) {
+        struct stat st;
+
+        fail_unless(fstat(fd, &st) == 0);
+        r->fd_inode = st.st_ino;
+        pa_close(fd);
+    }
+#endif
+}
+
+static void memblock_cb(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    struct fixture *f = userdata;
+    const uint8_t *d;
+
+    fail_unless(channel == MEMBLOCK_CHANNEL);
+    fail_unless(f->memblock_bytes + chunk->length <= MEMBLOCK_BYTES);
+
+    /* Only the first piece of a frame has the seek info */
+    if (f->memblock_bytes == 0) {
+        fail_unless(offset == 4711);
+        fail_unless(seek == PA_SEEK_RELATIVE_ON_READ);
+    }
+
+    d = pa_memblock_acquire_chunk(chunk);
+    memcpy(f->memblock_data + f->memblock_bytes, d, chunk->length);
+    pa_memblock_release(chunk->memblock);
+
+    f->memblock_bytes += chunk->length;
+}
+
+static void die_cb(pa_pstream *p, void *userdata) {
+    fail("pstream died");
+}
+
+static void fixture_setup(struct fixture *f) {
+    pa_iochannel *io;
+
+    pa_zero(*f);
+    fail_unless((f->writer_m = pa_mainloop_new()) != NULL);
+    fail_unless((f->reader_m = pa_mainloop_new()) != NULL);
+    fail_unless((f->pool = pa_mempool_new(FALSE, 0)) != NULL);
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, f->sockets) == 0);
+
+    fail_unless((io = pa_iochannel_new(pa_mainloop_get_api(f->writer_m), f->sockets[0], f->sockets[0])) != NULL);
+    fail_unless((f->writer = pa_pstream_new(pa_mainloop_get_api(f->writer_m), io, f->pool)) != NULL);
+
+    fail_unless((f->reader_io = pa_iochannel_new(pa_mainloop_get_api(f->reader_m), f->sockets[1], f->sockets[1])) != NULL);
+    fail_unless((f->reader = pa_pstream_new(pa_mainloop_get_api(f->reader_m), f->reader_io, f->pool)) != NULL);
+
+    pa_pstream_set_die_callback(f->writer, die_cb, f);
+    pa_pstream_set_die_callback(f->reader, die_cb, f);
+    pa_pstream_set_receive_packet_callback(f->reader, packet_cb, f);
+    pa_pstream_set_receive_memblock_callback(f->reader, memblock_cb, f);
+}
+
+static void fixture_teardown(struct fixture *f) {
+    pa_pstream_unlink(f->writer);
+    pa_pstream_unref(f->writer);
+    pa_pstream_unlink(f->reader);
+    pa_pstream_unref(f->reader);
+
+    pa_mempool_free(f->pool);
+    pa_mainloop_free(f->writer_m);
+    pa_mainloop_free(f->reader_m);
+}
+
+static void take_stat(struct fixture *f) {
+    const pa_pstream_stat *s = pa_pstream_get_stat();
+
+    pa_atomic_store(&f->stat.n_read_calls, pa_atomic_load(&s->n_read_calls));
+    pa_atomic_store(&f->stat.n_frames_read, pa_atomic_load(&s->n_frames_read));
+    pa_atomic_store(&f->stat.n_write_calls, pa_atomic_load(&s->n_write_calls));
+    pa_atomic_store(&f->stat.n_frames_written, pa_atomic_load(&s->n_frames_written));
+}
+
+#define STAT_DELTA(f, field) (pa_atomic_load(&pa_pstream_get_stat()->field) - pa_atomic_load(&(f)->stat.field))
+
+static void send_packet(struct fixture *f, uint32_t index, const pa_creds *creds) {
+    pa_packet *packet;
+
+    packet = pa_packet_new(sizeof(uint32_t));
+    *(uint32_t*) packet->data = htonl(index);
+    pa_pstream_send_packet(f->writer, packet, creds);
+    pa_packet_unref(packet);
+}
+
+#ifdef HAVE_CREDS
+static void send_packet_with_fd(struct fixture *f, uint32_t index, int fd) {
+    pa_packet *packet;
+
+    packet = pa_packet_new(sizeof(uint32_t));
+    *(uint32_t*) packet->data = htonl(index);
+    fail_unless(pa_pstream_send_packet_with_fds(f->writer, packet, &fd, 1) == 0);
+    pa_packet_unref(packet);
+}
+#endif
+
+/* Lets the writer run until it has written everything */
+static void run_writer(struct fixture *f) {
+    unsigned i;
+
+    for (i = 0; i < ITERATIONS_MAX && pa_pstream_is_pending(f->writer); i++)
+        fail_unless(pa_mainloop_iterate(f->writer_m, 0, NULL) >= 0);
+
+    fail_unless(!pa_pstream_is_pending(f->writer));
+}
+
+/* Lets both run until the reader has n packets */
+static void run_until_packets(struct fixture *f, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < ITERATIONS_MAX && f->n_packets < n; i++) {
+        fail_unless(pa_mainloop_iterate(f->writer_m, 0, NULL) >= 0);
+        fail_unless(pa_mainloop_iterate(f->reader_m, 0, NULL) >= 0);
+    }
+
+    fail_unless(f->n_packets == n);
+}
+
+START_TEST (batch_test) {
+    struct fixture f;
+    unsigned i;
+
+    fixture_setup(&f);
+    take_stat(&f);
+
+    /* Everything that is queued goes out with a single writev()... */
+    for (i = 0; i < 10; i++)
+        send_packet(&f, i, NULL);
+
+    run_writer(&f);
+
+    fail_unless(STAT_DELTA(&f, n_write_calls) == 1);
+    fail_unless(STAT_DELTA(&f, n_frames_written) == 10);
+
+    /* ...and comes back in with a single read */
+    run_until_packets(&f, 10);
+
+    fail_unless(STAT_DELTA(&f, n_read_calls) == 1);
+    fail_unless(STAT_DELTA(&f, n_frames_read) == 10);
+
+    for (i = 0; i < 10; i++)
+        fail_unless(f.packets[i].index == i);
+
+    fixture_teardown(&f);
+}
+END_TEST
+
+START_TEST (partial_write_test) {
+    struct fixture f;
+    pa_memchunk chunk;
+    uint8_t *d;
+    int sndbuf = 4096, queued;
+    unsigned i;
+
+    fixture_setup(&f);
+    take_stat(&f);
+
+    /* Much less than the memblock frame */
+    fail_unless(setsockopt(f.sockets[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) == 0);
+
+    chunk.memblock = pa_memblock_new(f.pool, MEMBLOCK_BYTES);
+    chunk.index = 0;
+    chunk.length = MEMBLOCK_BYTES;
+
+    d = pa_memblock_acquire(chunk.memblock);
+    for (i = 0; i < MEMBLOCK_BYTES; i++)
+        d[i] = (uint8_t) (i * 7 + i / 256);
+    pa_memblock_release(chunk.memblock);
+
+    send_packet(&f, 0, NULL);
+    pa_pstream_send_memblock(f.writer, MEMBLOCK_CHANNEL, 4711, PA_SEEK_RELATIVE_ON_READ, &chunk);
+    send_packet(&f, 1, NULL);
+
+    /* The writer gets stuck in the middle of the memblock frame */
+    for (i = 0; i < 10; i++)
+        fail_unless(pa_mainloop_iterate(f.writer_m, 0, NULL) >= 0);
+
+    fail_unless(pa_pstream_is_pending(f.writer));
+    fail_unless(ioctl(f.sockets[1], FIONREAD, &queued) == 0);
+    fail_unless((size_t) queued > PACKET_FRAME_SIZE + DESCRIPTOR_SIZE);
+    fail_unless((size_t) queued < PACKET_FRAME_SIZE + DESCRIPTOR_SIZE + MEMBLOCK_BYTES);
+
+    /* Then picks up where it stopped, as the reader makes room */
+    run_until_packets(&f, 2);
+
+    fail_unless(STAT_DELTA(&f, n_write_calls) > 1);
+    fail_unless(STAT_DELTA(&f, n_frames_written) == 3);
+
+    fail_unless(f.packets[0].index == 0);
+    fail_unless(f.packets[0].memblock_bytes_before == 0);
+    fail_unless(f.packets[1].index == 1);
+    fail_unless(f.packets[1].memblock_bytes_before == MEMBLOCK_BYTES);
+
+    d = pa_memblock_acquire(chunk.memblock);
+    fail_unless(memcmp(d, f.memblock_data, MEMBLOCK_BYTES) == 0);
+    pa_memblock_release(chunk.memblock);
+
+    pa_memblock_unref(chunk.memblock);
+    fixture_teardown(&f);
+}
+END_TEST
+
+#ifdef HAVE_CREDS
+
+START_TEST (fds_creds_test) {
+    struct fixture f;
+    int pipes[2][2];
+    struct stat st[2];
+    pa_creds creds;
+    unsigned i;
+
+    fixture_setup(&f);
+
+    pa_pstream_enable_shm(f.writer, TRUE);
+    pa_pstream_enable_memfd(f.writer, TRUE);
+    pa_pstream_enable_shm(f.reader, TRUE);
+    pa_pstream_enable_memfd(f.reader, TRUE);
+    fail_unless(pa_iochannel_creds_enable(f.reader_io) == 0);
+
+    for (i = 0; i < 2; i++) {
+        fail_unless(pipe(pipes[i]) == 0);
+        fail_unless(fstat(pipes[i][1], &st[i]) == 0);
+    }
+
+    creds.uid = getuid();
+    creds.gid = getgid();
+
+    take_stat(&f);
+
+    /* Frames with fds or creds go out in writes of their own, the ones
+     * in between are batched */
+    send_packet(&f, 0, NULL);
+    send_packet_with_fd(&f, 1, pipes[0][1]);
+    send_packet(&f, 2, NULL);
+    send_packet(&f, 3, NULL);
+    send_packet(&f, 4, &creds);
+    send_packet(&f, 5, NULL);
+    send_packet(&f, 6, NULL);
+    send_packet_with_fd(&f, 7, pipes[1][1]);
+    send_packet(&f, 8, NULL);
+    send_packet(&f, 9, NULL);
+
+    run_writer(&f);
+    fail_unless(STAT_DELTA(&f, n_write_calls) == 7);
+
+    /* The reader reads ahead over several of them, the fds still end
+     * up with their own packet */
+    run_until_packets(&f, 10);
+    fail_unless(STAT_DELTA(&f, n_read_calls) < 10);
+
+    for (i = 0; i < 10; i++) {
+        fail_unless(f.packets[i].index == i);
+
+        if (i == 1 || i == 7) {
+            fail_unless(f.packets[i].n_fds == 1);
+            fail_unless(f.packets[i].fd_inode == st[i == 1 ? 0 : 1].st_ino);
+        } else
+            fail_unless(f.packets[i].n_fds == 0);
+    }
+
+    fail_unless(f.packets[4].creds_valid);
+    fail_unless(f.packets[4].creds.uid == creds.uid);
+    fail_unless(f.packets[4].creds.gid == creds.gid);
+
+    for (i = 0; i < 2; i++) {
+        pa_close(pipes[i][0]);
+        pa_close(pipes[i][1]);
+    }
+
+    fixture_teardown(&f);
+}
+END_TEST
+
+#endif
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Packet Stream");
+    tc = tcase_create("pstream");
+    tcase_add_test(tc, batch_test);
+    tcase_add_test(tc, partial_write_test);
+#ifdef HAVE_CREDS
+    tcase_add_test(tc, fds_creds_test);
+#endif
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,119 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <stdlib.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/render-pool.h>
+#include <pulsecore/thread-mq.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#define N_JOBS 1000
+#define N_RUNS 100
+
+static pa_render_pool *pool;
+static pa_thread_mq thread_mq;
+
+static pa_atomic_t counts[N_JOBS];
+static pa_atomic_t wrong_mq;
+static pa_atomic_t nested_ran;
+
+static void count_job(unsigned idx, void *userdata) {
+    pa_assert(idx < N_JOBS);
+    pa_assert(userdata == counts);
+
+    pa_atomic_inc(&counts[idx]);
+
+    if (pa_thread_mq_get() != &thread_mq)
+        pa_atomic_inc(&wrong_mq);
+}
+
+static void nested_job(unsigned idx, void *userdata) {
+    /* The pool is busy with our own batch */
+    if (pa_render_pool_run(pool, N_JOBS, count_job, counts, NULL) == 0)
+        pa_atomic_inc(&nested_ran);
+}
+
+START_TEST (render_pool_test) {
+    unsigned i, j;
+    pa_usec_t join_wait;
+
+    pool = pa_render_pool_new(3, FALSE, 0);
+    fail_unless(pool != NULL);
+    fail_unless(pa_render_pool_get_n_threads(pool) == 3);
+
+    pa_thread_mq_install(&thread_mq);
+
+    /* Every job runs exactly once, with the caller's pa_thread_mq */
+    for (j = 0; j < N_RUNS; j++) {
+        for (i = 0; i < N_JOBS; i++)
+            pa_atomic_store(&counts[i], 0);
+
+        fail_unless(pa_render_pool_run(pool, N_JOBS, count_job, counts, &join_wait) == 0);
+
+        for (i = 0; i < N_JOBS; i++)
+            fail_unless(pa_atomic_load(&counts[i]) == 1);
+    }
+
+    fail_unless(pa_atomic_load(&wrong_mq) == 0);
+
+    /* Batches smaller than the pool */
+    pa_atomic_store(&counts[0], 0);
+    fail_unless(pa_render_pool_run(pool, 1, count_job, counts, NULL) == 0);
+    fail_unless(pa_atomic_load(&counts[0]) == 1);
+    fail_unless(pa_render_pool_run(pool, 0, count_job, counts, NULL) == 0);
+    fail_unless(pa_atomic_load(&counts[0]) == 1);
+
+    /* A busy pool refuses instead of blocking */
+    fail_unless(pa_render_pool_run(pool, 8, nested_job, NULL, NULL) == 0);
+    fail_unless(pa_atomic_load(&nested_ran) == 0);
+
+    pa_thread_mq_uninstall();
+
+    pa_render_pool_free(pool);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Render Pool");
+    tc = tcase_create("renderpool");
+    tcase_add_test(tc, render_pool_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
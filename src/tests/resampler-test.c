@@ -22,6 +22,8 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <getopt.h>
 #include <locale.h>
 
@@ -39,6 +41,7 @@
 #include <pulsecore/memblock.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/sconv.h>
 
 static void dump_block(const char *label, const pa_sample_spec *ss, const pa_memchunk *chunk) {
     void *d;
@@ -253,6 +256,369 @@ static pa_memblock* generate_block(pa_mempool *pool, const pa_sample_spec *ss) {
     return r;
 }
 
+/* Benchmark mode: resample a sine wave with every method, rate pair,
+ * channel count and sample format and print the results as CSV */
+
+#define BENCHMARK_CHUNK_FRAMES 1024
+#define BENCHMARK_FREQUENCY 997.0
+#define BENCHMARK_AMPLITUDE 0.5
+#define BENCHMARK_RIPPLE_POINTS 8
+
+static const struct {
+    uint32_t from, to;
+} benchmark_rates[] = {
+    { 44100, 48000 },
+    { 48000, 44100 },
+    { 8000, 48000 },
+    { 16000, 48000 },
+    { 96000, 48000 },
+};
+
+/* Resample seconds worth of a sine wave, return the output of the
+ * first channel in float and the time spent in pa_resampler_run() */
+static float *benchmark_resample(pa_mempool *pool, pa_resample_method_t method, const pa_sample_spec *a, uint32_t to_rate,
+                                 double freq, double seconds, unsigned *out_frames, pa_usec_t *usec) {
+    pa_resampler *r;
+    pa_sample_spec b;
+    pa_convert_func_t convert;
+    pa_memchunk *in, out;
+    unsigned frames, n_chunks, max_out, i, k, c;
+    float *tmp, *result;
+    pa_usec_t ts;
+
+    b.format = PA_SAMPLE_FLOAT32NE;
+    b.rate = to_rate;
+    b.channels = a->channels;
+
+    if (!(r = pa_resampler_new(pool, a, NULL, &b, NULL, method, 0)))
+        return NULL;
+
+    frames = (unsigned) (seconds * a->rate);
+    n_chunks = (frames + BENCHMARK_CHUNK_FRAMES - 1) / BENCHMARK_CHUNK_FRAMES;
+    max_out = (unsigned) (((uint64_t) frames * to_rate) / a->rate) + BENCHMARK_CHUNK_FRAMES * 8;
+
+    /* Generate all input up front, so that only the resampler is timed */
+    convert = pa_get_convert_from_float32ne_function(a->format);
+    in = pa_xnew(pa_memchunk, n_chunks);
+    tmp = pa_xnew(float, BENCHMARK_CHUNK_FRAMES * a->channels);
+
+    for (k = 0; k < n_chunks; k++) {
+        unsigned n = PA_MIN(frames - k * BENCHMARK_CHUNK_FRAMES, (unsigned) BENCHMARK_CHUNK_FRAMES);
+
+        for (i = 0; i < n; i++) {
+            double t = (double) (k * BENCHMARK_CHUNK_FRAMES + i) / a->rate;
+            float v = (float) (BENCHMARK_AMPLITUDE * sin(2 * M_PI * freq * t));
+
+            for (c = 0; c < a->channels; c++)
+                tmp[i * a->channels + c] = v;
+        }
+
+        in[k].memblock = pa_memblock_new(pool, n * pa_frame_size(a));
+        in[k].index = 0;
+        in[k].length = n * pa_frame_size(a);
+
+        convert(n * a->channels, tmp, pa_memblock_acquire(in[k].memblock));
+        pa_memblock_release(in[k].memblock);
+    }
+
+    pa_xfree(tmp);
+
+    result = pa_xnew(float, max_out);
+    *out_frames = 0;
+    *usec = 0;
+
+    for (k = 0; k < n_chunks; k++) {
+        const float *d;
+
+        ts = pa_rtclock_now();
+        pa_resampler_run(r, &in[k], &out);
+        *usec += pa_rtclock_now() - ts;
+
+        pa_memblock_unref(in[k].memblock);
+
+        if (!out.memblock)
+            continue;
+
+        d = (const float *) ((uint8_t *) pa_memblock_acquire(out.memblock) + out.index);
+        for (i = 0; i < out.length / pa_frame_size(&b) && *out_frames < max_out; i++)
+            result[(*out_frames)++] = d[i * b.channels];
+        pa_memblock_release(out.memblock);
+        pa_memblock_unref(out.memblock);
+    }
+
+    pa_xfree(in);
+    pa_resampler_free(r);
+
+    return result;
+}
+
+/* Least squares fit of a sine of the given frequency plus DC offset.
+ * Returns the ratio of the residual to the sine power and the
+ * amplitude of the sine. */
+static double benchmark_fit_sine(const float *y, unsigned n, double w, double *amplitude) {
+    double m[3][4];
+    double residual = 0, signal = 0, x[3];
+    unsigned i, j, k;
+
+    memset(m, 0, sizeof(m));
+
+    for (k = 0; k < n; k++) {
+        double v[3] = { sin(w * k), cos(w * k), 1 };
+
+        for (i = 0; i < 3; i++) {
+            for (j = 0; j < 3; j++)
+                m[i][j] += v[i] * v[j];
+            m[i][3] += v[i] * y[k];
+        }
+    }
+
+    /* Gaussian elimination, the system is well conditioned */
+    for (i = 0; i < 3; i++)
+        for (j = i + 1; j < 3; j++) {
+            double f = m[j][i] / m[i][i];
+
+            for (k = i; k < 4; k++)
+                m[j][k] -= f * m[i][k];
+        }
+
+    for (i = 3; i > 0; i--) {
+        x[i - 1] = m[i - 1][3];
+        for (j = i; j < 3; j++)
+            x[i - 1] -= m[i - 1][j] * x[j];
+        x[i - 1] /= m[i - 1][i - 1];
+    }
+
+    for (k = 0; k < n; k++) {
+        double s = x[0] * sin(w * k) + x[1] * cos(w * k);
+
+        residual += (y[k] - s - x[2]) * (y[k] - s - x[2]);
+        signal += s * s;
+    }
+
+    *amplitude = sqrt(x[0] * x[0] + x[1] * x[1]);
+
+    return residual / signal;
+}
+
+/* Analyze the output without the first and last tenth of a second,
+ * where the filters are still settling */
+static double benchmark_analyze(const float *y, unsigned n, uint32_t rate, double freq, double *amplitude) {
+    unsigned skip = rate / 10;
+
+    if (n <= 3 * skip) {
+        *amplitude = 0;
+        return 1;
+    }
+
+    return benchmark_fit_sine(y + skip, n - 2 * skip, 2 * M_PI * freq / rate, amplitude);
+}
+
+/* Peak to peak gain variation over the lower 80% of the common band,
+ * or -1 if it can't be measured. Not NAN, we build with -ffast-math. */
+static double benchmark_ripple(pa_mempool *pool, pa_resample_method_t method, uint32_t from, uint32_t to, double seconds) {
+    pa_sample_spec a;
+    double min_db = 0, max_db = 0;
+    unsigned i;
+
+    a.format = PA_SAMPLE_FLOAT32NE;
+    a.rate = from;
+    a.channels = 1;
+
+    for (i = 1; i <= BENCHMARK_RIPPLE_POINTS; i++) {
+        double freq = 0.4 * PA_MIN(from, to) * i / BENCHMARK_RIPPLE_POINTS, amplitude, db;
+        unsigned n;
+        pa_usec_t usec;
+        float *y;
+
+        if (!(y = benchmark_resample(pool, method, &a, to, freq, seconds, &n, &usec)))
+            return -1;
+
+        benchmark_analyze(y, n, to, freq, &amplitude);
+        pa_xfree(y);
+
+        db = 20 * log10(amplitude / BENCHMARK_AMPLITUDE);
+
+        if (i == 1 || db < min_db)
+            min_db = db;
+        if (i == 1 || db > max_db)
+            max_db = db;
+    }
+
+    return max_db - min_db;
+}
+
+static void benchmark(pa_mempool *pool, pa_resample_method_t only_method, const pa_sample_spec *only, uint32_t only_to_rate, double seconds) {
+    pa_resample_method_t method;
+    pa_sample_spec a;
+    unsigned p;
+
+    printf("method,from_rate,to_rate,channels,format,ns_per_frame,thd_n_db,ripple_db\n");
+
+    for (method = 0; method < PA_RESAMPLER_MAX; method++) {
+
+        /* auto and copy are not resamplers of their own */
+        if (!pa_resample_method_supported(method) || method == PA_RESAMPLER_AUTO || method == PA_RESAMPLER_COPY)
+            continue;
+
+        if (only_method != PA_RESAMPLER_AUTO && method != only_method)
+            continue;
+
+        for (p = 0; p < PA_ELEMENTSOF(benchmark_rates); p++) {
+            double ripple = 0;
+            pa_bool_t have_ripple = FALSE;
+
+            if ((only->rate && benchmark_rates[p].from != only->rate) ||
+                (only_to_rate && benchmark_rates[p].to != only_to_rate))
+                continue;
+
+            /* peaks only reduces the rate */
+            if (method == PA_RESAMPLER_PEAKS && benchmark_rates[p].from < benchmark_rates[p].to)
+                continue;
+
+            for (a.channels = 1; a.channels <= 8; a.channels++) {
+
+                if (only->channels && a.channels != only->channels)
+                    continue;
+
+                for (a.format = 0; a.format < PA_SAMPLE_MAX; a.format++) {
+                    unsigned n;
+                    pa_usec_t usec;
+                    double thd_n, amplitude;
+                    float *y;
+
+                    if (only->format != PA_SAMPLE_INVALID && a.format != only->format)
+                        continue;
+
+                    a.rate = benchmark_rates[p].from;
+
+                    if (!(y = benchmark_resample(pool, method, &a, benchmark_rates[p].to, BENCHMARK_FREQUENCY, seconds, &n, &usec)))
+                        continue;
+
+                    thd_n = benchmark_analyze(y, n, benchmark_rates[p].to, BENCHMARK_FREQUENCY, &amplitude);
+                    pa_xfree(y);
+
+                    /* The frequency response doesn't depend on the
+                     * format and channels, measure it only once */
+                    if (!have_ripple) {
+                        ripple = benchmark_ripple(pool, method, benchmark_rates[p].from, benchmark_rates[p].to, PA_MIN(seconds, 0.5));
+                        have_ripple = TRUE;
+                    }
+
+                    printf("%s,%u,%u,%u,%s,%.2f,%.2f,%.4f\n",
+                           pa_resample_method_to_string(method),
+                           benchmark_rates[p].from, benchmark_rates[p].to,
+                           a.channels, pa_sample_format_to_string(a.format),
+                           (double) usec * 1000 / ((double) seconds * a.rate),
+                           10 * log10(thd_n), ripple);
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+}
+
+/* Input chunk sizes in frames for the silence test. They don't divide
+ * the rates, 441 frames are 10 ms and the large ones give more output
+ * than fits into one memory block. */
+static const unsigned silence_chunk_frames[] = { 100, 333, 7, 441, 40000, 1, 1001, 60000, 3 };
+
+static pa_memblock *silence_test_block(pa_mempool *pool, const pa_sample_spec *ss, unsigned frames, pa_bool_t marked) {
+    pa_memblock *b;
+
+    pa_assert_se(b = pa_memblock_new(pool, frames * pa_frame_size(ss)));
+    pa_silence_memblock(b, ss);
+    pa_memblock_set_is_silence(b, marked);
+
+    return b;
+}
+
+/* Feeds silence to two resamplers, marked as such to one of them and
+ * unmarked to the other. Once the filters had their 10 ms the marked
+ * silence has to come out marked, and both have to give the same amount
+ * of output and carry on alike when the input stops being silent. */
+static int silence_test(pa_mempool *pool, pa_resample_method_t method) {
+    pa_resampler *marked, *unmarked;
+    pa_sample_spec a, b;
+    pa_memchunk i, j, k;
+    uint64_t marked_length = 0, unmarked_length = 0;
+    unsigned u, lap, silent_frames;
+    int ret = 0;
+
+    a.format = b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = 1;
+    a.rate = 44100;
+    b.rate = 48000;
+
+    pa_assert_se(marked = pa_resampler_new(pool, &a, NULL, &b, NULL, method, 0));
+    pa_assert_se(unmarked = pa_resampler_new(pool, &a, NULL, &b, NULL, method, 0));
+
+    for (lap = 0; lap < 2; lap++) {
+        silent_frames = 0;
+
+        for (u = 0; u < PA_ELEMENTSOF(silence_chunk_frames); u++) {
+            i.index = 0;
+            i.length = silence_chunk_frames[u] * pa_frame_size(&a);
+
+            i.memblock = silence_test_block(pool, &a, silence_chunk_frames[u], FALSE);
+            pa_resampler_run(unmarked, &i, &j);
+            pa_memblock_unref(i.memblock);
+
+            i.memblock = silence_test_block(pool, &a, silence_chunk_frames[u], TRUE);
+            pa_resampler_run(marked, &i, &k);
+            pa_memblock_unref(i.memblock);
+
+            if (j.memblock) {
+                unmarked_length += j.length;
+                pa_memblock_unref(j.memblock);
+            }
+
+            if (k.memblock) {
+                marked_length += k.length;
+
+                if (silent_frames >= a.rate / 100 && !pa_memblock_is_silence(k.memblock)) {
+                    pa_log_error("%s: silence not marked after %u frames", pa_resample_method_to_string(method), silent_frames);
+                    ret = -1;
+                }
+
+                pa_memblock_unref(k.memblock);
+            }
+
+            silent_frames += silence_chunk_frames[u];
+        }
+
+        if (marked_length != unmarked_length) {
+            pa_log_error("%s: %llu bytes from marked silence, %llu bytes from unmarked silence", pa_resample_method_to_string(method),
+                         (unsigned long long) marked_length, (unsigned long long) unmarked_length);
+            ret = -1;
+        }
+
+        /* Sound again */
+        pa_memchunk_sine(&i, pool, a.rate, 997);
+        pa_resampler_run(unmarked, &i, &j);
+        pa_resampler_run(marked, &i, &k);
+        pa_memblock_unref(i.memblock);
+
+        if (j.length != k.length || pa_memblock_is_silence(k.memblock) ||
+            memcmp((uint8_t*) pa_memblock_acquire(j.memblock) + j.index,
+                   (uint8_t*) pa_memblock_acquire(k.memblock) + k.index, j.length) != 0) {
+            pa_log_error("%s: output differs after silence", pa_resample_method_to_string(method));
+            ret = -1;
+        }
+
+        pa_memblock_release(j.memblock);
+        pa_memblock_release(k.memblock);
+        marked_length += k.length;
+        unmarked_length += j.length;
+        pa_memblock_unref(j.memblock);
+        pa_memblock_unref(k.memblock);
+    }
+
+    pa_resampler_free(marked);
+    pa_resampler_free(unmarked);
+
+    return ret;
+}
+
 static void help(const char *argv0) {
     printf(_("%s [options]\n\n"
              "-h, --help                            Show this help\n"
@@ -264,7 +630,13 @@ static void help(const char *argv0) {
              "      --to-format=SAMPLEFORMAT        To sample type (defaults to s16le)\n"
              "      --to-channels=CHANNELS          To number of channels (defaults to 1)\n"
              "      --resample-method=METHOD        Resample method (defaults to auto)\n"
-             "      --seconds=SECONDS               From stream duration (defaults to 60)\n"
+             "      --seconds=SECONDS               From stream duration (defaults to 60, 1 for --benchmark)\n"
+             "      --benchmark                     Measure all resample methods and print CSV\n"
+             "\n"
+             "With --benchmark, a sine wave is resampled to float32ne with every resample\n"
+             "method for common rate pairs, 1 to 8 channels and all sample types. The time\n"
+             "per input frame, THD+N and passband ripple are printed as CSV. The --from-*,\n"
+             "--to-rate and --resample-method options restrict the benchmark.\n"
              "\n"
              "If the formats are not specified, the test performs all formats combinations,\n"
              "back and forth.\n"
@@ -286,7 +658,8 @@ enum {
     ARG_TO_CHANNELS,
     ARG_SECONDS,
     ARG_RESAMPLE_METHOD,
-    ARG_DUMP_RESAMPLE_METHODS
+    ARG_DUMP_RESAMPLE_METHODS,
+    ARG_BENCHMARK
 };
 
 static void dump_resample_methods(void) {
@@ -302,9 +675,11 @@ int main(int argc, char *argv[]) {
     pa_mempool *pool = NULL;
     pa_sample_spec a, b;
     int ret = 1, c;
-    pa_bool_t all_formats = TRUE;
+    pa_bool_t all_formats = TRUE, run_benchmark = FALSE;
     pa_resample_method_t method;
     int seconds;
+    pa_sample_spec only = { PA_SAMPLE_INVALID, 0, 0 };
+    uint32_t only_to_rate = 0;
 
     static const struct option long_options[] = {
         {"help",                  0, NULL, 'h'},
@@ -319,6 +694,7 @@ int main(int argc, char *argv[]) {
         {"seconds",               1, NULL, ARG_SECONDS},
         {"resample-method",       1, NULL, ARG_RESAMPLE_METHOD},
         {"dump-resample-methods", 0, NULL, ARG_DUMP_RESAMPLE_METHODS},
+        {"benchmark",             0, NULL, ARG_BENCHMARK},
         {NULL,                    0, NULL, 0}
     };
 
@@ -338,7 +714,7 @@ int main(int argc, char *argv[]) {
     a.format = b.format = PA_SAMPLE_S16LE;
 
     method = PA_RESAMPLER_AUTO;
-    seconds = 60;
+    seconds = -1;
 
     while ((c = getopt_long(argc, argv, "hv", long_options, NULL)) != -1) {
 
@@ -363,16 +739,16 @@ int main(int argc, char *argv[]) {
                 goto quit;
 
             case ARG_FROM_CHANNELS:
-                a.channels = (uint8_t) atoi(optarg);
+                a.channels = only.channels = (uint8_t) atoi(optarg);
                 break;
 
             case ARG_FROM_SAMPLEFORMAT:
-                a.format = pa_parse_sample_format(optarg);
+                a.format = only.format = pa_parse_sample_format(optarg);
                 all_formats = FALSE;
                 break;
 
             case ARG_FROM_SAMPLERATE:
-                a.rate = (uint32_t) atoi(optarg);
+                a.rate = only.rate = (uint32_t) atoi(optarg);
                 break;
 
             case ARG_TO_CHANNELS:
@@ -385,7 +761,7 @@ int main(int argc, char *argv[]) {
                 break;
 
             case ARG_TO_SAMPLERATE:
-                b.rate = (uint32_t) atoi(optarg);
+                b.rate = only_to_rate = (uint32_t) atoi(optarg);
                 break;
 
             case ARG_SECONDS:
@@ -401,13 +777,28 @@ int main(int argc, char *argv[]) {
                 method = pa_parse_resample_method(optarg);
                 break;
 
+            case ARG_BENCHMARK:
+                run_benchmark = TRUE;
+                break;
+
             default:
                 goto quit;
         }
     }
 
     ret = 0;
-    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+
+    if (run_benchmark) {
+        /* Keep the output parseable */
+        setlocale(LC_NUMERIC, "C");
+        pa_log_set_level(PA_LOG_WARN);
+
+        benchmark(pool, method, &only, only_to_rate, seconds < 0 ? 1 : seconds);
+        goto quit;
+    }
+
+    if (seconds < 0)
+        seconds = 60;
 
     if (!all_formats) {
 
@@ -441,6 +832,13 @@ int main(int argc, char *argv[]) {
         goto quit;
     }
 
+    if (silence_test(pool, PA_RESAMPLER_TRIVIAL) < 0 ||
+        silence_test(pool, PA_RESAMPLER_POLYPHASE) < 0 ||
+        (method != PA_RESAMPLER_AUTO && silence_test(pool, method) < 0)) {
+        ret = 1;
+        goto quit;
+    }
+
     for (a.format = 0; a.format < PA_SAMPLE_MAX; a.format ++) {
         for (b.format = 0; b.format < PA_SAMPLE_MAX; b.format ++) {
             pa_resampler *forth, *back;
@@ -23,9 +23,16 @@
 
 #include <check.h>
 #include <signal.h>
+#include <string.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/histogram.h>
 #include <pulsecore/poll.h>
 #include <pulsecore/log.h>
+#include <pulsecore/macro.h>
 #include <pulsecore/rtpoll.h>
 
 static int before(pa_rtpoll_item *i) {
@@ -84,6 +91,65 @@ START_TEST (rtpoll_test) {
 }
 END_TEST
 
+/* How late pa_rtpoll_run() returns for the timer, like a timer
+ * scheduled ALSA sink would see it */
+#define N_WAKEUPS 500
+#define PERIOD_USEC 1000
+
+static void measure_lateness(pa_bool_t timerfd) {
+    pa_histogram histogram;
+    uint32_t counts[PA_HISTOGRAM_BUCKETS];
+    pa_usec_t deadline, lateness, sum = 0, max = 0, histogram_max;
+    pa_rtpoll *p;
+    unsigned i;
+    char *t;
+
+    pa_histogram_reset(&histogram);
+
+    p = pa_rtpoll_new();
+    pa_rtpoll_set_lateness_histogram(p, &histogram);
+
+    if (timerfd && pa_rtpoll_enable_timerfd(p) < 0) {
+        pa_log("timerfd not supported, skipping.");
+        pa_rtpoll_free(p);
+        return;
+    }
+
+    deadline = pa_rtclock_now();
+
+    for (i = 0; i < N_WAKEUPS; i++) {
+        deadline += PERIOD_USEC;
+        pa_rtpoll_set_timer_absolute(p, deadline);
+
+        fail_unless(pa_rtpoll_run(p, TRUE) > 0);
+        fail_unless(pa_rtpoll_timer_elapsed(p));
+
+        lateness = pa_rtclock_now() - deadline;
+        fail_unless(lateness < PA_USEC_PER_SEC);
+
+        sum += lateness;
+        max = PA_MAX(max, lateness);
+    }
+
+    pa_rtpoll_free(p);
+
+    /* rtpoll takes its measurement before we take ours */
+    fail_unless(pa_histogram_get(&histogram, counts, &histogram_max) == N_WAKEUPS);
+    fail_unless(histogram_max <= max);
+
+    t = pa_histogram_to_string(&histogram);
+    pa_log("Wakeup lateness with %s: avg %llu usec, max %llu usec, %s",
+           timerfd ? "timerfd" : "poll() timeout",
+           (unsigned long long) (sum / N_WAKEUPS), (unsigned long long) max, t);
+    pa_xfree(t);
+}
+
+START_TEST (rtpoll_timer_test) {
+    measure_lateness(FALSE);
+    measure_lateness(TRUE);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -93,6 +159,7 @@ int main(int argc, char *argv[]) {
     s = suite_create("RT Poll");
     tc = tcase_create("rtpoll");
     tcase_add_test(tc, rtpoll_test);
+    tcase_add_test(tc, rtpoll_timer_test);
     /* the default timeout is too small,
      * set it to a reasonable large one.
      */
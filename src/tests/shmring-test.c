@@ -0,0 +1,325 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include <check.h>
+
+#include <pulsecore/shmring.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#define RING_SIZE 4096
+
+/* Layout of the segment as documented in PROTOCOL */
+#define FRAMES_OFFSET 128
+#define WRITE_INDEX_OFFSET 0
+#define TYPE_PAD 0xFFFFFFFFU
+
+struct rings {
+    pa_shmring *writer, *reader;
+    uint8_t *memory;
+    size_t memory_size;
+};
+
+static pa_shmring *attach(pa_shmring *writer, size_t size) {
+    return pa_shmring_attach(fcntl(pa_shmring_get_memfd(writer), F_DUPFD_CLOEXEC, 3),
+                             fcntl(pa_shmring_get_eventfd(writer), F_DUPFD_CLOEXEC, 3),
+                             size);
+}
+
+/* Returns FALSE if the ring couldn't be created, i.e. there's no memfd
+ * or eventfd support */
+static pa_bool_t rings_new(struct rings *r) {
+    if (!(r->writer = pa_shmring_new(RING_SIZE)))
+        return FALSE;
+
+    fail_unless(pa_shmring_get_size(r->writer) == RING_SIZE);
+    fail_unless((r->reader = attach(r->writer, RING_SIZE)) != NULL);
+
+    /* A mapping of our own, to play the misbehaving client */
+    r->memory_size = FRAMES_OFFSET + RING_SIZE;
+    r->memory = mmap(NULL, r->memory_size, PROT_READ|PROT_WRITE, MAP_SHARED, pa_shmring_get_memfd(r->writer), 0);
+    fail_unless(r->memory != MAP_FAILED);
+
+    return TRUE;
+}
+
+static void rings_free(struct rings *r) {
+    munmap(r->memory, r->memory_size);
+    pa_shmring_free(r->reader);
+    pa_shmring_free(r->writer);
+}
+
+static void fill(uint8_t *data, size_t length, unsigned seed) {
+    size_t i;
+
+    for (i = 0; i < length; i++)
+        data[i] = (uint8_t) (seed + i);
+}
+
+static void check_frame(pa_shmring *r, uint32_t type, int64_t offset, size_t length, unsigned seed) {
+    pa_shmring_frame f;
+    const void *data;
+    uint8_t expected[RING_SIZE];
+
+    fail_unless(pa_shmring_peek(r, &f, &data) == 1);
+    fail_unless(f.type == type);
+    fail_unless(f.offset == offset);
+    fail_unless(f.length == length);
+
+    fill(expected, length, seed);
+    fail_unless(memcmp(data, expected, length) == 0);
+
+    pa_shmring_drop(r);
+}
+
+static void check_empty(pa_shmring *r) {
+    pa_shmring_frame f;
+    const void *data;
+
+    fail_unless(pa_shmring_peek(r, &f, &data) == 0);
+}
+
+static void push(pa_shmring *r, uint32_t type, size_t length, unsigned seed) {
+    uint8_t data[RING_SIZE];
+
+    fill(data, length, seed);
+    fail_unless(pa_shmring_push(r, type, (int64_t) seed, data, length) == 0);
+}
+
+#define WRAP_FRAMES 1000
+#define WRAP_LENGTH(i) (1 + ((i) * 97) % 1000)
+
+START_TEST (wraparound_test) {
+    struct rings r;
+    unsigned i, next = 0;
+
+    if (!rings_new(&r))
+        return;
+
+    /* Frame sizes that don't divide the ring size, so that the frames
+     * end up everywhere and padding is needed on every lap. Now and
+     * then a frame is left in the ring while the next one is pushed. */
+    for (i = 0; i < WRAP_FRAMES; i++) {
+        push(r.writer, i % 4, WRAP_LENGTH(i), i);
+
+        if (i % 3 == 0)
+            continue;
+
+        for (; next <= i; next++)
+            check_frame(r.reader, next % 4, (int64_t) next, WRAP_LENGTH(next), next);
+
+        check_empty(r.reader);
+    }
+
+    for (; next < WRAP_FRAMES; next++)
+        check_frame(r.reader, next % 4, (int64_t) next, WRAP_LENGTH(next), next);
+
+    check_empty(r.reader);
+    rings_free(&r);
+}
+END_TEST
+
+/* Checks that pa_shmring_push_max() tells the truth */
+static void push_max(pa_shmring *r, size_t expected, unsigned seed) {
+    uint8_t data[RING_SIZE + 1];
+    size_t max;
+
+    max = pa_shmring_push_max(r);
+    fail_unless(max == expected);
+
+    fail_unless(pa_shmring_push(r, 0, 0, data, max + 1) < 0);
+
+    if (max > 0)
+        push(r, 0, max, seed);
+}
+
+START_TEST (full_test) {
+    struct rings r;
+    uint8_t data[RING_SIZE + 1];
+
+    if (!rings_new(&r))
+        return;
+
+    /* Oversized frames never fit */
+    fail_unless(pa_shmring_push(r.writer, 0, 0, data, RING_SIZE + 1) < 0);
+
+    /* Move away from the start of the ring */
+    push(r.writer, 0, 1000, 0);
+    check_frame(r.reader, 0, 0, 1000, 0);
+
+    /* Fill up to the end, then the part before the read index */
+    push_max(r.writer, RING_SIZE - 1024 - sizeof(pa_shmring_frame), 1);
+    push_max(r.writer, 1024 - sizeof(pa_shmring_frame), 2);
+    push_max(r.writer, 0, 3);
+
+    check_frame(r.reader, 0, 1, RING_SIZE - 1024 - sizeof(pa_shmring_frame), 1);
+    check_frame(r.reader, 0, 2, 1024 - sizeof(pa_shmring_frame), 2);
+    check_empty(r.reader);
+
+    /* This one doesn't fit before the end, the writer pads and the
+     * reader skips the padding */
+    push(r.writer, 1, 2000, 4);
+    check_frame(r.reader, 1, 4, 2000, 4);
+    push(r.writer, 2, 1500, 5);
+    check_frame(r.reader, 2, 5, 1500, 5);
+    check_empty(r.reader);
+
+    /* Barriers are frames without payload */
+    fail_unless(pa_shmring_push(r.writer, 0x100, 7, NULL, 0) == 0);
+    check_frame(r.reader, 0x100, 7, 0, 0);
+    check_empty(r.reader);
+
+    rings_free(&r);
+}
+END_TEST
+
+static void write_header(struct rings *r, size_t pos, uint32_t length, uint32_t type) {
+    pa_shmring_frame f;
+
+    f.length = length;
+    f.type = type;
+    f.offset = 0;
+
+    memcpy(r->memory + FRAMES_OFFSET + pos, &f, sizeof(f));
+}
+
+static void set_write_index(struct rings *r, uint32_t idx) {
+    memcpy(r->memory + WRITE_INDEX_OFFSET, &idx, sizeof(idx));
+}
+
+static void check_corrupt(struct rings *r) {
+    pa_shmring_frame f;
+    const void *data;
+
+    fail_unless(pa_shmring_peek(r->reader, &f, &data) < 0);
+}
+
+START_TEST (corrupt_test) {
+    struct rings r;
+    pa_shmring_frame f;
+    const void *data;
+
+    if (!rings_new(&r))
+        return;
+
+    /* A frame claiming more payload than was written */
+    write_header(&r, 0, 64, 0);
+    set_write_index(&r, 64);
+    check_corrupt(&r);
+    rings_free(&r);
+
+    rings_new(&r);
+
+    /* A frame larger than the ring */
+    write_header(&r, 0, RING_SIZE * 2, 0);
+    set_write_index(&r, RING_SIZE);
+    check_corrupt(&r);
+    rings_free(&r);
+
+    rings_new(&r);
+
+    /* A type the writer can't use */
+    write_header(&r, 0, 0, PA_SHMRING_TYPE_MAX);
+    set_write_index(&r, sizeof(pa_shmring_frame));
+    check_corrupt(&r);
+    rings_free(&r);
+
+    rings_new(&r);
+
+    /* A write index beyond the ring, or not on a frame boundary */
+    set_write_index(&r, RING_SIZE + sizeof(pa_shmring_frame));
+    check_corrupt(&r);
+    set_write_index(&r, 3);
+    check_corrupt(&r);
+    rings_free(&r);
+
+    rings_new(&r);
+
+    /* Padding that doesn't end at the end of the ring */
+    write_header(&r, 0, 64, TYPE_PAD);
+    set_write_index(&r, RING_SIZE);
+    check_corrupt(&r);
+    rings_free(&r);
+
+    rings_new(&r);
+
+    /* Proper padding followed by a frame that runs past the end */
+    write_header(&r, 0, RING_SIZE - sizeof(pa_shmring_frame), TYPE_PAD);
+    set_write_index(&r, RING_SIZE);
+    fail_unless(pa_shmring_peek(r.reader, &f, &data) == 0);
+    write_header(&r, 0, RING_SIZE, 0);
+    set_write_index(&r, RING_SIZE * 2);
+    check_corrupt(&r);
+    rings_free(&r);
+}
+END_TEST
+
+START_TEST (attach_test) {
+    pa_shmring *writer, *reader;
+
+    if (!(writer = pa_shmring_new(RING_SIZE)))
+        return;
+
+    /* Not a power of two, too small, larger than the segment */
+    fail_unless(attach(writer, RING_SIZE + 1024) == NULL);
+    fail_unless(attach(writer, 1024) == NULL);
+    fail_unless(attach(writer, RING_SIZE * 2) == NULL);
+
+    fail_unless((reader = attach(writer, RING_SIZE)) != NULL);
+    pa_shmring_free(reader);
+
+    pa_shmring_free(writer);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Shared Memory Ring");
+    tc = tcase_create("shmring");
+    tcase_add_test(tc, wraparound_test);
+    tcase_add_test(tc, full_test);
+    tcase_add_test(tc, corrupt_test);
+    tcase_add_test(tc, attach_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,544 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/source-output.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#define BLOCK_USEC (PA_USEC_PER_SEC / 10)
+#define INPUT_BYTES 4096
+#define RENDER_BYTES 1024
+#define RENDER_FRAMES (RENDER_BYTES / 4)
+#define CAPTURE_BYTES (4 * RENDER_BYTES)
+
+enum {
+    SINK_MESSAGE_RENDER = PA_SINK_MESSAGE_MAX,
+    SINK_MESSAGE_RENDER_INTO
+};
+
+/* A sink without a device, which renders when the test asks it to, with
+ * one input that keeps handing out the same block and one output on the
+ * monitor source that remembers the last block it got. The device
+ * pretends to have rewindable bytes left to play. */
+struct fixture {
+    pa_mainloop *m;
+    pa_core *core;
+    pa_rtpoll *rtpoll;
+    pa_thread_mq thread_mq;
+    pa_thread *thread;
+
+    pa_sink *sink;
+    pa_sink_input *input;
+    pa_source_output *output;
+
+    pa_memchunk input_data;
+    pa_memblock *monitor_block;
+    size_t rewindable;
+};
+
+static struct fixture f;
+
+/* Called from IO context */
+static void process_rewind(pa_sink *s) {
+    if (s->thread_info.rewind_requested)
+        pa_sink_process_rewind(s, PA_MIN(s->thread_info.rewind_nbytes, f.rewindable));
+}
+
+/* Called from IO context */
+static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    pa_sink *s = PA_SINK(o);
+
+    switch (code) {
+        case SINK_MESSAGE_RENDER:
+        case SINK_MESSAGE_RENDER_INTO:
+
+            process_rewind(s);
+
+            if (code == SINK_MESSAGE_RENDER)
+                pa_sink_render(s, (size_t) offset, data);
+            else
+                pa_sink_render_into(s, data);
+
+            return 0;
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+static void thread_func(void *userdata) {
+    pa_thread_mq_install(&f.thread_mq);
+
+    for (;;) {
+        int ret;
+
+        process_rewind(f.sink);
+
+        if ((ret = pa_rtpoll_run(f.rtpoll, TRUE)) <= 0) {
+            fail_unless(ret == 0);
+            break;
+        }
+    }
+}
+
+/* Called from IO context */
+static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk) {
+    *chunk = *(pa_memchunk*) i->userdata;
+    pa_memblock_ref(chunk->memblock);
+
+    if (chunk->length > length)
+        chunk->length = length;
+
+    return 0;
+}
+
+/* Called from IO context */
+static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+}
+
+/* Called from main context */
+static void sink_input_kill_cb(pa_sink_input *i) {
+    fail("sink input killed");
+}
+
+/* Called from IO context */
+static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk) {
+    if (f.monitor_block)
+        pa_memblock_unref(f.monitor_block);
+
+    f.monitor_block = pa_memblock_ref(chunk->memblock);
+}
+
+/* What an output on the monitor source got, in one piece */
+struct capture {
+    uint8_t data[CAPTURE_BYTES];
+    size_t length;
+};
+
+/* Called from IO context */
+static void source_output_capture_cb(pa_source_output *o, const pa_memchunk *chunk) {
+    struct capture *c = o->userdata;
+    const uint8_t *p;
+
+    fail_unless(c->length + chunk->length <= CAPTURE_BYTES);
+
+    p = pa_memblock_acquire(chunk->memblock);
+    memcpy(c->data + c->length, p + chunk->index, chunk->length);
+    pa_memblock_release(chunk->memblock);
+
+    c->length += chunk->length;
+}
+
+/* Called from IO context */
+static void source_output_process_rewind_cb(pa_source_output *o, size_t nbytes) {
+}
+
+/* Called from main context */
+static void source_output_kill_cb(pa_source_output *o) {
+    fail("source output killed");
+}
+
+/* Adds an input that plays data over and over */
+static pa_sink_input *add_input(pa_memchunk *data) {
+    pa_sink_input_new_data input_data;
+    pa_sink_input *i;
+
+    pa_sink_input_new_data_init(&input_data);
+    input_data.driver = __FILE__;
+    input_data.sink = f.sink;
+    pa_sink_input_new_data_set_sample_spec(&input_data, &f.sink->sample_spec);
+    fail_unless(pa_sink_input_new(&i, f.core, &input_data) == 0);
+    pa_sink_input_new_data_done(&input_data);
+
+    i->pop = sink_input_pop_cb;
+    i->process_rewind = sink_input_process_rewind_cb;
+    i->kill = sink_input_kill_cb;
+    i->userdata = data;
+    pa_sink_input_put(i);
+
+    return i;
+}
+
+static void remove_input(pa_sink_input *i) {
+    pa_sink_input_unlink(i);
+    pa_sink_input_unref(i);
+}
+
+/* Adds an output on the monitor source that resamples to 48 kHz into c */
+static pa_source_output *add_capture(struct capture *c, const pa_cvolume *volume_factor_source) {
+    pa_source_output_new_data output_data;
+    pa_source_output *o;
+    pa_sample_spec ss;
+
+    ss = f.sink->sample_spec;
+    ss.rate = 48000;
+
+    pa_source_output_new_data_init(&output_data);
+    output_data.driver = __FILE__;
+    output_data.source = f.sink->monitor_source;
+    output_data.resample_method = PA_RESAMPLER_POLYPHASE;
+    pa_source_output_new_data_set_sample_spec(&output_data, &ss);
+    if (volume_factor_source)
+        pa_source_output_new_data_apply_volume_factor_source(&output_data, volume_factor_source);
+    fail_unless(pa_source_output_new(&o, f.core, &output_data) == 0);
+    pa_source_output_new_data_done(&output_data);
+
+    o->push = source_output_capture_cb;
+    o->process_rewind = source_output_process_rewind_cb;
+    o->kill = source_output_kill_cb;
+    o->userdata = c;
+    pa_source_output_put(o);
+
+    return o;
+}
+
+static void remove_output(pa_source_output *o) {
+    pa_source_output_unlink(o);
+    pa_source_output_unref(o);
+}
+
+static void fixture_setup(void) {
+    pa_sample_spec ss;
+    pa_sink_new_data sink_data;
+    pa_source_output_new_data output_data;
+    uint8_t *p;
+    unsigned u;
+
+    ss.format = PA_SAMPLE_S16NE;
+    ss.rate = 44100;
+    ss.channels = 2;
+
+    pa_zero(f);
+    fail_unless((f.m = pa_mainloop_new()) != NULL);
+    fail_unless((f.core = pa_core_new(pa_mainloop_get_api(f.m), FALSE, FALSE, 0)) != NULL);
+
+    /* Stream volumes stay with the streams */
+    f.core->flat_volumes = FALSE;
+
+    f.rtpoll = pa_rtpoll_new();
+    pa_thread_mq_init(&f.thread_mq, f.core->mainloop, f.rtpoll);
+
+    pa_sink_new_data_init(&sink_data);
+    sink_data.driver = __FILE__;
+    pa_sink_new_data_set_name(&sink_data, "test-sink");
+    pa_sink_new_data_set_sample_spec(&sink_data, &ss);
+    f.sink = pa_sink_new(f.core, &sink_data, PA_SINK_LATENCY|PA_SINK_DYNAMIC_LATENCY);
+    pa_sink_new_data_done(&sink_data);
+    fail_unless(f.sink != NULL);
+
+    f.sink->parent.process_msg = sink_process_msg;
+    pa_sink_set_asyncmsgq(f.sink, f.thread_mq.inq);
+    pa_sink_set_rtpoll(f.sink, f.rtpoll);
+    pa_sink_set_latency_range(f.sink, 0, BLOCK_USEC);
+    pa_sink_set_max_rewind(f.sink, INPUT_BYTES);
+
+    fail_unless((f.thread = pa_thread_new("test-sink", thread_func, NULL)) != NULL);
+    pa_sink_put(f.sink);
+
+    /* Anything but silence, repeating every 256 bytes, so that every
+     * render of RENDER_BYTES gets the same data */
+    f.input_data.memblock = pa_memblock_new(f.core->mempool, INPUT_BYTES);
+    f.input_data.index = 0;
+    f.input_data.length = INPUT_BYTES;
+
+    p = pa_memblock_acquire(f.input_data.memblock);
+    for (u = 0; u < INPUT_BYTES; u++)
+        p[u] = (uint8_t) (u * 7 + 1);
+    pa_memblock_release(f.input_data.memblock);
+
+    f.input = add_input(&f.input_data);
+
+    pa_source_output_new_data_init(&output_data);
+    output_data.driver = __FILE__;
+    output_data.source = f.sink->monitor_source;
+    pa_source_output_new_data_set_sample_spec(&output_data, &ss);
+    fail_unless(pa_source_output_new(&f.output, f.core, &output_data) == 0);
+    pa_source_output_new_data_done(&output_data);
+
+    f.output->push = source_output_push_cb;
+    f.output->process_rewind = source_output_process_rewind_cb;
+    f.output->kill = source_output_kill_cb;
+    pa_source_output_put(f.output);
+}
+
+static void fixture_teardown(void) {
+    remove_output(f.output);
+    remove_input(f.input);
+    pa_sink_unlink(f.sink);
+    pa_sink_unref(f.sink);
+
+    pa_asyncmsgq_send(f.thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(f.thread);
+    pa_thread_mq_done(&f.thread_mq);
+    pa_rtpoll_free(f.rtpoll);
+
+    if (f.monitor_block)
+        pa_memblock_unref(f.monitor_block);
+    pa_memblock_unref(f.input_data.memblock);
+
+    pa_core_unref(f.core);
+    pa_mainloop_free(f.m);
+}
+
+/* Renders RENDER_BYTES and copies them to dst */
+static void render(int code, uint8_t *dst) {
+    pa_memchunk chunk;
+    const uint8_t *src;
+
+    if (code == SINK_MESSAGE_RENDER)
+        pa_asyncmsgq_send(f.thread_mq.inq, PA_MSGOBJECT(f.sink), SINK_MESSAGE_RENDER, &chunk, RENDER_BYTES, NULL);
+    else {
+        chunk.memblock = pa_memblock_new(f.core->mempool, RENDER_BYTES);
+        chunk.index = 0;
+        chunk.length = RENDER_BYTES;
+        pa_asyncmsgq_send(f.thread_mq.inq, PA_MSGOBJECT(f.sink), SINK_MESSAGE_RENDER_INTO, &chunk, 0, NULL);
+    }
+
+    fail_unless(chunk.length == RENDER_BYTES);
+
+    src = pa_memblock_acquire(chunk.memblock);
+    memcpy(dst, src + chunk.index, RENDER_BYTES);
+    pa_memblock_release(chunk.memblock);
+    pa_memblock_unref(chunk.memblock);
+}
+
+START_TEST (single_input_volume_test) {
+    uint8_t single[RENDER_BYTES], single_into[RENDER_BYTES], mixed[RENDER_BYTES], mixed_into[RENDER_BYTES];
+    pa_memchunk zero;
+    pa_sink_input *second;
+    pa_cvolume v;
+
+    fixture_setup();
+
+    v.channels = 2;
+    v.values[0] = pa_sw_volume_from_linear(0.3);
+    v.values[1] = pa_sw_volume_from_linear(0.8);
+    pa_sink_input_set_volume(f.input, &v, FALSE, TRUE);
+
+    /* One input goes down the single input path... */
+    render(SINK_MESSAGE_RENDER, single);
+    render(SINK_MESSAGE_RENDER_INTO, single_into);
+
+    /* ...and with another one that adds nothing, but isn't known to be
+     * silence, down the path that mixes all of them */
+    zero.memblock = pa_memblock_new(f.core->mempool, INPUT_BYTES);
+    zero.index = 0;
+    zero.length = INPUT_BYTES;
+    memset(pa_memblock_acquire(zero.memblock), 0, INPUT_BYTES);
+    pa_memblock_release(zero.memblock);
+    second = add_input(&zero);
+
+    render(SINK_MESSAGE_RENDER, mixed);
+    render(SINK_MESSAGE_RENDER_INTO, mixed_into);
+
+    fail_unless(pa_atomic_load(&f.sink->io_stats.single_input_renders) == 2);
+
+    fail_unless(memcmp(single, mixed, RENDER_BYTES) == 0);
+    fail_unless(memcmp(single_into, mixed_into, RENDER_BYTES) == 0);
+    fail_unless(memcmp(single, single_into, RENDER_BYTES) == 0);
+
+    remove_input(second);
+    pa_memblock_unref(zero.memblock);
+    fixture_teardown();
+}
+END_TEST
+
+START_TEST (volume_factor_tail_test) {
+    static struct capture half, full;
+    uint8_t out[RENDER_BYTES];
+    pa_source_output *half_output, *full_output;
+    pa_memchunk silence;
+    const int16_t *a, *b;
+    pa_bool_t tail = FALSE;
+    size_t sound_bytes;
+    unsigned u;
+    pa_cvolume v;
+
+    fixture_setup();
+
+    pa_zero(half);
+    pa_zero(full);
+    pa_cvolume_set(&v, 2, pa_sw_volume_from_linear(0.5));
+    half_output = add_capture(&half, &v);
+    full_output = add_capture(&full, NULL);
+
+    silence.memblock = pa_memblock_new(f.core->mempool, INPUT_BYTES);
+    silence.index = 0;
+    silence.length = INPUT_BYTES;
+    memset(pa_memblock_acquire(silence.memblock), 0, INPUT_BYTES);
+    pa_memblock_release(silence.memblock);
+    pa_memblock_set_is_silence(silence.memblock, TRUE);
+
+    /* Some sound, then silence that the resampler still rings into */
+    render(SINK_MESSAGE_RENDER, out);
+    sound_bytes = full.length;
+
+    f.input->userdata = &silence;
+    render(SINK_MESSAGE_RENDER, out);
+    render(SINK_MESSAGE_RENDER, out);
+
+    fail_unless(half.length == full.length);
+
+    a = (const int16_t*) half.data;
+    b = (const int16_t*) full.data;
+
+    for (u = 0; u < full.length / 2; u++) {
+        fail_unless(abs(a[u] - b[u] / 2) <= 1);
+
+        if (u >= sound_bytes / 2 && b[u] != 0)
+            tail = TRUE;
+    }
+
+    fail_unless(tail);
+
+    remove_output(half_output);
+    remove_output(full_output);
+    pa_memblock_unref(silence.memblock);
+    fixture_teardown();
+}
+END_TEST
+
+START_TEST (render_test) {
+    pa_memchunk result;
+
+    fixture_setup();
+
+    pa_asyncmsgq_send(f.thread_mq.inq, PA_MSGOBJECT(f.sink), SINK_MESSAGE_RENDER, &result, RENDER_BYTES, NULL);
+
+    /* The input's own block, for us and for the monitor */
+    fail_unless(result.memblock == f.input_data.memblock);
+    fail_unless(result.length == RENDER_BYTES);
+    fail_unless(f.monitor_block == f.input_data.memblock);
+
+    fail_unless(pa_atomic_load(&f.sink->io_stats.single_input_renders) == 1);
+    fail_unless(pa_atomic_load(&f.sink->io_stats.passthrough_renders) == 1);
+
+    pa_memblock_unref(result.memblock);
+    fixture_teardown();
+}
+END_TEST
+
+START_TEST (render_into_test) {
+    pa_memchunk target;
+    const uint8_t *src, *dst;
+
+    fixture_setup();
+
+    target.memblock = pa_memblock_new(f.core->mempool, RENDER_BYTES);
+    target.index = 0;
+    target.length = RENDER_BYTES;
+
+    pa_asyncmsgq_send(f.thread_mq.inq, PA_MSGOBJECT(f.sink), SINK_MESSAGE_RENDER_INTO, &target, 0, NULL);
+
+    /* The target has the input's data, the monitor the input's block */
+    fail_unless(target.length == RENDER_BYTES);
+    fail_unless(f.monitor_block == f.input_data.memblock);
+
+    src = pa_memblock_acquire(f.input_data.memblock);
+    dst = pa_memblock_acquire(target.memblock);
+    fail_unless(memcmp(src, dst, RENDER_BYTES) == 0);
+    pa_memblock_release(target.memblock);
+    pa_memblock_release(f.input_data.memblock);
+
+    fail_unless(pa_atomic_load(&f.sink->io_stats.single_input_renders) == 1);
+    fail_unless(pa_atomic_load(&f.sink->io_stats.passthrough_renders) == 1);
+
+    pa_memblock_unref(target.memblock);
+    fixture_teardown();
+}
+END_TEST
+
+START_TEST (ramp_rewind_test) {
+    int16_t out[RENDER_BYTES / 2];
+    int16_t *p;
+    unsigned u;
+    float gain;
+
+    fixture_setup();
+
+    p = pa_memblock_acquire(f.input_data.memblock);
+    for (u = 0; u < INPUT_BYTES / 2; u++)
+        p[u] = 16384;
+    pa_memblock_release(f.input_data.memblock);
+
+    /* Half the gain over 882 frames */
+    pa_sink_input_set_volume_ramp(f.input, pa_sw_volume_from_linear(0.5), 20 * PA_USEC_PER_MSEC, PA_VOLUME_RAMP_LINEAR);
+
+    for (u = 0; u < INPUT_BYTES / RENDER_BYTES; u++)
+        render(SINK_MESSAGE_RENDER, (uint8_t*) out);
+
+    /* The device still has the last two renders to play, so the next
+     * ramp starts at frame 512 of the first one */
+    f.rewindable = 2 * RENDER_BYTES;
+    pa_sink_input_set_volume_ramp(f.input, PA_VOLUME_MUTED, 20 * PA_USEC_PER_MSEC, PA_VOLUME_RAMP_LINEAR);
+    render(SINK_MESSAGE_RENDER, (uint8_t*) out);
+
+    gain = 1.0f - 0.5f * 2 * RENDER_FRAMES / 882.0f;
+    fail_unless(abs(out[0] - (int) (16384 * gain)) <= 2);
+    fail_unless(abs(out[1] - (int) (16384 * gain)) <= 2);
+
+    for (u = 1; u < RENDER_FRAMES; u++)
+        fail_unless(out[2 * u] < out[2 * (u - 1)]);
+
+    fixture_teardown();
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Sink Render");
+    tc = tcase_create("sink-render");
+    tcase_add_test(tc, single_input_volume_test);
+    tcase_add_test(tc, volume_factor_tail_test);
+    tcase_add_test(tc, render_test);
+    tcase_add_test(tc, render_into_test);
+    tcase_add_test(tc, ramp_rewind_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,282 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+#include <pulse/proplist.h>
+
+#include <pulsecore/tagstruct.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/native-common.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#define PA_CPU_TEST_RUN_START(l, t1, t2)                        \
+{                                                               \
+    int _j, _k;                                                 \
+    int _times = (t1), _times2 = (t2);                          \
+    pa_usec_t _start, _stop;                                    \
+    pa_usec_t _min = INT_MAX, _max = 0;                         \
+    double _s1 = 0, _s2 = 0;                                    \
+    const char *_label = (l);                                   \
+                                                                \
+    for (_k = 0; _k < _times2; _k++) {                          \
+        _start = pa_rtclock_now();                              \
+        for (_j = 0; _j < _times; _j++)
+
+#define PA_CPU_TEST_RUN_STOP                                    \
+        _stop = pa_rtclock_now();                               \
+                                                                \
+        if (_min > (_stop - _start)) _min = _stop - _start;     \
+        if (_max < (_stop - _start)) _max = _stop - _start;     \
+        _s1 += _stop - _start;                                  \
+        _s2 += (_stop - _start) * (_stop - _start);             \
+    }                                                           \
+    pa_log_debug("%s: %llu usec (avg: %g, min = %llu, max = %llu, stddev = %g).", _label, \
+            (long long unsigned int)_s1,                        \
+            ((double)_s1 / _times2),                            \
+            (long long unsigned int)_min,                       \
+            (long long unsigned int)_max,                       \
+            sqrt(_times2 * _s2 - _s1 * _s1) / _times2);         \
+}
+
+/* A sink input list as a client with a few streams gets it */
+#define N_INPUTS 16
+#define TIMES 1000
+#define TIMES2 20
+
+static pa_proplist *make_proplist(unsigned i) {
+    pa_proplist *p;
+
+    p = pa_proplist_new();
+    pa_proplist_setf(p, PA_PROP_MEDIA_NAME, "Playback Stream %u", i);
+    pa_proplist_sets(p, PA_PROP_MEDIA_ROLE, "music");
+    pa_proplist_sets(p, PA_PROP_APPLICATION_NAME, "Test Player");
+    pa_proplist_sets(p, PA_PROP_APPLICATION_ID, "org.example.TestPlayer");
+    pa_proplist_sets(p, PA_PROP_APPLICATION_ICON_NAME, "audio-x-generic");
+    pa_proplist_setf(p, PA_PROP_APPLICATION_PROCESS_ID, "%u", 1000 + i);
+    pa_proplist_sets(p, PA_PROP_APPLICATION_PROCESS_USER, "user");
+    pa_proplist_sets(p, PA_PROP_APPLICATION_PROCESS_HOST, "localhost");
+    pa_proplist_sets(p, PA_PROP_APPLICATION_PROCESS_BINARY, "test-player");
+    pa_proplist_sets(p, PA_PROP_APPLICATION_LANGUAGE, "en_US.UTF-8");
+    pa_proplist_sets(p, PA_PROP_WINDOW_X11_DISPLAY, ":0");
+    pa_proplist_sets(p, PA_PROP_APPLICATION_PROCESS_MACHINE_ID, "0123456789abcdef0123456789abcdef");
+    pa_proplist_sets(p, "module-stream-restore.id", "sink-input-by-application-name:Test Player");
+
+    return p;
+}
+
+static pa_packet *build_reply(pa_proplist *const*proplists) {
+    pa_tagstruct *t;
+    pa_sample_spec ss;
+    pa_channel_map map;
+    pa_cvolume v;
+    pa_format_info *f;
+    unsigned i;
+
+    ss.format = PA_SAMPLE_S16LE;
+    ss.rate = 44100;
+    ss.channels = 2;
+    pa_channel_map_init_stereo(&map);
+    pa_cvolume_set(&v, 2, PA_VOLUME_NORM);
+
+    f = pa_format_info_new();
+    f->encoding = PA_ENCODING_PCM;
+
+    t = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_putu32(t, PA_COMMAND_REPLY);
+    pa_tagstruct_putu32(t, 4711);
+
+    for (i = 0; i < N_INPUTS; i++) {
+        pa_tagstruct_putu32(t, i);
+        pa_tagstruct_puts(t, pa_proplist_gets(proplists[i], PA_PROP_MEDIA_NAME));
+        pa_tagstruct_putu32(t, PA_INVALID_INDEX);
+        pa_tagstruct_putu32(t, 7);
+        pa_tagstruct_putu32(t, 0);
+        pa_tagstruct_put_sample_spec(t, &ss);
+        pa_tagstruct_put_channel_map(t, &map);
+        pa_tagstruct_put_cvolume(t, &v);
+        pa_tagstruct_put_usec(t, 25000);
+        pa_tagstruct_put_usec(t, 40000);
+        pa_tagstruct_puts(t, "speex-float-1");
+        pa_tagstruct_puts(t, "protocol-native.c");
+        pa_tagstruct_put_boolean(t, FALSE);
+        pa_tagstruct_put_proplist(t, proplists[i]);
+        pa_tagstruct_put_boolean(t, FALSE);
+        pa_tagstruct_put_boolean(t, TRUE);
+        pa_tagstruct_put_boolean(t, TRUE);
+        pa_tagstruct_put_format_info(t, f);
+    }
+
+    pa_format_info_free(f);
+
+    return pa_tagstruct_free_to_packet(t);
+}
+
+static int parse_reply(pa_packet *packet, pa_proplist *const*proplists) {
+    pa_tagstruct *t;
+    uint32_t command, tag;
+    unsigned i;
+    int r = -1;
+
+    t = pa_tagstruct_new(packet->data, packet->length);
+
+    if (pa_tagstruct_getu32(t, &command) < 0 || command != PA_COMMAND_REPLY ||
+        pa_tagstruct_getu32(t, &tag) < 0 || tag != 4711)
+        goto finish;
+
+    for (i = 0; i < N_INPUTS; i++) {
+        uint32_t idx, owner_module, client, sink;
+        const char *name, *resample_method, *driver;
+        pa_sample_spec ss;
+        pa_channel_map map;
+        pa_cvolume v;
+        pa_usec_t buffer_usec, sink_usec;
+        pa_bool_t mute, corked, has_volume, volume_writable;
+        pa_proplist *p;
+        pa_format_info *f;
+
+        p = pa_proplist_new();
+        f = pa_format_info_new();
+
+        if (pa_tagstruct_getu32(t, &idx) < 0 ||
+            pa_tagstruct_gets(t, &name) < 0 ||
+            pa_tagstruct_getu32(t, &owner_module) < 0 ||
+            pa_tagstruct_getu32(t, &client) < 0 ||
+            pa_tagstruct_getu32(t, &sink) < 0 ||
+            pa_tagstruct_get_sample_spec(t, &ss) < 0 ||
+            pa_tagstruct_get_channel_map(t, &map) < 0 ||
+            pa_tagstruct_get_cvolume(t, &v) < 0 ||
+            pa_tagstruct_get_usec(t, &buffer_usec) < 0 ||
+            pa_tagstruct_get_usec(t, &sink_usec) < 0 ||
+            pa_tagstruct_gets(t, &resample_method) < 0 ||
+            pa_tagstruct_gets(t, &driver) < 0 ||
+            pa_tagstruct_get_boolean(t, &mute) < 0 ||
+            pa_tagstruct_get_proplist(t, p) < 0 ||
+            pa_tagstruct_get_boolean(t, &corked) < 0 ||
+            pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
+            pa_tagstruct_get_boolean(t, &volume_writable) < 0 ||
+            pa_tagstruct_get_format_info(t, f) < 0 ||
+            idx != i ||
+            !pa_streq(name, pa_proplist_gets(proplists[i], PA_PROP_MEDIA_NAME)) ||
+            !pa_streq(driver, "protocol-native.c") ||
+            ss.rate != 44100 ||
+            v.values[1] != PA_VOLUME_NORM ||
+            sink_usec != 40000 ||
+            !pa_proplist_equal(p, proplists[i]) ||
+            !volume_writable) {
+
+            pa_proplist_free(p);
+            pa_format_info_free(f);
+            goto finish;
+        }
+
+        pa_proplist_free(p);
+        pa_format_info_free(f);
+    }
+
+    if (pa_tagstruct_eof(t))
+        r = 0;
+
+finish:
+    pa_tagstruct_free(t);
+    return r;
+}
+
+START_TEST (tagstruct_test) {
+    pa_proplist *proplists[N_INPUTS];
+    pa_packet *packet;
+    pa_tagstruct *t;
+    const char *s;
+    unsigned i;
+
+    for (i = 0; i < N_INPUTS; i++)
+        proplists[i] = make_proplist(i);
+
+    packet = build_reply(proplists);
+    pa_log_debug("Sink input list of %u entries takes %lu bytes.", N_INPUTS, (unsigned long) packet->length);
+    fail_unless(parse_reply(packet, proplists) == 0);
+
+    /* A truncated reply must not parse */
+    packet->length--;
+    fail_unless(parse_reply(packet, proplists) < 0);
+    pa_packet_unref(packet);
+
+    /* Strings are not terminated past the end of the data */
+    t = pa_tagstruct_new((const uint8_t*) "tabc", 4);
+    fail_unless(pa_tagstruct_gets(t, &s) < 0);
+    pa_tagstruct_free(t);
+
+    t = pa_tagstruct_new((const uint8_t*) "tabc\0N", 6);
+    fail_unless(pa_tagstruct_gets(t, &s) == 0);
+    fail_unless(pa_streq(s, "abc"));
+    fail_unless(pa_tagstruct_gets(t, &s) == 0);
+    fail_unless(s == NULL);
+    fail_unless(pa_tagstruct_eof(t));
+    pa_tagstruct_free(t);
+
+    PA_CPU_TEST_RUN_START("build sink input list", TIMES, TIMES2) {
+        pa_packet_unref(build_reply(proplists));
+    } PA_CPU_TEST_RUN_STOP
+
+    packet = build_reply(proplists);
+
+    PA_CPU_TEST_RUN_START("parse sink input list", TIMES, TIMES2) {
+        pa_assert_se(parse_reply(packet, proplists) == 0);
+    } PA_CPU_TEST_RUN_STOP
+
+    pa_packet_unref(packet);
+
+    for (i = 0; i < N_INPUTS; i++)
+        pa_proplist_free(proplists[i]);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Tagstruct");
+    tc = tcase_create("tagstruct");
+    tcase_add_test(tc, tagstruct_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
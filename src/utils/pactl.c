@@ -127,6 +127,8 @@ static enum {
     SET_SOURCE_OUTPUT_MUTE,
     SET_SINK_FORMATS,
     SET_PORT_LATENCY_OFFSET,
+    GET_SINK_IO_STATS,
+    GET_SOURCE_IO_STATS,
     SUBSCRIBE
 } action = NONE;
 
@@ -828,6 +830,41 @@ static void get_sample_info_callback(pa_context *c, const pa_sample_info *i, int
     pa_xfree(pl);
 }
 
+static void get_io_stats_callback(pa_context *c, const pa_io_stats_info *i, void *userdata) {
+    uint32_t j, k;
+
+    if (!i) {
+        pa_log(_("Failed to get IO thread statistics: %s"), pa_strerror(pa_context_errno(c)));
+        quit(1);
+        return;
+    }
+
+    printf(action == GET_SINK_IO_STATS ? _("Sink #%u\n") : _("Source #%u\n"), i->index);
+
+    for (j = 0; j < i->n_histograms; j++) {
+        const pa_io_stats_histogram *h = &i->histograms[j];
+        unsigned n = 0;
+
+        for (k = 0; k < h->n_buckets; k++)
+            n += h->buckets[k];
+
+        printf(_("\t%s: %u samples, max %llu usec\n"), h->name, n, (unsigned long long) h->max);
+
+        for (k = 0; k < h->n_buckets; k++) {
+
+            if (h->buckets[k] == 0)
+                continue;
+
+            if (k == h->n_buckets - 1 && k > 0)
+                printf("\t\t>= %u usec: %u\n", 1U << (k - 1), h->buckets[k]);
+            else
+                printf("\t\t< %u usec: %u\n", 1U << k, h->buckets[k]);
+        }
+    }
+
+    complete_action();
+}
+
 static void simple_callback(pa_context *c, int success, void *userdata) {
     if (!success) {
         pa_log(_("Failure: %s"), pa_strerror(pa_context_errno(c)));
@@ -1271,6 +1308,14 @@ static void context_state_callback(pa_context *c, void *userdata) {
                         pa_operation_unref(pa_context_suspend_sink_by_index(c, PA_INVALID_INDEX, suspend, simple_callback, NULL));
                     break;
 
+                case GET_SINK_IO_STATS:
+                    pa_operation_unref(pa_context_get_sink_io_stats_by_name(c, sink_name, get_io_stats_callback, NULL));
+                    break;
+
+                case GET_SOURCE_IO_STATS:
+                    pa_operation_unref(pa_context_get_source_io_stats_by_name(c, source_name, get_io_stats_callback, NULL));
+                    break;
+
                 case SUSPEND_SOURCE:
                     if (source_name)
                         pa_operation_unref(pa_context_suspend_source_by_name(c, source_name, suspend, simple_callback, NULL));
@@ -1500,6 +1545,7 @@ static void help(const char *argv0) {
     printf("%s %s %s %s\n", argv0, _("[options]"), "unload-module ", _("NAME|#N"));
     printf("%s %s %s %s\n", argv0, _("[options]"), "move-(sink-input|source-output)", _("#N SINK|SOURCE"));
     printf("%s %s %s %s\n", argv0, _("[options]"), "suspend-(sink|source)", _("NAME|#N 1|0"));
+    printf("%s %s %s %s\n", argv0, _("[options]"), "get-(sink|source)-io-stats", _("[NAME|#N]"));
     printf("%s %s %s %s\n", argv0, _("[options]"), "set-card-profile ", _("CARD PROFILE"));
     printf("%s %s %s %s\n", argv0, _("[options]"), "set-default-(sink|source)", _("NAME"));
     printf("%s %s %s %s\n", argv0, _("[options]"), "set-(sink|source)-port", _("NAME|#N PORT"));
@@ -1731,6 +1777,28 @@ int main(int argc, char *argv[]) {
             if (pa_atou(argv[optind + 1], &module_index) < 0)
                 module_name = argv[optind + 1];
 
+        } else if (pa_streq(argv[optind], "get-sink-io-stats")) {
+            action = GET_SINK_IO_STATS;
+
+            if (argc > optind+2) {
+                pa_log(_("You may not specify more than one sink."));
+                goto quit;
+            }
+
+            if (argc > optind+1)
+                sink_name = pa_xstrdup(argv[optind+1]);
+
+        } else if (pa_streq(argv[optind], "get-source-io-stats")) {
+            action = GET_SOURCE_IO_STATS;
+
+            if (argc > optind+2) {
+                pa_log(_("You may not specify more than one source."));
+                goto quit;
+            }
+
+            if (argc > optind+1)
+                source_name = pa_xstrdup(argv[optind+1]);
+
         } else if (pa_streq(argv[optind], "suspend-sink")) {
             int b;
 